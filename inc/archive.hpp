@@ -0,0 +1,75 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2024 Dominik Protasewicz
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#pragma once
+
+#include <windows.h>
+#include <cstdint>
+#include <cstddef>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace Archive
+{
+    struct Config {
+        size_t workers;
+        size_t lookahead;
+        size_t cacheBytes;
+    };
+
+    /**
+     * @brief Start the speculative decompression pipeline
+     * @details Redirects the archive file imports of `module` so that every read from an
+     *      `ED6_DT*.dat` archive is remembered together with the offset it came from, and
+     *      starts the worker pool. Once the game decodes an entry it read, the entries
+     *      following it in the same archive are read and decoded ahead of time on the
+     *      workers, and later handed to the game from a bounded cache.
+     *
+     * @param module Module whose archive reads are intercepted
+     * @param config Worker count, how many entries to decode ahead and cache capacity
+     * @return true if the archive reads could be intercepted
+     */
+    bool init(HMODULE module, const Config& config);
+
+    /**
+     * @brief Decode an entry for the game
+     * @details Serves the entry from the cache if a worker already decoded it, waiting if
+     *      it is being decoded right now, and otherwise decodes it on the calling thread.
+     *      Either way the following entries are then queued for the workers. Behaves
+     *      exactly like `Decompress::decode` when the pipeline was not started.
+     *
+     * @param src Compressed stream
+     * @param dst Output buffer, must be large enough for the decoded data
+     * @return Number of bytes written to `dst`
+     */
+    size_t decode(const uint8_t* src, uint8_t* dst);
+
+    /**
+     * @brief Append the pipeline's counters, nothing if it was not started
+     *
+     * @param counters Vector the name and value of each counter are appended to
+     */
+    void counters(std::vector<std::pair<std::string, uint64_t>>* counters);
+}
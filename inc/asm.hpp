@@ -0,0 +1,281 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2024 Dominik Protasewicz
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <cstddef>
+#include <initializer_list>
+#include <string>
+#include <vector>
+
+namespace Asm
+{
+    enum Reg32 : uint8_t { eax, ecx, edx, ebx, esp, ebp, esi, edi };
+    enum Xmm : uint8_t { xmm0, xmm1, xmm2, xmm3, xmm4, xmm5, xmm6, xmm7 };
+
+    /**
+     * @brief Condition codes, in encoding order.
+     */
+    enum class Cond : uint8_t { o, no, b, ae, e, ne, be, a, s, ns, p, np, l, ge, le, g };
+
+    /**
+     * @brief A 32 bit field of a stub that is filled in once the stub is installed.
+     * @details `Absolute` fields receive the address bound to `slot` as is. `Relative`
+     *      fields are the rel32 of a branch and receive the distance from the end of the
+     *      field to that address.
+     */
+    struct Reloc {
+        enum class Kind : uint8_t { Absolute, Relative };
+
+        uint8_t offset;
+        uint8_t slot;
+        Kind kind;
+    };
+
+    /**
+     * @brief An address only known at runtime, bound by index when the stub is installed.
+     */
+    struct Slot {
+        uint8_t index;
+    };
+
+    constexpr Slot slot(uint8_t index) { return { index }; }
+
+    /**
+     * @brief A `[disp32]` memory operand, either a fixed address or a slot.
+     */
+    struct Mem {
+        uint32_t address = 0;
+        int slot = -1;
+
+        constexpr Mem(Slot s) : slot(s.index) {}
+        constexpr explicit Mem(uint32_t address) : address(address) {}
+    };
+
+    /**
+     * @brief An operand as the stub meant it, `slot` is -1 unless it is bound at install.
+     */
+    struct Operand {
+        enum class Kind : uint8_t { Reg32, Xmm, Mem, Imm, Rel };
+
+        Kind kind = Kind::Reg32;
+        uint8_t reg = 0;
+        int slot = -1;
+        uint32_t value = 0;
+    };
+
+    /**
+     * @brief An instruction of a stub, where it starts and what Zydis must decode it to.
+     */
+    struct Instruction {
+        const char* mnemonic = "";
+        uint8_t offset = 0;
+        uint8_t operandCount = 0;
+        std::array<Operand, 2> operands{};
+    };
+
+    /**
+     * @brief Machine code of a stub, assembled at compile time.
+     * @details Each instruction method appends its encoding and returns the stub so they
+     *      can be chained. Stubs are meant to be built in a `constexpr` initializer, where
+     *      running out of room is a compile error:
+     * @code
+     * constexpr auto stub = Asm::Code{}
+     *     .movsd(Asm::xmm0, Asm::slot(0))
+     *     .jmp(Asm::slot(1));
+     * @endcode
+     *      Only the forms fix stubs need are provided, memory operands are always absolute
+     *      `[disp32]` addresses and branches are always rel32.
+     */
+    struct Code {
+        static constexpr size_t CAPACITY = 64;
+        static constexpr size_t MAX_RELOCS = 8;
+        static constexpr size_t MAX_INSTRUCTIONS = 24;
+
+        std::array<uint8_t, CAPACITY> bytes{};
+        size_t size = 0;
+        std::array<Reloc, MAX_RELOCS> relocs{};
+        size_t relocCount = 0;
+        std::array<Instruction, MAX_INSTRUCTIONS> instructions{};
+        size_t instructionCount = 0;
+
+        // Integer, note `mov(reg, slot)` loads the address bound to the slot while
+        // `mov(reg, Mem(slot))` loads the value stored there
+        constexpr Code mov(Reg32 dst, uint32_t value) const { return insn("mov", { of(dst), imm(value) }).op({ (uint8_t)(0xB8 + dst) }).imm32(value); }
+        constexpr Code mov(Reg32 dst, Slot value) const { return insn("mov", { of(dst), imm(value) }).op({ (uint8_t)(0xB8 + dst) }).disp32(Mem(value)); }
+        constexpr Code mov(Reg32 dst, Mem src) const { return insn("mov", { of(dst), of(src) }).op({ 0x8B }).modrm(dst, src); }
+        constexpr Code mov(Mem dst, Reg32 src) const { return insn("mov", { of(dst), of(src) }).op({ 0x89 }).modrm(src, dst); }
+        constexpr Code push(Reg32 reg) const { return insn("push", { of(reg) }).op({ (uint8_t)(0x50 + reg) }); }
+        constexpr Code pop(Reg32 reg) const { return insn("pop", { of(reg) }).op({ (uint8_t)(0x58 + reg) }); }
+        constexpr Code pushfd() const { return insn("pushfd").op({ 0x9C }); }
+        constexpr Code popfd() const { return insn("popfd").op({ 0x9D }); }
+        constexpr Code pushad() const { return insn("pushad").op({ 0x60 }); }
+        constexpr Code popad() const { return insn("popad").op({ 0x61 }); }
+
+        // Scalar SSE, loads from and stores to memory
+        constexpr Code movss(Xmm dst, Mem src) const { return insn("movss", { of(dst), of(src) }).op({ 0xF3, 0x0F, 0x10 }).modrm(dst, src); }
+        constexpr Code movss(Mem dst, Xmm src) const { return insn("movss", { of(dst), of(src) }).op({ 0xF3, 0x0F, 0x11 }).modrm(src, dst); }
+        constexpr Code movsd(Xmm dst, Mem src) const { return insn("movsd", { of(dst), of(src) }).op({ 0xF2, 0x0F, 0x10 }).modrm(dst, src); }
+        constexpr Code movsd(Mem dst, Xmm src) const { return insn("movsd", { of(dst), of(src) }).op({ 0xF2, 0x0F, 0x11 }).modrm(src, dst); }
+        constexpr Code addss(Xmm dst, Mem src) const { return insn("addss", { of(dst), of(src) }).op({ 0xF3, 0x0F, 0x58 }).modrm(dst, src); }
+        constexpr Code addsd(Xmm dst, Mem src) const { return insn("addsd", { of(dst), of(src) }).op({ 0xF2, 0x0F, 0x58 }).modrm(dst, src); }
+        constexpr Code mulss(Xmm dst, Mem src) const { return insn("mulss", { of(dst), of(src) }).op({ 0xF3, 0x0F, 0x59 }).modrm(dst, src); }
+        constexpr Code mulsd(Xmm dst, Mem src) const { return insn("mulsd", { of(dst), of(src) }).op({ 0xF2, 0x0F, 0x59 }).modrm(dst, src); }
+        constexpr Code divss(Xmm dst, Mem src) const { return insn("divss", { of(dst), of(src) }).op({ 0xF3, 0x0F, 0x5E }).modrm(dst, src); }
+        constexpr Code divsd(Xmm dst, Mem src) const { return insn("divsd", { of(dst), of(src) }).op({ 0xF2, 0x0F, 0x5E }).modrm(dst, src); }
+        constexpr Code comiss(Xmm a, Xmm b) const { return insn("comiss", { of(a), of(b) }).op({ 0x0F, 0x2F }).modrm(a, b); }
+        constexpr Code comisd(Xmm a, Xmm b) const { return insn("comisd", { of(a), of(b) }).op({ 0x66, 0x0F, 0x2F }).modrm(a, b); }
+        constexpr Code ucomisd(Xmm a, Xmm b) const { return insn("ucomisd", { of(a), of(b) }).op({ 0x66, 0x0F, 0x2E }).modrm(a, b); }
+
+        // Control flow
+        constexpr Code jmp(Slot target) const { return insn("jmp", { rel(target) }).op({ 0xE9 }).rel32(target); }
+        constexpr Code call(Slot target) const { return insn("call", { rel(target) }).op({ 0xE8 }).rel32(target); }
+        constexpr Code jcc(Cond cond, Slot target) const {
+            // Zydis names, which spell out the negated conditions
+            constexpr const char* names[] = { "jo", "jno", "jb", "jnb", "jz", "jnz", "jbe", "jnbe",
+                "js", "jns", "jp", "jnp", "jl", "jnl", "jle", "jnle" };
+            return insn(names[(uint8_t)cond], { rel(target) }).op({ 0x0F, (uint8_t)(0x80 + (uint8_t)cond) }).rel32(target);
+        }
+        constexpr Code ret() const { return insn("ret").op({ 0xC3 }); }
+        constexpr Code nop() const { return insn("nop").op({ 0x90 }); }
+
+    private:
+        constexpr Code insn(const char* mnemonic, std::initializer_list<Operand> operands = {}) const {
+            Code code = *this;
+            if (code.instructionCount == MAX_INSTRUCTIONS) {
+                throw "Asm::Code: too many instructions";
+            }
+            Instruction& instruction = code.instructions[code.instructionCount++];
+            instruction.mnemonic = mnemonic;
+            instruction.offset = (uint8_t)size;
+            for (auto operand : operands) {
+                instruction.operands[instruction.operandCount++] = operand;
+            }
+            return code;
+        }
+
+        static constexpr Operand of(Reg32 reg) { return { Operand::Kind::Reg32, reg }; }
+        static constexpr Operand of(Xmm reg) { return { Operand::Kind::Xmm, reg }; }
+        static constexpr Operand of(Mem mem) { return { Operand::Kind::Mem, 0, mem.slot, mem.address }; }
+        static constexpr Operand imm(uint32_t value) { return { Operand::Kind::Imm, 0, -1, value }; }
+        static constexpr Operand imm(Slot value) { return { Operand::Kind::Imm, 0, value.index, 0 }; }
+        static constexpr Operand rel(Slot target) { return { Operand::Kind::Rel, 0, target.index, 0 }; }
+
+        constexpr Code op(std::initializer_list<uint8_t> encoding) const {
+            Code code = *this;
+            for (auto byte : encoding) {
+                code.emit(byte);
+            }
+            return code;
+        }
+
+        constexpr void emit(uint8_t byte) {
+            if (size == CAPACITY) {
+                throw "Asm::Code: stub does not fit";
+            }
+            bytes[size++] = byte;
+        }
+
+        constexpr void reloc(Reloc::Kind kind, uint8_t index) {
+            if (relocCount == MAX_RELOCS) {
+                throw "Asm::Code: too many relocations";
+            }
+            relocs[relocCount++] = { (uint8_t)size, index, kind };
+        }
+
+        constexpr Code imm32(uint32_t value) const {
+            Code code = *this;
+            for (int i = 0; i < 4; i++) {
+                code.emit((uint8_t)(value >> (8 * i)));
+            }
+            return code;
+        }
+
+        constexpr Code disp32(Mem mem) const {
+            Code code = *this;
+            if (mem.slot >= 0) {
+                code.reloc(Reloc::Kind::Absolute, (uint8_t)mem.slot);
+            }
+            return code.imm32(mem.address);
+        }
+
+        constexpr Code rel32(Slot target) const {
+            Code code = *this;
+            code.reloc(Reloc::Kind::Relative, target.index);
+            return code.imm32(0);
+        }
+
+        // mod 00, r/m 101 is an absolute [disp32] in 32 bit code
+        constexpr Code modrm(uint8_t reg, Mem mem) const {
+            return op({ (uint8_t)((reg << 3) | 0x05) }).disp32(mem);
+        }
+
+        // mod 11 is register to register
+        constexpr Code modrm(uint8_t reg, uint8_t rm) const {
+            return op({ (uint8_t)(0xC0 | (reg << 3) | rm) });
+        }
+    };
+
+    /**
+     * @brief Whether a stub encodes to exactly the given bytes, for `static_assert`s.
+     */
+    constexpr bool encodes(const Code& code, std::initializer_list<uint8_t> expected) {
+        if (code.size != expected.size()) {
+            return false;
+        }
+        size_t i = 0;
+        for (auto byte : expected) {
+            if (code.bytes[i++] != byte) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    /**
+     * @brief Copy a stub into executable memory and fill in its relocations
+     * @details Stubs are placed in an arena of executable pages that is never freed, so a
+     *      stub stays valid for as long as any hook may jump into it. Before the stub is
+     *      handed out it is decoded again with Zydis and refused unless every instruction
+     *      decodes at the offset it was emitted at, to the mnemonic and operands it was
+     *      emitted with, slots resolved, and the last one ends where the stub does.
+     *
+     * @param code Assembled stub
+     * @param slots Runtime address of every slot the stub refers to, by index
+     * @return Address of the installed stub, or nullptr
+     */
+    void* install(const Code& code, std::initializer_list<uintptr_t> slots);
+
+    /**
+     * @brief Disassemble code with Zydis, one line per instruction
+     *
+     * @param code Start of the code
+     * @param size Number of bytes to disassemble
+     * @return Lines of `address: instruction`, empty if the bytes do not decode
+     *      into whole instructions
+     */
+    std::vector<std::string> disassemble(const void* code, size_t size);
+}
@@ -0,0 +1,204 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2024 Dominik Protasewicz
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+namespace AssetCache
+{
+    /**
+     * @brief Identifies a compressed entry by the archive it lives in and its offset there.
+     */
+    struct Key {
+        uint32_t archive;
+        uint64_t offset;
+
+        bool operator==(const Key& other) const {
+            return archive == other.archive && offset == other.offset;
+        }
+    };
+
+    struct KeyHash {
+        size_t operator()(const Key& key) const {
+            return std::hash<uint64_t>()(key.offset * 31 + key.archive);
+        }
+    };
+
+    /**
+     * @brief A decoded entry together with the compressed source it was decoded from.
+     * @details The whole source is kept so that a hit can be told apart from different data
+     *      that was written to the same offset, both count towards the cache capacity.
+     */
+    struct Entry {
+        std::vector<uint8_t> data;
+        std::vector<uint8_t> source;
+        bool used = false;
+
+        size_t bytes() const {
+            return data.size() + source.size();
+        }
+    };
+
+    struct Stats {
+        uint64_t hits = 0;
+        uint64_t misses = 0;
+        uint64_t inserted = 0;
+        uint64_t evicted = 0;
+        uint64_t evictedUnused = 0;
+        uint64_t rejected = 0;
+        uint64_t starved = 0;
+        size_t bytes = 0;
+        size_t working = 0;
+        size_t entries = 0;
+    };
+
+    /**
+     * @brief Bounded cache of decoded entries with least recently used eviction.
+     * @details The capacity is in bytes of decoded data and source, which in a 32 bit process
+     *      is what actually runs out. The buffers entries are decoded in are charged against
+     *      the same capacity while they exist. Entries being decoded are tracked as in
+     *      flight so that the same entry is never decoded twice concurrently, and so a
+     *      lookup can wait for a decode that is already under way instead of starting its
+     *      own. All members are thread safe.
+     */
+    class Cache {
+    public:
+        enum class Reservation {
+            Reserved,
+            Present,
+            InFlight
+        };
+
+        explicit Cache(size_t capacity);
+
+        /**
+         * @brief Claim an entry for decoding.
+         *
+         * @param key Entry about to be decoded
+         * @return `Reserved` if the caller should decode it, otherwise why not
+         */
+        Reservation reserve(const Key& key);
+
+        /**
+         * @brief Publish a decoded entry claimed with `reserve`, evicting as needed.
+         */
+        void insert(const Key& key, std::shared_ptr<Entry> entry);
+
+        /**
+         * @brief Release a claim after failing to decode the entry.
+         */
+        void abandon(const Key& key);
+
+        /**
+         * @brief Charge working memory against the capacity, evicting entries to make room.
+         *
+         * @param bytes Bytes about to be allocated
+         * @return false if they do not fit even with the cache emptied, nothing is charged then
+         */
+        bool charge(size_t bytes);
+
+        /**
+         * @brief Give back working memory charged with `charge` once it is freed.
+         */
+        void release(size_t bytes);
+
+        /**
+         * @brief Look an entry up for use, counting a hit or miss.
+         *
+         * @param key Entry wanted
+         * @param wait Whether to wait for the entry if it is in flight
+         * @return The entry, or nullptr on a miss
+         */
+        std::shared_ptr<const Entry> take(const Key& key, bool wait);
+
+        /**
+         * @brief Look an entry up without counting it or touching its recency.
+         */
+        std::shared_ptr<const Entry> peek(const Key& key);
+
+        Stats stats();
+
+    private:
+        using Order = std::list<Key>;
+        struct Slot {
+            std::shared_ptr<Entry> entry;
+            Order::iterator position;
+        };
+
+        void evict(size_t reserve);
+
+        std::mutex mutex;
+        std::condition_variable published;
+        std::unordered_map<Key, Slot, KeyHash> slots;
+        std::unordered_set<Key, KeyHash> inFlight;
+        Order order; // Most recently used at the front
+        size_t capacity;
+        Stats counters;
+    };
+
+    /**
+     * @brief Fixed set of threads running jobs from a bounded FIFO queue.
+     */
+    class WorkerPool {
+    public:
+        /**
+         * @param threads Number of worker threads
+         * @param onStart Run on every worker before it takes its first job, e.g. to lower its priority
+         * @param maxQueued Jobs that may wait for a worker before further ones are dropped
+         */
+        WorkerPool(size_t threads, std::function<void()> onStart = {}, size_t maxQueued = SIZE_MAX);
+        ~WorkerPool();
+        WorkerPool(const WorkerPool&) = delete;
+        WorkerPool& operator=(const WorkerPool&) = delete;
+
+        /**
+         * @brief Queue a job for the workers.
+         *
+         * @return false if the queue was full and the job was dropped
+         */
+        bool submit(std::function<void()> job);
+
+    private:
+        void run(std::function<void()> onStart);
+
+        std::mutex mutex;
+        std::condition_variable pending;
+        std::deque<std::function<void()>> jobs;
+        std::vector<std::thread> workers;
+        size_t maxQueued;
+        bool stopping = false;
+    };
+}
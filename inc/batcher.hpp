@@ -0,0 +1,159 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2024 Dominik Protasewicz
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+/**
+ * @brief Merges consecutive small draws into one.
+ * @details The UI and sprites are drawn as one call of a few vertices each. A `Batcher` takes
+ *      those draws, converts strips and fans into triangle lists and appends them to one
+ *      buffer that is handed to its `Sink` as a single triangle list when `flush` is called.
+ *      The caller flushes whenever anything the pending draws depend on is about to change,
+ *      so every draw taken shares the same textures, shaders and render states.
+ */
+namespace Batch
+{
+    /**
+     * @brief Primitive types, the same values as `D3DPRIMITIVETYPE`
+     */
+    enum Primitive : uint32_t {
+        PointList = 1,
+        LineList,
+        LineStrip,
+        TriangleList,
+        TriangleStrip,
+        TriangleFan
+    };
+
+    /**
+     * @brief Number of vertices a draw of `primitives` primitives reads
+     */
+    uint32_t vertexCount(Primitive type, uint32_t primitives);
+
+    /**
+     * @brief Where the draws end up, the device or a recording in the tools.
+     */
+    class Sink {
+    public:
+        virtual ~Sink() = default;
+        virtual void draw(Primitive type, uint32_t primitives, const void* vertices, uint32_t stride) = 0;
+    };
+
+    struct Stats {
+        uint64_t received = 0;  // Draws given to the batcher
+        uint64_t merged = 0;    // Draws that were appended to a batch holding another one
+        uint64_t issued = 0;    // Draws handed to the sink
+    };
+
+    class Batcher {
+    public:
+        /**
+         * @param sink Receives the batched draws
+         * @param smallVertices Draws of more vertices than this are passed on as they are
+         * @param capacity Vertices a batch holds at most
+         */
+        Batcher(Sink* sink, uint32_t smallVertices, uint32_t capacity);
+
+        /**
+         * @brief Take a draw of vertices from memory
+         * @details Triangle draws of at most `smallVertices` vertices are copied into the batch,
+         *      anything else flushes the batch and is passed on.
+         */
+        void draw(Primitive type, uint32_t primitives, const void* vertices, uint32_t stride);
+
+        /**
+         * @brief Hand the pending draws to the sink, a single draw as it was given
+         */
+        void flush();
+
+        bool pending() const { return draws != 0; }
+        const Stats& stats() const { return counts; }
+
+    private:
+        void append(Primitive type, uint32_t primitives, const uint8_t* vertices);
+
+        Sink* sink;
+        uint32_t smallVertices;
+        uint32_t capacity;
+        std::vector<uint8_t> buffer;
+        std::vector<uint8_t> scratch;
+        uint32_t stride = 0;
+        uint32_t draws = 0;
+        Primitive firstType = TriangleList;
+        uint32_t firstPrimitives = 0;
+        Stats counts;
+    };
+
+    /**
+     * @brief Last value of every device state set, to tell which sets change nothing.
+     */
+    class StateCache {
+    public:
+        /**
+         * @brief Record a state being set
+         *
+         * @param kind Kind of state, such as render state or sampler state
+         * @param index Which state of that kind, including its stage or sampler
+         * @param value New value
+         * @return false if the state is known to already have this value
+         */
+        bool changed(uint32_t kind, uint32_t index, uint64_t value);
+
+        /**
+         * @brief Forget every value, for when states were changed without being seen
+         */
+        void forget() { values.clear(); }
+
+    private:
+        std::unordered_map<uint64_t, uint64_t> values;
+    };
+
+    /**
+     * @brief Batch the game's small draws from memory
+     * @details Windows only, implemented in batcherhooks.cpp. Hooks `DrawPrimitiveUP` and
+     *      every device method that changes what a draw depends on, the latter flush the
+     *      batch first unless they set a state to the value it already has. Draws received
+     *      and issued are logged every `logFrames` frames.
+     *
+     * @param smallVertices Draws of more vertices than this are not batched
+     * @param capacity Vertices a batch holds at most
+     * @param logFrames Frames between logging the draw counts, 0 to not log them
+     * @return true if the draws are batched
+     */
+    bool install(uint32_t smallVertices, uint32_t capacity, uint32_t logFrames);
+
+    /**
+     * @brief Append the batcher's counters, nothing if it was not installed
+     *
+     * @param counters Vector the name and value of each counter are appended to
+     */
+    void counters(std::vector<std::pair<std::string, uint64_t>>* counters);
+}
@@ -0,0 +1,91 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2024 Dominik Protasewicz
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#pragma once
+
+#include <cstdint>
+
+/**
+ * @brief Bodies of the mid hook callbacks.
+ * @details Written as templates over the context type so that the exact same code runs
+ *      inside the game on a `SafetyHookContext` and offline on a `HookContext32` when a
+ *      recorded hook trace is replayed by `hookreplay`.
+ */
+namespace Callbacks
+{
+    /**
+     * @brief Every hook site with a mid hook callback, as recorded in hook traces.
+     * @details Sites after `Textures` act on game state outside of the registers, they are
+     *      traced and timed like the others but `run` cannot replay them.
+     */
+    enum Site : uint8_t {
+        KeepAspect,
+        Textures,
+        IntroSkip,
+        SiteCount
+    };
+
+    inline constexpr const char* siteNames[SiteCount] = {
+        "keepAspect",
+        "textures",
+        "introSkip",
+    };
+
+    /**
+     * @brief Clears the zero flag so the keepAspect jne is always taken.
+     */
+    template <typename Context>
+    inline void keepAspect(Context& ctx) {
+        ctx.eflags &= ~0x40; // Clear zero flag
+    }
+
+    /**
+     * @brief Loads 1.0 into xmm0 ahead of the comparison that decides if textures render.
+     */
+    template <typename Context>
+    inline void textures(Context& ctx) {
+        ctx.xmm0.u64[0] = 0x3FF0000000000000;
+    }
+
+    /**
+     * @brief Run the callback of a site
+     *
+     * @param site Hook site
+     * @param ctx Register state to run the callback on
+     * @return false if `site` is unknown or cannot be replayed
+     */
+    template <typename Context>
+    inline bool run(Site site, Context& ctx) {
+        switch (site) {
+        case KeepAspect:
+            keepAspect(ctx);
+            return true;
+        case Textures:
+            textures(ctx);
+            return true;
+        default:
+            return false;
+        }
+    }
+}
@@ -0,0 +1,211 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2024 Dominik Protasewicz
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <cstddef>
+#include <functional>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+/**
+ * @brief Local control channel for querying and tweaking the running fix.
+ * @details Served on a named pipe (`\\.\pipe\<name>`) on Windows and on a Unix domain socket
+ *      (`$XDG_RUNTIME_DIR/<name>.sock`, falling back to `/tmp`) elsewhere. Both directions
+ *      exchange frames of
+ *      [u32 length of the rest][u8 command or status][payload]
+ *      with every value little-endian and strings prefixed by their u16 length. A client
+ *      sends one request frame and reads back one response frame before sending the next.
+ */
+namespace Control
+{
+    enum Command : uint8_t {
+        Ping,        // -> [string version]
+        Counters,    // -> [u16 count]{[string name][u64 value]}
+        Scans,       // -> [u16 count]{[string name][u8 found][u32 rva]}
+        SetFix,      // [string name][u8 enable] ->
+        SetLogLevel  // [u8 spdlog level] ->
+    };
+
+    enum Status : uint8_t {
+        Ok,
+        UnknownCommand,
+        BadRequest,
+        Failed
+    };
+
+    constexpr uint32_t MAX_FRAME = 1024 * 1024;
+
+    /**
+     * @brief Payload of a frame, written and read front to back.
+     * @details Reading past the end yields zeroes and clears `ok`, so a handler can read
+     *      every field and check `ok` once at the end.
+     */
+    class Message {
+    public:
+        Message() = default;
+        explicit Message(std::string bytes) : bytes(std::move(bytes)) {}
+
+        void putU8(uint8_t value) { put(&value, 1); }
+        void putU16(uint16_t value) { put(&value, 2); }
+        void putU32(uint32_t value) { put(&value, 4); }
+        void putU64(uint64_t value) { put(&value, 8); }
+        void putString(std::string_view value);
+
+        uint8_t getU8() { uint8_t value = 0; get(&value, 1); return value; }
+        uint16_t getU16() { uint16_t value = 0; get(&value, 2); return value; }
+        uint32_t getU32() { uint32_t value = 0; get(&value, 4); return value; }
+        uint64_t getU64() { uint64_t value = 0; get(&value, 8); return value; }
+        std::string getString();
+
+        const std::string& data() const { return bytes; }
+        bool ok = true;
+
+    private:
+        void put(const void* value, size_t size);
+        void get(void* value, size_t size);
+
+        std::string bytes;
+        size_t position = 0;
+    };
+
+    /**
+     * @brief Frame a command or status and its payload.
+     */
+    std::string frame(uint8_t code, const Message& payload);
+
+    /**
+     * @brief Split a byte stream back into frames.
+     */
+    class Decoder {
+    public:
+        void feed(const char* data, size_t size) { buffer.append(data, size); }
+
+        /**
+         * @brief Take the next complete frame
+         *
+         * @param code Receives the command or status
+         * @param payload Receives the payload
+         * @return false if no complete frame is buffered yet
+         */
+        bool next(uint8_t* code, Message* payload);
+
+        /**
+         * @brief Whether the peer announced a frame larger than `MAX_FRAME`
+         */
+        bool invalid() const;
+
+    private:
+        std::string buffer;
+    };
+
+    /**
+     * @brief Handles one command, filling in the response payload.
+     */
+    using Handler = std::function<Status(Message& request, Message* response)>;
+
+    /**
+     * @brief Serves the channel on a single background thread.
+     * @details All I/O is non-blocking, overlapped on Windows and `poll` elsewhere, with the
+     *      thread waking up regularly to notice `stop`. One client is served at a time, the
+     *      next one is accepted once it disconnects. Handlers run on the server thread.
+     */
+    class Server {
+    public:
+        explicit Server(std::string name);
+        ~Server();
+        Server(const Server&) = delete;
+        Server& operator=(const Server&) = delete;
+
+        /**
+         * @brief Register the handler of a command, must be called before `start`
+         */
+        void on(uint8_t command, Handler handler);
+
+        /**
+         * @brief Create the endpoint and start serving
+         *
+         * @return false if the endpoint could not be created
+         */
+        bool start();
+
+        /**
+         * @brief Stop serving and wait for the server thread
+         */
+        void stop();
+
+        /**
+         * @brief Full path of the endpoint
+         */
+        const std::string& path() const { return endpoint; }
+
+    private:
+        void run();
+        std::string dispatch(uint8_t command, Message& request);
+
+        std::string endpoint;
+        std::vector<Handler> handlers;
+        std::atomic<bool> running = false;
+        std::thread thread;
+        intptr_t listener = -1;
+    };
+
+    /**
+     * @brief Blocking client for tools.
+     */
+    class Client {
+    public:
+        Client() = default;
+        ~Client();
+        Client(const Client&) = delete;
+        Client& operator=(const Client&) = delete;
+
+        bool connect(const std::string& name);
+
+        /**
+         * @brief Send a request and wait for its response
+         *
+         * @param command Command
+         * @param request Request payload
+         * @param response Receives the response payload
+         * @return Status of the response, `Failed` if the connection broke
+         */
+        Status request(uint8_t command, const Message& request, Message* response);
+
+    private:
+        bool sendAll(const std::string& bytes);
+        bool receiveSome(Decoder* decoder);
+
+        intptr_t connection = -1;
+    };
+
+    /**
+     * @brief Endpoint path for a channel name on this platform.
+     */
+    std::string endpointPath(const std::string& name);
+}
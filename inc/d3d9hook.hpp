@@ -0,0 +1,137 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2024 Dominik Protasewicz
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#pragma once
+
+#include <windows.h>
+#include <d3d9.h>
+#include <cstddef>
+
+namespace D3D9Hook
+{
+    /**
+     * @brief Indices of the `IDirect3DDevice9` methods in its vtable
+     */
+    enum Method : size_t {
+        Reset = 16,
+        Present = 17,
+        CreateTexture = 23,
+        CreateVertexBuffer = 26,
+        CreateIndexBuffer = 27,
+        UpdateSurface = 30,
+        UpdateTexture = 31,
+        GetRenderTargetData = 32,
+        GetFrontBufferData = 33,
+        StretchRect = 34,
+        ColorFill = 35,
+        SetRenderTarget = 37,
+        SetDepthStencilSurface = 39,
+        BeginScene = 41,
+        EndScene = 42,
+        Clear = 43,
+        SetTransform = 44,
+        MultiplyTransform = 46,
+        SetViewport = 47,
+        SetMaterial = 49,
+        SetLight = 51,
+        LightEnable = 53,
+        SetClipPlane = 55,
+        SetRenderState = 57,
+        BeginStateBlock = 60,
+        EndStateBlock = 61,
+        SetTexture = 65,
+        SetTextureStageState = 67,
+        SetSamplerState = 69,
+        SetPaletteEntries = 71,
+        SetCurrentTexturePalette = 73,
+        SetScissorRect = 75,
+        SetSoftwareVertexProcessing = 77,
+        SetNPatchMode = 79,
+        DrawPrimitive = 81,
+        DrawIndexedPrimitive = 82,
+        DrawPrimitiveUP = 83,
+        DrawIndexedPrimitiveUP = 84,
+        ProcessVertices = 85,
+        SetVertexDeclaration = 87,
+        SetFVF = 89,
+        SetVertexShader = 92,
+        SetVertexShaderConstantF = 94,
+        SetVertexShaderConstantI = 96,
+        SetVertexShaderConstantB = 98,
+        SetStreamSource = 100,
+        SetStreamSourceFreq = 102,
+        SetIndices = 104,
+        SetPixelShader = 107,
+        SetPixelShaderConstantF = 109,
+        SetPixelShaderConstantI = 111,
+        SetPixelShaderConstantB = 113,
+        DrawRectPatch = 115,
+        DrawTriPatch = 116,
+        MethodCount = 119
+    };
+
+    /**
+     * @brief Called once per frame just after the game presented it
+     */
+    using PresentCallback = void (*)(IDirect3DDevice9* device);
+
+    /**
+     * @brief Find the device methods and hook `Present`
+     * @details The game creates its device long after the DLL is loaded, so a throwaway device
+     *      is created on a hidden window instead. Every device of the process shares the
+     *      vtable of `d3d9.dll`, the addresses read from the throwaway one are those the
+     *      game's device will call. Calling this again after it succeeded does nothing.
+     *
+     * @return true if the methods were found and `Present` is hooked
+     */
+    bool init();
+
+    /**
+     * @brief Find the device methods from a device the game created and hook `Present`
+     * @details Same as `init` without the cost of a throwaway device, for callers that already
+     *      intercept the game's device creation.
+     *
+     * @param device Any device of the process
+     * @return true if `Present` is hooked
+     */
+    bool init(IDirect3DDevice9* device);
+
+    /**
+     * @brief Address of a device method inside d3d9.dll
+     *
+     * @param method Index of the method
+     * @return Address of the method, nullptr before `init` succeeded
+     */
+    void* method(Method method);
+
+    /**
+     * @brief Register a callback to run every frame
+     * @details Callbacks cannot be removed and are run on the game's render thread in the
+     *      order they were added, at most 8 can be registered.
+     *
+     * @param callback Callback to run
+     * @return true if the callback was registered
+     */
+    bool onPresent(PresentCallback callback);
+}
@@ -0,0 +1,107 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2024 Dominik Protasewicz
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+
+/**
+ * @brief Decoder for the LZ scheme the game compresses its archived assets with.
+ * @details A compressed stream is a sequence of chunks:
+ *
+ * - `u16` chunk length, counting the length field itself
+ * - bit coded body, terminated by an end marker
+ * - `u8` continuation flag, zero if this was the last chunk
+ *
+ * Inside a body, control bits are taken least significant bit first from 16 bit little
+ * endian flag words, which are read from the stream the moment a bit is needed and none
+ * are left. Multi bit values are assembled most significant bit first. The operations are:
+ *
+ * - `0`: Literal, copy the next byte.
+ * - `1 0`: Short match, offset is the next byte, length follows as a count.
+ * - `1 1`: 5 bits and the next byte make a 13 bit offset. Offset 0 ends the chunk,
+ *   offset 1 is a run: `1` + 4 bits + next byte or `0` + 4 bits give the run length
+ *   minus 14, then the byte to repeat. Any other offset is a long match followed by a count.
+ *
+ * Counts are `1` = 2, `01` = 3, `001` = 4, `0001` = 5, `00001` + 3 bits = 6 to 13 and
+ * `00000` + next byte = 14 to 269. Matches copy from the decoded output, and can reach
+ * back into previous chunks.
+ */
+namespace Decompress
+{
+    /**
+     * @brief Returned by the bounded decoders when the stream is corrupt or does not fit.
+     */
+    constexpr size_t error = static_cast<size_t>(-1);
+
+    /**
+     * @brief Decode a stream the same way the game does, trusting it completely
+     * @details Like the game's own routine nothing about the stream is validated and the
+     *      size of the output buffer is unknown, so every copy writes exactly the bytes
+     *      it has to and nothing more. Matches are still copied a word at a time with
+     *      dedicated paths for overlapping matches.
+     *
+     * @param src Compressed stream
+     * @param dst Output buffer, must be large enough for the decoded data
+     * @return Number of bytes written to `dst`
+     */
+    size_t decode(const uint8_t* src, uint8_t* dst);
+
+    /**
+     * @brief Decode a stream whose compressed and decoded sizes are known
+     * @details Every operation is validated against both buffers, once per operation
+     *      rather than once per byte, and copies far enough from the end of `dst` are
+     *      allowed to overshoot by up to a word to keep the copy loops branch free.
+     *
+     * @param src Compressed stream
+     * @param srcSize Size of `src` parameter
+     * @param dst Output buffer
+     * @param dstSize Size of `dst` parameter
+     * @return Number of bytes written to `dst`, or `error`
+     */
+    size_t decode(const uint8_t* src, size_t srcSize, uint8_t* dst, size_t dstSize);
+
+    /**
+     * @brief Size of a compressed stream, found by walking its chunk headers
+     *
+     * @param src Compressed stream
+     * @param srcSize Number of bytes available at `src`
+     * @return Number of bytes the stream occupies, or `error` if it runs past `srcSize`
+     */
+    size_t streamSize(const uint8_t* src, size_t srcSize);
+
+    /**
+     * @brief Byte at a time decoder mirroring the structure of the game's routine
+     * @details Slow, but simple enough to be obviously correct. Used to check the fast
+     *      decoders against.
+     *
+     * @param src Compressed stream
+     * @param srcSize Size of `src` parameter
+     * @param dst Output buffer
+     * @param dstSize Size of `dst` parameter
+     * @return Number of bytes written to `dst`, or `error`
+     */
+    size_t decodeReference(const uint8_t* src, size_t srcSize, uint8_t* dst, size_t dstSize);
+}
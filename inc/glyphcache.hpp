@@ -0,0 +1,278 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2024 Dominik Protasewicz
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <cstdio>
+#include <list>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+/**
+ * @brief Keeps rasterized text glyphs in atlas pages so repeated glyphs are not rasterized again.
+ * @details The engine asks GDI for the bitmap of every character it draws, every time it draws
+ *      it. An `Atlas` packs each bitmap into a page with a skyline allocator and hands out the
+ *      packed copy on later requests. A skyline cannot free single rectangles, so once no page
+ *      has room the new glyph takes over the rectangle of the least recently used glyph it fits
+ *      in. Glyphs are kept in recency order per rectangle size to find it without walking the
+ *      whole atlas. Only when no rectangle is large enough the least recently used page is
+ *      cleared as a whole.
+ *
+ *      Request streams are recorded as a header:
+ *      [u32 magic "GLYF"][u16 version]
+ *      followed by one record per request:
+ *      [u64 font][u64 transform][u32 glyph][u32 format][u32 bitmap bytes][u32 bitmap rows]
+ *      All values are little-endian.
+ */
+namespace GlyphCache
+{
+    constexpr uint32_t MAGIC = 0x46594C47; // "GLYF"
+    constexpr uint16_t VERSION = 1;
+    constexpr size_t METRICS_SIZE = 32;
+    constexpr uint32_t NO_PAGE = ~0u;
+
+    /**
+     * @brief Bottom-left skyline rectangle packer.
+     * @details Keeps the top edge of everything placed so far as a list of horizontal segments
+     *      and places each rectangle where its top ends lowest.
+     */
+    class Skyline {
+    public:
+        Skyline(uint32_t width, uint32_t height);
+
+        /**
+         * @brief Place a rectangle
+         *
+         * @param width Width of the rectangle
+         * @param height Height of the rectangle
+         * @param x Receives the left edge of the placed rectangle
+         * @param y Receives the top edge of the placed rectangle
+         * @return false if there is no room left for it
+         */
+        bool insert(uint32_t width, uint32_t height, uint32_t* x, uint32_t* y);
+
+        /**
+         * @brief Remove every rectangle
+         */
+        void clear();
+
+        uint32_t width() const { return w; }
+        uint32_t height() const { return h; }
+
+        /**
+         * @brief Area covered by the placed rectangles
+         */
+        uint64_t used() const { return area; }
+
+    private:
+        struct Node {
+            uint32_t x, y, width;
+        };
+
+        std::vector<Node> nodes;
+        uint32_t w, h;
+        uint64_t area = 0;
+    };
+
+    /**
+     * @brief Identifies a rasterized glyph.
+     */
+    struct Key {
+        uint64_t font;      // Hash of the font it is rasterized with
+        uint64_t transform; // Hash of the transformation applied to it
+        uint32_t glyph;     // Character code or glyph index
+        uint32_t format;    // Requested bitmap format and flags
+
+        bool operator==(const Key&) const = default;
+    };
+
+    struct KeyHash {
+        size_t operator()(const Key& key) const;
+    };
+
+    /**
+     * @brief A glyph held by an `Atlas`.
+     * @details The bitmap is `rows` rows of `pitch` bytes at `x`, `y` of `page`, whatever
+     *      the bits per pixel. A glyph without a bitmap, such as a space, has no page.
+     */
+    struct Glyph {
+        Key key;
+        uint32_t size;   // Bytes of the bitmap
+        uint32_t pitch;
+        uint32_t rows;
+        uint32_t page;
+        uint32_t x, y;
+        uint64_t used;   // Request count at its last use
+        uint8_t metrics[METRICS_SIZE];
+    };
+
+    struct Stats {
+        uint64_t hits = 0;
+        uint64_t misses = 0;
+        uint64_t inserted = 0;
+        uint64_t rejected = 0;      // Bitmaps larger than a page or not made of whole rows
+        uint64_t evictedPages = 0;
+        uint64_t evictedGlyphs = 0;
+        uint64_t reused = 0;        // Glyphs placed in the rectangle of an evicted one
+    };
+
+    class Atlas {
+    public:
+        /**
+         * @param pageSize Width and height of a page in bytes
+         * @param pages Number of pages
+         */
+        Atlas(uint32_t pageSize, uint32_t pages);
+
+        /**
+         * @brief Look up a glyph and mark it used
+         *
+         * @return The glyph, valid until the next `insert`, nullptr if it is not held
+         */
+        const Glyph* find(const Key& key);
+
+        /**
+         * @brief Pack a glyph into a page, evicting least recently used glyphs if none has room
+         *
+         * @param key Glyph
+         * @param metrics Metrics returned with the bitmap, at most `METRICS_SIZE` bytes
+         * @param metricsSize Size of `metrics`
+         * @param bitmap Bitmap of `rows` rows, may be nullptr if `size` is 0
+         * @param size Bytes of `bitmap`
+         * @param rows Rows of `bitmap`
+         * @return The glyph, valid until the next `insert`, nullptr if it cannot be held
+         */
+        const Glyph* insert(const Key& key, const void* metrics, size_t metricsSize,
+            const uint8_t* bitmap, uint32_t size, uint32_t rows);
+
+        /**
+         * @brief Copy the bitmap of a glyph out of its page
+         *
+         * @param glyph Glyph returned by `find` or `insert`
+         * @param out Receives `glyph.size` bytes
+         */
+        void copy(const Glyph& glyph, uint8_t* out) const;
+
+        const Stats& stats() const { return counts; }
+        size_t glyphs() const { return lookup.size(); }
+
+        /**
+         * @brief Share of the page area covered by packed glyphs
+         */
+        double occupancy() const;
+
+    private:
+        struct Page {
+            Skyline skyline;
+            std::vector<uint8_t> pixels;
+            uint64_t used = 0;
+        };
+
+        using Order = std::list<Key>;
+        struct Entry {
+            Glyph glyph;
+            uint32_t width, height;     // Rectangle it was given, may be larger than its bitmap
+            Order* sizeClass;
+            Order::iterator position;
+        };
+
+        bool reuse(Glyph* glyph, uint32_t* width, uint32_t* height);
+        void evict(uint32_t page);
+
+        std::unordered_map<Key, Entry, KeyHash> lookup;
+        // Glyphs by the width and height of their rectangle, most recently used at the front
+        std::unordered_map<uint64_t, Order> sizeClasses;
+        std::vector<Page> pages;
+        uint32_t pageSize;
+        uint64_t tick = 0;
+        Stats counts;
+    };
+
+    /**
+     * @brief A glyph request as recorded.
+     */
+    struct Request {
+        Key key;
+        uint32_t size;
+        uint32_t rows;
+    };
+
+    /**
+     * @brief Appends glyph requests to a file.
+     * @details Once `maxBytes` have been written further requests are dropped.
+     */
+    class Recorder {
+    public:
+        Recorder(const char* path, uint64_t maxBytes);
+        ~Recorder();
+        Recorder(const Recorder&) = delete;
+        Recorder& operator=(const Recorder&) = delete;
+
+        bool isOpen() const { return file != nullptr; }
+
+        void write(const Request& request);
+
+    private:
+        std::mutex mutex;
+        FILE* file;
+        uint64_t written = 0;
+        uint64_t limit;
+    };
+
+    /**
+     * @brief Read a whole recorded request stream
+     *
+     * @param path Recorded file
+     * @param requests Receives every complete request
+     * @return false if the file could not be read or is not a request stream
+     */
+    bool read(const char* path, std::vector<Request>* requests);
+
+    /**
+     * @brief Serve the game's glyph rasterization from an `Atlas`
+     * @details Windows only, implemented in glyphcachehooks.cpp. Redirects the
+     *      `GetGlyphOutlineA` and `GetGlyphOutlineW` imports of `module`. Bitmap and metrics
+     *      requests are answered from the atlas once GDI has rasterized the glyph, outlines
+     *      are always passed on. Requests are appended to `record` unless it is empty.
+     *
+     * @param module Module whose imports are intercepted
+     * @param pageSize Width and height of a page in bytes
+     * @param pages Number of pages
+     * @param record Path requests are recorded to, empty to not record
+     * @return true if the glyph rasterization could be intercepted
+     */
+    bool install(void* module, uint32_t pageSize, uint32_t pages, const std::string& record);
+
+    /**
+     * @brief Append the cache's counters, nothing if it was not installed
+     *
+     * @param counters Vector the name and value of each counter are appended to
+     */
+    void counters(std::vector<std::pair<std::string, uint64_t>>* counters);
+}
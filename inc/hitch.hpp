@@ -0,0 +1,240 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2024 Dominik Protasewicz
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+/**
+ * @brief Attributes slow frames to what was running while they were produced.
+ * @details Interception points record timed events into a ring owned by the recording thread,
+ *      so recording never takes a lock. Once per frame a `Correlator` drains every ring and,
+ *      for each frame that took longer than a threshold, collects the events overlapping it.
+ *
+ *      Reports are written as a header naming the event kinds:
+ *      [u32 magic "HTCH"][u16 version][u16 kind count]{[u8 length][name]}...
+ *      followed by one record per slow frame:
+ *      [u64 frame start][u64 frame end][u32 event count]{[u64 start][u64 duration][u32 thread][u32 arg][u8 kind]}...
+ *      with times in nanoseconds of the steady clock. All values are little-endian.
+ */
+namespace Hitch
+{
+    constexpr uint32_t MAGIC = 0x48435448; // "HTCH"
+    constexpr uint16_t VERSION = 1;
+    constexpr size_t EVENT_SIZE = 2 * sizeof(uint64_t) + 2 * sizeof(uint32_t) + 1;
+
+    enum Kind : uint8_t {
+        FileRead,   // arg: bytes requested
+        Alloc,      // arg: bytes requested
+        Decode,     // arg: unused
+        Resource,   // arg: D3D9Hook method index
+        Hook,       // arg: Callbacks::Site
+        KindCount
+    };
+
+    inline constexpr const char* kindNames[KindCount] = {
+        "fileRead",
+        "alloc",
+        "decode",
+        "resource",
+        "hook"
+    };
+
+    struct Event {
+        uint64_t start;
+        uint64_t duration;
+        uint32_t thread;
+        uint32_t arg;
+        Kind kind;
+    };
+
+    struct Frame {
+        uint64_t start;
+        uint64_t end;
+        std::vector<Event> events;
+    };
+
+    /**
+     * @brief Per kind totals of a frame's events, clipped to the frame.
+     */
+    struct Summary {
+        uint32_t count[KindCount] = {};
+        uint64_t overlap[KindCount] = {};
+    };
+
+    /**
+     * @brief Set by `start`, nothing is recorded before
+     */
+    inline std::atomic<bool> recording = false;
+
+    /**
+     * @brief Current time of the clock events are recorded in
+     *
+     * @return Nanoseconds of the steady clock
+     */
+    uint64_t now();
+
+    /**
+     * @brief Identifies the calling thread in events
+     *
+     * @return Thread id of the OS on Windows, a hash of the standard library's elsewhere
+     */
+    uint32_t threadId();
+
+    /**
+     * @brief Start accepting events
+     * @details Until this is called `record` returns right away. Events shorter than
+     *      `minDuration` are discarded on the recording thread, which keeps frequent and
+     *      cheap calls such as allocations from flooding the rings.
+     *
+     * @param minDuration Shortest event kept in nanoseconds
+     */
+    void start(uint64_t minDuration);
+
+    /**
+     * @brief Record an event that started at `begin` and ends now
+     * @details Wait free. The first event of a thread takes a ring for it, one left behind by
+     *      an exited thread once drained, otherwise a new one. Rings are never freed. Events
+     *      are dropped, and counted as such, when the thread's ring is full or all rings are
+     *      taken by live threads.
+     *
+     * @param kind What the event was
+     * @param begin Time the event started, from `now`
+     * @param arg Kind specific value
+     */
+    void record(Kind kind, uint64_t begin, uint32_t arg = 0);
+
+    /**
+     * @brief Records the lifetime of the enclosing scope as an event.
+     */
+    class Scope {
+    public:
+        Scope(Kind kind, uint32_t arg = 0)
+            : kind(kind), arg(arg), begin(recording.load(std::memory_order_relaxed) ? now() : 0) {}
+        ~Scope() {
+            if (begin) {
+                record(kind, begin, arg);
+            }
+        }
+        Scope(const Scope&) = delete;
+        Scope& operator=(const Scope&) = delete;
+
+    private:
+        Kind kind;
+        uint32_t arg;
+        uint64_t begin;
+    };
+
+    /**
+     * @brief Turns the events of every thread into slow frame reports.
+     * @details There must be only one, as it is the sole consumer of the rings. A slow frame
+     *      is reported at the following `present`, so that events still running when the
+     *      frame ended, such as a read that held it up, have finished and are included.
+     */
+    class Correlator {
+    public:
+        explicit Correlator(uint64_t threshold) : threshold(threshold) {}
+
+        /**
+         * @brief Mark the end of a frame
+         *
+         * @param time Time the frame was presented, from `now`
+         * @param hitches Receives the slow frames that are now complete
+         */
+        void present(uint64_t time, std::vector<Frame>* hitches);
+
+    private:
+        void drain();
+
+        uint64_t threshold;
+        uint64_t last = 0;
+        std::vector<Event> window;
+        std::vector<Frame> pending;
+    };
+
+    /**
+     * @brief Appends slow frame reports to a file.
+     * @details Once `maxBytes` have been written further reports are dropped.
+     */
+    class Writer {
+    public:
+        Writer(const char* path, uint64_t maxBytes);
+        ~Writer();
+        Writer(const Writer&) = delete;
+        Writer& operator=(const Writer&) = delete;
+
+        bool isOpen() const { return file != nullptr; }
+
+        void write(const Frame& frame);
+
+    private:
+        std::mutex mutex;
+        FILE* file;
+        uint64_t written = 0;
+        uint64_t limit;
+    };
+
+    /**
+     * @brief Sum the events of a frame per kind
+     *
+     * @param frame Slow frame
+     * @return Number of events and the time they overlapped the frame, per kind
+     */
+    Summary summarize(const Frame& frame);
+
+    /**
+     * @brief Read a whole report file
+     *
+     * @param path Report file
+     * @param frames Receives every complete slow frame
+     * @return false if the file could not be read or is not a report
+     */
+    bool read(const char* path, std::vector<Frame>* frames);
+
+    /**
+     * @brief Append the recorder's counters
+     *
+     * @param counters Vector the name and value of each counter are appended to
+     */
+    void counters(std::vector<std::pair<std::string, uint64_t>>* counters);
+
+    /**
+     * @brief Intercept the game's file reads, allocations and Direct3D resource creation
+     * @details Windows only, implemented in hitchhooks.cpp. Also registers the per frame
+     *      callback that feeds a `Correlator` and reports slow frames to the log and `path`.
+     *
+     * @param module Module whose imports are intercepted
+     * @param threshold Frames taking longer are reported, in nanoseconds
+     * @param path Report file
+     * @param maxBytes Largest the report file may grow
+     * @return true if the per frame callback could be registered
+     */
+    bool install(void* module, uint64_t threshold, const char* path, uint64_t maxBytes);
+}
@@ -0,0 +1,92 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2024 Dominik Protasewicz
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+
+/**
+ * @brief Portable copy of the register state a 32 bit mid hook callback receives.
+ * @details Same members, in the same order, as SafetyHook's `Context32`, so callbacks
+ *      written as templates over the context type compile against either. Unlike the
+ *      SafetyHook context its members are fixed width on every platform, which is what
+ *      lets recorded contexts be replayed on a 64 bit Linux host.
+ */
+struct HookContext32 {
+    union Xmm {
+        uint8_t u8[16];
+        uint16_t u16[8];
+        uint32_t u32[4];
+        uint64_t u64[2];
+        float f32[4];
+        double f64[2];
+    };
+
+    Xmm xmm0, xmm1, xmm2, xmm3, xmm4, xmm5, xmm6, xmm7;
+    uint32_t eflags, edi, esi, edx, ecx, ebx, eax, ebp, esp, trampoline_esp, eip;
+};
+
+namespace HookContext
+{
+    /**
+     * @brief Bytes of a context that carry state, i.e. without trailing padding.
+     */
+    constexpr size_t SIZE = offsetof(HookContext32, eip) + sizeof(uint32_t);
+
+    /**
+     * @brief Copy the registers of one context type into another
+     *
+     * @param from Source context, e.g. a `SafetyHookContext`
+     * @param to Destination context
+     */
+    template <typename From, typename To>
+    void copy(const From& from, To* to) {
+        static_assert(sizeof(from.xmm0) == sizeof(to->xmm0));
+        auto xmm = [](const auto& src, auto& dst) {
+            for (int i = 0; i < 2; i++) {
+                dst.u64[i] = src.u64[i];
+            }
+        };
+        xmm(from.xmm0, to->xmm0);
+        xmm(from.xmm1, to->xmm1);
+        xmm(from.xmm2, to->xmm2);
+        xmm(from.xmm3, to->xmm3);
+        xmm(from.xmm4, to->xmm4);
+        xmm(from.xmm5, to->xmm5);
+        xmm(from.xmm6, to->xmm6);
+        xmm(from.xmm7, to->xmm7);
+        to->eflags = from.eflags;
+        to->edi = from.edi;
+        to->esi = from.esi;
+        to->edx = from.edx;
+        to->ecx = from.ecx;
+        to->ebx = from.ebx;
+        to->eax = from.eax;
+        to->ebp = from.ebp;
+        to->esp = from.esp;
+        to->trampoline_esp = from.trampoline_esp;
+        to->eip = from.eip;
+    }
+}
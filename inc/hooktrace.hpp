@@ -0,0 +1,99 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2024 Dominik Protasewicz
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <cstdio>
+#include <chrono>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "hookcontext.hpp"
+
+/**
+ * @brief Binary traces of the contexts seen by mid hooks.
+ * @details A trace starts with a header naming the hook sites:
+ *      [u32 magic "HKTR"][u16 version][u16 site count]{[u8 length][name]}...
+ *      followed by one record per callback invocation:
+ *      [u64 nanoseconds since the trace started][u8 site][context before][context after]
+ *      where each context is the first `HookContext::SIZE` bytes of a `HookContext32`.
+ *      All values are little-endian.
+ */
+namespace HookTrace
+{
+    constexpr uint32_t MAGIC = 0x52544B48; // "HKTR"
+    constexpr uint16_t VERSION = 1;
+    constexpr size_t RECORD_SIZE = sizeof(uint64_t) + 1 + 2 * HookContext::SIZE;
+
+    struct Record {
+        uint64_t timestamp;
+        uint8_t site;
+        HookContext32 before;
+        HookContext32 after;
+    };
+
+    /**
+     * @brief Appends records to a trace file, safe to call from any thread.
+     * @details Records are written through a large stdio buffer, which the CRT flushes
+     *      when the process exits. Once `maxBytes` have been written further records are
+     *      dropped, so a forgotten capture cannot fill the disk.
+     */
+    class Writer {
+    public:
+        Writer(const char* path, const std::vector<std::string>& sites, uint64_t maxBytes);
+        ~Writer();
+        Writer(const Writer&) = delete;
+        Writer& operator=(const Writer&) = delete;
+
+        bool isOpen() const { return file != nullptr; }
+
+        /**
+         * @brief Record one callback invocation
+         *
+         * @param site Index of the hook site in the header
+         * @param before Context the callback received
+         * @param after Context the callback left behind
+         */
+        void write(uint8_t site, const HookContext32& before, const HookContext32& after);
+
+    private:
+        std::mutex mutex;
+        FILE* file;
+        uint64_t written = 0;
+        uint64_t limit;
+        std::chrono::steady_clock::time_point start;
+    };
+
+    /**
+     * @brief Read a whole trace file
+     *
+     * @param path Trace file
+     * @param sites Receives the site names from the header
+     * @param records Receives every complete record
+     * @return false if the file could not be read or is not a trace
+     */
+    bool read(const char* path, std::vector<std::string>* sites, std::vector<Record>* records);
+}
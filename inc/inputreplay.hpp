@@ -0,0 +1,220 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2024 Dominik Protasewicz
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <cstdio>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+/**
+ * @brief Records the input the game polls each frame and plays it back at the same frames.
+ * @details Every poll of an input source is a sample on a channel, numbered by the frame it was
+ *      taken in and its order among the polls of that channel in that frame. Only samples that
+ *      differ from the channel's previous one are written, as the runs of bytes that changed.
+ *      On playback each poll is answered with the last sample recorded at or before its frame
+ *      and order, so the game sees the same input at the same points of the run.
+ *
+ *      Recordings are written as a header:
+ *      [u32 magic "INPT"][u16 version]
+ *      followed by one record per changed sample, all as LEB128 varints:
+ *      [frame delta][channel][order][size][runs]
+ *      and for each run the bytes it replaces:
+ *      [skip][length][length bytes]
+ *      where `skip` counts the unchanged bytes since the end of the previous run. A sample is
+ *      diffed against the channel's previous one padded or cut to its size.
+ */
+namespace InputReplay
+{
+    constexpr uint32_t MAGIC = 0x54504E49; // "INPT"
+    constexpr uint16_t VERSION = 1;
+
+    /**
+     * @brief Input sources, the top byte of a channel.
+     */
+    enum class Source : uint8_t {
+        KeyboardState = 1,  // GetKeyboardState
+        AsyncKeyState = 2,  // GetAsyncKeyState, per virtual key
+        KeyState = 3,       // GetKeyState, per virtual key
+        DeviceState = 4,    // IDirectInputDevice8::GetDeviceState, per device
+        DeviceData = 5,     // IDirectInputDevice8::GetDeviceData, per device
+        Polls = 6,          // Number of polls of the other sources in a frame, taken at its present
+    };
+
+    constexpr uint32_t channel(Source source, uint32_t index = 0) {
+        return ((uint32_t)source << 24) | (index & 0xFFFFFF);
+    }
+
+    struct Stats {
+        uint64_t samples = 0;   // Polls seen
+        uint64_t changed = 0;   // Samples written or played back that differed from the previous
+        uint64_t bytes = 0;     // Bytes written or read
+    };
+
+    /**
+     * @brief Writes the samples of a run to a file.
+     * @details Once `maxBytes` have been written further samples are dropped.
+     */
+    class Recorder {
+    public:
+        Recorder(const char* path, uint64_t maxBytes);
+        ~Recorder();
+        Recorder(const Recorder&) = delete;
+        Recorder& operator=(const Recorder&) = delete;
+
+        bool isOpen() const { return file != nullptr; }
+
+        /**
+         * @brief Record a poll of a channel
+         *
+         * @param frame Frame the poll was made in, never less than that of the previous poll
+         * @param channel Channel polled
+         * @param data What the poll returned
+         * @param size Size of `data`
+         */
+        void sample(uint32_t frame, uint32_t channel, const void* data, uint32_t size);
+
+        /**
+         * @brief Write out buffered records, so a run that is killed keeps most of its input
+         */
+        void flush();
+
+        Stats stats();
+
+    private:
+        struct Channel {
+            uint32_t frame = 0;
+            uint32_t order = 0;
+            std::vector<uint8_t> state;
+        };
+
+        std::mutex mutex;
+        FILE* file;
+        std::unordered_map<uint32_t, Channel> channels;
+        std::vector<uint8_t> buffer;
+        uint32_t lastFrame = 0;
+        uint64_t limit;
+        Stats counts;
+    };
+
+    /**
+     * @brief Reads a recording as the run advances and answers polls from it.
+     * @details Records are read one frame ahead of the polls. Samples of channels the run
+     *      does not poll are collapsed to the latest one before the current frame, so memory
+     *      stays bounded by the samples of a single frame however long the recording is.
+     */
+    class Player {
+    public:
+        explicit Player(const char* path);
+        ~Player();
+        Player(const Player&) = delete;
+        Player& operator=(const Player&) = delete;
+
+        /**
+         * @return false if the file could not be opened or is not a recording
+         */
+        bool isOpen() const { return file != nullptr; }
+
+        /**
+         * @brief Answer a poll of a channel
+         *
+         * @param frame Frame the poll is made in, never less than that of the previous poll
+         * @param channel Channel polled
+         * @param state Receives what the poll returned when recorded
+         * @return false if nothing was recorded for the channel up to this point
+         */
+        bool sample(uint32_t frame, uint32_t channel, std::vector<uint8_t>* state);
+
+        /**
+         * @return true once every record has been played and `frame` is past the last of them
+         */
+        bool finished(uint32_t frame);
+
+        Stats stats();
+
+    private:
+        struct Pending {
+            uint32_t frame;
+            uint32_t order;
+            std::vector<uint8_t> state;
+        };
+
+        struct Channel {
+            uint32_t frame = 0;
+            uint32_t order = 0;
+            bool played = false;
+            std::vector<uint8_t> state;     // Answer to polls
+            std::vector<uint8_t> decoded;   // Latest sample read, what the next record is diffed against
+            std::deque<Pending> pending;
+        };
+
+        bool readRecord();
+        void advance(uint32_t frame);
+        void prune(uint32_t frame);
+
+        std::mutex mutex;
+        FILE* file;
+        std::unordered_map<uint32_t, Channel> channels;
+        uint32_t readFrame = 0;     // Frame of the last record read
+        uint32_t prunedFrame = 0;   // Frame channels were last pruned in
+        bool ended = false;
+        Stats counts;
+    };
+
+    /**
+     * @brief Record or play back the game's input
+     * @details Windows only, implemented in inputreplayhooks.cpp. Hooks the `GetKeyboardState`,
+     *      `GetAsyncKeyState` and `GetKeyState` imports of `module` as well as the DirectInput
+     *      devices it creates through `DirectInput8Create`, numbering them in creation order.
+     *      Frames are counted at every present from the first poll on, so that time spent
+     *      loading before the game reads any input does not shift the recording. The number
+     *      of polls in every frame is recorded as well, and a replay logs the first frame
+     *      polling a different number of times, after which the run has most likely diverged.
+     *      When replaying every poll is still passed on, so devices keep being drained, and
+     *      its result is replaced by the recorded one.
+     *      Unless `telemetry` is empty the duration of every frame is written to it as CSV,
+     *      during a replay until the recording ends.
+     *
+     * @param module Module whose imports are hooked
+     * @param replay true to play `path` back, false to record to it
+     * @param path Recording
+     * @param telemetry Path of the frame time CSV, empty to not write it
+     * @param maxBytes Size the recording stops growing at
+     * @return true if input is recorded or played back
+     */
+    bool install(void* module, bool replay, const char* path, const std::string& telemetry, uint64_t maxBytes);
+
+    /**
+     * @brief Append the recorder's or player's counters, nothing if neither was installed
+     *
+     * @param counters Vector the name and value of each counter are appended to
+     */
+    void counters(std::vector<std::pair<std::string, uint64_t>>* counters);
+}
@@ -0,0 +1,68 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2024 Dominik Protasewicz
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <vector>
+
+namespace PeImage
+{
+    /**
+     * @brief Identifies a particular build of an executable.
+     * @details Taken from the headers, which are laid out the same in the file on disk and
+     *      in the image the loader maps, so the identity computed by the offline tools on
+     *      the executable matches the one computed at runtime on the loaded module.
+     */
+    struct Identity {
+        uint32_t timeDateStamp;
+        uint32_t sizeOfImage;
+        uint32_t checkSum;
+
+        bool operator==(const Identity&) const = default;
+    };
+
+    /**
+     * @brief Read the identity of a PE image from its headers
+     *
+     * @param headers Start of the file or of the loaded module
+     * @param size Number of readable bytes at `headers`
+     * @param identity Filled in on success
+     * @return true if `headers` holds valid PE headers
+     */
+    bool identify(const uint8_t* headers, size_t size, Identity* identity);
+
+    /**
+     * @brief Lay out a PE file the way the loader maps it
+     * @details Headers and sections are copied to their relative virtual addresses and
+     *      the rest is zero filled, so offsets into `image` are RVAs. Relocations and
+     *      imports are not processed, which does not matter for signature scanning.
+     *
+     * @param file Contents of the PE file
+     * @param image Receives `SizeOfImage` bytes of mapped image
+     * @return true if `file` is a valid PE file
+     */
+    bool map(const std::vector<uint8_t>& file, std::vector<uint8_t>* image);
+}
@@ -0,0 +1,112 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2024 Dominik Protasewicz
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+/**
+ * @brief In memory copy of an INI file answering reads the way `GetPrivateProfile*` does.
+ * @details The engine reads its settings from config.ini one key at a time, and every read
+ *      makes Windows open and parse the whole file again. An `Ini` is parsed once and looked
+ *      up by hash afterwards. Sections and keys match case insensitively, the first of
+ *      duplicates wins, names and values are trimmed and a value quoted on both ends loses
+ *      its quotes, all as Windows does.
+ */
+namespace ProfileCache
+{
+    class Ini {
+    public:
+        /**
+         * @brief Parse the contents of an INI file
+         *
+         * @param text Contents of the file, without a byte order mark
+         */
+        explicit Ini(std::string_view text);
+
+        /**
+         * @brief Look up a value
+         *
+         * @param section Section name
+         * @param key Key name
+         * @return The value, nullptr if the section or key does not exist
+         */
+        const std::string* find(std::string_view section, std::string_view key) const;
+
+        /**
+         * @brief Same as `GetPrivateProfileStringA` on the parsed file
+         * @details A null `section` lists the sections and a null `key` the keys of
+         *      `section`, each terminated by a null with a second null ending the list.
+         *
+         * @return Number of characters copied to `buffer`, excluding the terminating null
+         */
+        uint32_t getString(const char* section, const char* key, const char* fallback, char* buffer, uint32_t size) const;
+
+        /**
+         * @brief Same as `GetPrivateProfileIntA` on the parsed file
+         */
+        uint32_t getInt(const char* section, const char* key, int32_t fallback) const;
+
+        size_t sections() const { return order.size(); }
+
+    private:
+        struct Section {
+            std::string name;
+            std::vector<std::pair<std::string, std::string>> entries;
+            std::unordered_map<std::string, size_t> index;
+        };
+
+        std::unordered_map<std::string, Section> lookup;
+        std::vector<std::string> order;
+    };
+
+    /**
+     * @brief Answer the game's reads of config.ini from an `Ini`
+     * @details Windows only, implemented in profilecachehooks.cpp. Redirects the
+     *      `GetPrivateProfileStringA` and `GetPrivateProfileIntA` imports of `module`. The
+     *      first read of each section and key of an INI file given by path is passed on to
+     *      Windows and timed, and checked against the parsed file, later reads are served
+     *      from memory. A single mismatch passes every further read of the file on. The file
+     *      is parsed again whenever its last write time or size changes, and writes through
+     *      `WritePrivateProfile*A` are passed on and drop the cached file. Files given
+     *      without a path are looked up by Windows in its own folder and always passed on.
+     *
+     * @param module Module whose imports are intercepted
+     * @return true if the reads could be intercepted
+     */
+    bool install(void* module);
+
+    /**
+     * @brief Append the cache's counters, nothing if it was not installed
+     *
+     * @param counters Vector the name and value of each counter are appended to
+     */
+    void counters(std::vector<std::pair<std::string, uint64_t>>* counters);
+}
@@ -0,0 +1,49 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2024 Dominik Protasewicz
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#pragma once
+
+// Tracy client zones and frame marks, only compiled in when configured with -DTRACY=ON. Otherwise
+// every macro expands to nothing and release builds carry no trace of the profiler.
+#if defined(TRACY_ENABLE)
+#include "tracy/Tracy.hpp"
+
+// Starts the client, which is built with a manual lifetime so it does not spawn its threads
+// from DllMain under the loader lock. It is never shut down, like everything else owning threads.
+#define PROFILE_STARTUP() tracy::StartupProfiler()
+
+// Times the enclosing scope, named after the enclosing function
+#define PROFILE_ZONE() ZoneScoped
+// Times the enclosing scope under a name that must be a constant expression
+#define PROFILE_ZONE_NAMED(NAME) ZoneScopedN(NAME)
+// Ends the current frame, placed where the game presents
+#define PROFILE_FRAME() FrameMark
+#define PROFILER_ENABLED true
+#else
+#define PROFILE_STARTUP()
+#define PROFILE_ZONE()
+#define PROFILE_ZONE_NAMED(NAME)
+#define PROFILE_FRAME()
+#define PROFILER_ENABLED false
+#endif
@@ -0,0 +1,258 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2024 Dominik Protasewicz
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#if defined(_WIN32)
+#include <windows.h>
+#elif defined(__linux__)
+#include <linux/membarrier.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+/**
+ * @brief Read-copy-update holder for data read far more often than it is written.
+ * @details Writers never modify the published object, they build a complete new one and
+ *      publish it with a single atomic pointer swap. Readers take the current pointer with
+ *      one acquire load and may keep using it for as long as they are pinned, even if a new
+ *      object is published meanwhile.
+ *
+ *      Replaced objects are reclaimed with epochs. A pinned reader announces the global epoch
+ *      it started in through its own slot, an object retired in epoch E is freed once every
+ *      slot is idle or past E. Announcing is a plain store with no fence on the reader side;
+ *      instead the writer, which is rare, issues a process wide barrier before inspecting the
+ *      slots (`FlushProcessWriteBuffers` on Windows, `membarrier` on Linux), which forces
+ *      every reader's announcement to become visible. Where no such barrier is available
+ *      retired objects are simply kept.
+ *
+ *      A thread claims a slot on its first read and gives it back when it exits. Threads
+ *      beyond `MAX_READERS` alive at once share an overflow slot, and nothing is reclaimed
+ *      while any of them is alive.
+ *
+ * @tparam T Type of the published object
+ */
+template <typename T>
+class Rcu {
+public:
+    static constexpr size_t MAX_READERS = 64;
+
+    /**
+     * @brief Pins the calling thread and gives access to the current object.
+     * @details Must not outlive the `Rcu` and must not be nested on the same thread.
+     */
+    class Reader {
+    public:
+        explicit Reader(const Rcu& rcu) : slot(rcu.localSlot()) {
+            slot->epoch.store(rcu.epoch.load(std::memory_order_acquire), std::memory_order_relaxed);
+            std::atomic_signal_fence(std::memory_order_seq_cst);
+            object = rcu.current.load(std::memory_order_acquire);
+        }
+        ~Reader() {
+            slot->epoch.store(IDLE, std::memory_order_release);
+        }
+        Reader(const Reader&) = delete;
+        Reader& operator=(const Reader&) = delete;
+
+        const T* operator->() const { return object; }
+        const T& operator*() const { return *object; }
+
+    private:
+        typename Rcu::Slot* slot;
+        const T* object;
+    };
+
+    Rcu() : current(new T()) {
+        heavyBarrierAvailable = registerHeavyBarrier();
+    }
+
+    ~Rcu() {
+        delete current.load();
+        for (auto& retired : retiredObjects) {
+            delete retired.object;
+        }
+    }
+
+    Rcu(const Rcu&) = delete;
+    Rcu& operator=(const Rcu&) = delete;
+
+    /**
+     * @brief Pin the calling thread for as long as the returned reader lives.
+     */
+    Reader read() const {
+        return Reader(*this);
+    }
+
+    /**
+     * @brief The current object, with a single acquire load.
+     * @details Safe without pinning only where no writer can run concurrently, such as
+     *      during start up before any writer thread exists.
+     */
+    const T* load() const {
+        return current.load(std::memory_order_acquire);
+    }
+
+    /**
+     * @brief Replace the published object and reclaim whatever is no longer referenced.
+     */
+    void publish(std::unique_ptr<T> next) {
+        std::lock_guard lock(writer);
+        const T* previous = current.exchange(next.release(), std::memory_order_acq_rel);
+        uint64_t retiredIn = epoch.fetch_add(1, std::memory_order_acq_rel);
+        retiredObjects.push_back({ previous, retiredIn });
+        reclaim();
+    }
+
+    /**
+     * @brief Number of replaced objects still waiting for readers to move on.
+     */
+    size_t pending() const {
+        std::lock_guard lock(writer);
+        return retiredObjects.size();
+    }
+
+private:
+    static constexpr uint64_t IDLE = 0;
+
+    struct alignas(64) Slot {
+        std::atomic<uint64_t> epoch{ IDLE };
+        std::atomic<bool> claimed{ false };
+    };
+
+    /**
+     * @brief Holds the calling thread's slot and gives it back when the thread exits.
+     */
+    struct SlotOwner {
+        const Rcu* rcu = nullptr;
+        Slot* slot = nullptr;
+
+        void release() {
+            if (!slot) {
+                return;
+            }
+            if (slot == &rcu->overflow) {
+                rcu->overflowReaders.fetch_sub(1, std::memory_order_release);
+            }
+            else {
+                slot->epoch.store(IDLE, std::memory_order_relaxed);
+                slot->claimed.store(false, std::memory_order_release);
+            }
+            slot = nullptr;
+        }
+
+        ~SlotOwner() {
+            release();
+        }
+    };
+
+    struct Retired {
+        const T* object;
+        uint64_t epoch;
+    };
+
+    Slot* localSlot() const {
+        thread_local SlotOwner owner;
+        if (owner.rcu != this || !owner.slot) {
+            owner.release();
+            owner.rcu = this;
+            owner.slot = claimSlot();
+        }
+        return owner.slot;
+    }
+
+    Slot* claimSlot() const {
+        for (auto& slot : slots) {
+            bool expected = false;
+            if (!slot.claimed.load(std::memory_order_relaxed) &&
+                slot.claimed.compare_exchange_strong(expected, true, std::memory_order_acquire))
+            {
+                return &slot;
+            }
+        }
+        overflowReaders.fetch_add(1, std::memory_order_relaxed);
+        return &overflow;
+    }
+
+    void reclaim() {
+        if (!heavyBarrierAvailable) {
+            return;
+        }
+        heavyBarrier();
+
+        // Oldest epoch any pinned reader may still be using
+        uint64_t oldest = UINT64_MAX;
+        for (auto& slot : slots) {
+            uint64_t e = slot.epoch.load(std::memory_order_acquire);
+            if (e != IDLE && e < oldest) {
+                oldest = e;
+            }
+        }
+        if (overflowReaders.load(std::memory_order_acquire) > 0) {
+            return; // Readers sharing the overflow slot cannot be told apart, keep everything
+        }
+
+        std::erase_if(retiredObjects, [&](const Retired& retired) {
+            if (retired.epoch < oldest) {
+                delete retired.object;
+                return true;
+            }
+            return false;
+        });
+    }
+
+    static bool registerHeavyBarrier() {
+#if defined(_WIN32)
+        return true;
+#elif defined(__linux__)
+        return syscall(__NR_membarrier, MEMBARRIER_CMD_REGISTER_PRIVATE_EXPEDITED, 0, 0) == 0;
+#else
+        return false;
+#endif
+    }
+
+    static void heavyBarrier() {
+#if defined(_WIN32)
+        FlushProcessWriteBuffers();
+#elif defined(__linux__)
+        syscall(__NR_membarrier, MEMBARRIER_CMD_PRIVATE_EXPEDITED, 0, 0);
+#endif
+    }
+
+    // Epochs start at 1 so that 0 can mark an idle slot
+    std::atomic<const T*> current;
+    std::atomic<uint64_t> epoch{ 1 };
+    mutable Slot slots[MAX_READERS];
+    mutable Slot overflow;
+    mutable std::atomic<size_t> overflowReaders{ 0 };
+    mutable std::mutex writer;
+    std::vector<Retired> retiredObjects;
+    bool heavyBarrierAvailable = false;
+};
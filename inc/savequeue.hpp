@@ -0,0 +1,147 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2024 Dominik Protasewicz
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+/**
+ * @brief Writes save files on a background thread instead of the game's.
+ * @details Each save is written to a temporary file next to it, flushed to disk and then
+ *      renamed over the old save, so a crash or power loss mid write leaves either the old or
+ *      the new save but never a partial one. Saves are written in the order they were
+ *      submitted and readers of a path can wait until nothing is pending for it.
+ */
+namespace SaveQueue
+{
+    /**
+     * @brief Match a file name against a wildcard pattern
+     * @details `*` matches any run of characters and `?` any one character, case
+     *      insensitively as file names are on Windows.
+     *
+     * @param pattern Pattern such as `SAVE*.DAT`
+     * @param name File name without its directory
+     * @return true if the name matches
+     */
+    bool matches(std::string_view pattern, std::string_view name);
+
+    /**
+     * @brief Write a file atomically
+     * @details Writes `<path>.tmp`, flushes it to disk and renames it over `path`.
+     *
+     * @param path File to replace
+     * @param data New contents
+     * @return false if any step failed, the old file is then left untouched
+     */
+    bool writeAtomic(const std::string& path, const std::vector<uint8_t>& data);
+
+    struct Result {
+        std::string path;
+        size_t bytes;
+        uint64_t queuedNs;   // Time spent waiting behind earlier saves
+        uint64_t writeNs;    // Time the write itself took
+        bool ok;
+    };
+
+    class Writer {
+    public:
+        /**
+         * @param done Called on the writer thread after every save
+         */
+        explicit Writer(std::function<void(const Result&)> done);
+        ~Writer();
+        Writer(const Writer&) = delete;
+        Writer& operator=(const Writer&) = delete;
+
+        /**
+         * @brief Queue a save, returning right away
+         */
+        void submit(std::string path, std::vector<uint8_t> data);
+
+        /**
+         * @brief Block until no save to `path` is pending
+         */
+        void wait(const std::string& path);
+
+        /**
+         * @brief Block until every queued save was written
+         */
+        void waitAll();
+
+        /**
+         * @brief Whether a save to `path` is pending
+         */
+        bool pending(const std::string& path);
+
+    private:
+        struct Job {
+            std::string path;
+            std::vector<uint8_t> data;
+            std::chrono::steady_clock::time_point queued;
+        };
+
+        void run();
+
+        std::function<void(const Result&)> done;
+        std::mutex mutex;
+        std::condition_variable wake;
+        std::condition_variable written;
+        std::deque<Job> jobs;
+        std::unordered_map<std::string, size_t> pendingPaths;
+        bool stopping = false;
+        std::thread thread;
+    };
+
+    /**
+     * @brief Hand the game's save writes to a `Writer`
+     * @details Windows only, implemented in savequeuehooks.cpp. A save file matching
+     *      `pattern` that the game creates from scratch is given an in memory file instead,
+     *      the file imports of `module` report success right away and the contents are
+     *      submitted when the game closes it. Opening, probing or listing a save waits for
+     *      its pending write first and so does exiting the process.
+     *
+     * @param module Module whose imports are intercepted
+     * @param pattern Wildcard pattern of save file names
+     * @return true if the file imports could be intercepted
+     */
+    bool install(void* module, const std::string& pattern);
+
+    /**
+     * @brief Append the save counters, nothing if it was not installed
+     *
+     * @param counters Vector the name and value of each counter are appended to
+     */
+    void counters(std::vector<std::pair<std::string, uint64_t>>* counters);
+}
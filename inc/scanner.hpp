@@ -0,0 +1,186 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2024 Dominik Protasewicz
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace Scanner
+{
+    /**
+     * @brief Returned by `find` when no further match exists.
+     */
+    constexpr size_t npos = static_cast<size_t>(-1);
+
+    /**
+     * @brief A named slice of a signature whose bytes are decoded on every match.
+     * @details `Value` captures are read as a little-endian integer of `size` bytes.
+     *      `Relative` captures are the signed rel8 or rel32 displacement of a branch or
+     *      RIP-style operand and resolve to `end of the capture + displacement`, which
+     *      is the branch target as long as the displacement is the last operand of its
+     *      instruction, as it is for `jcc`, `jmp` and `call`.
+     */
+    struct Capture {
+        enum class Kind { Value, Relative };
+
+        std::string name;
+        size_t offset;
+        size_t size;
+        Kind kind;
+    };
+
+    /**
+     * @brief A set of byte alternatives one position of a signature may take.
+     */
+    struct Alternation {
+        size_t offset;
+        std::vector<uint8_t> value;
+        std::vector<uint8_t> mask;
+    };
+
+    /**
+     * @brief A signature compiled into a form the scan kernel can consume directly.
+     * @details Every byte of the signature is stored as a `value` and `mask` pair, a byte
+     *      in memory matches when `(byte & mask) == value`. Wildcards have a mask of 0 and
+     *      nibble wildcards a mask of 0x0F or 0xF0. Positions holding an alternation are
+     *      wildcards in `value`/`mask` and are checked against `alternations` once the
+     *      rest of the pattern matched. Two anchors, the first and last fully specified
+     *      bytes, are chosen at compile time and are what the vectorised kernel compares
+     *      16 candidates at a time against before the full pattern is verified.
+     *
+     *      A signature that fails to parse compiles to an empty pattern, which never
+     *      matches, with the reason left in `error`.
+     */
+    struct Pattern {
+        std::vector<uint8_t> value;
+        std::vector<uint8_t> mask;
+        std::vector<Alternation> alternations;
+        std::vector<Capture> captures;
+        size_t firstAnchor = npos;
+        size_t lastAnchor = npos;
+        std::string error;
+
+        size_t size() const { return value.size(); }
+        bool empty() const { return value.empty(); }
+    };
+
+    /**
+     * @brief A single occurrence of a pattern along with its decoded captures.
+     * @details `values` holds one entry per capture of `pattern`, in the order they
+     *      appear in the signature. Relative captures are absolute addresses computed
+     *      from the `base` address handed to `decode`.
+     */
+    struct Match {
+        const Pattern* pattern = nullptr;
+        uint64_t address = 0;
+        std::vector<uint64_t> values;
+
+        /**
+         * @brief Look up a capture by name
+         *
+         * @param name Capture name as written in the signature
+         * @return Decoded value, or 0 if the pattern has no such capture
+         */
+        uint64_t operator[](std::string_view name) const;
+    };
+
+    /**
+     * @brief A range of memory to be scanned.
+     */
+    struct Range {
+        const void* address;
+        size_t size;
+    };
+
+    /**
+     * @brief Compile an IDA-style byte array pattern
+     * @details The `signature` parameter is expected to be in the form "DE AD ?? EF",
+     *      with `?` or `??` standing in for a wildcard byte. On top of that:
+     *      - `4?` and `?4` match on a single nibble.
+     *      - `(75|74)` matches any one of the listed bytes, which may use nibble wildcards.
+     *      - `[name:N]` captures the next N (1 to 8) bytes as a little-endian value.
+     *      - `[name:rel8]` and `[name:rel32]` capture a displacement and resolve it to
+     *        the absolute address it points at.
+     *
+     *      The result can be reused for any number of scans, so callers scanning the same
+     *      signature repeatedly, or over many buffers, should compile it once.
+     *
+     * @param signature IDA-style byte array pattern
+     * @return Pattern
+     */
+    Pattern compile(const char* signature);
+
+    /**
+     * @brief Find the next occurrence of a compiled pattern in a buffer
+     * @details Only matches that lie completely inside `data[0]` to `data[size - 1]` are
+     *      reported. The search starts at offset `start`; to enumerate every match call
+     *      again with the previous result plus one.
+     *
+     * @param data Buffer to search
+     * @param size Size of `data` parameter
+     * @param pattern Compiled pattern
+     * @param start Offset into `data` at which to begin searching
+     * @return Offset of the match relative to `data`, or `npos`
+     */
+    size_t find(const uint8_t* data, size_t size, const Pattern& pattern, size_t start = 0);
+
+    /**
+     * @brief Append the offsets of every occurrence of a compiled pattern in a buffer
+     *
+     * @param data Buffer to search
+     * @param size Size of `data` parameter
+     * @param pattern Compiled pattern
+     * @param offsets Vector the offsets, relative to `data`, are appended to
+     */
+    void findAll(const uint8_t* data, size_t size, const Pattern& pattern, std::vector<size_t>* offsets);
+
+    /**
+     * @brief Decode the captures of a match found by `find`
+     *
+     * @param data Buffer that was searched
+     * @param offset Offset of the match relative to `data`
+     * @param pattern Compiled pattern that matched
+     * @param base Address `data[0]` is mapped at, used for the match address and to
+     *      resolve relative captures
+     * @return Match
+     */
+    Match decode(const uint8_t* data, size_t offset, const Pattern& pattern, uint64_t base);
+
+    /**
+     * @brief Ask the OS to bring memory into the working set ahead of scanning it
+     * @details On a cold start most of an image has not been touched by the loader yet and
+     *      a scan would otherwise soft fault its way through it page by page. All ranges
+     *      are handed over in a single batched `PrefetchVirtualMemory` call on Windows 8 and
+     *      later, and advised with `madvise(MADV_WILLNEED)` elsewhere. The call is only a
+     *      hint and returns without waiting for the pages.
+     *
+     * @param ranges Memory ranges about to be scanned
+     * @return true if the OS accepted the hint
+     */
+    bool prefetch(const std::vector<Range>& ranges);
+}
@@ -0,0 +1,88 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2024 Dominik Protasewicz
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "scanner.hpp"
+#include "peimage.hpp"
+
+namespace Signatures
+{
+    /**
+     * @brief Every signature with a fixed pattern, indexing `list` and `Build::rva`.
+     */
+    enum Id {
+        KeepAspect,
+        Textures,
+        Count
+    };
+
+    struct Signature {
+        const char* name;
+        const char* pattern;
+    };
+
+    /**
+     * @brief The one place the fixed signatures are spelled out.
+     * @details Shared by the fixes and by the resolver tool, which scans the game
+     *      executable for each of them at build time.
+     */
+    inline constexpr Signature list[Count] = {
+        { "keepAspect", "75 [skip:rel8] 0F 28 05 [source:4] 0F 29 05 [keepAspect:4]" },
+        { "textures", "66 0F 2F C1 76 [skip:rel8] A1 [source:4] 66 0F 6E 05 [operand:4]" },
+    };
+
+    /**
+     * @brief Where every signature was found in one particular build of the game.
+     * @details An RVA of 0 means the signature was not found in that build.
+     */
+    struct Build {
+        PeImage::Identity identity;
+        uint32_t rva[Count];
+    };
+
+    /**
+     * @brief The compiled form of a signature, compiled on first use
+     *
+     * @param id Signature
+     * @return const Scanner::Pattern&
+     */
+    const Scanner::Pattern& pattern(Id id);
+
+    /**
+     * @brief Find a signature in a module
+     * @details When the module is a build the resolver saw at build time the embedded RVA
+     *      is used, after checking that the pattern still matches there, and no scan is
+     *      needed. Unknown builds, or an RVA that no longer matches, fall back to a full
+     *      `Utils::patternScan`.
+     *
+     * @param module Base of the module to search
+     * @param id Signature
+     * @param matches Vector the matches are appended to
+     */
+    void locate(void* module, Id id, std::vector<Scanner::Match>* matches);
+}
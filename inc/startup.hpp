@@ -0,0 +1,177 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2024 Dominik Protasewicz
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <atomic>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "hitch.hpp"
+
+/**
+ * @brief Timeline of the game starting up, from process creation to its first presented frame.
+ * @details Steps, such as loading the configuration or arming a fix, and file opens are recorded
+ *      as they happen. Startup is divided into consecutive phases, each starting where the
+ *      previous one ended, and every file read is attributed to the phase it started in. The
+ *      timeline is written in the Chrome trace event format, which chrome://tracing and Perfetto
+ *      open, with a track of phases carrying their summed I/O bytes and time.
+ *
+ *      All times are nanoseconds of the clock `Hitch::now` reads and all functions are safe to
+ *      call from any thread.
+ */
+namespace Startup
+{
+    struct Phase {
+        std::string name;
+        uint64_t start = 0;
+        uint64_t end = 0;
+        uint64_t reads = 0;
+        uint64_t readBytes = 0;
+        uint64_t readTime = 0;
+    };
+
+    class Timeline {
+    public:
+        /**
+         * @brief Record a step that ran from `start` to `end`
+         *
+         * @param name Name of the step
+         * @param category Group of the step, such as "fix" or "io"
+         * @param start Start of the step
+         * @param end End of the step
+         * @param thread Thread the step ran on, from `Hitch::threadId`
+         */
+        void step(const std::string& name, const char* category, uint64_t start, uint64_t end, uint32_t thread);
+
+        /**
+         * @brief Record a point in time
+         */
+        void instant(const std::string& name, uint64_t time, uint32_t thread);
+
+        /**
+         * @brief Start a new phase, ending the one before it
+         * @details Phases may be started out of order from different threads, they are
+         *      ordered by their start time.
+         */
+        void phase(const std::string& name, uint64_t start);
+
+        /**
+         * @brief Record a file read, counted towards the phase it started in
+         */
+        void read(uint64_t start, uint64_t end, uint64_t bytes);
+
+        /**
+         * @brief End the last phase, after which nothing more is recorded
+         *
+         * @param time End of startup
+         * @return false if startup had already been finished
+         */
+        bool finish(uint64_t time);
+
+        /**
+         * @brief Whether startup was finished, a single load without taking the lock
+         */
+        bool finished() const;
+
+        /**
+         * @brief Phases in order with their reads summed up, valid once finished
+         */
+        std::vector<Phase> phases() const;
+
+        /**
+         * @brief Write the timeline as a Chrome trace
+         *
+         * @param path JSON file to write
+         * @return false if the file could not be written
+         */
+        bool write(const char* path) const;
+
+    private:
+        struct Step {
+            std::string name;
+            const char* category;
+            uint64_t start;
+            uint64_t end;
+            uint32_t thread;
+        };
+        struct Read {
+            uint64_t start;
+            uint64_t duration;
+            uint64_t bytes;
+        };
+
+        mutable std::mutex mutex;
+        std::vector<Step> steps;
+        std::vector<Phase> marks;
+        std::vector<Read> reads;
+        uint64_t end = 0;
+        std::atomic<bool> done = false;
+    };
+
+    /**
+     * @brief The timeline the DLL records into
+     */
+    Timeline& timeline();
+
+    /**
+     * @brief Records the lifetime of the enclosing scope as a step of `timeline()`.
+     */
+    class Scope {
+    public:
+        Scope(std::string name, const char* category) : name(std::move(name)), category(category), start(Hitch::now()) {}
+        ~Scope() { timeline().step(name, category, start, Hitch::now(), Hitch::threadId()); }
+        Scope(const Scope&) = delete;
+        Scope& operator=(const Scope&) = delete;
+
+    private:
+        std::string name;
+        const char* category;
+        uint64_t start;
+    };
+
+    /**
+     * @brief When the process was created
+     * @details Windows only, implemented in startuphooks.cpp.
+     *
+     * @return Time in the clock of `Hitch::now`, 0 if it is not known
+     */
+    uint64_t processCreation();
+
+    /**
+     * @brief Time process creation, file opens and reads, device creation and the first present
+     * @details Windows only, implemented in startuphooks.cpp. The phases before `attach` are
+     *      recorded from the creation time of the process. At the first present the
+     *      timeline is finished, written to `path` and its phases logged.
+     *
+     * @param module Module whose imports are intercepted
+     * @param attach Time the DLL was attached
+     * @param path Chrome trace file to write
+     * @return true if the first present can be observed
+     */
+    bool install(void* module, uint64_t attach, const char* path);
+}
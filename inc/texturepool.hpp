@@ -0,0 +1,153 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2024 Dominik Protasewicz
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <list>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+/**
+ * @brief Keeps released textures for the next creation of one just like them.
+ * @details Area loads release and create many textures of the same description, each a round
+ *      trip to the driver. A `Pool` holds released textures in free lists per description
+ *      and hands them out again. Free textures are kept within a byte budget, the ones
+ *      released longest ago are let go first.
+ */
+namespace TexturePool
+{
+    /**
+     * @brief Description of a texture, using the values of the `D3DFORMAT`, `D3DPOOL` and `D3DUSAGE` flags.
+     */
+    struct Key {
+        uint64_t device;
+        uint32_t width;
+        uint32_t height;
+        uint32_t levels;
+        uint32_t format;
+        uint32_t pool;
+        uint32_t usage;
+
+        bool operator==(const Key&) const = default;
+    };
+
+    struct KeyHash {
+        size_t operator()(const Key& key) const;
+    };
+
+    /**
+     * @brief Memory a texture of this description takes, estimated from its format
+     */
+    uint64_t textureBytes(const Key& key);
+
+    /**
+     * @brief Name of a format for the log, the FOURCC or its number
+     */
+    std::string formatName(uint32_t format);
+
+    struct KeyStats {
+        uint64_t created = 0;   // Textures created because none was free
+        uint64_t reused = 0;    // Creations served from the free list
+        uint64_t released = 0;  // Textures put on the free list
+        uint64_t evicted = 0;   // Free textures let go to stay within the budget
+    };
+
+    class Pool {
+    public:
+        /**
+         * @param budget Bytes the free textures may take at most
+         */
+        explicit Pool(uint64_t budget);
+
+        /**
+         * @brief Take a free texture of this description
+         *
+         * @return The texture, nullptr if none is free and one has to be created
+         */
+        void* take(const Key& key);
+
+        /**
+         * @brief Put a released texture on the free list
+         *
+         * @param key Description of the texture
+         * @param texture The texture
+         * @param evicted Receives the free textures that have to be let go, this one too if it
+         *      is larger than the whole budget
+         */
+        void give(const Key& key, void* texture, std::vector<void*>* evicted);
+
+        /**
+         * @brief Remove every free texture of a `D3DPOOL`
+         *
+         * @param pool Pool the textures were created in
+         * @param removed Receives the removed textures
+         */
+        void drain(uint32_t pool, std::vector<void*>* removed);
+
+        uint64_t freeBytes() const { return bytes; }
+        size_t freeCount() const { return order.size(); }
+        const std::unordered_map<Key, KeyStats, KeyHash>& stats() const { return keyStats; }
+
+    private:
+        struct Entry {
+            Key key;
+            void* texture;
+            uint64_t bytes;
+        };
+
+        void remove(std::list<Entry>::iterator entry);
+
+        // Oldest release first
+        std::list<Entry> order;
+        std::unordered_map<Key, std::vector<std::list<Entry>::iterator>, KeyHash> free;
+        std::unordered_map<Key, KeyStats, KeyHash> keyStats;
+        uint64_t budget;
+        uint64_t bytes = 0;
+    };
+
+    /**
+     * @brief Pool the game's textures
+     * @details Windows only, implemented in texturepoolhooks.cpp. Hooks `CreateTexture` and
+     *      `Reset` of the device and `Release` of the textures. Every texture created holds one
+     *      extra reference of the pool, when only that one is left the texture goes on the
+     *      free list instead of being destroyed. Free textures in the default pool are let go
+     *      before a reset. Statistics per description are logged every `logFrames` frames.
+     *
+     * @param budget Bytes the free textures may take at most
+     * @param logFrames Frames between logging, 0 to not log
+     * @return true if textures are pooled
+     */
+    bool install(uint64_t budget, uint32_t logFrames);
+
+    /**
+     * @brief Append the pool's counters, nothing if it was not installed
+     *
+     * @param counters Vector the name and value of each counter are appended to
+     */
+    void counters(std::vector<std::pair<std::string, uint64_t>>* counters);
+}
@@ -28,6 +28,8 @@
 #include <vector>
 #include <string>
 
+#include "scanner.hpp"
+
 namespace Utils
 {
     /**
@@ -90,13 +92,42 @@ namespace Utils
      */
     void patch(uintptr_t address, const char* pattern);
 
+    /**
+     * @brief How `patchAtomic` wrote a patch.
+     */
+    enum class PatchPath {
+        Atomic,
+        Frozen,
+        Failed
+    };
+
+    /**
+     * @brief Patch code that other threads may be executing without pausing them
+     * @details Same as `patch`, but meant for live code such as a conditional branch
+     *      flipped to an unconditional one. `address` must be the start of an instruction.
+     *      The original and the patched code are decoded with Zydis. When the patch stays
+     *      within one instruction, replaces it with one of the same length and lies within
+     *      a single aligned qword, it is written with one `lock cmpxchg8b`: every thread
+     *      executes either the old or the new instruction and never a torn mix, and the
+     *      game is never paused. Otherwise every other thread is suspended for the write,
+     *      retrying while one of them is stopped past the first byte of the instructions
+     *      the patch touches.
+     *
+     * @param address Starting memory address
+     * @param pattern IDA-style byte array pattern
+     * @return The path taken, `Failed` if the code did not decode, the memory could not be
+     *      made writable or a thread stayed inside the patched instructions
+     */
+    PatchPath patchAtomic(uintptr_t address, const char* pattern);
+
     /**
      * @brief Scan for a given byte pattern on a module
      * @details Obtained and modified from:
      *      https://github.com/OneshotGH/CSGOSimple-master/blob/master/CSGOSimple/helpers/utils.cpp
-     *      Original implementation is for the most part intact. Modified so that all
-     *      the addresses where the pattern is found is appended to the `address` vector,
-     *      instead of returning the address when the first instance is found.
+     *      Modified so that all the addresses where the pattern is found is appended to
+     *      the `address` vector, instead of returning the address when the first instance
+     *      is found. The byte matching itself is done by the vectorised kernel in
+     *      `Scanner::find`.
      *
      * @param module Base of the module to search
      * @param signature IDA-style byte array pattern
@@ -104,5 +135,73 @@ namespace Utils
      */
     void patternScan(void* module, const char* signature, std::vector<uint64_t>* address);
 
+    /**
+     * @brief Scan for a precompiled byte pattern on a module
+     * @details Same as the overload above but takes a pattern already compiled by
+     *      `Scanner::compile`, so that a signature scanned more than once, or shared
+     *      with the offline tools, is only parsed a single time.
+     *
+     * @param module Base of the module to search
+     * @param pattern Compiled byte array pattern
+     * @param address Vector of addresses where the pattern was found
+     */
+    void patternScan(void* module, const Scanner::Pattern& pattern, std::vector<uint64_t>* address);
+
+    /**
+     * @brief Scan for a precompiled byte pattern on a module and decode its captures
+     * @details Relative captures are resolved against the address the module is loaded
+     *      at, so they come back as absolute addresses inside the running image.
+     *
+     * @param module Base of the module to search
+     * @param pattern Compiled byte array pattern
+     * @param matches Vector the matches are appended to
+     */
+    void patternScan(void* module, const Scanner::Pattern& pattern, std::vector<Scanner::Match>* matches);
+
+    /**
+     * @brief Get the memory ranges of every section of a module
+     * @details The ranges cover the sections as mapped, using their virtual sizes, and are
+     *      meant to be handed to `Scanner::prefetch` ahead of scanning the module.
+     *
+     * @param module Base of the module
+     * @return std::vector<Scanner::Range>
+     */
+    std::vector<Scanner::Range> sectionRanges(void* module);
+
+    /**
+     * @brief Redirect an imported function of a module
+     * @details Walks the import directory of `module` looking for `functionName` imported
+     *      from `dllName` and swaps its import address table entry for `replacement`.
+     *      Only calls made by `module` itself are redirected. The previous entry is
+     *      stored to `original` before the swap, so the replacement can call through it
+     *      from the very first call. Hooking the same import again chains naturally, the
+     *      second caller receives the first replacement as its original.
+     *
+     * @param module Module whose imports are patched
+     * @param dllName Name of the DLL the function is imported from, case insensitive
+     * @param functionName Name of the imported function
+     * @param replacement Function to call instead
+     * @param original Receives the address that was previously in the table
+     * @return true if the import was found and redirected
+     */
+    bool hookImport(HMODULE module, const char* dllName, const char* functionName, void* replacement, void** original);
+
+    /**
+     * @brief Check that a function looks like a cdecl function taking `arguments` stack arguments
+     * @details Decodes the function linearly from its first byte up to its first `ret` and
+     *      rejects it if the `ret` pops bytes off the stack, as stdcall and thiscall functions
+     *      clean up after themselves, if it reads `ecx` or `edx` before writing them, as
+     *      fastcall and thiscall functions take arguments in them, or if it addresses the
+     *      stack past its last argument through `esp` or an `ebp` frame. This only looks at
+     *      one path through the function, it catches a signature matching the wrong routine
+     *      rather than proving the calling convention.
+     *
+     * @param function First byte of the function
+     * @param arguments Number of 4 byte stack arguments the caller will pass
+     * @param reason Receives why the function was rejected
+     * @return true if nothing contradicts the expected calling convention
+     */
+    bool isCdecl(const void* function, int arguments, std::string* reason);
+
     DWORD findProcessID(const char* targetProcess);
 }
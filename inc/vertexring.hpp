@@ -0,0 +1,107 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2024 Dominik Protasewicz
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <string>
+#include <utility>
+#include <vector>
+
+/**
+ * @brief Streams the vertices of user pointer draws through a dynamic buffer used as a ring.
+ * @details Each draw is appended after the previous one with a no-overwrite lock, so the GPU
+ *      keeps reading the earlier draws undisturbed. Only when the buffer is full is it locked
+ *      with discard and filled from the start again, which hands the driver a fresh buffer
+ *      instead of waiting for the GPU.
+ */
+namespace VertexRing
+{
+    class Ring {
+    public:
+        /**
+         * @brief Where an allocation lives and how its buffer must be locked.
+         */
+        struct Span {
+            uint32_t offset;
+            bool discard;
+        };
+
+        /**
+         * @param capacity Size of the buffer in bytes
+         */
+        explicit Ring(uint32_t capacity);
+
+        /**
+         * @brief Reserve the next `size` bytes
+         *
+         * @param size Bytes to reserve
+         * @param alignment Offset the span starts on a multiple of, the vertex stride
+         * @param span Receives the span
+         * @return false if `size` does not fit the buffer at all
+         */
+        bool allocate(uint32_t size, uint32_t alignment, Span* span);
+
+        /**
+         * @brief Start over on a new buffer, the next allocation discards
+         */
+        void reset() { next = capacity; }
+
+        uint32_t size() const { return capacity; }
+
+    private:
+        uint32_t capacity;
+        uint32_t next;
+    };
+
+    struct Stats {
+        uint64_t draws = 0;     // Draws issued from the rings
+        uint64_t passed = 0;    // Draws passed on as user pointer draws
+        uint64_t bytes = 0;     // Bytes of vertices and indices streamed
+        uint64_t discards = 0;  // Wraps of either ring
+    };
+
+    /**
+     * @brief Redirect the game's user pointer draws into the rings
+     * @details Windows only, implemented in vertexringhooks.cpp. Hooks `DrawPrimitiveUP` and
+     *      `DrawIndexedPrimitiveUP` as well as `Reset`, the rings are created on the game's
+     *      device on first use and released before it is reset. Draws that do not fit or use
+     *      32 bit indices are passed on. Bytes streamed per frame and discards are logged
+     *      every `logFrames` frames.
+     *
+     * @param vertexBytes Size of the vertex ring
+     * @param indexBytes Size of the index ring
+     * @param logFrames Frames between logging, 0 to not log
+     * @return true if the draws are redirected
+     */
+    bool install(uint32_t vertexBytes, uint32_t indexBytes, uint32_t logFrames);
+
+    /**
+     * @brief Append the rings' counters, nothing if they were not installed
+     *
+     * @param counters Vector the name and value of each counter are appended to
+     */
+    void counters(std::vector<std::pair<std::string, uint64_t>>* counters);
+}
@@ -48,12 +48,135 @@ name: The Legend of Heroes - Trials in the Sky FC Fix
 # Enables or disables all fixes
 masterEnable: true
 
+# Prefetches the game's image before scanning it, speeds up applying the fixes at start up
+prefetch: true
+
+# Records the registers seen by every hook into a binary trace, for replaying with hookreplay.
+# Fixes are armed with slower hooks while recording, leave disabled when playing
+trace:
+  enable: false
+  path: "TrailsInTheSkyFCFix.trace"
+  # Recording stops once the trace reaches this size
+  maxMiB: 256
+
+# Serves a local named pipe the fixctl tool uses to query counters and switch fixes on and off
+control:
+  enable: false
+  name: "TrailsInTheSkyFCFix"
+
+# Reports frames slower than the threshold along with the file reads, allocations and decoding
+# that overlapped them, to the log and to a report for the hitchdump tool
+hitch:
+  enable: false
+  thresholdMs: 25.0
+  # Shorter events are not recorded
+  minEventUs: 50
+  path: "TrailsInTheSkyFCFix.hitch"
+  # Reporting stops once the file reaches this size
+  maxMiB: 64
+
+# Records the game starting up, up to its first frame, and writes it in the Chrome trace format
+# for chrome://tracing or Perfetto, with the time and file I/O of each phase logged
+startup:
+  enable: false
+  path: "TrailsInTheSkyFCFix.startup.json"
+
+# Records the game's input per frame, or plays a recording back, so runs of different builds
+# can be compared on the same input, with every frame's duration written to telemetry as CSV
+replay:
+  enable: false
+  # record or replay, start both from the same save
+  mode: "record"
+  path: "TrailsInTheSkyFCFix.input"
+  # Frame times, left empty to not write them
+  telemetry: "TrailsInTheSkyFCFix.frames.csv"
+  # Recording stops once the file reaches this size
+  maxMiB: 16
+
 # Available fixes
 fixes:
 
   # If enabled textures will be restored
   textures:
     enable: true
+
+  # If enabled config.ini is parsed once and the game's reads of it are answered from memory,
+  # every key's first read is still checked against Windows and the file reparsed when it changes
+  profileCache:
+    enable: false
+
+  # If enabled save files are written on a background thread instead of stalling the game, the
+  # time the game was blocked for and the time each write took are logged
+  asyncSave:
+    enable: false
+    # File name of the save slots, * and ? as wildcards, e.g. "*.sav"
+    pattern: ""
+
+  # If enabled the logos and movies before the title screen are skipped, the time it takes to reach
+  # the title screen is logged
+  introSkip:
+    enable: false
+    # Only measures the time to the title screen when disabled
+    skip: true
+    # IDA-style signature within the intro's state machine, capturing the address of its state as [state:4]
+    signature: ""
+    # Value of the state once the title screen is shown. There is no verified value for it, the states the
+    # intro moves through are logged and it is only skipped after a start has reached this state by itself
+    titleState: 0
+    # Sequence of states seen on the start that reached titleState, skipping follows it
+    record: "TrailsInTheSkyFCFix.intro"
+
+  # If enabled glyphs the game has rasterized once are kept in an atlas and served from there
+  glyphCache:
+    enable: false
+    # Width and height of an atlas page in bytes, once all are full the least recently used glyphs make room
+    pageSize: 512
+    pages: 4
+    # Path the glyph requests are recorded to for glyphbench, empty to not record
+    record: ""
+
+  # If enabled textures the game releases are kept and reused when it creates the same kind again
+  texturePool:
+    enable: false
+    # Memory the kept textures may take, keep low as the game is a 32 bit process
+    budgetMiB: 64
+    # Frames between logging the reuse per kind of texture, 0 to not log it
+    logFrames: 1800
+
+  # If enabled draws of vertices from memory are streamed through dynamic buffers used as rings
+  vertexRing:
+    enable: false
+    # Sizes of the vertex and index rings
+    vertexKiB: 4096
+    indexKiB: 1024
+    # Frames between logging the bytes streamed per frame and the discards, 0 to not log them
+    logFrames: 600
+
+  # If enabled consecutive small draws of the UI and sprites are merged into one draw
+  batching:
+    enable: false
+    # Draws of more vertices than this are not merged
+    smallVertices: 64
+    # Vertices a merged draw holds at most
+    capacity: 4096
+    # Frames between logging the draw counts before and after merging, 0 to not log them
+    logFrames: 600
+
+  # If enabled the game's asset decompression is replaced with a faster decoder
+  decompress:
+    enable: false
+    # IDA-style signature of the first bytes of the game's decompression routine. The routine must be
+    # size_t __cdecl decode(const uint8_t* src, uint8_t* dst): both arguments on the stack, the caller
+    # pops them, the decompressed size returned in eax. A match that does not look like that is not hooked.
+    signature: ""
+    # Decodes the entries following each decoded one ahead of time on worker threads
+    pipeline:
+      enable: false
+      workers: 2
+      # Number of following entries to decode ahead
+      lookahead: 4
+      # Memory the cached entries and the workers' buffers may use together, keep low as the game is a 32 bit process
+      cacheMiB: 64
 "@
 
 if (Test-Path -Path $gameFolder) {
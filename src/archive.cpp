@@ -0,0 +1,375 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2024 Dominik Protasewicz
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <windows.h>
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <filesystem>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "archive.hpp"
+#include "assetcache.hpp"
+#include "decompress.hpp"
+#include "log.hpp"
+#include "utils.hpp"
+
+namespace Archive
+{
+    namespace
+    {
+        constexpr size_t RECENT_READS = 32;
+        constexpr size_t MAX_WINDOW = 16 * 1024 * 1024;
+        constexpr size_t MAX_DECODED = 32 * 1024 * 1024;
+        constexpr uint64_t STATS_INTERVAL = 256;
+
+        /**
+         * @brief An archive read by the game, remembered until its buffer is decoded.
+         */
+        struct Read {
+            const uint8_t* buffer;
+            size_t size;
+            uint32_t archive;
+            uint64_t offset;
+        };
+
+        decltype(&CreateFileA) originalCreateFileA = nullptr;
+        decltype(&ReadFile) originalReadFile = nullptr;
+        decltype(&CloseHandle) originalCloseHandle = nullptr;
+
+        std::mutex mutex; // Guards everything up to the cache
+        std::vector<std::string> archivePaths;
+        std::vector<HANDLE> workerHandles;
+        std::unordered_map<HANDLE, uint32_t> openArchives;
+        Read recentReads[RECENT_READS] = {};
+        size_t nextRead = 0;
+
+        // Never freed, tearing down threads under the loader lock at unload would deadlock
+        AssetCache::Cache* cache = nullptr;
+        AssetCache::WorkerPool* pool = nullptr;
+        size_t lookahead = 0;
+        std::atomic<uint64_t> decodes = 0;
+        std::atomic<uint64_t> speculated = 0;
+        std::atomic<uint64_t> dropped = 0;
+
+        bool isArchive(const char* path) {
+            std::string name = std::filesystem::path(path).filename().string();
+            for (auto& c : name) {
+                c = (char)tolower((unsigned char)c);
+            }
+            return name.starts_with("ed6_dt") && name.ends_with(".dat");
+        }
+
+        HANDLE WINAPI hookedCreateFileA(LPCSTR lpFileName, DWORD dwDesiredAccess, DWORD dwShareMode,
+            LPSECURITY_ATTRIBUTES lpSecurityAttributes, DWORD dwCreationDisposition,
+            DWORD dwFlagsAndAttributes, HANDLE hTemplateFile)
+        {
+            HANDLE handle = originalCreateFileA(lpFileName, dwDesiredAccess, dwShareMode,
+                lpSecurityAttributes, dwCreationDisposition, dwFlagsAndAttributes, hTemplateFile);
+            if (handle != INVALID_HANDLE_VALUE && lpFileName && isArchive(lpFileName)) {
+                std::lock_guard lock(mutex);
+                auto it = std::find(archivePaths.begin(), archivePaths.end(), lpFileName);
+                uint32_t archive = (uint32_t)(it - archivePaths.begin());
+                if (it == archivePaths.end()) {
+                    archivePaths.push_back(lpFileName);
+                    workerHandles.push_back(nullptr);
+                }
+                openArchives[handle] = archive;
+            }
+            return handle;
+        }
+
+        BOOL WINAPI hookedReadFile(HANDLE hFile, LPVOID lpBuffer, DWORD nNumberOfBytesToRead,
+            LPDWORD lpNumberOfBytesRead, LPOVERLAPPED lpOverlapped)
+        {
+            uint32_t archive;
+            {
+                std::lock_guard lock(mutex);
+                auto it = openArchives.find(hFile);
+                if (it == openArchives.end()) {
+                    return originalReadFile(hFile, lpBuffer, nNumberOfBytesToRead, lpNumberOfBytesRead, lpOverlapped);
+                }
+                archive = it->second;
+            }
+
+            uint64_t offset;
+            if (lpOverlapped) {
+                offset = lpOverlapped->Offset | ((uint64_t)lpOverlapped->OffsetHigh << 32);
+            }
+            else {
+                LARGE_INTEGER zero{}, position{};
+                SetFilePointerEx(hFile, zero, &position, FILE_CURRENT);
+                offset = (uint64_t)position.QuadPart;
+            }
+
+            BOOL ok = originalReadFile(hFile, lpBuffer, nNumberOfBytesToRead, lpNumberOfBytesRead, lpOverlapped);
+            if (ok) {
+                size_t size = lpNumberOfBytesRead && !lpOverlapped ? *lpNumberOfBytesRead : nNumberOfBytesToRead;
+                std::lock_guard lock(mutex);
+                recentReads[nextRead++ % RECENT_READS] = { (const uint8_t*)lpBuffer, size, archive, offset };
+            }
+            return ok;
+        }
+
+        BOOL WINAPI hookedCloseHandle(HANDLE hObject) {
+            {
+                std::lock_guard lock(mutex);
+                openArchives.erase(hObject);
+            }
+            return originalCloseHandle(hObject);
+        }
+
+        /**
+         * @brief Find the archive read a buffer about to be decoded came from.
+         */
+        bool findRead(const uint8_t* src, Read* read) {
+            std::lock_guard lock(mutex);
+            for (auto& candidate : recentReads) {
+                if (src >= candidate.buffer && src < candidate.buffer + candidate.size) {
+                    size_t skip = (size_t)(src - candidate.buffer);
+                    *read = { src, candidate.size - skip, candidate.archive, candidate.offset + skip };
+                    return true;
+                }
+            }
+            return false;
+        }
+
+        /**
+         * @brief Positional read from an archive on a handle owned by the workers.
+         */
+        size_t readAt(uint32_t archive, uint64_t offset, void* buffer, size_t size) {
+            HANDLE handle;
+            {
+                std::lock_guard lock(mutex);
+                if (!workerHandles[archive]) {
+                    workerHandles[archive] = originalCreateFileA(archivePaths[archive].c_str(), GENERIC_READ,
+                        FILE_SHARE_READ | FILE_SHARE_WRITE, nullptr, OPEN_EXISTING, FILE_FLAG_RANDOM_ACCESS, nullptr);
+                }
+                handle = workerHandles[archive];
+            }
+            if (handle == INVALID_HANDLE_VALUE) {
+                return 0;
+            }
+            OVERLAPPED overlapped{};
+            overlapped.Offset = (DWORD)offset;
+            overlapped.OffsetHigh = (DWORD)(offset >> 32);
+            DWORD got = 0;
+            return ReadFile(handle, buffer, (DWORD)size, &got, &overlapped) ? got : 0;
+        }
+
+        /**
+         * @brief Working memory of one decode, charged against the cache until it goes away.
+         */
+        struct Charge {
+            size_t bytes = 0;
+
+            bool grow(size_t total) {
+                if (total > bytes) {
+                    if (!cache->charge(total - bytes)) {
+                        return false;
+                    }
+                    bytes = total;
+                }
+                return true;
+            }
+
+            ~Charge() {
+                cache->release(bytes);
+            }
+        };
+
+        /**
+         * @brief Read the compressed stream at `key` and decode it.
+         * @details The stream is read in a growing window until its chunk headers are all
+         *      in view. The decoded size is not stored anywhere, so decoding is retried
+         *      with a bigger buffer until it fits. Both buffers are charged against the
+         *      cache capacity, and the decode is given up if they do not fit.
+         */
+        std::shared_ptr<AssetCache::Entry> decodeAt(const AssetCache::Key& key, size_t* streamSize) {
+            Charge charge;
+            std::vector<uint8_t> window;
+            size_t size = Decompress::error;
+            for (size_t length = 256 * 1024; length <= MAX_WINDOW; length *= 2) {
+                if (!charge.grow(length)) {
+                    return nullptr;
+                }
+                window.resize(length);
+                size_t got = readAt(key.archive, key.offset, window.data(), length);
+                size = Decompress::streamSize(window.data(), got);
+                if (size != Decompress::error || got < length) {
+                    break;
+                }
+            }
+            if (size == Decompress::error) {
+                return nullptr;
+            }
+            *streamSize = size;
+
+            auto entry = std::make_shared<AssetCache::Entry>();
+            for (size_t capacity = (std::max)(size * 4, (size_t)64 * 1024); capacity <= MAX_DECODED; capacity *= 4) {
+                if (!charge.grow(window.size() + capacity)) {
+                    return nullptr;
+                }
+                entry->data = {};
+                entry->data.resize(capacity);
+                size_t decoded = Decompress::decode(window.data(), size, entry->data.data(), capacity);
+                if (decoded != Decompress::error) {
+                    entry->data.resize(decoded);
+                    entry->data.shrink_to_fit();
+                    window.resize(size);
+                    window.shrink_to_fit();
+                    entry->source = std::move(window);
+                    return entry;
+                }
+            }
+            return nullptr;
+        }
+
+        void speculate(AssetCache::Key key, size_t depth);
+
+        /**
+         * @brief Queue the entry at `key` for the workers, dropping it when `lookahead` jobs already wait.
+         */
+        void submit(AssetCache::Key key, size_t depth) {
+            if (!pool->submit([key, depth] { speculate(key, depth); })) {
+                dropped++;
+            }
+        }
+
+        /**
+         * @brief Worker job decoding the entry at `key` and queueing the one after it.
+         * @details The next entry is queued as soon as the size of this one is known, before
+         *      decoding it, so that consecutive entries are decoded on different workers.
+         */
+        void speculate(AssetCache::Key key, size_t depth) {
+            size_t streamSize = 0;
+            switch (cache->reserve(key)) {
+            case AssetCache::Cache::Reservation::InFlight:
+                return;
+            case AssetCache::Cache::Reservation::Present:
+                if (auto entry = cache->peek(key); entry && depth > 1) {
+                    AssetCache::Key next{ key.archive, key.offset + entry->source.size() };
+                    submit(next, depth - 1);
+                }
+                return;
+            case AssetCache::Cache::Reservation::Reserved:
+                break;
+            }
+
+            auto entry = decodeAt(key, &streamSize);
+            if (!entry) {
+                cache->abandon(key);
+                return;
+            }
+            if (depth > 1) {
+                AssetCache::Key next{ key.archive, key.offset + streamSize };
+                submit(next, depth - 1);
+            }
+            speculated++;
+            cache->insert(key, std::move(entry));
+        }
+
+        void logStats() {
+            auto stats = cache->stats();
+            uint64_t lookups = stats.hits + stats.misses;
+            LOG("Decoded {} entries, hit rate {:.1f}% ({} hits, {} misses), {} speculative, {} evicted ({} unused), {} entries / {:.1f} MiB cached",
+                decodes.load(), lookups ? 100.0 * stats.hits / lookups : 0.0, stats.hits, stats.misses,
+                speculated.load(), stats.evicted, stats.evictedUnused, stats.entries, stats.bytes / (1024.0 * 1024.0));
+        }
+    }
+
+    bool init(HMODULE module, const Config& config) {
+        cache = new AssetCache::Cache(config.cacheBytes);
+        pool = new AssetCache::WorkerPool(config.workers, [] {
+            SetThreadPriority(GetCurrentThread(), THREAD_PRIORITY_BELOW_NORMAL);
+        }, (std::max)(config.lookahead, (size_t)1));
+        lookahead = config.lookahead;
+
+        bool ok = Utils::hookImport(module, "kernel32.dll", "CreateFileA",
+            reinterpret_cast<void*>(&hookedCreateFileA), reinterpret_cast<void**>(&originalCreateFileA));
+        ok &= Utils::hookImport(module, "kernel32.dll", "ReadFile",
+            reinterpret_cast<void*>(&hookedReadFile), reinterpret_cast<void**>(&originalReadFile));
+        ok &= Utils::hookImport(module, "kernel32.dll", "CloseHandle",
+            reinterpret_cast<void*>(&hookedCloseHandle), reinterpret_cast<void**>(&originalCloseHandle));
+        return ok;
+    }
+
+    size_t decode(const uint8_t* src, uint8_t* dst) {
+        if (!cache) {
+            return Decompress::decode(src, dst);
+        }
+
+        Read read;
+        bool known = findRead(src, &read);
+        std::shared_ptr<const AssetCache::Entry> entry;
+        if (known) {
+            entry = cache->take({ read.archive, read.offset }, true);
+        }
+
+        size_t size;
+        if (entry && read.size >= entry->source.size() &&
+            !memcmp(entry->source.data(), src, entry->source.size()))
+        {
+            size = entry->data.size();
+            memcpy(dst, entry->data.data(), size);
+        }
+        else {
+            size = Decompress::decode(src, dst);
+        }
+
+        if (known && lookahead) {
+            size_t streamSize = Decompress::streamSize(src, read.size);
+            if (streamSize != Decompress::error) {
+                submit({ read.archive, read.offset + streamSize }, lookahead);
+            }
+        }
+
+        if (++decodes % STATS_INTERVAL == 0) {
+            logStats();
+        }
+        return size;
+    }
+
+    void counters(std::vector<std::pair<std::string, uint64_t>>* counters) {
+        if (!cache) {
+            return;
+        }
+        auto stats = cache->stats();
+        counters->emplace_back("archive.decodes", decodes.load());
+        counters->emplace_back("archive.speculated", speculated.load());
+        counters->emplace_back("archive.dropped", dropped.load());
+        counters->emplace_back("archive.hits", stats.hits);
+        counters->emplace_back("archive.misses", stats.misses);
+        counters->emplace_back("archive.evicted", stats.evicted);
+        counters->emplace_back("archive.evictedUnused", stats.evictedUnused);
+        counters->emplace_back("archive.rejected", stats.rejected);
+        counters->emplace_back("archive.starved", stats.starved);
+        counters->emplace_back("archive.entries", stats.entries);
+        counters->emplace_back("archive.bytes", stats.bytes);
+        counters->emplace_back("archive.working", stats.working);
+    }
+}
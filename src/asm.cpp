@@ -0,0 +1,191 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2024 Dominik Protasewicz
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <windows.h>
+#include <mutex>
+#include <format>
+#include <cstring>
+
+#include <Zydis/Zydis.h>
+
+#include "asm.hpp"
+
+namespace Asm
+{
+    // Encodings checked against the game's own code and the Intel manual
+    static_assert(encodes(Code{}.movsd(xmm0, Mem(0x007A8120)), { 0xF2, 0x0F, 0x10, 0x05, 0x20, 0x81, 0x7A, 0x00 }));
+    static_assert(encodes(Code{}.comisd(xmm0, xmm1), { 0x66, 0x0F, 0x2F, 0xC1 }));
+    static_assert(encodes(Code{}.mov(eax, Mem(0x007A8120)), { 0x8B, 0x05, 0x20, 0x81, 0x7A, 0x00 }));
+    static_assert(encodes(Code{}.mov(Mem(0x007A8120), ecx), { 0x89, 0x0D, 0x20, 0x81, 0x7A, 0x00 }));
+    static_assert(encodes(Code{}.mov(edi, 0x3F800000u), { 0xBF, 0x00, 0x00, 0x80, 0x3F }));
+    static_assert(encodes(Code{}.mulss(xmm2, Mem(0x10)), { 0xF3, 0x0F, 0x59, 0x15, 0x10, 0x00, 0x00, 0x00 }));
+    static_assert(encodes(Code{}.movss(Mem(0x10), xmm7), { 0xF3, 0x0F, 0x11, 0x3D, 0x10, 0x00, 0x00, 0x00 }));
+    static_assert(encodes(Code{}.push(ebp).pop(esi).pushfd().popfd().ret(), { 0x55, 0x5E, 0x9C, 0x9D, 0xC3 }));
+    static_assert(encodes(Code{}.jcc(Cond::be, slot(0)), { 0x0F, 0x86, 0x00, 0x00, 0x00, 0x00 }));
+    static_assert(Code{}.movsd(xmm0, slot(2)).jmp(slot(3)).relocs[1].offset == 9);
+    static_assert(Code{}.movsd(xmm0, slot(2)).jmp(slot(3)).instructions[1].offset == 8);
+
+    /**
+     * @brief Carve executable memory out of pages that are never freed.
+     */
+    static uint8_t* allocate(size_t size) {
+        constexpr size_t ARENA_SIZE = 64 * 1024;
+        static std::mutex mutex;
+        static uint8_t* arena = nullptr;
+        static size_t used = ARENA_SIZE;
+
+        std::lock_guard lock(mutex);
+        size = (size + 15) & ~(size_t)15;
+        if (used + size > ARENA_SIZE) {
+            auto pages = (uint8_t*)VirtualAlloc(nullptr, ARENA_SIZE, MEM_COMMIT | MEM_RESERVE, PAGE_EXECUTE_READWRITE);
+            if (!pages) {
+                return nullptr;
+            }
+            arena = pages;
+            used = 0;
+        }
+        uint8_t* block = arena + used;
+        used += size;
+        return block;
+    }
+
+    /**
+     * @brief Whether a decoded operand is the one the stub was emitted with
+     */
+    static bool matches(const ZydisDecodedInstruction& instruction, const ZydisDecodedOperand& decoded,
+        const Operand& operand, uintptr_t address, std::initializer_list<uintptr_t> slots)
+    {
+        static const char* reg32Names[] = { "eax", "ecx", "edx", "ebx", "esp", "ebp", "esi", "edi" };
+        uint32_t expected = operand.slot >= 0 ? (uint32_t)slots.begin()[operand.slot] : operand.value;
+        switch (operand.kind) {
+        case Operand::Kind::Reg32:
+            return decoded.type == ZYDIS_OPERAND_TYPE_REGISTER &&
+                !strcmp(ZydisRegisterGetString(decoded.reg.value), reg32Names[operand.reg]);
+        case Operand::Kind::Xmm:
+            return decoded.type == ZYDIS_OPERAND_TYPE_REGISTER &&
+                ZydisRegisterGetString(decoded.reg.value) == std::format("xmm{}", operand.reg);
+        case Operand::Kind::Mem:
+            return decoded.type == ZYDIS_OPERAND_TYPE_MEMORY && decoded.mem.base == ZYDIS_REGISTER_NONE &&
+                decoded.mem.index == ZYDIS_REGISTER_NONE && (uint32_t)decoded.mem.disp.value == expected;
+        case Operand::Kind::Imm:
+            return decoded.type == ZYDIS_OPERAND_TYPE_IMMEDIATE && !decoded.imm.is_relative &&
+                (uint32_t)decoded.imm.value.u == expected;
+        case Operand::Kind::Rel: {
+            ZyanU64 target = 0;
+            return decoded.type == ZYDIS_OPERAND_TYPE_IMMEDIATE && decoded.imm.is_relative &&
+                ZYAN_SUCCESS(ZydisCalcAbsoluteAddress(&instruction, &decoded, address, &target)) &&
+                (uint32_t)target == expected;
+        }
+        }
+        return false;
+    }
+
+    /**
+     * @brief Decode an installed stub and compare it with the instructions it was emitted as
+     */
+    static bool verify(const Code& code, const uint8_t* stub, std::initializer_list<uintptr_t> slots) {
+        ZydisDecoder decoder;
+        ZydisDecoderInit(&decoder, ZYDIS_MACHINE_MODE_LEGACY_32, ZYDIS_STACK_WIDTH_32);
+        ZydisDecodedInstruction instruction;
+        ZydisDecodedOperand operands[ZYDIS_MAX_OPERAND_COUNT];
+        size_t offset = 0;
+        for (size_t i = 0; i < code.instructionCount; i++) {
+            const Instruction& expected = code.instructions[i];
+            if (expected.offset != offset ||
+                !ZYAN_SUCCESS(ZydisDecoderDecodeFull(&decoder, stub + offset, code.size - offset, &instruction, operands)) ||
+                strcmp(ZydisMnemonicGetString(instruction.mnemonic), expected.mnemonic) ||
+                instruction.operand_count_visible != expected.operandCount)
+            {
+                return false;
+            }
+            for (size_t k = 0; k < expected.operandCount; k++) {
+                if (!matches(instruction, operands[k], expected.operands[k], (uintptr_t)stub + offset, slots)) {
+                    return false;
+                }
+            }
+            offset += instruction.length;
+        }
+        return offset == code.size;
+    }
+
+    void* install(const Code& code, std::initializer_list<uintptr_t> slots) {
+        for (size_t i = 0; i < code.relocCount; i++) {
+            if (code.relocs[i].slot >= slots.size()) {
+                return nullptr;
+            }
+        }
+        for (size_t i = 0; i < code.instructionCount; i++) {
+            for (size_t k = 0; k < code.instructions[i].operandCount; k++) {
+                if (code.instructions[i].operands[k].slot >= (int)slots.size()) {
+                    return nullptr;
+                }
+            }
+        }
+
+        uint8_t* stub = allocate(code.size);
+        if (!stub) {
+            return nullptr;
+        }
+        memcpy(stub, code.bytes.data(), code.size);
+        for (size_t i = 0; i < code.relocCount; i++) {
+            const auto& reloc = code.relocs[i];
+            uintptr_t target = slots.begin()[reloc.slot];
+            uint32_t value = reloc.kind == Reloc::Kind::Absolute
+                ? (uint32_t)target
+                : (uint32_t)(target - ((uintptr_t)stub + reloc.offset + 4));
+            memcpy(stub + reloc.offset, &value, sizeof(value));
+        }
+        // A refused stub stays in the arena unused, nothing ever jumps to it
+        if (!verify(code, stub, slots)) {
+            return nullptr;
+        }
+        FlushInstructionCache(GetCurrentProcess(), stub, code.size);
+        return stub;
+    }
+
+    std::vector<std::string> disassemble(const void* code, size_t size) {
+        ZydisDecoder decoder;
+        ZydisDecoderInit(&decoder, ZYDIS_MACHINE_MODE_LEGACY_32, ZYDIS_STACK_WIDTH_32);
+        ZydisFormatter formatter;
+        ZydisFormatterInit(&formatter, ZYDIS_FORMATTER_STYLE_INTEL);
+
+        std::vector<std::string> lines;
+        auto bytes = reinterpret_cast<const uint8_t*>(code);
+        ZydisDecodedInstruction instruction;
+        ZydisDecodedOperand operands[ZYDIS_MAX_OPERAND_COUNT];
+        size_t offset = 0;
+        while (offset < size) {
+            if (!ZYAN_SUCCESS(ZydisDecoderDecodeFull(&decoder, bytes + offset, size - offset, &instruction, operands))) {
+                return {};
+            }
+            char text[256];
+            uintptr_t address = (uintptr_t)bytes + offset;
+            ZydisFormatterFormatInstruction(&formatter, &instruction, operands, instruction.operand_count_visible,
+                text, sizeof(text), address, ZYAN_NULL);
+            lines.push_back(std::format("0x{:x}: {}", address, text));
+            offset += instruction.length;
+        }
+        return lines;
+    }
+}
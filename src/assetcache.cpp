@@ -0,0 +1,173 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2024 Dominik Protasewicz
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "assetcache.hpp"
+
+namespace AssetCache
+{
+    Cache::Cache(size_t capacity) : capacity(capacity) {}
+
+    Cache::Reservation Cache::reserve(const Key& key) {
+        std::lock_guard lock(mutex);
+        if (slots.contains(key)) {
+            return Reservation::Present;
+        }
+        if (!inFlight.insert(key).second) {
+            return Reservation::InFlight;
+        }
+        return Reservation::Reserved;
+    }
+
+    void Cache::insert(const Key& key, std::shared_ptr<Entry> entry) {
+        {
+            std::lock_guard lock(mutex);
+            inFlight.erase(key);
+            if (entry->bytes() > capacity || slots.contains(key)) {
+                counters.rejected++;
+            }
+            else {
+                order.push_front(key);
+                counters.bytes += entry->bytes();
+                counters.inserted++;
+                slots.emplace(key, Slot{ std::move(entry), order.begin() });
+                evict(0);
+            }
+        }
+        published.notify_all();
+    }
+
+    void Cache::abandon(const Key& key) {
+        {
+            std::lock_guard lock(mutex);
+            inFlight.erase(key);
+        }
+        published.notify_all();
+    }
+
+    bool Cache::charge(size_t bytes) {
+        std::lock_guard lock(mutex);
+        if (counters.working + bytes > capacity) {
+            counters.starved++;
+            return false;
+        }
+        evict(bytes);
+        counters.working += bytes;
+        return true;
+    }
+
+    void Cache::release(size_t bytes) {
+        std::lock_guard lock(mutex);
+        counters.working -= bytes;
+    }
+
+    std::shared_ptr<const Entry> Cache::take(const Key& key, bool wait) {
+        std::unique_lock lock(mutex);
+        if (wait) {
+            published.wait(lock, [&] { return !inFlight.contains(key); });
+        }
+        auto it = slots.find(key);
+        if (it == slots.end()) {
+            counters.misses++;
+            return nullptr;
+        }
+        counters.hits++;
+        it->second.entry->used = true;
+        order.splice(order.begin(), order, it->second.position);
+        return it->second.entry;
+    }
+
+    std::shared_ptr<const Entry> Cache::peek(const Key& key) {
+        std::lock_guard lock(mutex);
+        auto it = slots.find(key);
+        return it == slots.end() ? nullptr : it->second.entry;
+    }
+
+    Stats Cache::stats() {
+        std::lock_guard lock(mutex);
+        Stats stats = counters;
+        stats.entries = slots.size();
+        return stats;
+    }
+
+    void Cache::evict(size_t reserve) {
+        while (counters.bytes + counters.working + reserve > capacity && !order.empty()) {
+            auto it = slots.find(order.back());
+            counters.bytes -= it->second.entry->bytes();
+            counters.evicted++;
+            if (!it->second.entry->used) {
+                counters.evictedUnused++;
+            }
+            slots.erase(it);
+            order.pop_back();
+        }
+    }
+
+    WorkerPool::WorkerPool(size_t threads, std::function<void()> onStart, size_t maxQueued) : maxQueued(maxQueued) {
+        for (size_t i = 0; i < threads; i++) {
+            workers.emplace_back(&WorkerPool::run, this, onStart);
+        }
+    }
+
+    WorkerPool::~WorkerPool() {
+        {
+            std::lock_guard lock(mutex);
+            stopping = true;
+        }
+        pending.notify_all();
+        for (auto& worker : workers) {
+            worker.join();
+        }
+    }
+
+    bool WorkerPool::submit(std::function<void()> job) {
+        {
+            std::lock_guard lock(mutex);
+            if (jobs.size() >= maxQueued) {
+                return false;
+            }
+            jobs.push_back(std::move(job));
+        }
+        pending.notify_one();
+        return true;
+    }
+
+    void WorkerPool::run(std::function<void()> onStart) {
+        if (onStart) {
+            onStart();
+        }
+        for (;;) {
+            std::function<void()> job;
+            {
+                std::unique_lock lock(mutex);
+                pending.wait(lock, [&] { return stopping || !jobs.empty(); });
+                if (stopping) {
+                    return;
+                }
+                job = std::move(jobs.front());
+                jobs.pop_front();
+            }
+            job();
+        }
+    }
+}
@@ -0,0 +1,130 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2024 Dominik Protasewicz
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <cstring>
+
+#include "batcher.hpp"
+
+namespace Batch
+{
+    uint32_t vertexCount(Primitive type, uint32_t primitives) {
+        switch (type) {
+        case PointList: return primitives;
+        case LineList: return primitives * 2;
+        case LineStrip: return primitives ? primitives + 1 : 0;
+        case TriangleList: return primitives * 3;
+        case TriangleStrip:
+        case TriangleFan: return primitives ? primitives + 2 : 0;
+        }
+        return 0;
+    }
+
+    Batcher::Batcher(Sink* sink, uint32_t smallVertices, uint32_t capacity) :
+        sink(sink), smallVertices(smallVertices), capacity(capacity)
+    {
+    }
+
+    void Batcher::draw(Primitive type, uint32_t primitives, const void* vertices, uint32_t stride) {
+        counts.received++;
+        uint32_t count = vertexCount(type, primitives);
+        bool triangles = type == TriangleList || type == TriangleStrip || type == TriangleFan;
+        // A batch grows by the triangle list of the draw, three vertices per primitive
+        if (!triangles || stride == 0 || count == 0 || count > smallVertices || primitives * 3 > capacity) {
+            flush();
+            counts.issued++;
+            sink->draw(type, primitives, vertices, stride);
+            return;
+        }
+        // A lone strip or fan is still held as given, it takes three vertices per primitive once merged
+        size_t queued = draws == 1 ? (size_t)firstPrimitives * 3 : buffer.size() / this->stride;
+        if (draws && (stride != this->stride || queued + primitives * 3 > capacity)) {
+            flush();
+        }
+
+        if (draws == 0) {
+            // Kept as given until a second draw joins it
+            this->stride = stride;
+            firstType = type;
+            firstPrimitives = primitives;
+            buffer.assign(static_cast<const uint8_t*>(vertices), static_cast<const uint8_t*>(vertices) + (size_t)count * stride);
+            draws = 1;
+            return;
+        }
+        if (draws == 1 && firstType != TriangleList) {
+            scratch.swap(buffer);
+            buffer.clear();
+            append(firstType, firstPrimitives, scratch.data());
+        }
+        append(type, primitives, static_cast<const uint8_t*>(vertices));
+        draws++;
+        counts.merged++;
+    }
+
+    void Batcher::append(Primitive type, uint32_t primitives, const uint8_t* vertices) {
+        if (type == TriangleList) {
+            buffer.insert(buffer.end(), vertices, vertices + (size_t)primitives * 3 * stride);
+            return;
+        }
+        size_t offset = buffer.size();
+        buffer.resize(offset + (size_t)primitives * 3 * stride);
+        uint8_t* out = buffer.data() + offset;
+        for (uint32_t i = 0; i < primitives; i++) {
+            // Every other strip triangle is swapped back to the winding of the first
+            uint32_t a = type == TriangleFan ? 0 : (i & 1 ? i + 1 : i);
+            uint32_t b = type == TriangleFan ? i + 1 : (i & 1 ? i : i + 1);
+            uint32_t c = i + 2;
+            for (uint32_t index : { a, b, c }) {
+                memcpy(out, vertices + (size_t)index * stride, stride);
+                out += stride;
+            }
+        }
+    }
+
+    void Batcher::flush() {
+        if (draws == 0) {
+            return;
+        }
+        counts.issued++;
+        if (draws == 1) {
+            sink->draw(firstType, firstPrimitives, buffer.data(), stride);
+        }
+        else {
+            sink->draw(TriangleList, (uint32_t)(buffer.size() / stride / 3), buffer.data(), stride);
+        }
+        draws = 0;
+        buffer.clear();
+    }
+
+    bool StateCache::changed(uint32_t kind, uint32_t index, uint64_t value) {
+        auto [it, inserted] = values.try_emplace((uint64_t)kind << 32 | index, value);
+        if (inserted) {
+            return true;
+        }
+        if (it->second == value) {
+            return false;
+        }
+        it->second = value;
+        return true;
+    }
+}
@@ -0,0 +1,320 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2024 Dominik Protasewicz
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <windows.h>
+#include <d3d9.h>
+#include <atomic>
+#include <mutex>
+#include <type_traits>
+
+#include "spdlog/spdlog.h"
+#include "safetyhook.hpp"
+
+#include "log.hpp"
+#include "d3d9hook.hpp"
+#include "batcher.hpp"
+
+namespace Batch
+{
+    namespace
+    {
+        enum Kind : uint32_t {
+            Untracked,
+            RenderState,
+            TextureStage,
+            Sampler,
+            Texture,
+            VertexShader,
+            PixelShader
+        };
+
+        /**
+         * @brief Issues the batched draws through the original `DrawPrimitiveUP`.
+         */
+        class DeviceSink : public Sink {
+        public:
+            void draw(Primitive type, uint32_t primitives, const void* vertices, uint32_t stride) override;
+
+            IDirect3DDevice9* device = nullptr;
+        };
+
+        SafetyHookInline drawHook{};
+        SafetyHookInline textureLockHook{};
+        SafetyHookInline surfaceLockHook{};
+        SafetyHookInline surfaceDCHook{};
+        SafetyHookInline applyHook{};
+
+        std::mutex batchMutex;
+        Batcher* batcher = nullptr;
+        DeviceSink* sink = nullptr;
+        StateCache* states = nullptr;
+        std::atomic<bool> pending = false;
+        // Batching starts once everything that can change a texture behind the device's back is hooked
+        std::atomic<bool> ready = false;
+        std::once_flag prepared;
+
+        uint32_t logEvery = 0;
+        uint32_t frames = 0;
+        Stats logged;
+
+        void DeviceSink::draw(Primitive type, uint32_t primitives, const void* vertices, uint32_t stride) {
+            drawHook.stdcall<HRESULT>(device, (D3DPRIMITIVETYPE)type, (UINT)primitives, vertices, (UINT)stride);
+        }
+
+        void flush() {
+            if (!pending.load(std::memory_order_acquire)) {
+                return;
+            }
+            std::lock_guard lock(batchMutex);
+            // Cleared first, issuing the batch may itself call hooked device methods
+            pending.store(false, std::memory_order_release);
+            batcher->flush();
+        }
+
+        template <typename T>
+        uint64_t bits(T value) {
+            if constexpr (std::is_pointer_v<T>) {
+                return (uint64_t)reinterpret_cast<uintptr_t>(value);
+            }
+            else {
+                return (uint64_t)value;
+            }
+        }
+
+        /**
+         * @brief Record a state set, every argument but the last names the state and the last is its value
+         * @return false if the state already had this value
+         */
+        template <typename... Args>
+        bool changed(Kind kind, Args... args) {
+            const uint64_t values[] = { bits(args)... };
+            uint32_t index = 0;
+            for (size_t i = 0; i + 1 < sizeof...(Args); i++) {
+                index = index << 16 | (uint32_t)values[i];
+            }
+            std::lock_guard lock(batchMutex);
+            return states->changed(kind, index, values[sizeof...(Args) - 1]);
+        }
+
+        /**
+         * @brief Hook of a device method that flushes the batch before the method runs.
+         * @details Tracked methods only flush when they change the state they set.
+         */
+        template <D3D9Hook::Method M, Kind K, typename Signature>
+        struct Flush;
+
+        template <D3D9Hook::Method M, Kind K, typename R, typename... Args>
+        struct Flush<M, K, R (__stdcall IDirect3DDevice9::*)(Args...)> {
+            static inline SafetyHookInline hook{};
+
+            static R __stdcall call(IDirect3DDevice9* device, Args... args) {
+                if constexpr (K == Untracked) {
+                    flush();
+                }
+                else {
+                    if (changed(K, args...)) {
+                        flush();
+                    }
+                }
+                return hook.template stdcall<R>(device, args...);
+            }
+
+            static bool install() {
+                hook = safetyhook::create_inline(D3D9Hook::method(M), reinterpret_cast<void*>(&call));
+                return (bool)hook;
+            }
+        };
+
+#define FLUSH(NAME) Flush<D3D9Hook::NAME, Untracked, decltype(&IDirect3DDevice9::NAME)>::install()
+#define TRACK(NAME, KIND) Flush<D3D9Hook::NAME, KIND, decltype(&IDirect3DDevice9::NAME)>::install()
+
+        /**
+         * @brief States changed without the device methods seeing it, flush and forget them all.
+         */
+        void forget() {
+            flush();
+            std::lock_guard lock(batchMutex);
+            states->forget();
+        }
+
+        template <D3D9Hook::Method M, typename Signature>
+        struct Forget;
+
+        template <D3D9Hook::Method M, typename R, typename... Args>
+        struct Forget<M, R (__stdcall IDirect3DDevice9::*)(Args...)> {
+            static inline SafetyHookInline hook{};
+
+            static R __stdcall call(IDirect3DDevice9* device, Args... args) {
+                forget();
+                return hook.template stdcall<R>(device, args...);
+            }
+
+            static bool install() {
+                hook = safetyhook::create_inline(D3D9Hook::method(M), reinterpret_cast<void*>(&call));
+                return (bool)hook;
+            }
+        };
+
+#define FORGET(NAME) Forget<D3D9Hook::NAME, decltype(&IDirect3DDevice9::NAME)>::install()
+
+        HRESULT __stdcall textureLock(IDirect3DTexture9* texture, UINT level, D3DLOCKED_RECT* locked, const RECT* rect,
+            DWORD flags)
+        {
+            flush();
+            return textureLockHook.stdcall<HRESULT>(texture, level, locked, rect, flags);
+        }
+
+        HRESULT __stdcall surfaceLock(IDirect3DSurface9* surface, D3DLOCKED_RECT* locked, const RECT* rect, DWORD flags) {
+            flush();
+            return surfaceLockHook.stdcall<HRESULT>(surface, locked, rect, flags);
+        }
+
+        HRESULT __stdcall surfaceDC(IDirect3DSurface9* surface, HDC* dc) {
+            flush();
+            return surfaceDCHook.stdcall<HRESULT>(surface, dc);
+        }
+
+        HRESULT __stdcall apply(IDirect3DStateBlock9* block) {
+            forget();
+            return applyHook.stdcall<HRESULT>(block);
+        }
+
+        /**
+         * @brief Hook the texture, surface and state block methods
+         * @details Those live in vtables of their own, which are read from objects made for it
+         *      on the game's device.
+         */
+        void prepare(IDirect3DDevice9* device) {
+            IDirect3DTexture9* texture = nullptr;
+            IDirect3DSurface9* surface = nullptr;
+            IDirect3DStateBlock9* block = nullptr;
+            if (SUCCEEDED(device->CreateTexture(1, 1, 1, 0, D3DFMT_A8R8G8B8, D3DPOOL_MANAGED, &texture, nullptr)) &&
+                SUCCEEDED(texture->GetSurfaceLevel(0, &surface)) &&
+                SUCCEEDED(device->CreateStateBlock(D3DSBT_ALL, &block)))
+            {
+                void** textureMethods = *reinterpret_cast<void***>(texture);
+                void** surfaceMethods = *reinterpret_cast<void***>(surface);
+                void** blockMethods = *reinterpret_cast<void***>(block);
+                textureLockHook = safetyhook::create_inline(textureMethods[19], reinterpret_cast<void*>(&textureLock));
+                surfaceLockHook = safetyhook::create_inline(surfaceMethods[13], reinterpret_cast<void*>(&surfaceLock));
+                surfaceDCHook = safetyhook::create_inline(surfaceMethods[15], reinterpret_cast<void*>(&surfaceDC));
+                applyHook = safetyhook::create_inline(blockMethods[5], reinterpret_cast<void*>(&apply));
+                ready = textureLockHook && surfaceLockHook && surfaceDCHook && applyHook;
+            }
+            if (block) {
+                block->Release();
+            }
+            if (surface) {
+                surface->Release();
+            }
+            if (texture) {
+                texture->Release();
+            }
+            LOG("Texture locks and state blocks {}, draws {}", ready ? "hooked" : "could not be hooked",
+                ready ? "batched" : "passed on");
+        }
+
+        HRESULT __stdcall drawPrimitiveUP(IDirect3DDevice9* device, D3DPRIMITIVETYPE type, UINT primitives,
+            const void* vertices, UINT stride)
+        {
+            std::call_once(prepared, prepare, device);
+            if (!ready) {
+                return drawHook.stdcall<HRESULT>(device, type, primitives, vertices, stride);
+            }
+            std::lock_guard lock(batchMutex);
+            pending.store(false, std::memory_order_release);
+            if (sink->device != device) {
+                batcher->flush();
+                sink->device = device;
+            }
+            batcher->draw((Primitive)type, primitives, vertices, stride);
+            pending.store(batcher->pending(), std::memory_order_release);
+            return D3D_OK;
+        }
+
+        void onPresent(IDirect3DDevice9*) {
+            if (!logEvery || ++frames < logEvery) {
+                return;
+            }
+            std::lock_guard lock(batchMutex);
+            const Stats& stats = batcher->stats();
+            LOG("{} draws from memory over {} frames issued as {}", stats.received - logged.received, frames,
+                stats.issued - logged.issued);
+            logged = stats;
+            frames = 0;
+        }
+    }
+
+    bool install(uint32_t smallVertices, uint32_t capacity, uint32_t logFrames) {
+        if (batcher) {
+            return true;
+        }
+        if (!D3D9Hook::init()) {
+            return false;
+        }
+        // Never freed, the render thread uses them until the very end of the process
+        sink = new DeviceSink();
+        batcher = new Batcher(sink, smallVertices, capacity);
+        states = new StateCache();
+        logEvery = logFrames;
+
+        // Everything a pending draw depends on is hooked before the draws themselves
+        bool hooked = TRACK(SetRenderState, RenderState) && TRACK(SetTextureStageState, TextureStage) &&
+            TRACK(SetSamplerState, Sampler) && TRACK(SetTexture, Texture) &&
+            TRACK(SetVertexShader, VertexShader) && TRACK(SetPixelShader, PixelShader) &&
+            // Either replaces what the other set, a value cached for one says nothing about the device
+            FLUSH(SetFVF) && FLUSH(SetVertexDeclaration) &&
+            FLUSH(UpdateSurface) && FLUSH(UpdateTexture) && FLUSH(GetRenderTargetData) && FLUSH(GetFrontBufferData) &&
+            FLUSH(StretchRect) && FLUSH(ColorFill) && FLUSH(SetRenderTarget) && FLUSH(SetDepthStencilSurface) &&
+            FLUSH(EndScene) && FLUSH(Clear) && FLUSH(SetTransform) && FLUSH(MultiplyTransform) && FLUSH(SetViewport) &&
+            FLUSH(SetMaterial) && FLUSH(SetLight) && FLUSH(LightEnable) && FLUSH(SetClipPlane) &&
+            FLUSH(SetPaletteEntries) && FLUSH(SetCurrentTexturePalette) && FLUSH(SetScissorRect) &&
+            FLUSH(SetSoftwareVertexProcessing) && FLUSH(SetNPatchMode) && FLUSH(DrawPrimitive) &&
+            FLUSH(DrawIndexedPrimitive) && FLUSH(DrawIndexedPrimitiveUP) && FLUSH(ProcessVertices) &&
+            FLUSH(SetVertexShaderConstantF) && FLUSH(SetVertexShaderConstantI) && FLUSH(SetVertexShaderConstantB) &&
+            FLUSH(SetStreamSource) && FLUSH(SetStreamSourceFreq) && FLUSH(SetIndices) &&
+            FLUSH(SetPixelShaderConstantF) && FLUSH(SetPixelShaderConstantI) && FLUSH(SetPixelShaderConstantB) &&
+            FLUSH(DrawRectPatch) && FLUSH(DrawTriPatch) &&
+            FORGET(Reset) && FORGET(BeginStateBlock) && FORGET(EndStateBlock);
+        if (!hooked) {
+            LOG("Could not hook every device method a draw depends on");
+            return false;
+        }
+        drawHook = safetyhook::create_inline(D3D9Hook::method(D3D9Hook::DrawPrimitiveUP),
+            reinterpret_cast<void*>(&drawPrimitiveUP));
+        LOG("DrawPrimitiveUP @ 0x{:x} {}", (uintptr_t)D3D9Hook::method(D3D9Hook::DrawPrimitiveUP),
+            drawHook ? "hooked" : "could not be hooked");
+        return drawHook && D3D9Hook::onPresent(&onPresent);
+    }
+
+    void counters(std::vector<std::pair<std::string, uint64_t>>* counters) {
+        if (!batcher) {
+            return;
+        }
+        std::lock_guard lock(batchMutex);
+        counters->emplace_back("batchReceived", batcher->stats().received);
+        counters->emplace_back("batchMerged", batcher->stats().merged);
+        counters->emplace_back("batchIssued", batcher->stats().issued);
+    }
+}
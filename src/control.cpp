@@ -0,0 +1,399 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2024 Dominik Protasewicz
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <cstring>
+#include <algorithm>
+#include <cstdlib>
+
+#if defined(_WIN32)
+#include <windows.h>
+#else
+#include <cerrno>
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+#endif
+
+#include "control.hpp"
+
+namespace Control
+{
+    // How often the server thread wakes up to check if it should stop
+    constexpr int POLL_MS = 100;
+
+    void Message::put(const void* value, size_t size) {
+        bytes.append(reinterpret_cast<const char*>(value), size);
+    }
+
+    void Message::get(void* value, size_t size) {
+        if (bytes.size() - position < size) {
+            ok = false;
+            position = bytes.size();
+            return;
+        }
+        memcpy(value, bytes.data() + position, size);
+        position += size;
+    }
+
+    void Message::putString(std::string_view value) {
+        uint16_t length = (uint16_t)(std::min)(value.size(), (size_t)UINT16_MAX);
+        putU16(length);
+        put(value.data(), length);
+    }
+
+    std::string Message::getString() {
+        uint16_t length = getU16();
+        if (bytes.size() - position < length) {
+            ok = false;
+            position = bytes.size();
+            return {};
+        }
+        std::string value = bytes.substr(position, length);
+        position += length;
+        return value;
+    }
+
+    std::string frame(uint8_t code, const Message& payload) {
+        uint32_t length = (uint32_t)(1 + payload.data().size());
+        std::string bytes(reinterpret_cast<const char*>(&length), sizeof(length));
+        bytes += (char)code;
+        bytes += payload.data();
+        return bytes;
+    }
+
+    bool Decoder::next(uint8_t* code, Message* payload) {
+        uint32_t length;
+        if (buffer.size() < sizeof(length)) {
+            return false;
+        }
+        memcpy(&length, buffer.data(), sizeof(length));
+        if (length == 0 || length > MAX_FRAME || buffer.size() - sizeof(length) < length) {
+            return false;
+        }
+        *code = (uint8_t)buffer[sizeof(length)];
+        *payload = Message(buffer.substr(sizeof(length) + 1, length - 1));
+        buffer.erase(0, sizeof(length) + length);
+        return true;
+    }
+
+    bool Decoder::invalid() const {
+        uint32_t length;
+        if (buffer.size() < sizeof(length)) {
+            return false;
+        }
+        memcpy(&length, buffer.data(), sizeof(length));
+        return length == 0 || length > MAX_FRAME;
+    }
+
+    std::string endpointPath(const std::string& name) {
+#if defined(_WIN32)
+        return "\\\\.\\pipe\\" + name;
+#else
+        const char* directory = getenv("XDG_RUNTIME_DIR");
+        return std::string(directory && *directory ? directory : "/tmp") + "/" + name + ".sock";
+#endif
+    }
+
+    Server::Server(std::string name) : endpoint(endpointPath(name)) {}
+
+    Server::~Server() {
+        stop();
+    }
+
+    void Server::on(uint8_t command, Handler handler) {
+        if (handlers.size() <= command) {
+            handlers.resize(command + 1);
+        }
+        handlers[command] = std::move(handler);
+    }
+
+    std::string Server::dispatch(uint8_t command, Message& request) {
+        Message response;
+        Status status = UnknownCommand;
+        if (command < handlers.size() && handlers[command]) {
+            status = handlers[command](request, &response);
+            if (status != Ok) {
+                response = Message();
+            }
+        }
+        return frame(status, response);
+    }
+
+    bool Server::start() {
+#if defined(_WIN32)
+        HANDLE pipe = CreateNamedPipeA(endpoint.c_str(),
+            PIPE_ACCESS_DUPLEX | FILE_FLAG_OVERLAPPED | FILE_FLAG_FIRST_PIPE_INSTANCE,
+            PIPE_TYPE_BYTE | PIPE_READMODE_BYTE | PIPE_WAIT | PIPE_REJECT_REMOTE_CLIENTS,
+            1, 64 * 1024, 64 * 1024, 0, nullptr);
+        if (pipe == INVALID_HANDLE_VALUE) {
+            return false;
+        }
+        listener = (intptr_t)pipe;
+#else
+        sockaddr_un address{};
+        if (endpoint.size() >= sizeof(address.sun_path)) {
+            return false;
+        }
+        int server = socket(AF_UNIX, SOCK_STREAM, 0);
+        if (server < 0) {
+            return false;
+        }
+        address.sun_family = AF_UNIX;
+        memcpy(address.sun_path, endpoint.c_str(), endpoint.size() + 1);
+        unlink(endpoint.c_str());
+        // The socket is created owner only, changing its mode after bind would leave a window open
+        mode_t mask = umask(S_IRWXG | S_IRWXO | S_IXUSR);
+        int bound = bind(server, reinterpret_cast<sockaddr*>(&address), sizeof(address));
+        umask(mask);
+        if (bound != 0 || listen(server, 1) != 0) {
+            close(server);
+            return false;
+        }
+        fcntl(server, F_SETFL, fcntl(server, F_GETFL) | O_NONBLOCK);
+        listener = server;
+#endif
+        running = true;
+        thread = std::thread(&Server::run, this);
+        return true;
+    }
+
+    void Server::stop() {
+        running = false;
+        if (thread.joinable()) {
+            thread.join();
+        }
+        if (listener == -1) {
+            return;
+        }
+#if defined(_WIN32)
+        CloseHandle((HANDLE)listener);
+#else
+        close((int)listener);
+        unlink(endpoint.c_str());
+#endif
+        listener = -1;
+    }
+
+#if defined(_WIN32)
+    void Server::run() {
+        SetThreadPriority(GetCurrentThread(), THREAD_PRIORITY_BELOW_NORMAL);
+        HANDLE pipe = (HANDLE)listener;
+        OVERLAPPED overlapped{};
+        overlapped.hEvent = CreateEventA(nullptr, TRUE, FALSE, nullptr);
+
+        // Completes an overlapped operation, giving up when asked to stop
+        auto complete = [&](BOOL done, DWORD* transferred) {
+            if (!done && GetLastError() != ERROR_IO_PENDING) {
+                return false;
+            }
+            while (WaitForSingleObject(overlapped.hEvent, POLL_MS) == WAIT_TIMEOUT) {
+                if (!running) {
+                    CancelIo(pipe);
+                    GetOverlappedResult(pipe, &overlapped, transferred, TRUE);
+                    return false;
+                }
+            }
+            return GetOverlappedResult(pipe, &overlapped, transferred, FALSE) != FALSE;
+        };
+
+        while (running) {
+            DWORD transferred = 0;
+            ResetEvent(overlapped.hEvent);
+            if (!ConnectNamedPipe(pipe, &overlapped) && GetLastError() != ERROR_PIPE_CONNECTED &&
+                !complete(FALSE, &transferred))
+            {
+                DisconnectNamedPipe(pipe);
+                continue;
+            }
+
+            Decoder decoder;
+            char buffer[4096];
+            bool open = true;
+            while (running && open) {
+                DWORD got = 0;
+                ResetEvent(overlapped.hEvent);
+                if (!complete(ReadFile(pipe, buffer, sizeof(buffer), nullptr, &overlapped), &got) || got == 0) {
+                    break;
+                }
+                decoder.feed(buffer, got);
+                uint8_t command;
+                Message request;
+                while (open && decoder.next(&command, &request)) {
+                    std::string response = dispatch(command, request);
+                    DWORD sent = 0;
+                    ResetEvent(overlapped.hEvent);
+                    open = complete(WriteFile(pipe, response.data(), (DWORD)response.size(), nullptr, &overlapped), &sent) &&
+                        sent == response.size();
+                }
+                open &= !decoder.invalid();
+            }
+            DisconnectNamedPipe(pipe);
+        }
+        CloseHandle(overlapped.hEvent);
+    }
+#else
+    static bool sendAll(int socket, const std::string& bytes, const std::atomic<bool>* running) {
+        size_t sent = 0;
+        while (sent < bytes.size()) {
+            ssize_t result = send(socket, bytes.data() + sent, bytes.size() - sent, MSG_NOSIGNAL);
+            if (result > 0) {
+                sent += (size_t)result;
+                continue;
+            }
+            if (result < 0 && (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR)) {
+                pollfd writable{ socket, POLLOUT, 0 };
+                poll(&writable, 1, POLL_MS);
+                if (running && !*running) {
+                    return false;
+                }
+                continue;
+            }
+            return false;
+        }
+        return true;
+    }
+
+    void Server::run() {
+        int server = (int)listener;
+        while (running) {
+            pollfd pending{ server, POLLIN, 0 };
+            if (poll(&pending, 1, POLL_MS) <= 0) {
+                continue;
+            }
+            int client = accept(server, nullptr, nullptr);
+            if (client < 0) {
+                continue;
+            }
+            fcntl(client, F_SETFL, fcntl(client, F_GETFL) | O_NONBLOCK);
+
+            Decoder decoder;
+            bool open = true;
+            while (running && open) {
+                pollfd readable{ client, POLLIN, 0 };
+                if (poll(&readable, 1, POLL_MS) <= 0) {
+                    continue;
+                }
+                char buffer[4096];
+                ssize_t got = recv(client, buffer, sizeof(buffer), 0);
+                if (got < 0 && (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR)) {
+                    continue;
+                }
+                if (got <= 0) {
+                    break;
+                }
+                decoder.feed(buffer, (size_t)got);
+                uint8_t command;
+                Message request;
+                while (open && decoder.next(&command, &request)) {
+                    open = sendAll(client, dispatch(command, request), &running);
+                }
+                open &= !decoder.invalid();
+            }
+            close(client);
+        }
+    }
+#endif
+
+    Client::~Client() {
+        if (connection == -1) {
+            return;
+        }
+#if defined(_WIN32)
+        CloseHandle((HANDLE)connection);
+#else
+        close((int)connection);
+#endif
+    }
+
+    bool Client::connect(const std::string& name) {
+        std::string path = endpointPath(name);
+#if defined(_WIN32)
+        HANDLE pipe = CreateFileA(path.c_str(), GENERIC_READ | GENERIC_WRITE, 0, nullptr, OPEN_EXISTING, 0, nullptr);
+        if (pipe == INVALID_HANDLE_VALUE) {
+            return false;
+        }
+        connection = (intptr_t)pipe;
+#else
+        sockaddr_un address{};
+        if (path.size() >= sizeof(address.sun_path)) {
+            return false;
+        }
+        int client = socket(AF_UNIX, SOCK_STREAM, 0);
+        if (client < 0) {
+            return false;
+        }
+        address.sun_family = AF_UNIX;
+        memcpy(address.sun_path, path.c_str(), path.size() + 1);
+        if (::connect(client, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0) {
+            close(client);
+            return false;
+        }
+        connection = client;
+#endif
+        return true;
+    }
+
+    bool Client::sendAll(const std::string& bytes) {
+#if defined(_WIN32)
+        DWORD sent = 0;
+        return WriteFile((HANDLE)connection, bytes.data(), (DWORD)bytes.size(), &sent, nullptr) && sent == bytes.size();
+#else
+        return Control::sendAll((int)connection, bytes, nullptr);
+#endif
+    }
+
+    bool Client::receiveSome(Decoder* decoder) {
+        char buffer[4096];
+#if defined(_WIN32)
+        DWORD got = 0;
+        if (!ReadFile((HANDLE)connection, buffer, sizeof(buffer), &got, nullptr) || got == 0) {
+            return false;
+        }
+#else
+        ssize_t got = recv((int)connection, buffer, sizeof(buffer), 0);
+        if (got <= 0) {
+            return false;
+        }
+#endif
+        decoder->feed(buffer, (size_t)got);
+        return true;
+    }
+
+    Status Client::request(uint8_t command, const Message& request, Message* response) {
+        if (connection == -1 || !sendAll(frame(command, request))) {
+            return Failed;
+        }
+        Decoder decoder;
+        uint8_t status;
+        while (!decoder.next(&status, response)) {
+            if (decoder.invalid() || !receiveSome(&decoder)) {
+                return Failed;
+            }
+        }
+        return (Status)status;
+    }
+}
@@ -0,0 +1,157 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2024 Dominik Protasewicz
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <windows.h>
+#include <d3d9.h>
+#include <atomic>
+#include <cstring>
+#include <mutex>
+
+#include "spdlog/spdlog.h"
+#include "safetyhook.hpp"
+
+#include "log.hpp"
+#include "profiler.hpp"
+#include "d3d9hook.hpp"
+
+namespace D3D9Hook
+{
+    static constexpr size_t MAX_CALLBACKS = 8;
+
+    static std::mutex initMutex;
+    static void* methods[MethodCount] = {};
+    static SafetyHookInline presentHook{};
+    static std::atomic<PresentCallback> callbacks[MAX_CALLBACKS] = {};
+    static std::atomic<size_t> callbackCount = 0;
+
+    static HRESULT __stdcall present(IDirect3DDevice9* device, const RECT* sourceRect, const RECT* destRect,
+        HWND destWindow, const RGNDATA* dirtyRegion)
+    {
+        HRESULT result = presentHook.stdcall<HRESULT>(device, sourceRect, destRect, destWindow, dirtyRegion);
+        PROFILE_FRAME();
+        size_t count = callbackCount.load(std::memory_order_acquire);
+        for (size_t i = 0; i < count; i++) {
+            PresentCallback callback = callbacks[i].load(std::memory_order_acquire);
+            if (callback) {
+                callback(device);
+            }
+        }
+        return result;
+    }
+
+    /**
+     * @brief Copy the device vtable out of a throwaway device
+     */
+    static bool readMethods() {
+        // Looked up at runtime so the DLL does not pull in d3d9.dll by itself
+        using Direct3DCreate9_t = IDirect3D9* (WINAPI*)(UINT);
+        HMODULE d3d9 = LoadLibraryA("d3d9.dll");
+        auto create = d3d9 ? reinterpret_cast<Direct3DCreate9_t>(GetProcAddress(d3d9, "Direct3DCreate9")) : nullptr;
+        if (!create) {
+            LOG("Could not load d3d9.dll");
+            return false;
+        }
+        IDirect3D9* d3d = create(D3D_SDK_VERSION);
+        if (!d3d) {
+            LOG("Direct3DCreate9 failed");
+            return false;
+        }
+
+        HWND window = CreateWindowExA(0, "STATIC", "D3D9Hook", WS_OVERLAPPEDWINDOW, 0, 0, 16, 16,
+            nullptr, nullptr, nullptr, nullptr);
+        D3DPRESENT_PARAMETERS params{};
+        params.Windowed = TRUE;
+        params.SwapEffect = D3DSWAPEFFECT_DISCARD;
+        params.BackBufferFormat = D3DFMT_UNKNOWN;
+        params.hDeviceWindow = window;
+
+        IDirect3DDevice9* device = nullptr;
+        HRESULT result = d3d->CreateDevice(D3DADAPTER_DEFAULT, D3DDEVTYPE_HAL, window,
+            D3DCREATE_SOFTWARE_VERTEXPROCESSING | D3DCREATE_DISABLE_DRIVER_MANAGEMENT, &params, &device);
+        if (FAILED(result)) {
+            // The null reference device has the same vtable and needs no working driver
+            result = d3d->CreateDevice(D3DADAPTER_DEFAULT, D3DDEVTYPE_NULLREF, window,
+                D3DCREATE_SOFTWARE_VERTEXPROCESSING, &params, &device);
+        }
+        if (SUCCEEDED(result)) {
+            memcpy(methods, *reinterpret_cast<void***>(device), sizeof(methods));
+            device->Release();
+        }
+        else {
+            LOG("Could not create a device: 0x{:x}", (uint32_t)result);
+        }
+        d3d->Release();
+        if (window) {
+            DestroyWindow(window);
+        }
+        return SUCCEEDED(result);
+    }
+
+    static bool hookPresent() {
+        presentHook = safetyhook::create_inline(methods[Present], reinterpret_cast<void*>(&present));
+        LOG("Present @ 0x{:x} {}", (uintptr_t)methods[Present], presentHook ? "hooked" : "could not be hooked");
+        return (bool)presentHook;
+    }
+
+    bool init() {
+        PROFILE_ZONE();
+        std::lock_guard lock(initMutex);
+        if (presentHook) {
+            return true;
+        }
+        if (!methods[Present] && !readMethods()) {
+            return false;
+        }
+        return hookPresent();
+    }
+
+    bool init(IDirect3DDevice9* device) {
+        PROFILE_ZONE();
+        std::lock_guard lock(initMutex);
+        if (presentHook) {
+            return true;
+        }
+        memcpy(methods, *reinterpret_cast<void***>(device), sizeof(methods));
+        return hookPresent();
+    }
+
+    void* method(Method method) {
+        return methods[method];
+    }
+
+    bool onPresent(PresentCallback callback) {
+        // Slots are only ever appended, the render thread sees a slot once the count covers it
+        static std::atomic<size_t> reserved = 0;
+        size_t slot = reserved.fetch_add(1);
+        if (slot >= MAX_CALLBACKS) {
+            return false;
+        }
+        callbacks[slot].store(callback, std::memory_order_release);
+        size_t expected = slot;
+        while (!callbackCount.compare_exchange_weak(expected, slot + 1, std::memory_order_release)) {
+            expected = slot;
+        }
+        return true;
+    }
+}
@@ -0,0 +1,431 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2024 Dominik Protasewicz
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <cstdint>
+#include <cstring>
+#include <bit>
+
+#include "decompress.hpp"
+
+namespace Decompress
+{
+    static inline size_t load16(const uint8_t* bytes) {
+        return (size_t)bytes[0] | ((size_t)bytes[1] << 8);
+    }
+
+    /**
+     * @brief Copy bytes one at a time, correct for any overlap.
+     * @details Faster than anything else for the very short matches that dominate.
+     */
+    static inline void copyBytes(uint8_t* op, const uint8_t* from, size_t len) {
+        for (size_t i = 0; i < len; i++) {
+            op[i] = from[i];
+        }
+    }
+
+    /**
+     * @brief Copy a match writing exactly `len` bytes.
+     * @details A run of a single byte becomes a memset. Longer matches closer than a word
+     *      are widened by copying the pattern onto itself, which doubles the distance each
+     *      time, until whole words can be copied without overlap.
+     */
+    static inline void copyMatch(uint8_t* op, size_t offset, size_t len) {
+        const uint8_t* from = op - offset;
+        if (offset == 1) {
+            memset(op, *from, len);
+            return;
+        }
+        if (offset >= len && len >= 4 && len <= 16) {
+            // Source and destination do not overlap, two possibly overlapping words
+            // cover the whole match exactly
+            if (len >= 8) {
+                uint64_t head, tail;
+                memcpy(&head, from, 8);
+                memcpy(&tail, from + len - 8, 8);
+                memcpy(op, &head, 8);
+                memcpy(op + len - 8, &tail, 8);
+            }
+            else {
+                uint32_t head, tail;
+                memcpy(&head, from, 4);
+                memcpy(&tail, from + len - 4, 4);
+                memcpy(op, &head, 4);
+                memcpy(op + len - 4, &tail, 4);
+            }
+            return;
+        }
+        if (offset < 8) {
+            if (len <= 16) {
+                copyBytes(op, from, len);
+                return;
+            }
+            for (; offset < 8; offset <<= 1) {
+                copyBytes(op, from, offset);
+                op += offset;
+                len -= offset;
+            }
+        }
+        for (; len >= 8; len -= 8) {
+            memcpy(op, from, 8);
+            op += 8;
+            from += 8;
+        }
+        copyBytes(op, from, len);
+    }
+
+    /**
+     * @brief Copy a match, possibly writing up to 15 bytes past `op + len`.
+     * @details Only used when the output buffer is known to have room for the overshoot,
+     *      in exchange the copy loop has no tail to handle.
+     */
+    static inline void copyMatchWild(uint8_t* op, size_t offset, size_t len) {
+        const uint8_t* from = op - offset;
+        uint8_t* end = op + len;
+        if (offset == 1) {
+            memset(op, *from, len);
+            return;
+        }
+        if (offset < 8) {
+            if (len <= 16) {
+                copyBytes(op, from, len);
+                return;
+            }
+            for (; offset < 8; offset <<= 1) {
+                copyBytes(op, from, offset);
+                op += offset;
+            }
+        }
+        do {
+            memcpy(op, from, 8);
+            op += 8;
+            from += 8;
+        } while (op < end);
+    }
+
+    template <bool Bounded>
+    static size_t decodeImpl(const uint8_t* src, const uint8_t* srcEnd, uint8_t* dst, uint8_t* dstEnd) {
+        uint8_t* op = dst;
+        const uint8_t* chunk = src;
+        for (;;) {
+            if constexpr (Bounded) {
+                if (srcEnd - chunk < 3) {
+                    return error;
+                }
+            }
+            size_t chunkLen = load16(chunk);
+            const uint8_t* chunkEnd = chunk + chunkLen;
+            if constexpr (Bounded) {
+                // The continuation flag after the chunk must be in bounds too
+                if (chunkLen < 2 || chunkLen >= (size_t)(srcEnd - chunk)) {
+                    return error;
+                }
+            }
+            const uint8_t* ip = chunk + 2;
+            // A sentinel above the 16 flag bits marks when the word is used up, so taking a
+            // bit needs no separate counter
+            uint32_t flags = 1;
+            bool bad = false;
+
+            auto byte = [&]() -> size_t {
+                if constexpr (Bounded) {
+                    if (ip >= chunkEnd) {
+                        bad = true;
+                        return 0;
+                    }
+                }
+                return *ip++;
+            };
+            auto bit = [&]() -> size_t {
+                if (flags == 1) {
+                    if constexpr (Bounded) {
+                        if (chunkEnd - ip < 2) {
+                            bad = true;
+                            return 0;
+                        }
+                    }
+                    flags = (uint32_t)load16(ip) | 0x10000;
+                    ip += 2;
+                }
+                size_t b = flags & 1;
+                flags >>= 1;
+                return b;
+            };
+            auto getBits = [&](int n) -> size_t {
+                size_t value = 0;
+                while (n--) {
+                    value = (value << 1) | bit();
+                }
+                return value;
+            };
+            auto count = [&]() -> size_t {
+                // With the whole unary prefix in the flag word it is decoded in one step
+                if (flags >= (1u << 5)) {
+                    int zeros = std::countr_zero(flags);
+                    if (zeros < 4) {
+                        flags >>= zeros + 1;
+                        return 2 + zeros;
+                    }
+                    bool fourZeros = zeros == 4;
+                    flags >>= 5;
+                    return fourZeros ? 6 + getBits(3) : 14 + byte();
+                }
+                if (bit()) return 2;
+                if (bit()) return 3;
+                if (bit()) return 4;
+                if (bit()) return 5;
+                if (bit()) return 6 + getBits(3);
+                return 14 + byte();
+            };
+
+            for (;;) {
+                if constexpr (Bounded) {
+                    if (bad) {
+                        return error;
+                    }
+                }
+                if (flags == 1) {
+                    if constexpr (Bounded) {
+                        if (chunkEnd - ip < 2) {
+                            return error;
+                        }
+                    }
+                    flags = (uint32_t)load16(ip) | 0x10000;
+                    ip += 2;
+                }
+
+                // Every zero bit before the next set bit (or the sentinel) is a literal,
+                // take all of them at once
+                size_t literals = (size_t)std::countr_zero(flags);
+                if (literals) {
+                    if constexpr (Bounded) {
+                        if (literals > (size_t)(chunkEnd - ip) || literals > (size_t)(dstEnd - op)) {
+                            return error;
+                        }
+                    }
+                    copyBytes(op, ip, literals);
+                    op += literals;
+                    ip += literals;
+                    flags >>= literals;
+                    continue;
+                }
+                flags >>= 1;
+
+                size_t offset;
+                size_t len;
+                if (!bit()) {
+                    offset = byte();
+                    len = count();
+                }
+                else {
+                    offset = getBits(5) << 8;
+                    offset |= byte();
+                    if (offset == 0) {
+                        break;
+                    }
+                    if (offset == 1) {
+                        if (bit()) {
+                            len = getBits(4) << 8;
+                            len |= byte();
+                        }
+                        else {
+                            len = getBits(4);
+                        }
+                        len += 14;
+                        uint8_t value = (uint8_t)byte();
+                        if constexpr (Bounded) {
+                            if (bad || len > (size_t)(dstEnd - op)) {
+                                return error;
+                            }
+                        }
+                        memset(op, value, len);
+                        op += len;
+                        continue;
+                    }
+                    len = count();
+                }
+
+                if constexpr (Bounded) {
+                    size_t room = (size_t)(dstEnd - op);
+                    if (bad || offset == 0 || offset > (size_t)(op - dst) || len > room) {
+                        return error;
+                    }
+                    if (len + 16 <= room) {
+                        copyMatchWild(op, offset, len);
+                        op += len;
+                        continue;
+                    }
+                }
+                copyMatch(op, offset, len);
+                op += len;
+            }
+
+            if constexpr (Bounded) {
+                if (bad) {
+                    return error;
+                }
+            }
+            chunk = chunkEnd;
+            if (*chunk++ == 0) {
+                return (size_t)(op - dst);
+            }
+        }
+    }
+
+    size_t decode(const uint8_t* src, uint8_t* dst) {
+        return decodeImpl<false>(src, nullptr, dst, nullptr);
+    }
+
+    size_t decode(const uint8_t* src, size_t srcSize, uint8_t* dst, size_t dstSize) {
+        return decodeImpl<true>(src, src + srcSize, dst, dst + dstSize);
+    }
+
+    size_t streamSize(const uint8_t* src, size_t srcSize) {
+        size_t pos = 0;
+        for (;;) {
+            if (srcSize - pos < 3) {
+                return error;
+            }
+            size_t chunkLen = load16(src + pos);
+            if (chunkLen < 2 || chunkLen >= srcSize - pos) {
+                return error;
+            }
+            pos += chunkLen;
+            if (src[pos++] == 0) {
+                return pos;
+            }
+        }
+    }
+
+    size_t decodeReference(const uint8_t* src, size_t srcSize, uint8_t* dst, size_t dstSize) {
+        size_t ip = 0;
+        size_t op = 0;
+        for (;;) {
+            if (ip + 2 > srcSize) {
+                return error;
+            }
+            size_t chunkEnd = ip + load16(src + ip);
+            if (chunkEnd < ip + 2 || chunkEnd >= srcSize) {
+                return error;
+            }
+            ip += 2;
+
+            uint32_t flags = 0;
+            int bits = 0;
+            bool bad = false;
+            auto byte = [&]() -> size_t {
+                if (ip >= chunkEnd) {
+                    bad = true;
+                    return 0;
+                }
+                return src[ip++];
+            };
+            auto bit = [&]() -> size_t {
+                if (bits == 0) {
+                    flags = (uint32_t)byte();
+                    flags |= (uint32_t)byte() << 8;
+                    bits = 16;
+                }
+                size_t b = flags & 1;
+                flags >>= 1;
+                bits--;
+                return b;
+            };
+            auto getBits = [&](int n) -> size_t {
+                size_t value = 0;
+                for (int i = 0; i < n; i++) {
+                    value = (value << 1) | bit();
+                }
+                return value;
+            };
+            auto count = [&]() -> size_t {
+                if (bit()) return 2;
+                if (bit()) return 3;
+                if (bit()) return 4;
+                if (bit()) return 5;
+                if (bit()) return 6 + getBits(3);
+                return 14 + byte();
+            };
+
+            for (;;) {
+                if (bad) {
+                    return error;
+                }
+                if (bit() == 0) {
+                    uint8_t value = (uint8_t)byte();
+                    if (op >= dstSize) {
+                        return error;
+                    }
+                    dst[op++] = value;
+                    continue;
+                }
+                size_t offset;
+                size_t len;
+                if (bit() == 0) {
+                    offset = byte();
+                    len = count();
+                }
+                else {
+                    offset = getBits(5) << 8;
+                    offset |= byte();
+                    if (offset == 0) {
+                        break;
+                    }
+                    if (offset == 1) {
+                        if (bit()) {
+                            len = getBits(4) << 8;
+                            len |= byte();
+                        }
+                        else {
+                            len = getBits(4);
+                        }
+                        len += 14;
+                        uint8_t value = (uint8_t)byte();
+                        if (bad || len > dstSize - op) {
+                            return error;
+                        }
+                        for (size_t i = 0; i < len; i++) {
+                            dst[op++] = value;
+                        }
+                        continue;
+                    }
+                    len = count();
+                }
+                if (bad || offset == 0 || offset > op || len > dstSize - op) {
+                    return error;
+                }
+                for (size_t i = 0; i < len; i++, op++) {
+                    dst[op] = dst[op - offset];
+                }
+            }
+            if (bad) {
+                return error;
+            }
+
+            ip = chunkEnd;
+            if (src[ip++] == 0) {
+                return op;
+            }
+        }
+    }
+}
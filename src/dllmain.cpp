@@ -24,6 +24,9 @@
 
 // System includes
 #include <windows.h>
+#include <psapi.h>
+#include <chrono>
+#include <future>
 #include <fstream>
 #include <iostream>
 #include <string>
@@ -32,6 +35,10 @@
 #include <numbers>
 #include <cmath>
 #include <cstdint>
+#include <algorithm>
+#include <functional>
+#include <map>
+#include <mutex>
 
 // 3rd party includes
 #include "spdlog/spdlog.h"
@@ -40,31 +47,172 @@
 #include "safetyhook.hpp"
 
 // Local includes
+#include "log.hpp"
 #include "utils.hpp"
+#include "decompress.hpp"
+#include "archive.hpp"
+#include "rcu.hpp"
+#include "signatures.hpp"
+#include "asm.hpp"
+#include "callbacks.hpp"
+#include "hooktrace.hpp"
+#include "control.hpp"
+#include "profiler.hpp"
+#include "d3d9hook.hpp"
+#include "hitch.hpp"
+#include "startup.hpp"
+#include "profilecache.hpp"
+#include "savequeue.hpp"
+#include "glyphcache.hpp"
+#include "batcher.hpp"
+#include "vertexring.hpp"
+#include "texturepool.hpp"
+#include "inputreplay.hpp"
 
 // Macros
 #define VERSION "1.0.0"
-#define LOG(STRING, ...) spdlog::info("{} : " STRING, __func__, ##__VA_ARGS__)
 
 // .yml to struct
+typedef struct keepAspect_t {
+    bool enable;    // Not in the .yml, armed with masterEnable and switched over the control channel
+} keepAspect_t;
+
 typedef struct textures_t {
     bool enable;
 } textures_t;
 
+typedef struct pipeline_t {
+    bool enable;
+    int workers;
+    int lookahead;
+    int cacheMiB;
+} pipeline_t;
+
+typedef struct decompress_t {
+    bool enable;
+    std::string signature;
+    pipeline_t pipeline;
+} decompress_t;
+
+typedef struct profileCache_t {
+    bool enable;
+} profileCache_t;
+
+typedef struct introSkip_t {
+    bool enable;
+    bool skip;
+    std::string signature;
+    int titleState;
+    std::string record;
+} introSkip_t;
+
+typedef struct asyncSave_t {
+    bool enable;
+    std::string pattern;
+} asyncSave_t;
+
+typedef struct glyphCache_t {
+    bool enable;
+    int pageSize;
+    int pages;
+    std::string record;
+} glyphCache_t;
+
+typedef struct batching_t {
+    bool enable;
+    int smallVertices;
+    int capacity;
+    int logFrames;
+} batching_t;
+
+typedef struct vertexRing_t {
+    bool enable;
+    int vertexKiB;
+    int indexKiB;
+    int logFrames;
+} vertexRing_t;
+
+typedef struct texturePool_t {
+    bool enable;
+    int budgetMiB;
+    int logFrames;
+} texturePool_t;
+
 typedef struct fix_t {
+    keepAspect_t keepAspect;
     textures_t textures;
+    decompress_t decompress;
+    profileCache_t profileCache;
+    introSkip_t introSkip;
+    asyncSave_t asyncSave;
+    glyphCache_t glyphCache;
+    batching_t batching;
+    vertexRing_t vertexRing;
+    texturePool_t texturePool;
 } fix_t;
 
+typedef struct trace_t {
+    bool enable;
+    std::string path;
+    int maxMiB;
+} trace_t;
+
+typedef struct control_t {
+    bool enable;
+    std::string name;
+} control_t;
+
+typedef struct hitch_t {
+    bool enable;
+    double thresholdMs;
+    int minEventUs;
+    std::string path;
+    int maxMiB;
+} hitch_t;
+
+typedef struct startup_t {
+    bool enable;
+    std::string path;
+} startup_t;
+
+typedef struct replay_t {
+    bool enable;
+    std::string mode;
+    std::string path;
+    std::string telemetry;
+    int maxMiB;
+} replay_t;
+
 typedef struct yml_t {
     std::string name;
     bool masterEnable;
+    bool prefetch;
+    trace_t trace;
+    control_t control;
+    hitch_t hitch;
+    startup_t startup;
+    replay_t replay;
     fix_t fix;
 } yml_t;
 
 // Globals
 HMODULE baseModule = GetModuleHandle(NULL);
-YAML::Node config = YAML::LoadFile("TrailsInTheSkyFCFix.yml");
-yml_t yml;
+YAML::Node config;
+Rcu<yml_t> yml;
+HookTrace::Writer* tracer = nullptr;
+std::chrono::steady_clock::time_point mainStart;
+uint64_t attachTime = 0;
+
+typedef struct scan_t {
+    std::string name;
+    bool found;
+    uint32_t rva;
+} scan_t;
+
+// Filled in while the fixes are armed and read by the control channel
+std::mutex armedMutex;
+std::vector<scan_t> scans;
+std::map<std::string, std::function<bool(bool)>> toggles;
 
 /**
  * @brief Initializes logging for the application.
@@ -77,6 +225,8 @@ yml_t yml;
  * @return void
  */
 void logInit() {
+    PROFILE_ZONE();
+    Startup::Scope step("logInit", "setup");
     // spdlog initialisation
     auto logger = spdlog::basic_logger_mt("TrailsInTheSkyFCFix", "TrailsInTheSkyFCFix.log", true);
     spdlog::set_default_logger(logger);
@@ -98,26 +248,473 @@ void logInit() {
     LOG("Module Addr: 0x{:x}", (uintptr_t)baseModule);
 }
 
+/**
+ * @brief Loads the configuration file and prefetches the image of the game.
+ *
+ * This function performs the following tasks:
+ * 1. Loads the YAML configuration file into `config`.
+ * 2. Unless disabled in the configuration, collects every section of the base module.
+ * 3. Asks the OS to bring all of them into the working set in a single batched request.
+ *
+ * @details
+ * The DLL is loaded so early that most of ed6_win_DX9.exe has not been touched yet, and the
+ * first signature scans would otherwise soft fault their way through the image page by page.
+ * This runs on its own thread while `Main` sets up the logger, so the pages are being brought
+ * in before the scans start.
+ *
+ * @return true if the prefetch was issued.
+ */
+bool loadConfigAndPrefetch() {
+    Startup::Scope step("loadConfigAndPrefetch", "setup");
+    config = YAML::LoadFile("TrailsInTheSkyFCFix.yml");
+    if (!config["prefetch"].as<bool>()) {
+        return false;
+    }
+    return Scanner::prefetch(Utils::sectionRanges(baseModule));
+}
+
 /**
  * @brief Reads and parses configuration settings from a YAML file.
  *
  * This function performs the following tasks:
- * 1. Reads general settings from the configuration file and assigns them to the `yml` structure.
+ * 1. Reads general settings from the configuration file into a new `yml_t` snapshot.
  * 2. Initializes global settings if certain values are missing or default.
  * 3. Logs the parsed configuration values for debugging purposes.
+ * 4. Publishes the snapshot through `yml`, replacing the previous one.
+ *
+ * @details
+ * A published snapshot is never modified again. Anything wanting to change the configuration
+ * at runtime must build a complete new `yml_t` and publish it the same way, hook callbacks can
+ * then read the configuration through `yml.read()` without ever taking a lock.
  *
  * @return void
  */
 void readYml() {
-    yml.name = config["name"].as<std::string>();
+    PROFILE_ZONE();
+    Startup::Scope step("readYml", "setup");
+    auto next = std::make_unique<yml_t>();
+
+    next->name = config["name"].as<std::string>();
+
+    next->masterEnable = config["masterEnable"].as<bool>();
+    next->prefetch = config["prefetch"].as<bool>();
+
+    next->trace.enable = config["trace"]["enable"].as<bool>();
+    next->trace.path = config["trace"]["path"].as<std::string>();
+    next->trace.maxMiB = config["trace"]["maxMiB"].as<int>();
+
+    next->control.enable = config["control"]["enable"].as<bool>();
+    next->control.name = config["control"]["name"].as<std::string>();
+
+    next->hitch.enable = config["hitch"]["enable"].as<bool>();
+    next->hitch.thresholdMs = config["hitch"]["thresholdMs"].as<double>();
+    next->hitch.minEventUs = config["hitch"]["minEventUs"].as<int>();
+    next->hitch.path = config["hitch"]["path"].as<std::string>();
+    next->hitch.maxMiB = config["hitch"]["maxMiB"].as<int>();
+
+    next->startup.enable = config["startup"]["enable"].as<bool>();
+    next->startup.path = config["startup"]["path"].as<std::string>();
+
+    next->replay.enable = config["replay"]["enable"].as<bool>();
+    next->replay.mode = config["replay"]["mode"].as<std::string>();
+    next->replay.path = config["replay"]["path"].as<std::string>();
+    next->replay.telemetry = config["replay"]["telemetry"].as<std::string>();
+    next->replay.maxMiB = config["replay"]["maxMiB"].as<int>();
+
+    next->fix.keepAspect.enable = true;
+    next->fix.textures.enable = config["fixes"]["textures"]["enable"].as<bool>();
+
+    next->fix.decompress.enable = config["fixes"]["decompress"]["enable"].as<bool>();
+    next->fix.decompress.signature = config["fixes"]["decompress"]["signature"].as<std::string>();
+    next->fix.decompress.pipeline.enable = config["fixes"]["decompress"]["pipeline"]["enable"].as<bool>();
+    next->fix.decompress.pipeline.workers = config["fixes"]["decompress"]["pipeline"]["workers"].as<int>();
+    next->fix.decompress.pipeline.lookahead = config["fixes"]["decompress"]["pipeline"]["lookahead"].as<int>();
+    next->fix.decompress.pipeline.cacheMiB = config["fixes"]["decompress"]["pipeline"]["cacheMiB"].as<int>();
+    next->fix.profileCache.enable = config["fixes"]["profileCache"]["enable"].as<bool>();
+    next->fix.introSkip.enable = config["fixes"]["introSkip"]["enable"].as<bool>();
+    next->fix.introSkip.skip = config["fixes"]["introSkip"]["skip"].as<bool>();
+    next->fix.introSkip.signature = config["fixes"]["introSkip"]["signature"].as<std::string>();
+    next->fix.introSkip.titleState = config["fixes"]["introSkip"]["titleState"].as<int>();
+    next->fix.introSkip.record = config["fixes"]["introSkip"]["record"].as<std::string>();
+    next->fix.asyncSave.enable = config["fixes"]["asyncSave"]["enable"].as<bool>();
+    next->fix.asyncSave.pattern = config["fixes"]["asyncSave"]["pattern"].as<std::string>();
+    next->fix.glyphCache.enable = config["fixes"]["glyphCache"]["enable"].as<bool>();
+    next->fix.glyphCache.pageSize = config["fixes"]["glyphCache"]["pageSize"].as<int>();
+    next->fix.glyphCache.pages = config["fixes"]["glyphCache"]["pages"].as<int>();
+    next->fix.glyphCache.record = config["fixes"]["glyphCache"]["record"].as<std::string>();
+    next->fix.batching.enable = config["fixes"]["batching"]["enable"].as<bool>();
+    next->fix.batching.smallVertices = config["fixes"]["batching"]["smallVertices"].as<int>();
+    next->fix.batching.capacity = config["fixes"]["batching"]["capacity"].as<int>();
+    next->fix.batching.logFrames = config["fixes"]["batching"]["logFrames"].as<int>();
+    next->fix.vertexRing.enable = config["fixes"]["vertexRing"]["enable"].as<bool>();
+    next->fix.vertexRing.vertexKiB = config["fixes"]["vertexRing"]["vertexKiB"].as<int>();
+    next->fix.vertexRing.indexKiB = config["fixes"]["vertexRing"]["indexKiB"].as<int>();
+    next->fix.vertexRing.logFrames = config["fixes"]["vertexRing"]["logFrames"].as<int>();
+    next->fix.texturePool.enable = config["fixes"]["texturePool"]["enable"].as<bool>();
+    next->fix.texturePool.budgetMiB = config["fixes"]["texturePool"]["budgetMiB"].as<int>();
+    next->fix.texturePool.logFrames = config["fixes"]["texturePool"]["logFrames"].as<int>();
+
+    LOG("Name: {}", next->name);
+    LOG("MasterEnable: {}", next->masterEnable);
+    LOG("Prefetch: {}", next->prefetch);
+    LOG("Trace.Enable: {}", next->trace.enable);
+    LOG("Trace.Path: {}", next->trace.path);
+    LOG("Trace.MaxMiB: {}", next->trace.maxMiB);
+    LOG("Control.Enable: {}", next->control.enable);
+    LOG("Control.Name: {}", next->control.name);
+    LOG("Hitch.Enable: {}", next->hitch.enable);
+    LOG("Hitch.ThresholdMs: {}", next->hitch.thresholdMs);
+    LOG("Hitch.MinEventUs: {}", next->hitch.minEventUs);
+    LOG("Hitch.Path: {}", next->hitch.path);
+    LOG("Hitch.MaxMiB: {}", next->hitch.maxMiB);
+    LOG("Startup.Enable: {}", next->startup.enable);
+    LOG("Startup.Path: {}", next->startup.path);
+    LOG("Replay.Enable: {}", next->replay.enable);
+    LOG("Replay.Mode: {}", next->replay.mode);
+    LOG("Replay.Path: {}", next->replay.path);
+    LOG("Replay.Telemetry: {}", next->replay.telemetry);
+    LOG("Replay.MaxMiB: {}", next->replay.maxMiB);
+    LOG("Fix.Textures.Enable: {}", next->fix.textures.enable);
+    LOG("Fix.Decompress.Enable: {}", next->fix.decompress.enable);
+    LOG("Fix.Decompress.Signature: {}", next->fix.decompress.signature);
+    LOG("Fix.Decompress.Pipeline.Enable: {}", next->fix.decompress.pipeline.enable);
+    LOG("Fix.Decompress.Pipeline.Workers: {}", next->fix.decompress.pipeline.workers);
+    LOG("Fix.Decompress.Pipeline.Lookahead: {}", next->fix.decompress.pipeline.lookahead);
+    LOG("Fix.Decompress.Pipeline.CacheMiB: {}", next->fix.decompress.pipeline.cacheMiB);
+    LOG("Fix.ProfileCache.Enable: {}", next->fix.profileCache.enable);
+    LOG("Fix.IntroSkip.Enable: {}", next->fix.introSkip.enable);
+    LOG("Fix.IntroSkip.Skip: {}", next->fix.introSkip.skip);
+    LOG("Fix.IntroSkip.Signature: {}", next->fix.introSkip.signature);
+    LOG("Fix.IntroSkip.TitleState: {}", next->fix.introSkip.titleState);
+    LOG("Fix.IntroSkip.Record: {}", next->fix.introSkip.record);
+    LOG("Fix.AsyncSave.Enable: {}", next->fix.asyncSave.enable);
+    LOG("Fix.AsyncSave.Pattern: {}", next->fix.asyncSave.pattern);
+    LOG("Fix.GlyphCache.Enable: {}", next->fix.glyphCache.enable);
+    LOG("Fix.GlyphCache.PageSize: {}", next->fix.glyphCache.pageSize);
+    LOG("Fix.GlyphCache.Pages: {}", next->fix.glyphCache.pages);
+    LOG("Fix.GlyphCache.Record: {}", next->fix.glyphCache.record);
+    LOG("Fix.Batching.Enable: {}", next->fix.batching.enable);
+    LOG("Fix.Batching.SmallVertices: {}", next->fix.batching.smallVertices);
+    LOG("Fix.Batching.Capacity: {}", next->fix.batching.capacity);
+    LOG("Fix.Batching.LogFrames: {}", next->fix.batching.logFrames);
+    LOG("Fix.VertexRing.Enable: {}", next->fix.vertexRing.enable);
+    LOG("Fix.VertexRing.VertexKiB: {}", next->fix.vertexRing.vertexKiB);
+    LOG("Fix.VertexRing.IndexKiB: {}", next->fix.vertexRing.indexKiB);
+    LOG("Fix.VertexRing.LogFrames: {}", next->fix.vertexRing.logFrames);
+    LOG("Fix.TexturePool.Enable: {}", next->fix.texturePool.enable);
+    LOG("Fix.TexturePool.BudgetMiB: {}", next->fix.texturePool.budgetMiB);
+    LOG("Fix.TexturePool.LogFrames: {}", next->fix.texturePool.logFrames);
+
+    yml.publish(std::move(next));
+}
+
+/**
+ * @brief Remembers the result of a fix's scan so it can be queried over the control channel.
+ *
+ * @param name Name of the signature
+ * @param address Address of the first match, 0 if there was none
+ * @return void
+ */
+void recordScan(const char* name, uintptr_t address) {
+    std::lock_guard lock(armedMutex);
+    scans.push_back({ name, address != 0, address ? (uint32_t)(address - (uintptr_t)baseModule) : 0 });
+}
+
+/**
+ * @brief Registers how an armed fix is switched on and off over the control channel.
+ *
+ * @param name Name the fix is toggled by
+ * @param toggle Switches the fix on when passed true and off when passed false, returning false on failure
+ * @return void
+ */
+void registerToggle(const char* name, std::function<bool(bool)> toggle) {
+    std::lock_guard lock(armedMutex);
+    toggles[name] = std::move(toggle);
+}
+
+/**
+ * @brief Starts recording hook contexts if enabled in the configuration.
+ *
+ * @details
+ * While a trace is recorded the fixes are armed with their mid hooks, even where a cheaper patch
+ * is available, so that every call passes through a callback that can be recorded. The trace can
+ * be replayed offline with the `hookreplay` tool.
+ *
+ * @return void
+ */
+void traceInit() {
+    auto cfg = yml.read();
+    if (!cfg->masterEnable || !cfg->trace.enable) {
+        return;
+    }
+    std::vector<std::string> sites(Callbacks::siteNames, Callbacks::siteNames + Callbacks::SiteCount);
+    // Never freed, hooks may record until the very end of the process
+    auto writer = new HookTrace::Writer(cfg->trace.path.c_str(), sites,
+        (uint64_t)(std::max)(1, cfg->trace.maxMiB) * 1024 * 1024);
+    if (writer->isOpen()) {
+        tracer = writer;
+    }
+    LOG("Recording hook trace to '{}' {}", cfg->trace.path, tracer ? "started" : "failed");
+}
+
+/**
+ * @brief Runs a mid hook callback, recording its context when a trace is being recorded.
+ *
+ * @tparam site Hook site the callback belongs to
+ * @tparam callback Callback body from callbacks.hpp
+ * @param ctx Register state at the hook
+ * @return void
+ */
+template <Callbacks::Site site, void (*callback)(SafetyHookContext&)>
+void midHook(SafetyHookContext& ctx) {
+    PROFILE_ZONE_NAMED(Callbacks::siteNames[site]);
+    Hitch::Scope scope(Hitch::Hook, site);
+    if (!tracer) {
+        callback(ctx);
+        return;
+    }
+    HookContext32 before, after;
+    HookContext::copy(ctx, &before);
+    callback(ctx);
+    HookContext::copy(ctx, &after);
+    tracer->write(site, before, after);
+}
+
+/**
+ * @brief Records how the game starts up, from process creation to the first presented frame.
+ *
+ * @details
+ * Startup is split into phases: the loader up to the DLL being attached, arming the critical
+ * fixes, the game initialising, creating its Direct3D device and producing its first frame. The
+ * steps of the DLL, every file the game opens and its Direct3D device creation are recorded along
+ * with them, and every file read is counted towards its phase. At the first present the timeline
+ * is written in the Chrome trace format, which chrome://tracing and Perfetto open, and the time
+ * and I/O of each phase are logged.
+ *
+ * Armed first so that the game's file opens are timed from as early as possible.
+ *
+ * @return void
+ */
+void startupTimeline() {
+    PROFILE_ZONE();
+    auto cfg = yml.read();
+
+    bool enable = cfg->masterEnable & cfg->startup.enable;
+    LOG("Fix {}", enable ? "Enabled" : "Disabled");
+    if (enable) {
+        bool installed = Startup::install(baseModule, attachTime, cfg->startup.path.c_str());
+        LOG("First present {}", installed ? "awaited" : "cannot be observed");
+    }
+}
+
+/**
+ * @brief Records the game's input per frame, or plays a recording back, for repeatable runs.
+ *
+ * @details
+ * In `record` mode every poll of the keyboard through `GetKeyboardState`, `GetAsyncKeyState`
+ * and `GetKeyState` and of the DirectInput devices is written to `path` with the frame it was
+ * made in. In `replay` mode the same polls are answered from `path`, so the game is played the
+ * same way at the same frames and frame times of different builds can be compared. Runs should
+ * start from the same point, as input only lines up while the game takes the same number of
+ * frames to get anywhere. Unless `telemetry` is empty every frame's duration is written to it
+ * as CSV, while replaying up to the end of the recording.
+ *
+ * Armed with the critical fixes so that the game's first polls are already seen.
+ *
+ * @return void
+ */
+void inputReplay() {
+    PROFILE_ZONE();
+    auto cfg = yml.read();
+
+    bool enable = cfg->masterEnable & cfg->replay.enable;
+    LOG("Fix {}", enable ? "Enabled" : "Disabled");
+    if (enable) {
+        if (cfg->replay.mode != "record" && cfg->replay.mode != "replay") {
+            LOG("Unknown mode {}, expected record or replay", cfg->replay.mode);
+            return;
+        }
+        bool replay = cfg->replay.mode == "replay";
+        bool installed = InputReplay::install(baseModule, replay, cfg->replay.path.c_str(), cfg->replay.telemetry,
+            (uint64_t)(std::max)(1, cfg->replay.maxMiB) * 1024 * 1024);
+        LOG("Input {}", installed ? (replay ? "replayed" : "recorded") : "not hooked");
+    }
+}
+
+/**
+ * @brief Answers the game's reads of config.ini from memory.
+ *
+ * @details
+ * The engine reads its settings, keepAspect among them as described in `forceKeepAspect`, one key
+ * at a time through `GetPrivateProfileStringA` and `GetPrivateProfileIntA`, and Windows opens and
+ * parses the whole file again for each of them. These imports are redirected so that the file is
+ * parsed once and every further read is a hash lookup. The first read of every section and key
+ * is still passed on to Windows and the parsed file is only trusted while it gives the same
+ * answers. The file is parsed again when its last write time or size changes, and writes through
+ * the `WritePrivateProfile*A` imports drop the parsed file. Reads served, reads passed on and the
+ * time saved are logged every 16 reads served. The fix ships disabled until the parser is shown to
+ * match Windows on the game's own config.ini.
+ *
+ * @return void
+ */
+void profileCacheFix() {
+    PROFILE_ZONE();
+    auto cfg = yml.read();
 
-    yml.masterEnable = config["masterEnable"].as<bool>();
+    bool enable = cfg->masterEnable & cfg->fix.profileCache.enable;
+    LOG("Fix {}", enable ? "Enabled" : "Disabled");
+    if (enable) {
+        bool installed = ProfileCache::install(baseModule);
+        LOG("Profile reads {}", installed ? "intercepted" : "not imported");
+    }
+}
+
+/**
+ * @brief Writes save files on a background thread.
+ *
+ * @details
+ * Files matching the configured name pattern that the game opens to replace are kept in memory.
+ * The game's writes only copy into that buffer and return, closing the file queues it for a
+ * writer thread which writes a temporary file and renames it over the save so a crash never
+ * leaves a half written slot behind. Opening, probing or listing a save waits until its pending
+ * write is on disk, as does exiting the game. The time the game spent in its file calls and the
+ * time the write took on the writer thread are logged for every save.
+ *
+ * @return void
+ */
+void asyncSaveFix() {
+    PROFILE_ZONE();
+    auto cfg = yml.read();
+
+    bool enable = cfg->masterEnable & cfg->fix.asyncSave.enable;
+    LOG("Fix {}", enable ? "Enabled" : "Disabled");
+    if (enable) {
+        if (cfg->fix.asyncSave.pattern.empty()) {
+            LOG("No save pattern configured");
+            return;
+        }
+        bool installed = SaveQueue::install(baseModule, cfg->fix.asyncSave.pattern);
+        LOG("Save writes {}", installed ? "intercepted" : "not imported");
+    }
+}
 
-    yml.fix.textures.enable = config["fixes"]["textures"]["enable"].as<bool>();
+/**
+ * @brief Serves the game's glyph rasterization from an atlas.
+ *
+ * @details
+ * The game asks GDI for the bitmap of every character of its text each time it is drawn. Once
+ * GDI has rasterized a glyph its bitmap and metrics are packed into atlas pages with a skyline
+ * allocator, later requests for the same glyph in the same font are copied out of the atlas.
+ * When the atlas is full a new glyph takes over the space of the least recently used glyph it
+ * fits in, a page is only cleared when none is large enough. Glyphs served, glyphs rasterized,
+ * glyphs evicted, pages cleared and the time saved are logged periodically.
+ *
+ * @return void
+ */
+void glyphCacheFix() {
+    PROFILE_ZONE();
+    auto cfg = yml.read();
+
+    bool enable = cfg->masterEnable & cfg->fix.glyphCache.enable;
+    LOG("Fix {}", enable ? "Enabled" : "Disabled");
+    if (enable) {
+        if (cfg->fix.glyphCache.pageSize <= 0 || cfg->fix.glyphCache.pages <= 0) {
+            LOG("Atlas needs at least one page");
+            return;
+        }
+        bool installed = GlyphCache::install(baseModule, cfg->fix.glyphCache.pageSize, cfg->fix.glyphCache.pages,
+            cfg->fix.glyphCache.record);
+        LOG("Glyph rasterization {}", installed ? "intercepted" : "not imported");
+    }
+}
+
+/**
+ * @brief Reuses released textures for later creations of the same kind.
+ *
+ * @details
+ * Area transitions release the textures of the old area and create the same sizes and formats
+ * again for the new one. Textures the game releases are kept on free lists per device, size,
+ * levels, format, pool and usage and handed out again by `CreateTexture`. The free textures are
+ * held within `budgetMiB`, the longest unused ones are destroyed first, and those in the default
+ * pool are destroyed before the device is reset. Reuse, creation and eviction counts per kind
+ * of texture are logged every `logFrames` frames.
+ *
+ * @return void
+ */
+void texturePoolFix() {
+    PROFILE_ZONE();
+    auto cfg = yml.read();
+
+    bool enable = cfg->masterEnable & cfg->fix.texturePool.enable;
+    LOG("Fix {}", enable ? "Enabled" : "Disabled");
+    if (enable) {
+        if (cfg->fix.texturePool.budgetMiB <= 0) {
+            LOG("Pool needs a budget");
+            return;
+        }
+        bool installed = TexturePool::install((uint64_t)cfg->fix.texturePool.budgetMiB * 1024 * 1024,
+            (std::max)(cfg->fix.texturePool.logFrames, 0));
+        LOG("Textures {}", installed ? "pooled" : "not pooled");
+    }
+}
+
+/**
+ * @brief Streams user pointer draws through dynamic buffers.
+ *
+ * @details
+ * `DrawPrimitiveUP` and `DrawIndexedPrimitiveUP` make the runtime copy the vertices through
+ * buffers of its own on every call. Their vertices and 16 bit indices are instead appended to a
+ * dynamic vertex and index buffer used as rings, locked without overwriting what the GPU may
+ * still read and discarded only when they wrap, and drawn with the regular draw calls. The
+ * bytes streamed per frame and the discards are logged every `logFrames` frames.
+ *
+ * @return void
+ */
+void vertexRingFix() {
+    PROFILE_ZONE();
+    auto cfg = yml.read();
+
+    bool enable = cfg->masterEnable & cfg->fix.vertexRing.enable;
+    LOG("Fix {}", enable ? "Enabled" : "Disabled");
+    if (enable) {
+        if (cfg->fix.vertexRing.vertexKiB <= 0 || cfg->fix.vertexRing.indexKiB <= 0) {
+            LOG("Rings need a size");
+            return;
+        }
+        bool installed = VertexRing::install(cfg->fix.vertexRing.vertexKiB * 1024, cfg->fix.vertexRing.indexKiB * 1024,
+            (std::max)(cfg->fix.vertexRing.logFrames, 0));
+        LOG("User pointer draws {}", installed ? "streamed" : "not streamed");
+    }
+}
+
+/**
+ * @brief Batches the small draws of the UI and sprites.
+ *
+ * @details
+ * The UI is drawn with `DrawPrimitiveUP`, one call of a few vertices per element. Consecutive
+ * small draws are collected into one triangle list and issued as a single draw once anything
+ * they depend on changes: a texture, shader, render, stage or sampler state being set to a new
+ * value, a render target or stream change, another kind of draw or the end of the scene. Sets
+ * that leave a state as it was do not end a batch. The draw counts before and after batching
+ * are logged every `logFrames` frames.
+ *
+ * @return void
+ */
+void batchingFix() {
+    PROFILE_ZONE();
+    auto cfg = yml.read();
 
-    LOG("Name: {}", yml.name);
-    LOG("MasterEnable: {}", yml.masterEnable);
-    LOG("Fix.Textures.Enable: {}", yml.fix.textures.enable);
+    bool enable = cfg->masterEnable & cfg->fix.batching.enable;
+    LOG("Fix {}", enable ? "Enabled" : "Disabled");
+    if (enable) {
+        if (cfg->fix.batching.smallVertices <= 0 || cfg->fix.batching.capacity < 3) {
+            LOG("Batches need room for at least one triangle");
+            return;
+        }
+        bool installed = Batch::install(cfg->fix.batching.smallVertices, cfg->fix.batching.capacity,
+            (std::max)(cfg->fix.batching.logFrames, 0));
+        LOG("Draws {}", installed ? "batched" : "not batched");
+    }
 }
 
 /**
@@ -126,12 +723,14 @@ void readYml() {
  * This function performs the following tasks:
  * 1. Checks if the master enable is enabled based on the configuration.
  * 2. Searches for a specific memory pattern in the base module.
- * 3. Hooks the identified pattern to clear the zero flag in the eflags (status) register.
+ * 3. Patches the conditional jump at the identified pattern into an unconditional one.
  *
  * @details
  * The function uses a pattern scan to find a specific byte sequence in the memory of the base module.
- * If the pattern is found, a hook is created at an offset from the found pattern address. The hook
- * clears the zero flag in the eflags (status) register.
+ * If the pattern is found, the `jne` (75) it starts with is patched into a `jmp` (EB) with the same
+ * displacement. The patch is a single atomic write so the game is not paused for it. Should the patch
+ * fail, or while a hook trace is recorded, a hook clearing the zero flag in the eflags (status) register
+ * before the jump is used instead.
  *
  * The zero flag being set or not is dependent on the keepAspect setting in the config.ini file which
  * the game reads to setup things around the engine. The keepAspect setting is one such setting which
@@ -181,35 +780,48 @@ void readYml() {
  * ed6_win_DX9.exe+3A8120+2 -> 00 00 00 00
  * ed6_win_DX9.exe+3A8120+3 -> 00 00 F0 3F
  *
- * A hook is injected between 1 and 2 to clear the zero flag in the eflags (status) register and now the
- * jump is always taken and the data at ed6_win_DX9.exe+3A8120 is preserved. This is important for the
- * textures fix to work.
+ * The jne at 2 is patched into a jmp, so the jump is always taken and the data at ed6_win_DX9.exe+3A8120
+ * is preserved. This is important for the textures fix to work.
  *
  * @return void
  */
 void forceKeepAspect() {
-    const char* patternFind = "75 ?? 0F 28 05 ?? ?? ?? ?? 0F 29 05 ?? ?? ?? ??";
+    PROFILE_ZONE();
+    auto cfg = yml.read();
+    const char* patternFind = Signatures::list[Signatures::KeepAspect].pattern;
     uintptr_t  hookOffset = 0;
 
-    bool enable = yml.masterEnable;
+    bool enable = cfg->masterEnable;
     LOG("Fix {}", enable ? "Enabled" : "Disabled");
     if (enable) {
-        std::vector<uint64_t> addr;
-        Utils::patternScan(baseModule, patternFind, &addr);
-        uint8_t* hit = (uint8_t*)addr[0];
-        uintptr_t absAddr = (uintptr_t)hit;
-        uintptr_t relAddr = (uintptr_t)hit - (uintptr_t)baseModule;
-        if (hit) {
+        std::vector<Scanner::Match> matches;
+        Signatures::locate(baseModule, Signatures::KeepAspect, &matches);
+        recordScan(Signatures::list[Signatures::KeepAspect].name, matches.empty() ? 0 : (uintptr_t)matches[0].address);
+        if (!matches.empty()) {
+            const auto& match = matches[0];
+            uintptr_t absAddr = (uintptr_t)match.address;
+            uintptr_t relAddr = absAddr - (uintptr_t)baseModule;
             LOG("Found '{}' @ 0x{:x}", patternFind, relAddr);
+            LOG("jne -> 0x{:x}, movaps [0x{:x}] -> [0x{:x}]",
+                match["skip"] - (uintptr_t)baseModule, match["source"], match["keepAspect"]);
             uintptr_t hookAbsAddr = absAddr + hookOffset;
             uintptr_t hookRelAddr = relAddr + hookOffset;
+            auto path = cfg->trace.enable ? Utils::PatchPath::Failed : Utils::patchAtomic(hookAbsAddr, "EB");
+            if (path != Utils::PatchPath::Failed) {
+                LOG("Patched @ 0x{:x} + 0x{:x} = 0x{:x} {}", relAddr, hookOffset, hookRelAddr,
+                    path == Utils::PatchPath::Atomic ? "atomically" : "with threads suspended");
+                registerToggle("keepAspect", [hookAbsAddr](bool on) {
+                    return Utils::patchAtomic(hookAbsAddr, on ? "EB" : "75") != Utils::PatchPath::Failed;
+                });
+                return;
+            }
             static SafetyHookMid aspectMidHook{};
             aspectMidHook = safetyhook::create_mid(reinterpret_cast<void*>(hookAbsAddr),
-                [](SafetyHookContext& ctx) {
-                    ctx.eflags &= ~0x40; // Clear zero flag
-                }
-            );
+                midHook<Callbacks::KeepAspect, Callbacks::keepAspect<SafetyHookContext>>);
             LOG("Hooked @ 0x{:x} + 0x{:x} = 0x{:x}", relAddr, hookOffset, hookRelAddr);
+            registerToggle("keepAspect", [](bool on) {
+                return (on ? aspectMidHook.enable() : aspectMidHook.disable()).has_value();
+            });
         }
         else {
             LOG("Did not find '{}'", patternFind);
@@ -217,6 +829,26 @@ void forceKeepAspect() {
     }
 }
 
+/**
+ * @brief Runtime addresses the textures stub refers to.
+ */
+enum TexturesSlot : uint8_t {
+    TexturesOne,    // 1.0 as a double
+    TexturesSkip,   // Target of the game's jbe
+    TexturesResume  // First instruction after the jbe
+};
+
+/**
+ * @brief Replacement for the `comisd xmm0, xmm1` and `jbe` the textures fix hooks.
+ *
+ * Loads 1.0 into xmm0 and then runs the two replaced instructions.
+ */
+constexpr auto texturesStub = Asm::Code{}
+    .movsd(Asm::xmm0, Asm::slot(TexturesOne))
+    .comisd(Asm::xmm0, Asm::xmm1)
+    .jcc(Asm::Cond::be, Asm::slot(TexturesSkip))
+    .jmp(Asm::slot(TexturesResume));
+
 /**
  * @brief Fixes the black textures.
  *
@@ -230,6 +862,11 @@ void forceKeepAspect() {
  * If the pattern is found, a hook is created at an offset from the found pattern address. The hook
  * injects a new value into xmm0.
  *
+ * The hook is a small stub assembled at compile time, see `texturesStub`, which the `comisd` and `jbe`
+ * at the found address are redirected to by an inline hook. Should the stub not decode to what was
+ * assembled, or while a hook trace is recorded, a mid hook doing the same is used instead, at the cost
+ * of saving and restoring the whole context on every call.
+ *
  * I haven't delved into the inner working of how the game handles and uses the xmm0 value, but this
  * value plays a key role of whether or not the game will render textures. This fix works in conjunction
  * with the forceKeepAspect fix.
@@ -252,28 +889,313 @@ void forceKeepAspect() {
  * @return void
  */
 void texturesFix() {
-    const char* patternFind  = "66 0F 2F C1 76 ?? A1 ?? ?? ?? ?? 66 0F 6E 05 ?? ?? ?? ??";
+    PROFILE_ZONE();
+    auto cfg = yml.read();
+    const char* patternFind = Signatures::list[Signatures::Textures].pattern;
     uintptr_t hookOffset = 0;
 
-    bool enable = yml.masterEnable & yml.fix.textures.enable;
+    bool enable = cfg->masterEnable & cfg->fix.textures.enable;
     LOG("Fix {}", enable ? "Enabled" : "Disabled");
     if (enable) { // Master FOV controller
-        std::vector<uint64_t> addr;
-        Utils::patternScan(baseModule, patternFind, &addr);
-        uint8_t* hit = (uint8_t*)addr[0];
-        uintptr_t absAddr = (uintptr_t)hit;
-        uintptr_t relAddr = (uintptr_t)hit - (uintptr_t)baseModule;
-        if (hit) {
+        std::vector<Scanner::Match> matches;
+        Signatures::locate(baseModule, Signatures::Textures, &matches);
+        recordScan(Signatures::list[Signatures::Textures].name, matches.empty() ? 0 : (uintptr_t)matches[0].address);
+        if (!matches.empty()) {
+            const auto& match = matches[0];
+            uintptr_t absAddr = (uintptr_t)match.address;
+            uintptr_t relAddr = absAddr - (uintptr_t)baseModule;
             LOG("Found '{}' @ 0x{:x}", patternFind, relAddr);
+            LOG("jbe -> 0x{:x}, mov eax, [0x{:x}], movd xmm0, [0x{:x}]",
+                match["skip"] - (uintptr_t)baseModule, match["source"], match["operand"]);
             uintptr_t hookAbsAddr = absAddr + hookOffset;
             uintptr_t hookRelAddr = relAddr + hookOffset;
+
+            // The stub runs the comisd (4 bytes) and jbe rel8 (2 bytes) itself and resumes after them
+            static const double one = 1.0;
+            constexpr size_t replaced = 6;
+            void* stub = cfg->trace.enable ? nullptr : Asm::install(texturesStub, {
+                (uintptr_t)&one, (uintptr_t)match["skip"], hookAbsAddr + replaced });
+            if (stub) {
+                for (const auto& line : Asm::disassemble(stub, texturesStub.size)) {
+                    LOG("Stub {}", line);
+                }
+                // Written by SafetyHook with the other threads frozen and moved out of the replaced bytes
+                static SafetyHookInline texturesStubHook{};
+                texturesStubHook = safetyhook::create_inline(reinterpret_cast<void*>(hookAbsAddr), stub);
+                if (texturesStubHook) {
+                    LOG("Redirected @ 0x{:x} + 0x{:x} = 0x{:x} to stub", relAddr, hookOffset, hookRelAddr);
+                    registerToggle("textures", [](bool on) {
+                        return (on ? texturesStubHook.enable() : texturesStubHook.disable()).has_value();
+                    });
+                    return;
+                }
+            }
+            else if (!cfg->trace.enable) {
+                LOG("Stub did not decode as assembled");
+            }
             static SafetyHookMid texturesMidHook{};
             texturesMidHook = safetyhook::create_mid(reinterpret_cast<void*>(hookAbsAddr),
-                [](SafetyHookContext& ctx) {
-                    ctx.xmm0.u64[0] = 0x3FF0000000000000;
-                }
-            );
+                midHook<Callbacks::Textures, Callbacks::textures<SafetyHookContext>>);
             LOG("Hooked @ 0x{:x} + 0x{:x} = 0x{:x}", relAddr, hookOffset, hookRelAddr);
+            registerToggle("textures", [](bool on) {
+                return (on ? texturesMidHook.enable() : texturesMidHook.disable()).has_value();
+            });
+        }
+        else {
+            LOG("Did not find '{}'", patternFind);
+        }
+    }
+}
+
+/**
+ * @brief Replacement for the game's decompression routine.
+ *
+ * @param src Compressed stream
+ * @param dst Output buffer
+ * @return Number of bytes written to `dst`
+ */
+size_t __cdecl decodeAsset(const uint8_t* src, uint8_t* dst) {
+    PROFILE_ZONE();
+    Hitch::Scope scope(Hitch::Decode);
+    return Archive::decode(src, dst);
+}
+
+/**
+ * @brief Replaces the game's asset decompression routine with a faster decoder.
+ *
+ * This function performs the following tasks:
+ * 1. Checks if the master enable and decompress fix are enabled based on the configuration.
+ * 2. Searches for the start of the game's decompression routine in the base module.
+ * 3. Optionally starts the pipeline decoding upcoming entries on worker threads.
+ * 4. Redirects the whole routine to `Archive::decode`.
+ *
+ * @details
+ * Every area transition decompresses its assets with the engine's own decoder, which is a
+ * compiled loop that handles one byte and one control bit at a time. The replacement decodes
+ * the same format, documented in decompress.hpp, but takes runs of literals at once, copies
+ * matches a word at a time with dedicated paths for overlapping matches, and like the
+ * original trusts the stream so the inner loops have no bounds checks.
+ *
+ * The routine is expected to be a cdecl function taking the compressed stream and the output
+ * buffer and returning the number of bytes written. The signature of its first bytes is
+ * taken from the configuration so it can be supplied for a given build of the executable,
+ * the fix does nothing while it is left empty. Since a signature can just as well match a
+ * routine with another calling convention, the match is decoded first and not hooked if it
+ * cleans up its own arguments, takes any in registers or reads more than two off the stack.
+ *
+ * Even with the faster decoder every entry is still decoded synchronously on the game's main
+ * thread. With the pipeline enabled, reads from the `ED6_DT*.dat` archives are tracked and
+ * whenever the game decodes an entry it read, the entries following it in the archive, which
+ * are usually the rest of the same batch, are decoded ahead of time on below normal priority
+ * workers. The game is then handed their decoded data from a cache, bounded to a size that
+ * a 32 bit process can afford and evicting the least recently used entries first. The buffers
+ * the workers decode in count towards the same bound, and no more than `lookahead` entries
+ * wait for a worker at a time. The cache hit rate is logged every 256 decoded entries.
+ *
+ * @return void
+ */
+void decompressFix() {
+    PROFILE_ZONE();
+    auto cfg = yml.read();
+    const std::string& patternFind = cfg->fix.decompress.signature;
+
+    bool enable = cfg->masterEnable & cfg->fix.decompress.enable;
+    LOG("Fix {}", enable ? "Enabled" : "Disabled");
+    if (enable) {
+        if (patternFind.empty()) {
+            LOG("No signature configured");
+            return;
+        }
+        std::vector<uint64_t> addr;
+        Utils::patternScan(baseModule, patternFind.c_str(), &addr);
+        uint8_t* hit = addr.empty() ? nullptr : (uint8_t*)addr[0];
+        recordScan("decompress", (uintptr_t)hit);
+        uintptr_t relAddr = (uintptr_t)hit - (uintptr_t)baseModule;
+        if (hit) {
+            LOG("Found '{}' @ 0x{:x}", patternFind, relAddr);
+            std::string reason;
+            if (!Utils::isCdecl(hit, 2, &reason)) {
+                LOG("Not hooking, routine is not cdecl(src, dst): {}", reason);
+                return;
+            }
+            if (cfg->fix.decompress.pipeline.enable) {
+                Archive::Config pipeline{};
+                pipeline.workers = (size_t)(std::max)(1, cfg->fix.decompress.pipeline.workers);
+                pipeline.lookahead = (size_t)(std::max)(0, cfg->fix.decompress.pipeline.lookahead);
+                pipeline.cacheBytes = (size_t)(std::max)(1, cfg->fix.decompress.pipeline.cacheMiB) * 1024 * 1024;
+                bool started = Archive::init(baseModule, pipeline);
+                LOG("Pipeline {}", started ? "started" : "could not intercept archive reads");
+            }
+            static SafetyHookInline decompressHook{};
+            decompressHook = safetyhook::create_inline(reinterpret_cast<void*>(hit),
+                reinterpret_cast<void*>(&decodeAsset));
+            LOG("Hooked @ 0x{:x}", relAddr);
+            registerToggle("decompress", [](bool on) {
+                return (on ? decompressHook.enable() : decompressHook.disable()).has_value();
+            });
+        }
+        else {
+            LOG("Did not find '{}'", patternFind);
+        }
+    }
+}
+
+/**
+ * @brief State of the intro sequence, filled in by `introSkipFix` before its hook is created.
+ */
+struct {
+    volatile int32_t* state;
+    uint32_t rva;
+    int32_t title;
+    bool skip;
+    bool reached;
+    std::string record;
+    std::vector<int32_t> seen;      // Each state the intro moved to, in order
+    std::vector<int32_t> verified;  // States seen on a start that reached the title screen by itself
+    SafetyHookMid hook;
+} intro{};
+
+/**
+ * @brief Read the sequence recorded by a start that reached the title screen without skipping.
+ *
+ * @param path Record file
+ * @param rva Address of the state the record must be for
+ * @param title Title state the record must end with
+ * @return Recorded states, empty if there is none for this state and title
+ */
+std::vector<int32_t> readIntroRecord(const std::string& path, uint32_t rva, int32_t title) {
+    std::ifstream file(path);
+    uint32_t recordRva = 0;
+    std::vector<int32_t> states;
+    int32_t state;
+    if (!(file >> std::hex >> recordRva >> std::dec) || recordRva != rva) {
+        return {};
+    }
+    while (file >> state) {
+        states.push_back(state);
+    }
+    return !states.empty() && states.back() == title ? states : std::vector<int32_t>{};
+}
+
+/**
+ * @brief Runs every time the intro sequence's state machine is stepped.
+ *
+ * Moves the state machine to the title screen when skipping is verified, and logs how long after
+ * the process was created the title screen was first reached.
+ *
+ * @param ctx Register state at the hook
+ * @return void
+ */
+void introHook(SafetyHookContext& ctx) {
+    if (intro.reached) {
+        return;
+    }
+    int32_t state = *intro.state;
+    if (intro.seen.empty() || intro.seen.back() != state) {
+        intro.seen.push_back(state);
+        LOG("Intro state {}", state);
+    }
+    // The intro has a handful of states, this is not it or titleState is wrong
+    if (intro.seen.size() > 64) {
+        intro.reached = true;
+        bool disabled = intro.hook.disable().has_value();
+        LOG("Title state {} never reached, hook {}", intro.title, disabled ? "disabled" : "left in place");
+        return;
+    }
+    // Only jump while the intro follows the recorded sequence, anything else may not be the intro
+    bool following = intro.seen.size() <= intro.verified.size() &&
+        std::equal(intro.seen.begin(), intro.seen.end(), intro.verified.begin());
+    bool skipped = intro.skip && following && state != intro.title;
+    if (skipped) {
+        *intro.state = intro.title;
+    }
+    if (*intro.state == intro.title) {
+        intro.reached = true;
+        uint64_t created = Startup::processCreation();
+        LOG("Title screen reached {:.1f} ms after process start, intro {}",
+            created ? (Hitch::now() - created) / 1e6 : 0.0, skipped ? "skipped" : "played");
+        if (!skipped && intro.verified.empty()) {
+            std::ofstream file(intro.record);
+            file << std::hex << intro.rva << std::dec;
+            for (int32_t seen : intro.seen) {
+                file << ' ' << seen;
+            }
+            LOG("Intro sequence {} to '{}'", file ? "recorded" : "could not be recorded", intro.record);
+        }
+        // Nothing left to do, this thread returns through the hook's trampoline which stays allocated
+        bool disabled = intro.hook.disable().has_value();
+        LOG("Hook {}", disabled ? "disabled" : "left in place");
+    }
+}
+
+/**
+ * @brief Skips the publisher and developer logos and movies played before the title screen.
+ *
+ * This function performs the following tasks:
+ * 1. Checks if the master enable and intro skip fix are enabled based on the configuration.
+ * 2. Searches for the configured signature of the intro sequence's state machine.
+ * 3. Hooks it to move the state machine straight to the title screen.
+ *
+ * @details
+ * The intro plays as a state machine stepping through each logo and movie, keeping its state in a
+ * global. The signature is taken from the configuration, as it is for the decompress fix, and must
+ * capture the address of that global as `[state:4]`, for example the `mov eax, [state]` the state
+ * machine starts with.
+ *
+ * Neither the signature nor `titleState` can be trusted on their own, writing the wrong value to
+ * the wrong global would corrupt the game rather than skip anything. So the first start with the
+ * fix enabled plays the intro and only logs each state it moves through. If it reaches
+ * `titleState` by itself, that sequence is written to the `record` file, and later starts set the
+ * state to `titleState` while the intro follows the recorded sequence. A start that reaches the
+ * title screen after a different sequence, or never logs `titleState`, is not skipped.
+ *
+ * With `skip` disabled the state is left alone and the hook only observes it, so that the time to
+ * the title screen, which is logged either way, can be compared with and without the skip.
+ * Once the title screen is reached the hook disables itself.
+ *
+ * @return void
+ */
+void introSkipFix() {
+    PROFILE_ZONE();
+    auto cfg = yml.read();
+    const std::string& patternFind = cfg->fix.introSkip.signature;
+
+    bool enable = cfg->masterEnable & cfg->fix.introSkip.enable;
+    LOG("Fix {}", enable ? "Enabled" : "Disabled");
+    if (enable) {
+        if (patternFind.empty()) {
+            LOG("No signature configured");
+            return;
+        }
+        Scanner::Pattern pattern = Scanner::compile(patternFind.c_str());
+        if (!pattern.error.empty()) {
+            LOG("Bad signature '{}': {}", patternFind, pattern.error);
+            return;
+        }
+        bool captured = std::any_of(pattern.captures.begin(), pattern.captures.end(),
+            [](const Scanner::Capture& capture) { return capture.name == "state" && capture.size == 4; });
+        if (!captured) {
+            LOG("Signature '{}' does not capture [state:4]", patternFind);
+            return;
+        }
+        std::vector<Scanner::Match> matches;
+        Utils::patternScan(baseModule, pattern, &matches);
+        recordScan("introSkip", matches.empty() ? 0 : (uintptr_t)matches[0].address);
+        if (!matches.empty()) {
+            const auto& match = matches[0];
+            uintptr_t absAddr = (uintptr_t)match.address;
+            uintptr_t relAddr = absAddr - (uintptr_t)baseModule;
+            LOG("Found '{}' @ 0x{:x}, state @ 0x{:x}", patternFind, relAddr, match["state"]);
+            intro.state = reinterpret_cast<volatile int32_t*>((uintptr_t)match["state"]);
+            intro.rva = (uint32_t)(match["state"] - (uintptr_t)baseModule);
+            intro.title = cfg->fix.introSkip.titleState;
+            intro.skip = cfg->fix.introSkip.skip;
+            intro.record = cfg->fix.introSkip.record;
+            intro.verified = readIntroRecord(intro.record, intro.rva, intro.title);
+            LOG("Title state {}", intro.verified.empty() ? "not verified yet, intro is played and recorded" : "verified");
+            intro.hook = safetyhook::create_mid(reinterpret_cast<void*>(absAddr),
+                midHook<Callbacks::IntroSkip, introHook>);
+            LOG("Hooked @ 0x{:x}", relAddr);
         }
         else {
             LOG("Did not find '{}'", patternFind);
@@ -281,23 +1203,298 @@ void texturesFix() {
     }
 }
 
+/**
+ * @brief Hooks the game's Present to mark the end of every frame.
+ *
+ * @details
+ * Only armed when something needs to run once per frame, for now that is the Tracy frame mark in
+ * builds configured with the profiler. The hook itself lives in d3d9hook.cpp.
+ *
+ * @return void
+ */
+void frameHook() {
+    PROFILE_ZONE();
+    auto cfg = yml.read();
+
+    bool enable = cfg->masterEnable & PROFILER_ENABLED;
+    LOG("Fix {}", enable ? "Enabled" : "Disabled");
+    if (enable) {
+        D3D9Hook::init();
+    }
+}
+
+/**
+ * @brief Attributes slow frames to the file reads, allocations and decoding overlapping them.
+ *
+ * @details
+ * Reads and allocations made through the game's imports, Direct3D resource creation, asset
+ * decoding and the fixes' own hooks are timed into per thread rings. At every present the
+ * frame's duration is checked against the threshold and for each slow frame the events that
+ * overlapped it are logged in summary and written to a report file, which the `hitchdump` tool
+ * lists in full. Events shorter than the configured minimum are not kept.
+ *
+ * @return void
+ */
+void hitchAttribution() {
+    PROFILE_ZONE();
+    auto cfg = yml.read();
+
+    bool enable = cfg->masterEnable & cfg->hitch.enable;
+    LOG("Fix {}", enable ? "Enabled" : "Disabled");
+    if (enable) {
+        Hitch::start((uint64_t)(std::max)(0, cfg->hitch.minEventUs) * 1000);
+        bool installed = Hitch::install(baseModule, (uint64_t)(cfg->hitch.thresholdMs * 1e6), cfg->hitch.path.c_str(),
+            (uint64_t)(std::max)(1, cfg->hitch.maxMiB) * 1024 * 1024);
+        LOG("Frames {}", installed ? "timed" : "could not be timed");
+    }
+}
+
+/**
+ * @brief Enable flag of a fix that can be switched over the control channel.
+ *
+ * @param fix Configuration of the fixes
+ * @param name Name the fix was registered with
+ * @return The flag, nullptr if the fix has none
+ */
+bool* fixEnable(fix_t& fix, const std::string& name) {
+    static const std::map<std::string, bool* (*)(fix_t&)> flags = {
+        { "keepAspect", [](fix_t& f) { return &f.keepAspect.enable; } },
+        { "textures", [](fix_t& f) { return &f.textures.enable; } },
+        { "decompress", [](fix_t& f) { return &f.decompress.enable; } },
+    };
+    auto it = flags.find(name);
+    return it == flags.end() ? nullptr : it->second(fix);
+}
+
+/**
+ * @brief Switches an armed fix on or off and publishes the configuration to match.
+ *
+ * @param name Name the fix was registered with
+ * @param enable Whether to switch it on
+ * @return true if the fix exists and was switched
+ */
+bool setFix(const std::string& name, bool enable) {
+    std::function<bool(bool)> toggle;
+    {
+        std::lock_guard lock(armedMutex);
+        auto it = toggles.find(name);
+        if (it == toggles.end()) {
+            return false;
+        }
+        toggle = it->second;
+    }
+    if (!toggle(enable)) {
+        return false;
+    }
+
+    std::unique_ptr<yml_t> next;
+    {
+        auto cfg = yml.read();
+        next = std::make_unique<yml_t>(*cfg);
+    }
+    if (bool* flag = fixEnable(next->fix, name)) {
+        *flag = enable;
+    }
+    else {
+        LOG("{} has no enable flag to publish", name);
+    }
+    yml.publish(std::move(next));
+    LOG("{} {}", name, enable ? "Enabled" : "Disabled");
+    return true;
+}
+
+/**
+ * @brief Serves the control channel for the `fixctl` tool.
+ *
+ * @details
+ * A named pipe that lets a running game be inspected and tweaked from outside: querying counters
+ * and where each signature was found, switching fixes on and off and changing the log level. It is
+ * served by a single below normal priority thread using overlapped I/O, so it never holds up the
+ * game. The pipe only accepts local clients.
+ *
+ * @return void
+ */
+void controlChannel() {
+    PROFILE_ZONE();
+    auto cfg = yml.read();
+
+    bool enable = cfg->masterEnable & cfg->control.enable;
+    LOG("Fix {}", enable ? "Enabled" : "Disabled");
+    if (enable) {
+        // Never freed, stopping the server thread under the loader lock at unload would deadlock
+        auto server = new Control::Server(cfg->control.name);
+        server->on(Control::Ping, [](Control::Message&, Control::Message* response) {
+            response->putString(VERSION);
+            return Control::Ok;
+        });
+        server->on(Control::Counters, [](Control::Message&, Control::Message* response) {
+            std::vector<std::pair<std::string, uint64_t>> counters;
+            std::chrono::duration<double, std::milli> uptime = std::chrono::steady_clock::now() - mainStart;
+            counters.emplace_back("uptimeMs", (uint64_t)uptime.count());
+            Archive::counters(&counters);
+            Hitch::counters(&counters);
+            ProfileCache::counters(&counters);
+            SaveQueue::counters(&counters);
+            GlyphCache::counters(&counters);
+            Batch::counters(&counters);
+            VertexRing::counters(&counters);
+            TexturePool::counters(&counters);
+            InputReplay::counters(&counters);
+            response->putU16((uint16_t)counters.size());
+            for (const auto& [name, value] : counters) {
+                response->putString(name);
+                response->putU64(value);
+            }
+            return Control::Ok;
+        });
+        server->on(Control::Scans, [](Control::Message&, Control::Message* response) {
+            std::lock_guard lock(armedMutex);
+            response->putU16((uint16_t)scans.size());
+            for (const auto& scan : scans) {
+                response->putString(scan.name);
+                response->putU8(scan.found);
+                response->putU32(scan.rva);
+            }
+            return Control::Ok;
+        });
+        server->on(Control::SetFix, [](Control::Message& request, Control::Message*) {
+            std::string name = request.getString();
+            bool on = request.getU8() != 0;
+            if (!request.ok) {
+                return Control::BadRequest;
+            }
+            return setFix(name, on) ? Control::Ok : Control::Failed;
+        });
+        server->on(Control::SetLogLevel, [](Control::Message& request, Control::Message*) {
+            uint8_t level = request.getU8();
+            if (!request.ok || level >= spdlog::level::n_levels) {
+                return Control::BadRequest;
+            }
+            spdlog::set_level((spdlog::level::level_enum)level);
+            return Control::Ok;
+        });
+        bool started = server->start();
+        LOG("{} '{}'", started ? "Serving" : "Could not create", server->path());
+    }
+}
+
+/**
+ * @brief When a fix has to be armed.
+ * @details `Critical` fixes change what is drawn and must be in place before the first frame,
+ * they are armed first on the high priority `Main` thread. `Normal` and then `Background` fixes,
+ * such as optimisations and diagnostics, are armed afterwards on a below normal priority worker
+ * so that they only take CPU time the game is not using.
+ */
+enum class Tier {
+    Critical,
+    Normal,
+    Background
+};
+
+/**
+ * @brief Every fix along with its tier, armed in this order within a tier.
+ */
+const struct {
+    const char* name;
+    void (*apply)();
+    Tier tier;
+} fixes[] = {
+    { "startupTimeline", startupTimeline, Tier::Critical },
+    { "inputReplay", inputReplay, Tier::Critical },
+    { "profileCacheFix", profileCacheFix, Tier::Critical },
+    { "asyncSaveFix", asyncSaveFix, Tier::Critical },
+    { "forceKeepAspect", forceKeepAspect, Tier::Critical },
+    { "texturesFix", texturesFix, Tier::Critical },
+    { "introSkipFix", introSkipFix, Tier::Critical },
+    { "decompressFix", decompressFix, Tier::Normal },
+    { "glyphCacheFix", glyphCacheFix, Tier::Normal },
+    { "texturePoolFix", texturePoolFix, Tier::Normal },
+    // Before batching so that batched draws are streamed through the rings as well
+    { "vertexRingFix", vertexRingFix, Tier::Normal },
+    { "batchingFix", batchingFix, Tier::Normal },
+    { "frameHook", frameHook, Tier::Normal },
+    { "controlChannel", controlChannel, Tier::Background },
+    { "hitchAttribution", hitchAttribution, Tier::Background },
+};
+
+/**
+ * @brief Arms every fix of a tier and logs when the tier was done.
+ *
+ * The time the tier was armed is logged relative to the start of `Main`, together with the time
+ * and page faults spent on it, to compare with and without prefetch.
+ *
+ * @param tier Tier to arm
+ * @return void
+ */
+void armTier(Tier tier) {
+    PROFILE_ZONE();
+    static const char* names[] = { "Critical", "Normal", "Background" };
+
+    PROCESS_MEMORY_COUNTERS before{}, after{};
+    GetProcessMemoryInfo(GetCurrentProcess(), &before, sizeof(before));
+    auto start = std::chrono::steady_clock::now();
+    for (const auto& fix : fixes) {
+        if (fix.tier == tier) {
+            Startup::Scope step(fix.name, names[(int)tier]);
+            fix.apply();
+        }
+    }
+    auto end = std::chrono::steady_clock::now();
+    GetProcessMemoryInfo(GetCurrentProcess(), &after, sizeof(after));
+    std::chrono::duration<double, std::milli> elapsed = end - start;
+    std::chrono::duration<double, std::milli> armedAt = end - mainStart;
+    LOG("{} tier armed at {:.3f} ms, took {:.3f} ms with {} page faults",
+        names[(int)tier], armedAt.count(), elapsed.count(), after.PageFaultCount - before.PageFaultCount);
+}
+
+/**
+ * @brief Arms the tiers that are not critical.
+ *
+ * @param lpParameter Unused parameter.
+ * @return Always returns TRUE to indicate successful execution.
+ */
+DWORD __stdcall deferredMain(void* lpParameter) {
+    armTier(Tier::Normal);
+    armTier(Tier::Background);
+    return true;
+}
+
 /**
  * @brief Main function that initializes and applies various fixes.
  *
  * This function serves as the entry point for the DLL. It performs the following tasks:
- * 1. Initializes the logging system.
- * 2. Reads the configuration from a YAML file.
- * 3. Applies a forced aspect ratio fix.
- * 3. Applies a textures fix.
+ * 1. Loads the configuration and prefetches the game's image on a second thread.
+ * 2. Initializes the logging system meanwhile.
+ * 3. Reads the configuration from the loaded YAML file and starts recording a hook trace if enabled.
+ * 4. Arms the critical fixes, the forced aspect ratio and textures fixes.
+ * 5. Hands the remaining tiers, such as the asset decompression fix, to a below normal priority
+ *    worker. If that thread cannot be created they are armed here instead.
  *
  * @param lpParameter Unused parameter.
  * @return Always returns TRUE to indicate successful execution.
  */
 DWORD __stdcall Main(void* lpParameter) {
+    mainStart = std::chrono::steady_clock::now();
+    PROFILE_STARTUP();
+    auto setup = std::async(std::launch::async, loadConfigAndPrefetch);
     logInit();
+    bool prefetched = setup.get();
     readYml();
-    forceKeepAspect();
-    texturesFix();
+    LOG("Prefetch {}", prefetched ? "on" : "off");
+    traceInit();
+
+    armTier(Tier::Critical);
+    Startup::timeline().phase("gameInit", Hitch::now());
+
+    HANDLE deferredHandle = CreateThread(NULL, 0, deferredMain, 0, CREATE_SUSPENDED, 0);
+    if (deferredHandle) {
+        SetThreadPriority(deferredHandle, THREAD_PRIORITY_BELOW_NORMAL);
+        ResumeThread(deferredHandle);
+        CloseHandle(deferredHandle);
+    }
+    else {
+        deferredMain(nullptr);
+    }
     return true;
 }
 
@@ -337,6 +1534,7 @@ BOOL APIENTRY DllMain(
     HANDLE mainHandle;
     switch (ul_reason_for_call) {
     case DLL_PROCESS_ATTACH:
+        attachTime = Hitch::now();
         LOG("DLL_PROCESS_ATTACH");
         mainHandle = CreateThread(NULL, 0, Main, 0, NULL, 0);
         if (mainHandle)
@@ -0,0 +1,317 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2024 Dominik Protasewicz
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <algorithm>
+#include <cstring>
+
+#include "glyphcache.hpp"
+
+namespace GlyphCache
+{
+    Skyline::Skyline(uint32_t width, uint32_t height) : w(width), h(height) {
+        clear();
+    }
+
+    void Skyline::clear() {
+        nodes.assign(1, Node{ 0, 0, w });
+        area = 0;
+    }
+
+    bool Skyline::insert(uint32_t width, uint32_t height, uint32_t* x, uint32_t* y) {
+        if (width == 0 || height == 0 || width > w || height > h) {
+            return false;
+        }
+
+        // Lowest resulting top edge wins, the narrower segment on a tie so wide gaps stay open
+        size_t best = nodes.size();
+        uint32_t bestY = 0;
+        uint32_t bestTop = UINT32_MAX;
+        uint32_t bestWidth = UINT32_MAX;
+        for (size_t i = 0; i < nodes.size() && nodes[i].x + width <= w; i++) {
+            uint32_t top = 0;
+            uint32_t remaining = width;
+            for (size_t j = i; remaining > 0; j++) {
+                top = (std::max)(top, nodes[j].y);
+                remaining -= (std::min)(remaining, nodes[j].width);
+            }
+            if (top + height > h) {
+                continue;
+            }
+            if (top + height < bestTop || (top + height == bestTop && nodes[i].width < bestWidth)) {
+                best = i;
+                bestY = top;
+                bestTop = top + height;
+                bestWidth = nodes[i].width;
+            }
+        }
+        if (best == nodes.size()) {
+            return false;
+        }
+
+        Node node{ nodes[best].x, bestTop, width };
+        nodes.insert(nodes.begin() + best, node);
+        uint32_t right = node.x + node.width;
+        for (size_t i = best + 1; i < nodes.size() && nodes[i].x < right;) {
+            uint32_t end = nodes[i].x + nodes[i].width;
+            if (end <= right) {
+                nodes.erase(nodes.begin() + i);
+                continue;
+            }
+            nodes[i].x = right;
+            nodes[i].width = end - right;
+            break;
+        }
+        for (size_t i = 0; i + 1 < nodes.size();) {
+            if (nodes[i].y == nodes[i + 1].y) {
+                nodes[i].width += nodes[i + 1].width;
+                nodes.erase(nodes.begin() + i + 1);
+            }
+            else {
+                i++;
+            }
+        }
+
+        *x = node.x;
+        *y = bestY;
+        area += (uint64_t)width * height;
+        return true;
+    }
+
+    size_t KeyHash::operator()(const Key& key) const {
+        uint64_t hash = key.font ^ (key.transform * 0x9E3779B97F4A7C15ull) ^
+            ((uint64_t)key.glyph << 32 | key.format) * 0xC2B2AE3D27D4EB4Full;
+        hash ^= hash >> 29;
+        hash *= 0xBF58476D1CE4E5B9ull;
+        hash ^= hash >> 32;
+        return (size_t)hash;
+    }
+
+    Atlas::Atlas(uint32_t pageSize, uint32_t pages) : pageSize(pageSize) {
+        for (uint32_t i = 0; i < (std::max)(pages, 1u); i++) {
+            this->pages.push_back(Page{ Skyline(pageSize, pageSize), {}, 0 });
+        }
+    }
+
+    const Glyph* Atlas::find(const Key& key) {
+        tick++;
+        auto it = lookup.find(key);
+        if (it == lookup.end()) {
+            counts.misses++;
+            return nullptr;
+        }
+        counts.hits++;
+        Glyph& glyph = it->second.glyph;
+        glyph.used = tick;
+        if (glyph.page != NO_PAGE) {
+            pages[glyph.page].used = tick;
+        }
+        Order& sizeClass = *it->second.sizeClass;
+        sizeClass.splice(sizeClass.begin(), sizeClass, it->second.position);
+        return &glyph;
+    }
+
+    const Glyph* Atlas::insert(const Key& key, const void* metrics, size_t metricsSize,
+        const uint8_t* bitmap, uint32_t size, uint32_t rows)
+    {
+        if (metricsSize > METRICS_SIZE || (size && (rows == 0 || size % rows)) || rows > pageSize ||
+            (size && size / rows > pageSize))
+        {
+            counts.rejected++;
+            return nullptr;
+        }
+        // A replaced glyph's space is only reclaimed with its page
+        if (auto it = lookup.find(key); it != lookup.end()) {
+            it->second.sizeClass->erase(it->second.position);
+            lookup.erase(it);
+        }
+
+        Glyph glyph{ key, size, size ? size / rows : 0, size ? rows : 0, NO_PAGE, 0, 0, tick, {} };
+        memcpy(glyph.metrics, metrics, metricsSize);
+        uint32_t width = glyph.pitch;
+        uint32_t height = glyph.rows;
+        if (size) {
+            uint32_t page = 0;
+            while (page < pages.size() && !pages[page].skyline.insert(width, height, &glyph.x, &glyph.y)) {
+                page++;
+            }
+            if (page == pages.size() && reuse(&glyph, &width, &height)) {
+                page = glyph.page;
+            }
+            else if (page == pages.size()) {
+                page = (uint32_t)(std::min_element(pages.begin(), pages.end(),
+                    [](const Page& a, const Page& b) { return a.used < b.used; }) - pages.begin());
+                evict(page);
+                pages[page].skyline.insert(width, height, &glyph.x, &glyph.y);
+            }
+
+            Page& target = pages[page];
+            if (target.pixels.empty()) {
+                target.pixels.resize((size_t)pageSize * pageSize);
+            }
+            for (uint32_t row = 0; row < glyph.rows; row++) {
+                memcpy(target.pixels.data() + (size_t)(glyph.y + row) * pageSize + glyph.x,
+                    bitmap + (size_t)row * glyph.pitch, glyph.pitch);
+            }
+            target.used = tick;
+            glyph.page = page;
+        }
+        counts.inserted++;
+        Order& sizeClass = sizeClasses[(uint64_t)width << 32 | height];
+        sizeClass.push_front(key);
+        Entry& entry = lookup[key] = Entry{ glyph, width, height, &sizeClass, sizeClass.begin() };
+        return &entry.glyph;
+    }
+
+    /**
+     * @brief Evict the least recently used glyph whose rectangle `glyph` fits in and take the rectangle over
+     * @details Only the least recently used glyph of every size class large enough is compared,
+     *      glyphs come in few sizes so this stays far cheaper than rasterizing.
+     *
+     * @param glyph Glyph to place, receives the page and position of the rectangle
+     * @param width Receives the width of the rectangle
+     * @param height Receives the height of the rectangle
+     * @return false if no rectangle is large enough
+     */
+    bool Atlas::reuse(Glyph* glyph, uint32_t* width, uint32_t* height) {
+        auto victim = lookup.end();
+        for (auto& [size, sizeClass] : sizeClasses) {
+            // Glyphs without a bitmap are in the class of width 0, which never fits
+            if (sizeClass.empty() || (uint32_t)(size >> 32) < glyph->pitch || (uint32_t)size < glyph->rows) {
+                continue;
+            }
+            auto candidate = lookup.find(sizeClass.back());
+            if (victim == lookup.end() || candidate->second.glyph.used < victim->second.glyph.used) {
+                victim = candidate;
+            }
+        }
+        if (victim == lookup.end()) {
+            return false;
+        }
+        const Entry& evicted = victim->second;
+        glyph->page = evicted.glyph.page;
+        glyph->x = evicted.glyph.x;
+        glyph->y = evicted.glyph.y;
+        *width = evicted.width;
+        *height = evicted.height;
+        evicted.sizeClass->erase(evicted.position);
+        lookup.erase(victim);
+        counts.evictedGlyphs++;
+        counts.reused++;
+        return true;
+    }
+
+    void Atlas::evict(uint32_t page) {
+        for (auto it = lookup.begin(); it != lookup.end();) {
+            if (it->second.glyph.page == page) {
+                it->second.sizeClass->erase(it->second.position);
+                it = lookup.erase(it);
+                counts.evictedGlyphs++;
+            }
+            else {
+                ++it;
+            }
+        }
+        pages[page].skyline.clear();
+        counts.evictedPages++;
+    }
+
+    void Atlas::copy(const Glyph& glyph, uint8_t* out) const {
+        if (glyph.page == NO_PAGE) {
+            return;
+        }
+        const Page& page = pages[glyph.page];
+        for (uint32_t row = 0; row < glyph.rows; row++) {
+            memcpy(out + (size_t)row * glyph.pitch,
+                page.pixels.data() + (size_t)(glyph.y + row) * pageSize + glyph.x, glyph.pitch);
+        }
+    }
+
+    double Atlas::occupancy() const {
+        uint64_t used = 0;
+        for (const Page& page : pages) {
+            used += page.skyline.used();
+        }
+        return (double)used / ((double)pageSize * pageSize * pages.size());
+    }
+
+    template <typename T>
+    static void put(FILE* file, T value) {
+        fwrite(&value, sizeof(value), 1, file);
+    }
+
+    template <typename T>
+    static bool get(FILE* file, T* value) {
+        return fread(value, sizeof(*value), 1, file) == 1;
+    }
+
+    Recorder::Recorder(const char* path, uint64_t maxBytes) : file(fopen(path, "wb")), limit(maxBytes) {
+        if (!file) {
+            return;
+        }
+        setvbuf(file, nullptr, _IOFBF, 64 * 1024);
+        put(file, MAGIC);
+        put(file, VERSION);
+    }
+
+    Recorder::~Recorder() {
+        if (file) {
+            fclose(file);
+        }
+    }
+
+    void Recorder::write(const Request& request) {
+        constexpr uint64_t RECORD_SIZE = 2 * sizeof(uint64_t) + 4 * sizeof(uint32_t);
+        std::lock_guard lock(mutex);
+        if (!file || written + RECORD_SIZE > limit) {
+            return;
+        }
+        put(file, request.key.font);
+        put(file, request.key.transform);
+        put(file, request.key.glyph);
+        put(file, request.key.format);
+        put(file, request.size);
+        put(file, request.rows);
+        written += RECORD_SIZE;
+    }
+
+    bool read(const char* path, std::vector<Request>* requests) {
+        FILE* file = fopen(path, "rb");
+        if (!file) {
+            return false;
+        }
+        uint32_t magic = 0;
+        uint16_t version = 0;
+        bool ok = get(file, &magic) && get(file, &version) && magic == MAGIC && version == VERSION;
+
+        Request request;
+        while (ok && get(file, &request.key.font) && get(file, &request.key.transform) &&
+            get(file, &request.key.glyph) && get(file, &request.key.format) &&
+            get(file, &request.size) && get(file, &request.rows))
+        {
+            requests->push_back(request);
+        }
+        fclose(file);
+        return ok;
+    }
+}
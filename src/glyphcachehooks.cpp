@@ -0,0 +1,221 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2024 Dominik Protasewicz
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <windows.h>
+#include <atomic>
+#include <cstddef>
+#include <cstring>
+#include <cwchar>
+#include <mutex>
+#include <string>
+
+#include "spdlog/spdlog.h"
+
+#include "log.hpp"
+#include "utils.hpp"
+#include "hitch.hpp"
+#include "glyphcache.hpp"
+
+namespace GlyphCache
+{
+    namespace
+    {
+        constexpr uint64_t LOG_EVERY = 4096;
+        constexpr uint64_t RECORD_MAX_BYTES = 64ull * 1024 * 1024;
+        // Keeps the requests of both imports apart, their character codes mean different things
+        constexpr uint32_t WIDE = 0x80000000;
+
+        using GetGlyphOutlineA_t = DWORD(WINAPI*)(HDC, UINT, UINT, LPGLYPHMETRICS, DWORD, LPVOID, const MAT2*);
+        using GetGlyphOutlineW_t = DWORD(WINAPI*)(HDC, UINT, UINT, LPGLYPHMETRICS, DWORD, LPVOID, const MAT2*);
+        GetGlyphOutlineA_t originalGetGlyphOutlineA = nullptr;
+        GetGlyphOutlineW_t originalGetGlyphOutlineW = nullptr;
+
+        /**
+         * @brief Everything a request returns besides the bitmap, kept as the metrics of a glyph.
+         */
+        struct Answer {
+            GLYPHMETRICS metrics;
+            DWORD result;
+        };
+        static_assert(sizeof(Answer) <= METRICS_SIZE);
+
+        std::mutex atlasMutex;
+        Atlas* atlas = nullptr;
+        Recorder* recorder = nullptr;
+
+        std::atomic<uint64_t> served = 0;
+        std::atomic<uint64_t> servedTime = 0;
+        std::atomic<uint64_t> passed = 0;
+        std::atomic<uint64_t> passedTime = 0;
+
+        uint64_t hashBytes(const void* data, size_t size, uint64_t hash = 0xCBF29CE484222325ull) {
+            auto bytes = static_cast<const uint8_t*>(data);
+            for (size_t i = 0; i < size; i++) {
+                hash = (hash ^ bytes[i]) * 0x100000001B3ull;
+            }
+            return hash;
+        }
+
+        /**
+         * @brief Identify the font selected into a device context by its description
+         * @details Font handles are reused once a font is deleted, the description is not.
+         * @return Hash of the font, 0 if it could not be described
+         */
+        uint64_t fontHash(HDC hdc) {
+            LOGFONTW font{};
+            HGDIOBJ object = GetCurrentObject(hdc, OBJ_FONT);
+            if (!object || !GetObjectW(object, sizeof(font), &font)) {
+                return 0;
+            }
+            uint64_t hash = hashBytes(&font, offsetof(LOGFONTW, lfFaceName));
+            return hashBytes(font.lfFaceName, wcsnlen(font.lfFaceName, LF_FACESIZE) * sizeof(WCHAR), hash);
+        }
+
+        bool cacheable(UINT format) {
+            UINT base = format & ~(GGO_GLYPH_INDEX | GGO_UNHINTED);
+            return base == GGO_METRICS || base == GGO_BITMAP || (base >= GGO_GRAY2_BITMAP && base <= GGO_GRAY8_BITMAP);
+        }
+
+        void account(uint64_t start, bool cached) {
+            uint64_t elapsed = Hitch::now() - start;
+            if (!cached) {
+                passed++;
+                passedTime += elapsed;
+                return;
+            }
+            servedTime += elapsed;
+            if (++served % LOG_EVERY == 0) {
+                uint64_t calls = passed.load();
+                double original = calls ? passedTime.load() / (double)calls : 0.0;
+                double saved = (served.load() * original - servedTime.load()) / 1e6;
+                std::lock_guard lock(atlasMutex);
+                const Stats& stats = atlas->stats();
+                LOG("{} glyphs served from the atlas, {} rasterized, {} evicted, {} pages cleared, {:.0f}% of the atlas used, "
+                    "about {:.2f} ms saved", served.load(), calls, stats.evictedGlyphs, stats.evictedPages,
+                    atlas->occupancy() * 100, saved);
+            }
+        }
+
+        DWORD serve(bool wide, HDC hdc, UINT uChar, UINT fuFormat, LPGLYPHMETRICS lpgm, DWORD cjBuffer,
+            LPVOID pvBuffer, const MAT2* lpmat2)
+        {
+            auto rasterize = [&] {
+                return wide ? originalGetGlyphOutlineW(hdc, uChar, fuFormat, lpgm, cjBuffer, pvBuffer, lpmat2) :
+                    originalGetGlyphOutlineA(hdc, uChar, fuFormat, lpgm, cjBuffer, pvBuffer, lpmat2);
+            };
+            if (!lpgm || !lpmat2 || !cacheable(fuFormat)) {
+                return rasterize();
+            }
+            uint64_t start = Hitch::now();
+            Key key{ fontHash(hdc), hashBytes(lpmat2, sizeof(MAT2)), uChar, fuFormat | (wide ? WIDE : 0) };
+            if (!key.font) {
+                return rasterize();
+            }
+
+            Answer answer;
+            bool hit = false;
+            {
+                std::lock_guard lock(atlasMutex);
+                const Glyph* glyph = atlas->find(key);
+                // Too small a buffer is left to GDI to fail the way it does
+                if (glyph && (!pvBuffer || cjBuffer >= glyph->size)) {
+                    memcpy(&answer, glyph->metrics, sizeof(answer));
+                    if (pvBuffer) {
+                        atlas->copy(*glyph, static_cast<uint8_t*>(pvBuffer));
+                    }
+                    if (recorder) {
+                        recorder->write({ key, glyph->size, glyph->rows });
+                    }
+                    hit = true;
+                }
+            }
+            if (hit) {
+                *lpgm = answer.metrics;
+                account(start, true);
+                return answer.result;
+            }
+
+            DWORD result = rasterize();
+            account(start, false);
+            if (result == GDI_ERROR) {
+                return result;
+            }
+            // Bitmap sizes alone are not kept, the bitmap itself follows in the next request
+            uint32_t size = (fuFormat & ~(GGO_GLYPH_INDEX | GGO_UNHINTED)) == GGO_METRICS ? 0 : result;
+            if (recorder) {
+                recorder->write({ key, size, lpgm->gmBlackBoxY });
+            }
+            if (pvBuffer || size == 0) {
+                answer = { *lpgm, result };
+                std::lock_guard lock(atlasMutex);
+                atlas->insert(key, &answer, sizeof(answer), static_cast<const uint8_t*>(pvBuffer), size, lpgm->gmBlackBoxY);
+            }
+            return result;
+        }
+
+        DWORD WINAPI hookedGetGlyphOutlineA(HDC hdc, UINT uChar, UINT fuFormat, LPGLYPHMETRICS lpgm, DWORD cjBuffer,
+            LPVOID pvBuffer, const MAT2* lpmat2)
+        {
+            return serve(false, hdc, uChar, fuFormat, lpgm, cjBuffer, pvBuffer, lpmat2);
+        }
+
+        DWORD WINAPI hookedGetGlyphOutlineW(HDC hdc, UINT uChar, UINT fuFormat, LPGLYPHMETRICS lpgm, DWORD cjBuffer,
+            LPVOID pvBuffer, const MAT2* lpmat2)
+        {
+            return serve(true, hdc, uChar, fuFormat, lpgm, cjBuffer, pvBuffer, lpmat2);
+        }
+    }
+
+    bool install(void* module, uint32_t pageSize, uint32_t pages, const std::string& record) {
+        // Never freed, the game may rasterize text until the very end of the process
+        atlas = new Atlas(pageSize, pages);
+        if (!record.empty()) {
+            recorder = new Recorder(record.c_str(), RECORD_MAX_BYTES);
+            if (!recorder->isOpen()) {
+                LOG("Could not open '{}' to record glyph requests to", record);
+            }
+        }
+
+        auto game = reinterpret_cast<HMODULE>(module);
+        bool narrow = Utils::hookImport(game, "gdi32.dll", "GetGlyphOutlineA",
+            reinterpret_cast<void*>(&hookedGetGlyphOutlineA), reinterpret_cast<void**>(&originalGetGlyphOutlineA));
+        bool wide = Utils::hookImport(game, "gdi32.dll", "GetGlyphOutlineW",
+            reinterpret_cast<void*>(&hookedGetGlyphOutlineW), reinterpret_cast<void**>(&originalGetGlyphOutlineW));
+        return narrow || wide;
+    }
+
+    void counters(std::vector<std::pair<std::string, uint64_t>>* counters) {
+        if (!atlas) {
+            return;
+        }
+        counters->emplace_back("glyphServed", served.load());
+        counters->emplace_back("glyphRasterized", passed.load());
+        counters->emplace_back("glyphServedNs", servedTime.load());
+        counters->emplace_back("glyphRasterizedNs", passedTime.load());
+        std::lock_guard lock(atlasMutex);
+        counters->emplace_back("glyphsEvicted", atlas->stats().evictedGlyphs);
+        counters->emplace_back("glyphPagesCleared", atlas->stats().evictedPages);
+        counters->emplace_back("glyphsHeld", atlas->glyphs());
+    }
+}
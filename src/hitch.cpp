@@ -0,0 +1,296 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2024 Dominik Protasewicz
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <functional>
+#include <thread>
+
+#if defined(_WIN32)
+#include <windows.h>
+#endif
+
+#include "hitch.hpp"
+
+namespace Hitch
+{
+    static constexpr size_t RING_EVENTS = 4096;
+    static constexpr size_t MAX_RINGS = 256;
+
+    /**
+     * @brief Single producer, single consumer queue of one thread's events.
+     * @details A ring outlives its thread. Once the thread exited and the correlator drained
+     *      what it left behind, the ring is freed for the next thread that records an event.
+     */
+    struct Ring {
+        Event events[RING_EVENTS];
+        std::atomic<size_t> head = 0;   // Only written by the owning thread
+        std::atomic<size_t> tail = 0;   // Only written by the correlator
+        std::atomic<bool> claimed = true;
+        std::atomic<bool> exited = false;
+    };
+
+    /**
+     * @brief Marks the thread's ring as exited when the thread ends.
+     */
+    struct RingOwner {
+        Ring* ring = nullptr;
+
+        ~RingOwner() {
+            if (ring) {
+                ring->exited.store(true, std::memory_order_release);
+            }
+        }
+    };
+
+    static uint64_t minimum = 0;
+    static std::atomic<Ring*> rings[MAX_RINGS] = {};
+    static std::atomic<size_t> ringCount = 0;
+    static std::atomic<uint64_t> dropped = 0;
+    static std::atomic<uint64_t> framesSeen = 0;
+    static std::atomic<uint64_t> hitchesSeen = 0;
+    static thread_local RingOwner local;
+    static thread_local bool refused = false;
+
+    uint32_t threadId() {
+#if defined(_WIN32)
+        return (uint32_t)GetCurrentThreadId();
+#else
+        return (uint32_t)std::hash<std::thread::id>()(std::this_thread::get_id());
+#endif
+    }
+
+    uint64_t now() {
+        return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
+    void start(uint64_t minDuration) {
+        minimum = minDuration;
+        recording.store(true, std::memory_order_release);
+    }
+
+    static Ring* attach() {
+        size_t count = (std::min)(ringCount.load(std::memory_order_acquire), MAX_RINGS);
+        for (size_t i = 0; i < count; i++) {
+            Ring* ring = rings[i].load(std::memory_order_acquire);
+            bool expected = false;
+            if (ring && !ring->claimed.load(std::memory_order_relaxed) &&
+                ring->claimed.compare_exchange_strong(expected, true, std::memory_order_acquire))
+            {
+                return local.ring = ring;
+            }
+        }
+        size_t slot = ringCount.fetch_add(1, std::memory_order_relaxed);
+        if (slot >= MAX_RINGS) {
+            refused = true;
+            return nullptr;
+        }
+        // Never freed, only handed to another thread once drained
+        local.ring = new Ring();
+        rings[slot].store(local.ring, std::memory_order_release);
+        return local.ring;
+    }
+
+    void record(Kind kind, uint64_t begin, uint32_t arg) {
+        if (!recording.load(std::memory_order_acquire)) {
+            return;
+        }
+        uint64_t duration = now() - begin;
+        if (duration < minimum) {
+            return;
+        }
+        Ring* ring = local.ring;
+        if (!ring && (refused || !(ring = attach()))) {
+            dropped.fetch_add(1, std::memory_order_relaxed);
+            return;
+        }
+        size_t head = ring->head.load(std::memory_order_relaxed);
+        if (head - ring->tail.load(std::memory_order_acquire) >= RING_EVENTS) {
+            dropped.fetch_add(1, std::memory_order_relaxed);
+            return;
+        }
+        ring->events[head % RING_EVENTS] = { begin, duration, threadId(), arg, kind };
+        ring->head.store(head + 1, std::memory_order_release);
+    }
+
+    void Correlator::drain() {
+        size_t count = (std::min)(ringCount.load(std::memory_order_acquire), MAX_RINGS);
+        for (size_t i = 0; i < count; i++) {
+            Ring* ring = rings[i].load(std::memory_order_acquire);
+            if (!ring || !ring->claimed.load(std::memory_order_acquire)) {
+                continue;
+            }
+            // Read before head, so that everything an exited thread recorded is drained below
+            bool exited = ring->exited.load(std::memory_order_acquire);
+            size_t tail = ring->tail.load(std::memory_order_relaxed);
+            size_t head = ring->head.load(std::memory_order_acquire);
+            for (; tail != head; tail++) {
+                window.push_back(ring->events[tail % RING_EVENTS]);
+            }
+            ring->tail.store(tail, std::memory_order_release);
+            if (exited) {
+                ring->exited.store(false, std::memory_order_relaxed);
+                ring->claimed.store(false, std::memory_order_release);
+            }
+        }
+    }
+
+    void Correlator::present(uint64_t time, std::vector<Frame>* hitches) {
+        drain();
+        framesSeen.fetch_add(1, std::memory_order_relaxed);
+
+        // Frames held back at the previous present are complete now
+        for (auto& frame : pending) {
+            for (const auto& event : window) {
+                if (event.start < frame.end && event.start + event.duration > frame.start) {
+                    frame.events.push_back(event);
+                }
+            }
+            std::sort(frame.events.begin(), frame.events.end(),
+                [](const Event& a, const Event& b) { return a.start < b.start; });
+            hitchesSeen.fetch_add(1, std::memory_order_relaxed);
+            hitches->push_back(std::move(frame));
+        }
+        pending.clear();
+
+        if (last != 0 && time - last > threshold) {
+            pending.push_back({ last, time, {} });
+        }
+        uint64_t keepFrom = pending.empty() ? time : last;
+        last = time;
+
+        // Only events that can still overlap a frame that is yet to be reported are kept
+        std::erase_if(window, [keepFrom](const Event& event) { return event.start + event.duration <= keepFrom; });
+    }
+
+    template <typename T>
+    static void put(FILE* file, T value) {
+        fwrite(&value, sizeof(value), 1, file);
+    }
+
+    template <typename T>
+    static bool get(FILE* file, T* value) {
+        return fread(value, sizeof(*value), 1, file) == 1;
+    }
+
+    Writer::Writer(const char* path, uint64_t maxBytes) : file(fopen(path, "wb")), limit(maxBytes) {
+        if (!file) {
+            return;
+        }
+        setvbuf(file, nullptr, _IOFBF, 64 * 1024);
+        put(file, MAGIC);
+        put(file, VERSION);
+        put(file, (uint16_t)KindCount);
+        for (const char* name : kindNames) {
+            uint8_t length = (uint8_t)strlen(name);
+            put(file, length);
+            fwrite(name, 1, length, file);
+        }
+    }
+
+    Writer::~Writer() {
+        if (file) {
+            fclose(file);
+        }
+    }
+
+    void Writer::write(const Frame& frame) {
+        uint64_t size = 2 * sizeof(uint64_t) + sizeof(uint32_t) + frame.events.size() * EVENT_SIZE;
+        std::lock_guard lock(mutex);
+        if (!file || written + size > limit) {
+            return;
+        }
+        put(file, frame.start);
+        put(file, frame.end);
+        put(file, (uint32_t)frame.events.size());
+        for (const auto& event : frame.events) {
+            put(file, event.start);
+            put(file, event.duration);
+            put(file, event.thread);
+            put(file, event.arg);
+            put(file, (uint8_t)event.kind);
+        }
+        written += size;
+    }
+
+    Summary summarize(const Frame& frame) {
+        Summary summary;
+        for (const auto& event : frame.events) {
+            if (event.kind >= KindCount) {
+                continue;
+            }
+            uint64_t from = (std::max)(event.start, frame.start);
+            uint64_t to = (std::min)(event.start + event.duration, frame.end);
+            summary.count[event.kind]++;
+            summary.overlap[event.kind] += to > from ? to - from : 0;
+        }
+        return summary;
+    }
+
+    bool read(const char* path, std::vector<Frame>* frames) {
+        FILE* file = fopen(path, "rb");
+        if (!file) {
+            return false;
+        }
+        uint32_t magic = 0;
+        uint16_t version = 0, kinds = 0;
+        bool ok = get(file, &magic) && get(file, &version) && get(file, &kinds) &&
+            magic == MAGIC && version == VERSION;
+        for (uint16_t i = 0; ok && i < kinds; i++) {
+            uint8_t length = 0;
+            char name[256];
+            ok = get(file, &length) && fread(name, 1, length, file) == length;
+        }
+
+        Frame frame;
+        uint32_t count = 0;
+        while (ok && get(file, &frame.start) && get(file, &frame.end) && get(file, &count)) {
+            frame.events.clear();
+            bool complete = true;
+            for (uint32_t i = 0; i < count && complete; i++) {
+                Event event{};
+                uint8_t kind = 0;
+                complete = get(file, &event.start) && get(file, &event.duration) && get(file, &event.thread) &&
+                    get(file, &event.arg) && get(file, &kind);
+                event.kind = (Kind)kind;
+                frame.events.push_back(event);
+            }
+            if (!complete) {
+                break;
+            }
+            frames->push_back(frame);
+        }
+        fclose(file);
+        return ok;
+    }
+
+    void counters(std::vector<std::pair<std::string, uint64_t>>* counters) {
+        counters->emplace_back("hitchFrames", framesSeen.load(std::memory_order_relaxed));
+        counters->emplace_back("hitchReported", hitchesSeen.load(std::memory_order_relaxed));
+        counters->emplace_back("hitchDropped", dropped.load(std::memory_order_relaxed));
+        counters->emplace_back("hitchThreads", (std::min)(ringCount.load(std::memory_order_relaxed), MAX_RINGS));
+    }
+}
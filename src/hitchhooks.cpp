@@ -0,0 +1,148 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2024 Dominik Protasewicz
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <windows.h>
+#include <d3d9.h>
+#include <algorithm>
+#include <format>
+#include <string>
+#include <vector>
+
+#include "spdlog/spdlog.h"
+#include "safetyhook.hpp"
+
+#include "log.hpp"
+#include "utils.hpp"
+#include "d3d9hook.hpp"
+#include "hitch.hpp"
+
+namespace Hitch
+{
+    namespace
+    {
+        Correlator* correlator = nullptr;
+        Writer* writer = nullptr;
+
+        using ReadFile_t = BOOL(WINAPI*)(HANDLE, LPVOID, DWORD, LPDWORD, LPOVERLAPPED);
+        using HeapAlloc_t = LPVOID(WINAPI*)(HANDLE, DWORD, SIZE_T);
+        ReadFile_t originalReadFile = nullptr;
+        HeapAlloc_t originalHeapAlloc = nullptr;
+
+        SafetyHookInline createTextureHook{};
+        SafetyHookInline createVertexBufferHook{};
+        SafetyHookInline createIndexBufferHook{};
+
+        BOOL WINAPI hookedReadFile(HANDLE hFile, LPVOID lpBuffer, DWORD nNumberOfBytesToRead,
+            LPDWORD lpNumberOfBytesRead, LPOVERLAPPED lpOverlapped)
+        {
+            Scope scope(FileRead, nNumberOfBytesToRead);
+            return originalReadFile(hFile, lpBuffer, nNumberOfBytesToRead, lpNumberOfBytesRead, lpOverlapped);
+        }
+
+        LPVOID WINAPI hookedHeapAlloc(HANDLE hHeap, DWORD dwFlags, SIZE_T dwBytes) {
+            Scope scope(Alloc, (uint32_t)dwBytes);
+            return originalHeapAlloc(hHeap, dwFlags, dwBytes);
+        }
+
+        HRESULT __stdcall createTexture(IDirect3DDevice9* device, UINT width, UINT height, UINT levels, DWORD usage,
+            D3DFORMAT format, D3DPOOL pool, IDirect3DTexture9** texture, HANDLE* sharedHandle)
+        {
+            Scope scope(Resource, D3D9Hook::CreateTexture);
+            return createTextureHook.stdcall<HRESULT>(device, width, height, levels, usage, format, pool, texture,
+                sharedHandle);
+        }
+
+        HRESULT __stdcall createVertexBuffer(IDirect3DDevice9* device, UINT length, DWORD usage, DWORD fvf,
+            D3DPOOL pool, IDirect3DVertexBuffer9** buffer, HANDLE* sharedHandle)
+        {
+            Scope scope(Resource, D3D9Hook::CreateVertexBuffer);
+            return createVertexBufferHook.stdcall<HRESULT>(device, length, usage, fvf, pool, buffer, sharedHandle);
+        }
+
+        HRESULT __stdcall createIndexBuffer(IDirect3DDevice9* device, UINT length, DWORD usage, D3DFORMAT format,
+            D3DPOOL pool, IDirect3DIndexBuffer9** buffer, HANDLE* sharedHandle)
+        {
+            Scope scope(Resource, D3D9Hook::CreateIndexBuffer);
+            return createIndexBufferHook.stdcall<HRESULT>(device, length, usage, format, pool, buffer, sharedHandle);
+        }
+
+        /**
+         * @brief Logs a slow frame, what overlapped it per kind and the longest event.
+         */
+        void report(const Frame& frame) {
+            Summary summary = summarize(frame);
+            std::string kinds;
+            for (int kind = 0; kind < KindCount; kind++) {
+                if (summary.count[kind]) {
+                    kinds += std::format("{}{} {} ({:.2f} ms)", kinds.empty() ? "" : ", ", kindNames[kind],
+                        summary.count[kind], summary.overlap[kind] / 1e6);
+                }
+            }
+            LOG("Frame took {:.2f} ms: {}", (frame.end - frame.start) / 1e6, kinds.empty() ? "nothing recorded" : kinds);
+            auto longest = std::max_element(frame.events.begin(), frame.events.end(),
+                [](const Event& a, const Event& b) { return a.duration < b.duration; });
+            if (longest != frame.events.end()) {
+                LOG("Longest: {} on thread {} for {:.2f} ms, arg {}", kindNames[longest->kind], longest->thread,
+                    longest->duration / 1e6, longest->arg);
+            }
+        }
+
+        void onPresent(IDirect3DDevice9*) {
+            std::vector<Frame> hitches;
+            correlator->present(now(), &hitches);
+            for (const auto& frame : hitches) {
+                writer->write(frame);
+                report(frame);
+            }
+        }
+    }
+
+    bool install(void* module, uint64_t threshold, const char* path, uint64_t maxBytes) {
+        if (correlator) {
+            return true;
+        }
+        auto game = reinterpret_cast<HMODULE>(module);
+        bool reads = Utils::hookImport(game, "kernel32.dll", "ReadFile",
+            reinterpret_cast<void*>(&hookedReadFile), reinterpret_cast<void**>(&originalReadFile));
+        bool allocs = Utils::hookImport(game, "kernel32.dll", "HeapAlloc",
+            reinterpret_cast<void*>(&hookedHeapAlloc), reinterpret_cast<void**>(&originalHeapAlloc));
+        LOG("File reads {}, allocations {}", reads ? "intercepted" : "not imported", allocs ? "intercepted" : "not imported");
+
+        if (!D3D9Hook::init()) {
+            return false;
+        }
+        createTextureHook = safetyhook::create_inline(D3D9Hook::method(D3D9Hook::CreateTexture),
+            reinterpret_cast<void*>(&createTexture));
+        createVertexBufferHook = safetyhook::create_inline(D3D9Hook::method(D3D9Hook::CreateVertexBuffer),
+            reinterpret_cast<void*>(&createVertexBuffer));
+        createIndexBufferHook = safetyhook::create_inline(D3D9Hook::method(D3D9Hook::CreateIndexBuffer),
+            reinterpret_cast<void*>(&createIndexBuffer));
+
+        // Never freed, the render thread uses them until the very end of the process
+        correlator = new Correlator(threshold);
+        writer = new Writer(path, maxBytes);
+        LOG("Writing slow frames to '{}' {}", path, writer->isOpen() ? "started" : "failed");
+        return D3D9Hook::onPresent(&onPresent);
+    }
+}
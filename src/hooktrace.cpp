@@ -0,0 +1,105 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2024 Dominik Protasewicz
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <cstring>
+#include <algorithm>
+
+#include "hooktrace.hpp"
+
+namespace HookTrace
+{
+    Writer::Writer(const char* path, const std::vector<std::string>& sites, uint64_t maxBytes)
+        : file(fopen(path, "wb")), limit(maxBytes), start(std::chrono::steady_clock::now())
+    {
+        if (!file) {
+            return;
+        }
+        setvbuf(file, nullptr, _IOFBF, 1024 * 1024);
+        uint32_t magic = MAGIC;
+        uint16_t version = VERSION;
+        uint16_t count = (uint16_t)sites.size();
+        fwrite(&magic, sizeof(magic), 1, file);
+        fwrite(&version, sizeof(version), 1, file);
+        fwrite(&count, sizeof(count), 1, file);
+        for (const auto& site : sites) {
+            uint8_t length = (uint8_t)(std::min)(site.size(), (size_t)255);
+            fwrite(&length, 1, 1, file);
+            fwrite(site.data(), 1, length, file);
+        }
+    }
+
+    Writer::~Writer() {
+        if (file) {
+            fclose(file);
+        }
+    }
+
+    void Writer::write(uint8_t site, const HookContext32& before, const HookContext32& after) {
+        uint8_t record[RECORD_SIZE];
+        uint64_t timestamp = (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now() - start).count();
+        memcpy(record, &timestamp, sizeof(timestamp));
+        record[sizeof(timestamp)] = site;
+        memcpy(record + sizeof(timestamp) + 1, &before, HookContext::SIZE);
+        memcpy(record + sizeof(timestamp) + 1 + HookContext::SIZE, &after, HookContext::SIZE);
+
+        std::lock_guard lock(mutex);
+        if (!file || written + RECORD_SIZE > limit) {
+            return;
+        }
+        fwrite(record, 1, RECORD_SIZE, file);
+        written += RECORD_SIZE;
+    }
+
+    bool read(const char* path, std::vector<std::string>* sites, std::vector<Record>* records) {
+        FILE* file = fopen(path, "rb");
+        if (!file) {
+            return false;
+        }
+        uint32_t magic = 0;
+        uint16_t version = 0, count = 0;
+        bool ok = fread(&magic, sizeof(magic), 1, file) == 1 && fread(&version, sizeof(version), 1, file) == 1 &&
+            fread(&count, sizeof(count), 1, file) == 1 && magic == MAGIC && version == VERSION;
+        for (uint16_t i = 0; ok && i < count; i++) {
+            uint8_t length = 0;
+            char name[256];
+            ok = fread(&length, 1, 1, file) == 1 && fread(name, 1, length, file) == length;
+            if (ok) {
+                sites->emplace_back(name, length);
+            }
+        }
+
+        uint8_t bytes[RECORD_SIZE];
+        while (ok && fread(bytes, 1, RECORD_SIZE, file) == RECORD_SIZE) {
+            Record record{};
+            memcpy(&record.timestamp, bytes, sizeof(record.timestamp));
+            record.site = bytes[sizeof(record.timestamp)];
+            memcpy(&record.before, bytes + sizeof(record.timestamp) + 1, HookContext::SIZE);
+            memcpy(&record.after, bytes + sizeof(record.timestamp) + 1 + HookContext::SIZE, HookContext::SIZE);
+            records->push_back(record);
+        }
+        fclose(file);
+        return ok;
+    }
+}
@@ -0,0 +1,268 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2024 Dominik Protasewicz
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <algorithm>
+#include <cstring>
+
+#include "inputreplay.hpp"
+
+namespace InputReplay
+{
+    // Larger samples are taken for a corrupt recording
+    constexpr uint32_t MAX_SAMPLE = 1024 * 1024;
+
+    template <typename T>
+    static void put(FILE* file, T value) {
+        fwrite(&value, sizeof(value), 1, file);
+    }
+
+    template <typename T>
+    static bool get(FILE* file, T* value) {
+        return fread(value, sizeof(*value), 1, file) == 1;
+    }
+
+    static void putVarint(std::vector<uint8_t>* buffer, uint32_t value) {
+        while (value >= 0x80) {
+            buffer->push_back((uint8_t)(value | 0x80));
+            value >>= 7;
+        }
+        buffer->push_back((uint8_t)value);
+    }
+
+    static bool getVarint(FILE* file, uint32_t* value, uint64_t* bytes) {
+        *value = 0;
+        for (int shift = 0; shift < 35; shift += 7) {
+            int byte = fgetc(file);
+            if (byte == EOF) {
+                return false;
+            }
+            (*bytes)++;
+            *value |= (uint32_t)(byte & 0x7F) << shift;
+            if (!(byte & 0x80)) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    Recorder::Recorder(const char* path, uint64_t maxBytes) : file(fopen(path, "wb")), limit(maxBytes) {
+        if (!file) {
+            return;
+        }
+        setvbuf(file, nullptr, _IOFBF, 64 * 1024);
+        put(file, MAGIC);
+        put(file, VERSION);
+    }
+
+    Recorder::~Recorder() {
+        if (file) {
+            fclose(file);
+        }
+    }
+
+    void Recorder::sample(uint32_t frame, uint32_t channel, const void* data, uint32_t size) {
+        const uint8_t* bytes = static_cast<const uint8_t*>(data);
+        std::lock_guard lock(mutex);
+        counts.samples++;
+        if (!file || size > MAX_SAMPLE) {
+            return;
+        }
+        // Polls from other threads may race the frame count by one
+        frame = (std::max)(frame, lastFrame);
+        Channel& polled = channels[channel];
+        if (polled.frame != frame) {
+            polled.frame = frame;
+            polled.order = 0;
+        }
+        uint32_t order = polled.order++;
+        if (polled.state.size() == size && (size == 0 || memcmp(polled.state.data(), bytes, size) == 0)) {
+            return;
+        }
+
+        std::vector<uint8_t> base = polled.state;
+        base.resize(size);
+        // Runs end at two unchanged bytes, a shorter gap costs as much to skip as to copy
+        std::vector<std::pair<uint32_t, uint32_t>> runs;
+        for (uint32_t i = 0; i < size;) {
+            if (bytes[i] == base[i]) {
+                i++;
+                continue;
+            }
+            uint32_t start = i;
+            uint32_t end = i + 1;
+            while (end < size && (bytes[end] != base[end] || (end + 1 < size && bytes[end + 1] != base[end + 1]))) {
+                end++;
+            }
+            runs.emplace_back(start, end - start);
+            i = end;
+        }
+
+        buffer.clear();
+        putVarint(&buffer, frame - lastFrame);
+        putVarint(&buffer, channel);
+        putVarint(&buffer, order);
+        putVarint(&buffer, size);
+        putVarint(&buffer, (uint32_t)runs.size());
+        uint32_t position = 0;
+        for (const auto& [start, length] : runs) {
+            putVarint(&buffer, start - position);
+            putVarint(&buffer, length);
+            buffer.insert(buffer.end(), bytes + start, bytes + start + length);
+            position = start + length;
+        }
+
+        if (counts.bytes + buffer.size() > limit) {
+            // Later samples are diffed against this one, so nothing can be written after it
+            fclose(file);
+            file = nullptr;
+            return;
+        }
+        fwrite(buffer.data(), 1, buffer.size(), file);
+        counts.bytes += buffer.size();
+        counts.changed++;
+        lastFrame = frame;
+        polled.state.assign(bytes, bytes + size);
+    }
+
+    void Recorder::flush() {
+        std::lock_guard lock(mutex);
+        if (file) {
+            fflush(file);
+        }
+    }
+
+    Stats Recorder::stats() {
+        std::lock_guard lock(mutex);
+        return counts;
+    }
+
+    Player::Player(const char* path) : file(fopen(path, "rb")) {
+        if (!file) {
+            return;
+        }
+        setvbuf(file, nullptr, _IOFBF, 64 * 1024);
+        uint32_t magic = 0;
+        uint16_t version = 0;
+        if (!get(file, &magic) || !get(file, &version) || magic != MAGIC || version != VERSION) {
+            fclose(file);
+            file = nullptr;
+        }
+    }
+
+    Player::~Player() {
+        if (file) {
+            fclose(file);
+        }
+    }
+
+    bool Player::readRecord() {
+        uint32_t delta, channel, order, size, runs;
+        if (!getVarint(file, &delta, &counts.bytes) || !getVarint(file, &channel, &counts.bytes) ||
+            !getVarint(file, &order, &counts.bytes) || !getVarint(file, &size, &counts.bytes) ||
+            !getVarint(file, &runs, &counts.bytes) || size > MAX_SAMPLE)
+        {
+            return false;
+        }
+        Channel& recorded = channels[channel];
+        std::vector<uint8_t> state = recorded.decoded;
+        state.resize(size);
+        uint32_t position = 0;
+        for (uint32_t i = 0; i < runs; i++) {
+            uint32_t skip, length;
+            if (!getVarint(file, &skip, &counts.bytes) || !getVarint(file, &length, &counts.bytes) ||
+                skip > size - position || length > size - position - skip)
+            {
+                return false;
+            }
+            position += skip;
+            if (length && fread(state.data() + position, 1, length, file) != length) {
+                return false;
+            }
+            counts.bytes += length;
+            position += length;
+        }
+        readFrame += delta;
+        recorded.decoded = state;
+        recorded.pending.push_back({ readFrame, order, std::move(state) });
+        return true;
+    }
+
+    void Player::advance(uint32_t frame) {
+        // Read until a record past `frame` is pending, polls in `frame` may need any before it
+        while (file && !ended && readFrame <= frame) {
+            ended = !readRecord();
+        }
+        if (frame > prunedFrame) {
+            prune(frame);
+        }
+    }
+
+    void Player::prune(uint32_t frame) {
+        // Of the samples before `frame` only the latest can still be played, the rest belong to polls not made
+        prunedFrame = frame;
+        for (auto& [channel, recorded] : channels) {
+            while (recorded.pending.size() > 1 && recorded.pending[1].frame < frame) {
+                recorded.pending.pop_front();
+            }
+        }
+    }
+
+    bool Player::sample(uint32_t frame, uint32_t channel, std::vector<uint8_t>* state) {
+        std::lock_guard lock(mutex);
+        counts.samples++;
+        advance(frame);
+        Channel& polled = channels[channel];
+        if (polled.frame != frame) {
+            polled.frame = frame;
+            polled.order = 0;
+        }
+        uint32_t order = polled.order++;
+        while (!polled.pending.empty()) {
+            Pending& next = polled.pending.front();
+            if (next.frame > frame || (next.frame == frame && next.order > order)) {
+                break;
+            }
+            polled.state = std::move(next.state);
+            polled.played = true;
+            polled.pending.pop_front();
+            counts.changed++;
+        }
+        if (!polled.played) {
+            return false;
+        }
+        *state = polled.state;
+        return true;
+    }
+
+    bool Player::finished(uint32_t frame) {
+        std::lock_guard lock(mutex);
+        advance(frame);
+        return ended && frame > readFrame;
+    }
+
+    Stats Player::stats() {
+        std::lock_guard lock(mutex);
+        return counts;
+    }
+}
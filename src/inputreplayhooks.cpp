@@ -0,0 +1,415 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2024 Dominik Protasewicz
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <windows.h>
+#include <d3d9.h>
+#define DIRECTINPUT_VERSION 0x0800
+#include <dinput.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+#include "spdlog/spdlog.h"
+#include "safetyhook.hpp"
+
+#include "log.hpp"
+#include "utils.hpp"
+#include "d3d9hook.hpp"
+#include "inputreplay.hpp"
+
+namespace InputReplay
+{
+    namespace
+    {
+        constexpr size_t CREATE_DEVICE = 3;     // Index of IDirectInput8::CreateDevice in its vtable
+        constexpr size_t GET_DEVICE_STATE = 9;  // Index of IDirectInputDevice8::GetDeviceState in its vtable
+        constexpr size_t GET_DEVICE_DATA = 10;  // Index of IDirectInputDevice8::GetDeviceData in its vtable
+        constexpr uint32_t FLUSH_FRAMES = 60;
+        constexpr uint32_t UNKNOWN_DEVICE = 0xFFFFFF;
+        // The ANSI and wide interfaces have vtables of their own
+        constexpr size_t SLOTS = 2;
+
+        using GetKeyboardState_t = BOOL(WINAPI*)(PBYTE);
+        using GetAsyncKeyState_t = SHORT(WINAPI*)(int);
+        using GetKeyState_t = SHORT(WINAPI*)(int);
+        using DirectInput8Create_t = HRESULT(WINAPI*)(HINSTANCE, DWORD, REFIID, LPVOID*, LPUNKNOWN);
+        GetKeyboardState_t originalGetKeyboardState = GetKeyboardState;
+        GetAsyncKeyState_t originalGetAsyncKeyState = GetAsyncKeyState;
+        GetKeyState_t originalGetKeyState = GetKeyState;
+        DirectInput8Create_t originalDirectInput8Create = nullptr;
+
+        /**
+         * @brief A COM method hooked where it lives, shared by every object of its vtable.
+         */
+        struct Method {
+            void* target = nullptr;
+            SafetyHookInline hook{};
+        };
+
+        std::mutex methodMutex;
+        Method createDeviceMethods[SLOTS];
+        Method deviceStateMethods[SLOTS];
+        Method deviceDataMethods[SLOTS];
+
+        // Devices numbered in the order the game created them
+        std::mutex deviceMutex;
+        std::unordered_map<void*, uint32_t> devices;
+        uint32_t nextDevice = 0;
+
+        Recorder* recorder = nullptr;
+        Player* player = nullptr;
+        std::atomic<bool> replaying = false;
+        std::atomic<bool> anchored = false;     // Set by the first poll, frames are counted from there
+        std::atomic<uint32_t> frame = 0;
+        std::atomic<uint32_t> framePolls = 0;
+        std::atomic<uint64_t> mismatched = 0;
+        std::atomic<uint64_t> diverged = 0;
+
+        // Only touched on the render thread
+        FILE* telemetry = nullptr;
+        std::chrono::steady_clock::time_point lastPresent{};
+        double totalMs = 0;
+        uint32_t timedFrames = 0;
+
+        /**
+         * @brief Count a poll towards the current frame, anchoring the frame count at the first
+         *
+         * @return Frame the poll is made in
+         */
+        uint32_t poll() {
+            if (!anchored.load(std::memory_order_relaxed) && !anchored.exchange(true)) {
+                LOG("Input first polled, frames are counted from here");
+            }
+            framePolls.fetch_add(1, std::memory_order_relaxed);
+            return frame.load(std::memory_order_relaxed);
+        }
+
+        /**
+         * @brief Record a poll or replace its result by the recorded one
+         *
+         * @param channel Channel polled
+         * @param result What the call returned, replaced when replaying
+         * @param data What it wrote, replaced when replaying
+         * @param size Size of `data`
+         */
+        template <typename Result>
+        void exchange(uint32_t channel, Result* result, void* data, uint32_t size) {
+            uint32_t polled = poll();
+            if (recorder) {
+                uint8_t sample[sizeof(Result) + 256];
+                std::vector<uint8_t> large;
+                uint8_t* bytes = sample;
+                if (size > sizeof(sample) - sizeof(Result)) {
+                    large.resize(sizeof(Result) + size);
+                    bytes = large.data();
+                }
+                memcpy(bytes, result, sizeof(Result));
+                if (size) {
+                    memcpy(bytes + sizeof(Result), data, size);
+                }
+                recorder->sample(polled, channel, bytes, (uint32_t)sizeof(Result) + size);
+                return;
+            }
+            std::vector<uint8_t> state;
+            if (!replaying.load(std::memory_order_relaxed) || !player->sample(polled, channel, &state)) {
+                return;
+            }
+            if (state.size() != sizeof(Result) + size) {
+                mismatched++;
+                return;
+            }
+            memcpy(result, state.data(), sizeof(Result));
+            if (size) {
+                memcpy(data, state.data() + sizeof(Result), size);
+            }
+        }
+
+        uint32_t deviceIndex(void* device) {
+            std::lock_guard lock(deviceMutex);
+            auto found = devices.find(device);
+            return found == devices.end() ? UNKNOWN_DEVICE : found->second;
+        }
+
+        BOOL WINAPI hookedGetKeyboardState(PBYTE keys) {
+            BOOL result = originalGetKeyboardState(keys);
+            if (keys) {
+                exchange(channel(Source::KeyboardState), &result, keys, 256);
+            }
+            return result;
+        }
+
+        SHORT WINAPI hookedGetAsyncKeyState(int key) {
+            SHORT result = originalGetAsyncKeyState(key);
+            exchange(channel(Source::AsyncKeyState, (uint32_t)key), &result, nullptr, 0);
+            return result;
+        }
+
+        SHORT WINAPI hookedGetKeyState(int key) {
+            SHORT result = originalGetKeyState(key);
+            exchange(channel(Source::KeyState, (uint32_t)key), &result, nullptr, 0);
+            return result;
+        }
+
+        template <size_t Slot>
+        HRESULT __stdcall getDeviceState(void* device, DWORD size, LPVOID data) {
+            HRESULT result = deviceStateMethods[Slot].hook.stdcall<HRESULT>(device, size, data);
+            if (data) {
+                exchange(channel(Source::DeviceState, deviceIndex(device)), &result, data, size);
+            }
+            return result;
+        }
+
+        template <size_t Slot>
+        HRESULT __stdcall getDeviceData(void* device, DWORD objectSize, LPDIDEVICEOBJECTDATA objects, LPDWORD inOut,
+            DWORD flags)
+        {
+            HRESULT result = deviceDataMethods[Slot].hook.stdcall<HRESULT>(device, objectSize, objects, inOut,
+                flags);
+            if (!inOut || !objectSize || (flags & DIGDD_PEEK)) {
+                return result;
+            }
+            uint32_t index = channel(Source::DeviceData, deviceIndex(device));
+            uint32_t returned = *inOut;
+            uint32_t bytes = objects ? returned * objectSize : 0;
+            if (recorder) {
+                // The buffered events follow their count, a flush without a buffer records the count only
+                std::vector<uint8_t> sample(sizeof(uint32_t) + bytes);
+                memcpy(sample.data(), &returned, sizeof(uint32_t));
+                if (bytes) {
+                    memcpy(sample.data() + sizeof(uint32_t), objects, bytes);
+                }
+                exchange(index, &result, sample.data(), (uint32_t)sample.size());
+                return result;
+            }
+            uint32_t polled = poll();
+            std::vector<uint8_t> state;
+            if (!replaying.load(std::memory_order_relaxed) || !player->sample(polled, index, &state) ||
+                state.size() < sizeof(HRESULT) + sizeof(uint32_t))
+            {
+                return result;
+            }
+            uint32_t recorded;
+            memcpy(&result, state.data(), sizeof(HRESULT));
+            memcpy(&recorded, state.data() + sizeof(HRESULT), sizeof(uint32_t));
+            if (objects) {
+                // The game asked for at most what its buffer holds, `returned` may be less than that
+                uint32_t stored = (uint32_t)(state.size() - sizeof(HRESULT) - sizeof(uint32_t)) / objectSize;
+                recorded = (std::min)(recorded, stored);
+                memcpy(objects, state.data() + sizeof(HRESULT) + sizeof(uint32_t), (size_t)recorded * objectSize);
+            }
+            *inOut = recorded;
+            return result;
+        }
+
+        /**
+         * @brief Hook a method of a vtable not hooked before
+         *
+         * @param methods Slots the hooks of this method are kept in
+         * @param target Address of the method
+         * @param detours Replacement for each slot
+         */
+        void hookMethod(Method (&methods)[SLOTS], void* target, void* const (&detours)[SLOTS]) {
+            std::lock_guard lock(methodMutex);
+            for (size_t i = 0; i < SLOTS; i++) {
+                if (methods[i].target == target) {
+                    return;
+                }
+                if (!methods[i].target) {
+                    methods[i].target = target;
+                    methods[i].hook = safetyhook::create_inline(target, detours[i]);
+                    if (!methods[i].hook) {
+                        LOG("DirectInput method at {} could not be hooked", target);
+                    }
+                    return;
+                }
+            }
+        }
+
+        template <size_t Slot>
+        HRESULT __stdcall createDevice(void* input, REFGUID guid, void** device, LPUNKNOWN outer) {
+            HRESULT result = createDeviceMethods[Slot].hook.stdcall<HRESULT>(input, guid, device, outer);
+            if (FAILED(result) || !device || !*device) {
+                return result;
+            }
+            uint32_t index;
+            {
+                std::lock_guard lock(deviceMutex);
+                index = nextDevice++;
+                devices[*device] = index;
+            }
+            LOG("DirectInput device {} created", index);
+            void** methods = *reinterpret_cast<void***>(*device);
+            static void* const stateDetours[SLOTS] = {
+                reinterpret_cast<void*>(&getDeviceState<0>), reinterpret_cast<void*>(&getDeviceState<1>) };
+            static void* const dataDetours[SLOTS] = {
+                reinterpret_cast<void*>(&getDeviceData<0>), reinterpret_cast<void*>(&getDeviceData<1>) };
+            hookMethod(deviceStateMethods, methods[GET_DEVICE_STATE], stateDetours);
+            hookMethod(deviceDataMethods, methods[GET_DEVICE_DATA], dataDetours);
+            return result;
+        }
+
+        HRESULT WINAPI hookedDirectInput8Create(HINSTANCE instance, DWORD version, REFIID iid, LPVOID* out,
+            LPUNKNOWN outer)
+        {
+            HRESULT result = originalDirectInput8Create(instance, version, iid, out, outer);
+            if (SUCCEEDED(result) && out && *out) {
+                static void* const detours[SLOTS] = {
+                    reinterpret_cast<void*>(&createDevice<0>), reinterpret_cast<void*>(&createDevice<1>) };
+                hookMethod(createDeviceMethods, (*reinterpret_cast<void***>(*out))[CREATE_DEVICE], detours);
+            }
+            return result;
+        }
+
+        /**
+         * @brief Record how often input was polled in a frame, or compare it with the recording
+         */
+        void checkPolls(uint32_t ended) {
+            uint32_t polls = framePolls.exchange(0, std::memory_order_relaxed);
+            if (recorder) {
+                recorder->sample(ended, channel(Source::Polls), &polls, sizeof(polls));
+                return;
+            }
+            std::vector<uint8_t> state;
+            if (!replaying.load(std::memory_order_relaxed) || !player->sample(ended, channel(Source::Polls), &state) ||
+                state.size() != sizeof(uint32_t))
+            {
+                return;
+            }
+            uint32_t recorded;
+            memcpy(&recorded, state.data(), sizeof(recorded));
+            if (recorded != polls && diverged++ == 0) {
+                LOG("Frame {} polled input {} times, {} when recorded, the replay has likely diverged", ended, polls,
+                    recorded);
+            }
+        }
+
+        void onPresent(IDirect3DDevice9*) {
+            if (!anchored.load(std::memory_order_relaxed)) {
+                return;
+            }
+            checkPolls(frame.load(std::memory_order_relaxed));
+            uint32_t presented = frame.fetch_add(1, std::memory_order_relaxed) + 1;
+            auto now = std::chrono::steady_clock::now();
+            if (telemetry && presented > 1) {
+                double ms = std::chrono::duration<double, std::milli>(now - lastPresent).count();
+                fprintf(telemetry, "%u,%.4f\n", presented - 1, ms);
+                totalMs += ms;
+                timedFrames++;
+            }
+            lastPresent = now;
+
+            if (recorder && presented % FLUSH_FRAMES == 0) {
+                recorder->flush();
+            }
+            if (replaying.load(std::memory_order_relaxed) && player->finished(presented)) {
+                // Input is live again from here, frames after it no longer compare between runs
+                replaying = false;
+                if (telemetry) {
+                    fclose(telemetry);
+                    telemetry = nullptr;
+                }
+                LOG("Replay ended at frame {}, {} frames timed at {:.3f} ms on average", presented, timedFrames,
+                    timedFrames ? totalMs / timedFrames : 0.0);
+            }
+        }
+    }
+
+    bool install(void* module, bool replay, const char* path, const std::string& telemetryPath, uint64_t maxBytes) {
+        if (recorder || player) {
+            return true;
+        }
+        // Never freed, the game polls its input until the very end of the process
+        if (replay) {
+            player = new Player(path);
+            if (!player->isOpen()) {
+                LOG("{} is not an input recording", path);
+                return false;
+            }
+        }
+        else {
+            recorder = new Recorder(path, maxBytes);
+            if (!recorder->isOpen()) {
+                LOG("{} could not be created", path);
+                return false;
+            }
+        }
+        if (!telemetryPath.empty()) {
+            telemetry = fopen(telemetryPath.c_str(), "w");
+            if (telemetry) {
+                setvbuf(telemetry, nullptr, _IOFBF, 64 * 1024);
+                fprintf(telemetry, "frame,ms\n");
+            }
+            else {
+                LOG("{} could not be created, frames are not timed", telemetryPath);
+            }
+        }
+        if (!D3D9Hook::init() || !D3D9Hook::onPresent(&onPresent)) {
+            LOG("Frames cannot be counted");
+            return false;
+        }
+
+        HMODULE game = static_cast<HMODULE>(module);
+        const struct {
+            const char* dll;
+            const char* name;
+            void* replacement;
+            void** original;
+        } imports[] = {
+            { "user32.dll", "GetKeyboardState", reinterpret_cast<void*>(&hookedGetKeyboardState),
+                reinterpret_cast<void**>(&originalGetKeyboardState) },
+            { "user32.dll", "GetAsyncKeyState", reinterpret_cast<void*>(&hookedGetAsyncKeyState),
+                reinterpret_cast<void**>(&originalGetAsyncKeyState) },
+            { "user32.dll", "GetKeyState", reinterpret_cast<void*>(&hookedGetKeyState),
+                reinterpret_cast<void**>(&originalGetKeyState) },
+            { "dinput8.dll", "DirectInput8Create", reinterpret_cast<void*>(&hookedDirectInput8Create),
+                reinterpret_cast<void**>(&originalDirectInput8Create) },
+        };
+        bool any = false;
+        for (const auto& import : imports) {
+            bool hooked = Utils::hookImport(game, import.dll, import.name, import.replacement, import.original);
+            LOG("{} {}", import.name, hooked ? "hooked" : "not imported");
+            any |= hooked;
+        }
+        replaying = replay && any;
+        return any;
+    }
+
+    void counters(std::vector<std::pair<std::string, uint64_t>>* counters) {
+        if (!recorder && !player) {
+            return;
+        }
+        Stats stats = recorder ? recorder->stats() : player->stats();
+        counters->emplace_back("inputFrames", frame.load());
+        counters->emplace_back("inputSamples", stats.samples);
+        counters->emplace_back("inputChanged", stats.changed);
+        counters->emplace_back("inputBytes", stats.bytes);
+        counters->emplace_back("inputMismatched", mismatched.load());
+        counters->emplace_back("inputDiverged", diverged.load());
+    }
+}
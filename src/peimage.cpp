@@ -0,0 +1,115 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2024 Dominik Protasewicz
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <cstring>
+#include <algorithm>
+
+#include "peimage.hpp"
+
+namespace PeImage
+{
+    namespace
+    {
+        // Offsets into the headers, the fields used here sit at the same place in PE32
+        // and PE32+ optional headers
+        constexpr size_t DOS_LFANEW = 0x3C;
+        constexpr size_t FILE_NUMBER_OF_SECTIONS = 4 + 2;
+        constexpr size_t FILE_TIME_DATE_STAMP = 4 + 4;
+        constexpr size_t FILE_SIZE_OF_OPTIONAL_HEADER = 4 + 16;
+        constexpr size_t OPTIONAL_HEADER = 4 + 20;
+        constexpr size_t OPTIONAL_SIZE_OF_IMAGE = OPTIONAL_HEADER + 56;
+        constexpr size_t OPTIONAL_SIZE_OF_HEADERS = OPTIONAL_HEADER + 60;
+        constexpr size_t OPTIONAL_CHECK_SUM = OPTIONAL_HEADER + 64;
+        constexpr size_t SECTION_SIZE = 40;
+
+        template <typename T>
+        T read(const uint8_t* bytes) {
+            T value;
+            memcpy(&value, bytes, sizeof(T));
+            return value;
+        }
+
+        /**
+         * @brief Locate the NT headers, checking that they fit inside `size` bytes.
+         */
+        const uint8_t* ntHeaders(const uint8_t* headers, size_t size) {
+            if (size < DOS_LFANEW + 4 || headers[0] != 'M' || headers[1] != 'Z') {
+                return nullptr;
+            }
+            uint32_t lfanew = read<uint32_t>(headers + DOS_LFANEW);
+            if (lfanew > size || size - lfanew < OPTIONAL_CHECK_SUM + 4) {
+                return nullptr;
+            }
+            const uint8_t* nt = headers + lfanew;
+            if (memcmp(nt, "PE\0\0", 4) != 0) {
+                return nullptr;
+            }
+            return nt;
+        }
+    }
+
+    bool identify(const uint8_t* headers, size_t size, Identity* identity) {
+        const uint8_t* nt = ntHeaders(headers, size);
+        if (!nt) {
+            return false;
+        }
+        identity->timeDateStamp = read<uint32_t>(nt + FILE_TIME_DATE_STAMP);
+        identity->sizeOfImage = read<uint32_t>(nt + OPTIONAL_SIZE_OF_IMAGE);
+        identity->checkSum = read<uint32_t>(nt + OPTIONAL_CHECK_SUM);
+        return true;
+    }
+
+    bool map(const std::vector<uint8_t>& file, std::vector<uint8_t>* image) {
+        const uint8_t* nt = ntHeaders(file.data(), file.size());
+        if (!nt) {
+            return false;
+        }
+        uint32_t sizeOfImage = read<uint32_t>(nt + OPTIONAL_SIZE_OF_IMAGE);
+        uint32_t sizeOfHeaders = read<uint32_t>(nt + OPTIONAL_SIZE_OF_HEADERS);
+        uint16_t sections = read<uint16_t>(nt + FILE_NUMBER_OF_SECTIONS);
+        uint16_t optionalSize = read<uint16_t>(nt + FILE_SIZE_OF_OPTIONAL_HEADER);
+        size_t sectionTable = (size_t)(nt - file.data()) + OPTIONAL_HEADER + optionalSize;
+        if (sectionTable + (size_t)sections * SECTION_SIZE > file.size()) {
+            return false;
+        }
+
+        image->assign(sizeOfImage, 0);
+        memcpy(image->data(), file.data(), (std::min<size_t>)({ sizeOfHeaders, sizeOfImage, file.size() }));
+        for (uint16_t i = 0; i < sections; i++) {
+            const uint8_t* section = file.data() + sectionTable + (size_t)i * SECTION_SIZE;
+            uint32_t virtualSize = read<uint32_t>(section + 8);
+            uint32_t virtualAddress = read<uint32_t>(section + 12);
+            uint32_t sizeOfRawData = read<uint32_t>(section + 16);
+            uint32_t pointerToRawData = read<uint32_t>(section + 20);
+
+            size_t size = virtualSize ? (std::min)(virtualSize, sizeOfRawData) : sizeOfRawData;
+            if (virtualAddress >= sizeOfImage || pointerToRawData >= file.size()) {
+                continue;
+            }
+            size = (std::min<size_t>)({ size, sizeOfImage - virtualAddress, file.size() - pointerToRawData });
+            memcpy(image->data() + virtualAddress, file.data() + pointerToRawData, size);
+        }
+        return true;
+    }
+}
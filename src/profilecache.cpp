@@ -0,0 +1,188 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2024 Dominik Protasewicz
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <algorithm>
+#include <cstring>
+
+#include "profilecache.hpp"
+
+namespace ProfileCache
+{
+    static std::string lower(std::string_view text) {
+        std::string lowered(text);
+        for (char& c : lowered) {
+            if (c >= 'A' && c <= 'Z') {
+                c = (char)(c - 'A' + 'a');
+            }
+        }
+        return lowered;
+    }
+
+    static std::string_view trim(std::string_view text) {
+        while (!text.empty() && (text.front() == ' ' || text.front() == '\t')) text.remove_prefix(1);
+        while (!text.empty() && (text.back() == ' ' || text.back() == '\t' || text.back() == '\r')) text.remove_suffix(1);
+        return text;
+    }
+
+    Ini::Ini(std::string_view text) {
+        Section* section = nullptr;
+        while (!text.empty()) {
+            size_t newline = text.find('\n');
+            std::string_view line = trim(text.substr(0, newline));
+            text.remove_prefix(newline == std::string_view::npos ? text.size() : newline + 1);
+            if (line.empty() || line.front() == ';') {
+                continue;
+            }
+
+            if (line.front() == '[') {
+                size_t close = line.find(']');
+                std::string_view name = trim(line.substr(1, close == std::string_view::npos ? line.size() - 1 : close - 1));
+                auto [it, added] = lookup.try_emplace(lower(name));
+                if (added) {
+                    it->second.name = std::string(name);
+                    order.push_back(it->first);
+                    section = &it->second;
+                }
+                else {
+                    // Windows only ever finds the first section of a name
+                    section = nullptr;
+                }
+                continue;
+            }
+            if (!section) {
+                continue;
+            }
+
+            size_t equals = line.find('=');
+            std::string_view key = trim(line.substr(0, equals));
+            std::string_view value = equals == std::string_view::npos ? std::string_view() : trim(line.substr(equals + 1));
+            if (value.size() >= 2 && (value.front() == '"' || value.front() == '\'') && value.back() == value.front()) {
+                value = value.substr(1, value.size() - 2);
+            }
+            if (section->index.try_emplace(lower(key), section->entries.size()).second) {
+                section->entries.emplace_back(std::string(key), std::string(value));
+            }
+        }
+    }
+
+    const std::string* Ini::find(std::string_view section, std::string_view key) const {
+        auto it = lookup.find(lower(section));
+        if (it == lookup.end()) {
+            return nullptr;
+        }
+        auto entry = it->second.index.find(lower(key));
+        return entry == it->second.index.end() ? nullptr : &it->second.entries[entry->second].second;
+    }
+
+    /**
+     * @brief Copy a double null terminated list, truncated the way Windows does it
+     */
+    static uint32_t copyList(const std::vector<std::string_view>& items, char* buffer, uint32_t size) {
+        if (size < 2) {
+            if (size) {
+                buffer[0] = 0;
+            }
+            return 0;
+        }
+        uint32_t used = 0;
+        for (const auto& item : items) {
+            if (used + item.size() + 1 > size - 1) {
+                // Whatever fits of the item, then the two terminating nulls
+                uint32_t room = size - 2 - used;
+                memcpy(buffer + used, item.data(), room);
+                buffer[size - 2] = 0;
+                buffer[size - 1] = 0;
+                return size - 2;
+            }
+            memcpy(buffer + used, item.data(), item.size());
+            used += (uint32_t)item.size();
+            buffer[used++] = 0;
+        }
+        buffer[used] = 0;
+        return used;
+    }
+
+    uint32_t Ini::getString(const char* section, const char* key, const char* fallback, char* buffer, uint32_t size) const {
+        if (!buffer || size == 0) {
+            return 0;
+        }
+        std::vector<std::string_view> items;
+        if (!section) {
+            for (const auto& name : order) {
+                items.push_back(lookup.at(name).name);
+            }
+            return copyList(items, buffer, size);
+        }
+        if (!key) {
+            auto it = lookup.find(lower(section));
+            if (it != lookup.end()) {
+                for (const auto& entry : it->second.entries) {
+                    items.push_back(entry.first);
+                }
+            }
+            return copyList(items, buffer, size);
+        }
+
+        std::string_view value;
+        if (const std::string* found = find(section, key)) {
+            value = *found;
+        }
+        else if (fallback) {
+            value = fallback;
+            while (!value.empty() && value.back() == ' ') value.remove_suffix(1);
+        }
+        uint32_t length = (uint32_t)(std::min)(value.size(), (size_t)size - 1);
+        memcpy(buffer, value.data(), length);
+        buffer[length] = 0;
+        return length;
+    }
+
+    uint32_t Ini::getInt(const char* section, const char* key, int32_t fallback) const {
+        const std::string* found = section && key ? find(section, key) : nullptr;
+        if (!found) {
+            return (uint32_t)fallback;
+        }
+        // Leading decimal or 0x prefixed hexadecimal number, anything after it is ignored
+        std::string_view text = *found;
+        bool negative = !text.empty() && text.front() == '-';
+        if (negative || (!text.empty() && text.front() == '+')) {
+            text.remove_prefix(1);
+        }
+        uint32_t base = 10;
+        if (text.size() > 2 && text[0] == '0' && (text[1] == 'x' || text[1] == 'X')) {
+            base = 16;
+            text.remove_prefix(2);
+        }
+        uint32_t value = 0;
+        for (char c : text) {
+            uint32_t digit;
+            if (c >= '0' && c <= '9') digit = (uint32_t)(c - '0');
+            else if (base == 16 && c >= 'a' && c <= 'f') digit = (uint32_t)(c - 'a' + 10);
+            else if (base == 16 && c >= 'A' && c <= 'F') digit = (uint32_t)(c - 'A' + 10);
+            else break;
+            value = value * base + digit;
+        }
+        return negative ? 0u - value : value;
+    }
+}
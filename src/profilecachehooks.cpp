@@ -0,0 +1,295 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2024 Dominik Protasewicz
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <windows.h>
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+
+#include "spdlog/spdlog.h"
+
+#include "log.hpp"
+#include "utils.hpp"
+#include "hitch.hpp"
+#include "profilecache.hpp"
+
+namespace ProfileCache
+{
+    namespace
+    {
+        constexpr uint64_t LOG_EVERY = 16;
+
+        using GetPrivateProfileStringA_t = DWORD(WINAPI*)(LPCSTR, LPCSTR, LPCSTR, LPSTR, DWORD, LPCSTR);
+        using GetPrivateProfileIntA_t = UINT(WINAPI*)(LPCSTR, LPCSTR, INT, LPCSTR);
+        using WritePrivateProfileStringA_t = BOOL(WINAPI*)(LPCSTR, LPCSTR, LPCSTR, LPCSTR);
+        using WritePrivateProfileSectionA_t = BOOL(WINAPI*)(LPCSTR, LPCSTR, LPCSTR);
+        using WritePrivateProfileStructA_t = BOOL(WINAPI*)(LPCSTR, LPCSTR, LPVOID, UINT, LPCSTR);
+        GetPrivateProfileStringA_t originalGetString = nullptr;
+        GetPrivateProfileIntA_t originalGetInt = nullptr;
+        WritePrivateProfileStringA_t originalWriteString = nullptr;
+        WritePrivateProfileSectionA_t originalWriteSection = nullptr;
+        WritePrivateProfileStructA_t originalWriteStruct = nullptr;
+
+        /**
+         * @brief A file as last parsed, together with the reads already checked against Windows.
+         */
+        struct File {
+            std::shared_ptr<const Ini> ini; // nullptr if reads must be passed on
+            bool loaded = false;
+            bool trusted = true;
+            uint64_t lastWrite = 0;
+            uint64_t size = 0;
+            std::unordered_set<std::string> checked;
+        };
+
+        std::mutex filesMutex;
+        std::unordered_map<std::string, File> files;
+
+        bool installed = false;
+        std::atomic<uint64_t> served = 0;
+        std::atomic<uint64_t> servedTime = 0;
+        std::atomic<uint64_t> passed = 0;
+        std::atomic<uint64_t> passedTime = 0;
+        std::atomic<uint64_t> parses = 0;
+
+        std::string normalize(const char* path) {
+            std::string key(path);
+            for (char& c : key) {
+                c = c == '/' ? '\\' : (char)tolower((unsigned char)c);
+            }
+            return key;
+        }
+
+        /**
+         * @brief Identifies a read by its section and key, either of which may be null
+         */
+        std::string readKey(const char* section, const char* key) {
+            std::string id = section ? "[" + std::string(section) : std::string();
+            id += '\0';
+            if (key) {
+                id += "=" + std::string(key);
+            }
+            for (char& c : id) {
+                c = (char)tolower((unsigned char)c);
+            }
+            return id;
+        }
+
+        /**
+         * @brief Parse a file for the cache
+         * @return The parsed file, nullptr if it cannot be read or is not plain text
+         */
+        std::shared_ptr<const Ini> load(const char* path) {
+            std::ifstream stream(path, std::ios::binary);
+            if (!stream) {
+                return nullptr;
+            }
+            std::string text((std::istreambuf_iterator<char>(stream)), std::istreambuf_iterator<char>());
+            // Windows reads files with a byte order mark as Unicode, leave those to it
+            if (text.size() >= 2 && ((uint8_t)text[0] == 0xFF || (uint8_t)text[0] == 0xFE || (uint8_t)text[0] == 0xEF)) {
+                return nullptr;
+            }
+            parses++;
+            return std::make_shared<const Ini>(text);
+        }
+
+        /**
+         * @brief The parsed file to answer a read from
+         * @details The file is parsed again whenever its last write time or size changed, so
+         *      edits made outside the game are picked up by the next read.
+         *
+         * @param path File passed to the read
+         * @param section Section passed to the read
+         * @param key Key passed to the read
+         * @param check Set when this section and key were not read since the file was parsed,
+         *      the read should then be passed on and checked against Windows
+         * @return The parsed file, nullptr if the read must be passed on
+         */
+        std::shared_ptr<const Ini> lookup(const char* path, const char* section, const char* key, bool* check) {
+            *check = false;
+            // Without a path Windows looks in its own folder rather than the working directory
+            if (!path || (!strchr(path, '\\') && !strchr(path, '/'))) {
+                return nullptr;
+            }
+            WIN32_FILE_ATTRIBUTE_DATA attributes;
+            if (!GetFileAttributesExA(path, GetFileExInfoStandard, &attributes)) {
+                return nullptr;
+            }
+            uint64_t lastWrite = attributes.ftLastWriteTime.dwLowDateTime | ((uint64_t)attributes.ftLastWriteTime.dwHighDateTime << 32);
+            uint64_t size = attributes.nFileSizeLow | ((uint64_t)attributes.nFileSizeHigh << 32);
+
+            std::lock_guard lock(filesMutex);
+            File& file = files[normalize(path)];
+            if (!file.trusted) {
+                return nullptr;
+            }
+            if (!file.loaded || file.lastWrite != lastWrite || file.size != size) {
+                file.ini = load(path);
+                file.loaded = true;
+                file.lastWrite = lastWrite;
+                file.size = size;
+                file.checked.clear();
+            }
+            if (file.ini) {
+                *check = file.checked.insert(readKey(section, key)).second;
+            }
+            return file.ini;
+        }
+
+        /**
+         * @brief Stop answering reads of a file from memory after it no longer matches Windows
+         */
+        void distrust(const char* path) {
+            std::lock_guard lock(filesMutex);
+            File& file = files[normalize(path)];
+            file.trusted = false;
+            file.ini = nullptr;
+        }
+
+        void invalidate(const char* path) {
+            if (path) {
+                std::lock_guard lock(filesMutex);
+                auto it = files.find(normalize(path));
+                if (it != files.end() && it->second.trusted) {
+                    files.erase(it);
+                }
+            }
+        }
+
+        void account(uint64_t start, bool cached) {
+            uint64_t elapsed = Hitch::now() - start;
+            if (!cached) {
+                passed++;
+                passedTime += elapsed;
+                return;
+            }
+            servedTime += elapsed;
+            if (++served % LOG_EVERY == 0) {
+                uint64_t calls = passed.load();
+                double original = calls ? passedTime.load() / (double)calls : 0.0;
+                double saved = (served.load() * original - servedTime.load()) / 1e6;
+                LOG("{} reads served from memory, {} passed on, {} parses, about {:.2f} ms saved",
+                    served.load(), calls, parses.load(), saved);
+            }
+        }
+
+        DWORD WINAPI hookedGetPrivateProfileStringA(LPCSTR lpAppName, LPCSTR lpKeyName, LPCSTR lpDefault,
+            LPSTR lpReturnedString, DWORD nSize, LPCSTR lpFileName)
+        {
+            uint64_t start = Hitch::now();
+            bool check;
+            auto ini = lookup(lpFileName, lpAppName, lpKeyName, &check);
+            if (!ini || check) {
+                DWORD result = originalGetString(lpAppName, lpKeyName, lpDefault, lpReturnedString, nSize, lpFileName);
+                account(start, false);
+                if (check) {
+                    std::string expected(nSize, '\0');
+                    DWORD length = ini->getString(lpAppName, lpKeyName, lpDefault, expected.data(), nSize);
+                    if (length != result || (lpReturnedString && memcmp(expected.data(), lpReturnedString, (std::min)(nSize, result + 1)))) {
+                        LOG("'{}' is not read the same as Windows reads it, passing its reads on", lpFileName);
+                        distrust(lpFileName);
+                    }
+                }
+                return result;
+            }
+            DWORD result = ini->getString(lpAppName, lpKeyName, lpDefault, lpReturnedString, nSize);
+            account(start, true);
+            return result;
+        }
+
+        UINT WINAPI hookedGetPrivateProfileIntA(LPCSTR lpAppName, LPCSTR lpKeyName, INT nDefault, LPCSTR lpFileName) {
+            uint64_t start = Hitch::now();
+            bool check;
+            auto ini = lookup(lpFileName, lpAppName, lpKeyName, &check);
+            if (!ini || check) {
+                UINT result = originalGetInt(lpAppName, lpKeyName, nDefault, lpFileName);
+                account(start, false);
+                if (check && ini->getInt(lpAppName, lpKeyName, nDefault) != result) {
+                    LOG("'{}' is not read the same as Windows reads it, passing its reads on", lpFileName);
+                    distrust(lpFileName);
+                }
+                return result;
+            }
+            UINT result = ini->getInt(lpAppName, lpKeyName, nDefault);
+            account(start, true);
+            return result;
+        }
+
+        BOOL WINAPI hookedWritePrivateProfileStringA(LPCSTR lpAppName, LPCSTR lpKeyName, LPCSTR lpString, LPCSTR lpFileName) {
+            BOOL result = originalWriteString(lpAppName, lpKeyName, lpString, lpFileName);
+            invalidate(lpFileName);
+            return result;
+        }
+
+        BOOL WINAPI hookedWritePrivateProfileSectionA(LPCSTR lpAppName, LPCSTR lpString, LPCSTR lpFileName) {
+            BOOL result = originalWriteSection(lpAppName, lpString, lpFileName);
+            invalidate(lpFileName);
+            return result;
+        }
+
+        BOOL WINAPI hookedWritePrivateProfileStructA(LPCSTR lpszSection, LPCSTR lpszKey, LPVOID lpStruct, UINT uSizeStruct,
+            LPCSTR szFile)
+        {
+            BOOL result = originalWriteStruct(lpszSection, lpszKey, lpStruct, uSizeStruct, szFile);
+            invalidate(szFile);
+            return result;
+        }
+    }
+
+    bool install(void* module) {
+        auto game = reinterpret_cast<HMODULE>(module);
+        // Writes are hooked first so that no read can be served from memory after a write it missed
+        Utils::hookImport(game, "kernel32.dll", "WritePrivateProfileStringA",
+            reinterpret_cast<void*>(&hookedWritePrivateProfileStringA), reinterpret_cast<void**>(&originalWriteString));
+        Utils::hookImport(game, "kernel32.dll", "WritePrivateProfileSectionA",
+            reinterpret_cast<void*>(&hookedWritePrivateProfileSectionA), reinterpret_cast<void**>(&originalWriteSection));
+        Utils::hookImport(game, "kernel32.dll", "WritePrivateProfileStructA",
+            reinterpret_cast<void*>(&hookedWritePrivateProfileStructA), reinterpret_cast<void**>(&originalWriteStruct));
+        bool strings = Utils::hookImport(game, "kernel32.dll", "GetPrivateProfileStringA",
+            reinterpret_cast<void*>(&hookedGetPrivateProfileStringA), reinterpret_cast<void**>(&originalGetString));
+        bool ints = Utils::hookImport(game, "kernel32.dll", "GetPrivateProfileIntA",
+            reinterpret_cast<void*>(&hookedGetPrivateProfileIntA), reinterpret_cast<void**>(&originalGetInt));
+        installed = strings || ints;
+        return installed;
+    }
+
+    void counters(std::vector<std::pair<std::string, uint64_t>>* counters) {
+        if (!installed) {
+            return;
+        }
+        counters->emplace_back("profileServed", served.load());
+        counters->emplace_back("profilePassed", passed.load());
+        counters->emplace_back("profileParses", parses.load());
+        counters->emplace_back("profileServedNs", servedTime.load());
+        counters->emplace_back("profilePassedNs", passedTime.load());
+    }
+}
@@ -0,0 +1,169 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2024 Dominik Protasewicz
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <cstdio>
+#include <filesystem>
+
+#if defined(_WIN32)
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+#include "savequeue.hpp"
+
+namespace SaveQueue
+{
+    static char fold(char c) {
+        return c >= 'A' && c <= 'Z' ? (char)(c - 'A' + 'a') : c;
+    }
+
+    bool matches(std::string_view pattern, std::string_view name) {
+        // Greedy matching that backtracks to the last star
+        size_t p = 0, n = 0, star = std::string_view::npos, resume = 0;
+        while (n < name.size()) {
+            if (p < pattern.size() && (pattern[p] == '?' || fold(pattern[p]) == fold(name[n]))) {
+                p++;
+                n++;
+            }
+            else if (p < pattern.size() && pattern[p] == '*') {
+                star = p++;
+                resume = n;
+            }
+            else if (star != std::string_view::npos) {
+                p = star + 1;
+                n = ++resume;
+            }
+            else {
+                return false;
+            }
+        }
+        while (p < pattern.size() && pattern[p] == '*') {
+            p++;
+        }
+        return p == pattern.size();
+    }
+
+    bool writeAtomic(const std::string& path, const std::vector<uint8_t>& data) {
+        std::string temporary = path + ".tmp";
+#if defined(_WIN32)
+        HANDLE file = CreateFileA(temporary.c_str(), GENERIC_WRITE, 0, nullptr, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+        if (file == INVALID_HANDLE_VALUE) {
+            return false;
+        }
+        DWORD written = 0;
+        bool ok = WriteFile(file, data.data(), (DWORD)data.size(), &written, nullptr) && written == data.size();
+        ok &= FlushFileBuffers(file) != FALSE;
+        CloseHandle(file);
+        ok = ok && MoveFileExA(temporary.c_str(), path.c_str(), MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH);
+#else
+        int file = open(temporary.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        if (file < 0) {
+            return false;
+        }
+        size_t done = 0;
+        while (done < data.size()) {
+            ssize_t count = write(file, data.data() + done, data.size() - done);
+            if (count <= 0) {
+                break;
+            }
+            done += (size_t)count;
+        }
+        bool ok = done == data.size() && fsync(file) == 0;
+        ok &= close(file) == 0;
+        ok = ok && rename(temporary.c_str(), path.c_str()) == 0;
+#endif
+        if (!ok) {
+            std::error_code ignored;
+            std::filesystem::remove(temporary, ignored);
+        }
+        return ok;
+    }
+
+    Writer::Writer(std::function<void(const Result&)> done) : done(std::move(done)), thread(&Writer::run, this) {}
+
+    Writer::~Writer() {
+        {
+            std::lock_guard lock(mutex);
+            stopping = true;
+        }
+        wake.notify_all();
+        thread.join();
+    }
+
+    void Writer::submit(std::string path, std::vector<uint8_t> data) {
+        {
+            std::lock_guard lock(mutex);
+            pendingPaths[path]++;
+            jobs.push_back({ std::move(path), std::move(data), std::chrono::steady_clock::now() });
+        }
+        wake.notify_one();
+    }
+
+    void Writer::wait(const std::string& path) {
+        std::unique_lock lock(mutex);
+        written.wait(lock, [&] { return !pendingPaths.contains(path); });
+    }
+
+    void Writer::waitAll() {
+        std::unique_lock lock(mutex);
+        written.wait(lock, [&] { return pendingPaths.empty(); });
+    }
+
+    bool Writer::pending(const std::string& path) {
+        std::lock_guard lock(mutex);
+        return pendingPaths.contains(path);
+    }
+
+    void Writer::run() {
+        std::unique_lock lock(mutex);
+        while (true) {
+            wake.wait(lock, [&] { return stopping || !jobs.empty(); });
+            // Pending saves are still written when stopping
+            if (jobs.empty()) {
+                return;
+            }
+            Job job = std::move(jobs.front());
+            jobs.pop_front();
+            lock.unlock();
+
+            auto start = std::chrono::steady_clock::now();
+            bool ok = writeAtomic(job.path, job.data);
+            auto end = std::chrono::steady_clock::now();
+            Result result{ job.path, job.data.size(),
+                (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(start - job.queued).count(),
+                (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count(), ok };
+            if (done) {
+                done(result);
+            }
+
+            lock.lock();
+            if (--pendingPaths[job.path] == 0) {
+                pendingPaths.erase(job.path);
+            }
+            written.notify_all();
+        }
+    }
+}
@@ -0,0 +1,385 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2024 Dominik Protasewicz
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <windows.h>
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <filesystem>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "spdlog/spdlog.h"
+
+#include "log.hpp"
+#include "utils.hpp"
+#include "savequeue.hpp"
+
+namespace SaveQueue
+{
+    namespace
+    {
+        using CreateFileA_t = HANDLE(WINAPI*)(LPCSTR, DWORD, DWORD, LPSECURITY_ATTRIBUTES, DWORD, DWORD, HANDLE);
+        using WriteFile_t = BOOL(WINAPI*)(HANDLE, LPCVOID, DWORD, LPDWORD, LPOVERLAPPED);
+        using ReadFile_t = BOOL(WINAPI*)(HANDLE, LPVOID, DWORD, LPDWORD, LPOVERLAPPED);
+        using SetFilePointer_t = DWORD(WINAPI*)(HANDLE, LONG, PLONG, DWORD);
+        using SetFilePointerEx_t = BOOL(WINAPI*)(HANDLE, LARGE_INTEGER, PLARGE_INTEGER, DWORD);
+        using GetFileSize_t = DWORD(WINAPI*)(HANDLE, LPDWORD);
+        using GetFileSizeEx_t = BOOL(WINAPI*)(HANDLE, PLARGE_INTEGER);
+        using FlushFileBuffers_t = BOOL(WINAPI*)(HANDLE);
+        using CloseHandle_t = BOOL(WINAPI*)(HANDLE);
+        using GetFileAttributesA_t = DWORD(WINAPI*)(LPCSTR);
+        using FindFirstFileA_t = HANDLE(WINAPI*)(LPCSTR, LPWIN32_FIND_DATAA);
+        using ExitProcess_t = void(WINAPI*)(UINT);
+        CreateFileA_t originalCreateFileA = CreateFileA;
+        WriteFile_t originalWriteFile = WriteFile;
+        ReadFile_t originalReadFile = ReadFile;
+        SetFilePointer_t originalSetFilePointer = SetFilePointer;
+        SetFilePointerEx_t originalSetFilePointerEx = SetFilePointerEx;
+        GetFileSize_t originalGetFileSize = GetFileSize;
+        GetFileSizeEx_t originalGetFileSizeEx = GetFileSizeEx;
+        FlushFileBuffers_t originalFlushFileBuffers = FlushFileBuffers;
+        CloseHandle_t originalCloseHandle = CloseHandle;
+        GetFileAttributesA_t originalGetFileAttributesA = GetFileAttributesA;
+        FindFirstFileA_t originalFindFirstFileA = FindFirstFileA;
+        ExitProcess_t originalExitProcess = ExitProcess;
+
+        /**
+         * @brief A save the game is writing, kept in memory until it is closed.
+         */
+        struct File {
+            std::string path;
+            std::vector<uint8_t> data;
+            size_t position = 0;
+            std::chrono::steady_clock::time_point opened;
+            uint64_t blockedNs = 0;
+        };
+
+        std::string pattern;
+        Writer* writer = nullptr;
+        std::mutex filesMutex;
+        std::unordered_map<HANDLE, File> files;
+
+        std::atomic<uint64_t> saves = 0;
+        std::atomic<uint64_t> failures = 0;
+        std::atomic<uint64_t> blockedNs = 0;
+        std::atomic<uint64_t> writeNs = 0;
+
+        /**
+         * @brief Times an intercepted call on an in memory file towards what the game was blocked for.
+         */
+        struct Blocked {
+            File& file;
+            std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+            ~Blocked() {
+                file.blockedNs += (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(
+                    std::chrono::steady_clock::now() - start).count();
+            }
+        };
+
+        bool isSave(LPCSTR path) {
+            return path && matches(pattern, std::filesystem::path(path).filename().string());
+        }
+
+        /**
+         * @brief Key a save path the way the writer knows it
+         */
+        std::string absolute(LPCSTR path) {
+            std::error_code error;
+            auto full = std::filesystem::absolute(path, error);
+            return error ? std::string(path) : full.string();
+        }
+
+        File* find(HANDLE handle) {
+            auto it = files.find(handle);
+            return it == files.end() ? nullptr : &it->second;
+        }
+
+        void done(const Result& result) {
+            saves++;
+            failures += !result.ok;
+            writeNs += result.writeNs;
+            LOG("'{}' ({} bytes) {} in {:.2f} ms on the writer thread, {:.2f} ms after it was queued",
+                result.path, result.bytes, result.ok ? "written" : "could not be written",
+                result.writeNs / 1e6, (result.queuedNs + result.writeNs) / 1e6);
+        }
+
+        HANDLE WINAPI hookedCreateFileA(LPCSTR lpFileName, DWORD dwDesiredAccess, DWORD dwShareMode,
+            LPSECURITY_ATTRIBUTES lpSecurityAttributes, DWORD dwCreationDisposition, DWORD dwFlagsAndAttributes,
+            HANDLE hTemplateFile)
+        {
+            if (!isSave(lpFileName)) {
+                return originalCreateFileA(lpFileName, dwDesiredAccess, dwShareMode, lpSecurityAttributes,
+                    dwCreationDisposition, dwFlagsAndAttributes, hTemplateFile);
+            }
+            auto start = std::chrono::steady_clock::now();
+            std::string path = absolute(lpFileName);
+            // Only writes replacing the whole file can be held in memory, anything else sees the file on disk
+            bool replaces = (dwDesiredAccess & GENERIC_WRITE) &&
+                (dwCreationDisposition == CREATE_ALWAYS || dwCreationDisposition == TRUNCATE_EXISTING);
+            if (!replaces || (dwFlagsAndAttributes & FILE_FLAG_OVERLAPPED)) {
+                writer->wait(path);
+                return originalCreateFileA(lpFileName, dwDesiredAccess, dwShareMode, lpSecurityAttributes,
+                    dwCreationDisposition, dwFlagsAndAttributes, hTemplateFile);
+            }
+
+            bool exists = originalGetFileAttributesA(lpFileName) != INVALID_FILE_ATTRIBUTES || writer->pending(path);
+            if (dwCreationDisposition == TRUNCATE_EXISTING && !exists) {
+                return originalCreateFileA(lpFileName, dwDesiredAccess, dwShareMode, lpSecurityAttributes,
+                    dwCreationDisposition, dwFlagsAndAttributes, hTemplateFile);
+            }
+            // A real handle so that anything not intercepted fails cleanly rather than crashing
+            HANDLE handle = CreateEventA(nullptr, TRUE, FALSE, nullptr);
+            if (!handle) {
+                return INVALID_HANDLE_VALUE;
+            }
+            std::lock_guard lock(filesMutex);
+            File& file = files[handle];
+            file.path = std::move(path);
+            file.opened = start;
+            file.blockedNs = (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(
+                std::chrono::steady_clock::now() - start).count();
+            SetLastError(exists && dwCreationDisposition == CREATE_ALWAYS ? ERROR_ALREADY_EXISTS : ERROR_SUCCESS);
+            return handle;
+        }
+
+        BOOL WINAPI hookedWriteFile(HANDLE hFile, LPCVOID lpBuffer, DWORD nNumberOfBytesToWrite,
+            LPDWORD lpNumberOfBytesWritten, LPOVERLAPPED lpOverlapped)
+        {
+            {
+                std::lock_guard lock(filesMutex);
+                if (File* file = find(hFile)) {
+                    Blocked blocked{ *file };
+                    size_t position = lpOverlapped ?
+                        (size_t)((uint64_t)lpOverlapped->OffsetHigh << 32 | lpOverlapped->Offset) : file->position;
+                    if (file->data.size() < position + nNumberOfBytesToWrite) {
+                        file->data.resize(position + nNumberOfBytesToWrite);
+                    }
+                    memcpy(file->data.data() + position, lpBuffer, nNumberOfBytesToWrite);
+                    file->position = position + nNumberOfBytesToWrite;
+                    if (lpNumberOfBytesWritten) {
+                        *lpNumberOfBytesWritten = nNumberOfBytesToWrite;
+                    }
+                    return TRUE;
+                }
+            }
+            return originalWriteFile(hFile, lpBuffer, nNumberOfBytesToWrite, lpNumberOfBytesWritten, lpOverlapped);
+        }
+
+        BOOL WINAPI hookedReadFile(HANDLE hFile, LPVOID lpBuffer, DWORD nNumberOfBytesToRead,
+            LPDWORD lpNumberOfBytesRead, LPOVERLAPPED lpOverlapped)
+        {
+            {
+                std::lock_guard lock(filesMutex);
+                if (File* file = find(hFile)) {
+                    Blocked blocked{ *file };
+                    size_t position = lpOverlapped ?
+                        (size_t)((uint64_t)lpOverlapped->OffsetHigh << 32 | lpOverlapped->Offset) : file->position;
+                    size_t count = position < file->data.size() ?
+                        (std::min)((size_t)nNumberOfBytesToRead, file->data.size() - position) : 0;
+                    memcpy(lpBuffer, file->data.data() + position, count);
+                    file->position = position + count;
+                    if (lpNumberOfBytesRead) {
+                        *lpNumberOfBytesRead = (DWORD)count;
+                    }
+                    return TRUE;
+                }
+            }
+            return originalReadFile(hFile, lpBuffer, nNumberOfBytesToRead, lpNumberOfBytesRead, lpOverlapped);
+        }
+
+        /**
+         * @brief Move the position of an in memory file
+         * @return false if it would move before the start of the file
+         */
+        bool seek(File* file, int64_t distance, DWORD method) {
+            int64_t origin = method == FILE_BEGIN ? 0 :
+                method == FILE_CURRENT ? (int64_t)file->position : (int64_t)file->data.size();
+            if (origin + distance < 0) {
+                SetLastError(ERROR_NEGATIVE_SEEK);
+                return false;
+            }
+            file->position = (size_t)(origin + distance);
+            SetLastError(ERROR_SUCCESS);
+            return true;
+        }
+
+        DWORD WINAPI hookedSetFilePointer(HANDLE hFile, LONG lDistanceToMove, PLONG lpDistanceToMoveHigh, DWORD dwMoveMethod) {
+            {
+                std::lock_guard lock(filesMutex);
+                if (File* file = find(hFile)) {
+                    int64_t distance = lpDistanceToMoveHigh ?
+                        (int64_t)((uint64_t)(uint32_t)*lpDistanceToMoveHigh << 32 | (uint32_t)lDistanceToMove) : lDistanceToMove;
+                    if (!seek(file, distance, dwMoveMethod)) {
+                        return INVALID_SET_FILE_POINTER;
+                    }
+                    if (lpDistanceToMoveHigh) {
+                        *lpDistanceToMoveHigh = (LONG)((uint64_t)file->position >> 32);
+                    }
+                    return (DWORD)file->position;
+                }
+            }
+            return originalSetFilePointer(hFile, lDistanceToMove, lpDistanceToMoveHigh, dwMoveMethod);
+        }
+
+        BOOL WINAPI hookedSetFilePointerEx(HANDLE hFile, LARGE_INTEGER liDistanceToMove, PLARGE_INTEGER lpNewFilePointer,
+            DWORD dwMoveMethod)
+        {
+            {
+                std::lock_guard lock(filesMutex);
+                if (File* file = find(hFile)) {
+                    if (!seek(file, liDistanceToMove.QuadPart, dwMoveMethod)) {
+                        return FALSE;
+                    }
+                    if (lpNewFilePointer) {
+                        lpNewFilePointer->QuadPart = (LONGLONG)file->position;
+                    }
+                    return TRUE;
+                }
+            }
+            return originalSetFilePointerEx(hFile, liDistanceToMove, lpNewFilePointer, dwMoveMethod);
+        }
+
+        DWORD WINAPI hookedGetFileSize(HANDLE hFile, LPDWORD lpFileSizeHigh) {
+            {
+                std::lock_guard lock(filesMutex);
+                if (File* file = find(hFile)) {
+                    if (lpFileSizeHigh) {
+                        *lpFileSizeHigh = (DWORD)((uint64_t)file->data.size() >> 32);
+                    }
+                    return (DWORD)file->data.size();
+                }
+            }
+            return originalGetFileSize(hFile, lpFileSizeHigh);
+        }
+
+        BOOL WINAPI hookedGetFileSizeEx(HANDLE hFile, PLARGE_INTEGER lpFileSize) {
+            {
+                std::lock_guard lock(filesMutex);
+                if (File* file = find(hFile)) {
+                    lpFileSize->QuadPart = (LONGLONG)file->data.size();
+                    return TRUE;
+                }
+            }
+            return originalGetFileSizeEx(hFile, lpFileSize);
+        }
+
+        BOOL WINAPI hookedFlushFileBuffers(HANDLE hFile) {
+            {
+                // The writer flushes the file before renaming it into place
+                std::lock_guard lock(filesMutex);
+                if (find(hFile)) {
+                    return TRUE;
+                }
+            }
+            return originalFlushFileBuffers(hFile);
+        }
+
+        BOOL WINAPI hookedCloseHandle(HANDLE hObject) {
+            File file;
+            {
+                std::lock_guard lock(filesMutex);
+                auto it = files.find(hObject);
+                if (it == files.end()) {
+                    return originalCloseHandle(hObject);
+                }
+                file = std::move(it->second);
+                files.erase(it);
+            }
+            auto start = std::chrono::steady_clock::now();
+            size_t bytes = file.data.size();
+            writer->submit(file.path, std::move(file.data));
+            BOOL result = originalCloseHandle(hObject);
+            file.blockedNs += (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(
+                std::chrono::steady_clock::now() - start).count();
+            blockedNs += file.blockedNs;
+            LOG("'{}' ({} bytes) queued, the game was blocked for {:.3f} ms by its file calls",
+                file.path, bytes, file.blockedNs / 1e6);
+            return result;
+        }
+
+        DWORD WINAPI hookedGetFileAttributesA(LPCSTR lpFileName) {
+            if (isSave(lpFileName)) {
+                writer->wait(absolute(lpFileName));
+            }
+            return originalGetFileAttributesA(lpFileName);
+        }
+
+        HANDLE WINAPI hookedFindFirstFileA(LPCSTR lpFileName, LPWIN32_FIND_DATAA lpFindFileData) {
+            // Listing may include any save, all of them have to be on disk first
+            writer->waitAll();
+            return originalFindFirstFileA(lpFileName, lpFindFileData);
+        }
+
+        void WINAPI hookedExitProcess(UINT uExitCode) {
+            writer->waitAll();
+            originalExitProcess(uExitCode);
+        }
+    }
+
+    bool install(void* module, const std::string& savePattern) {
+        pattern = savePattern;
+        // Never freed, saves may be pending until the very end of the process
+        writer = new Writer(done);
+
+        auto game = reinterpret_cast<HMODULE>(module);
+        struct {
+            const char* name;
+            void* replacement;
+            void** original;
+        } imports[] = {
+            { "GetFileAttributesA", reinterpret_cast<void*>(&hookedGetFileAttributesA), reinterpret_cast<void**>(&originalGetFileAttributesA) },
+            { "ReadFile", reinterpret_cast<void*>(&hookedReadFile), reinterpret_cast<void**>(&originalReadFile) },
+            { "WriteFile", reinterpret_cast<void*>(&hookedWriteFile), reinterpret_cast<void**>(&originalWriteFile) },
+            { "SetFilePointer", reinterpret_cast<void*>(&hookedSetFilePointer), reinterpret_cast<void**>(&originalSetFilePointer) },
+            { "SetFilePointerEx", reinterpret_cast<void*>(&hookedSetFilePointerEx), reinterpret_cast<void**>(&originalSetFilePointerEx) },
+            { "GetFileSize", reinterpret_cast<void*>(&hookedGetFileSize), reinterpret_cast<void**>(&originalGetFileSize) },
+            { "GetFileSizeEx", reinterpret_cast<void*>(&hookedGetFileSizeEx), reinterpret_cast<void**>(&originalGetFileSizeEx) },
+            { "FlushFileBuffers", reinterpret_cast<void*>(&hookedFlushFileBuffers), reinterpret_cast<void**>(&originalFlushFileBuffers) },
+            { "CloseHandle", reinterpret_cast<void*>(&hookedCloseHandle), reinterpret_cast<void**>(&originalCloseHandle) },
+            { "FindFirstFileA", reinterpret_cast<void*>(&hookedFindFirstFileA), reinterpret_cast<void**>(&originalFindFirstFileA) },
+            { "ExitProcess", reinterpret_cast<void*>(&hookedExitProcess), reinterpret_cast<void**>(&originalExitProcess) },
+            // Last, so no in memory file exists before everything using one is intercepted
+            { "CreateFileA", reinterpret_cast<void*>(&hookedCreateFileA), reinterpret_cast<void**>(&originalCreateFileA) },
+        };
+        // Functions the game does not import cannot be called with an in memory file either
+        bool created = false;
+        for (const auto& import : imports) {
+            created = Utils::hookImport(game, "kernel32.dll", import.name, import.replacement, import.original);
+        }
+        return created;
+    }
+
+    void counters(std::vector<std::pair<std::string, uint64_t>>* counters) {
+        if (!writer) {
+            return;
+        }
+        counters->emplace_back("saves", saves.load());
+        counters->emplace_back("saveFailures", failures.load());
+        counters->emplace_back("saveBlockedNs", blockedNs.load());
+        counters->emplace_back("saveWriteNs", writeNs.load());
+    }
+}
@@ -0,0 +1,323 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2024 Dominik Protasewicz
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <cstdint>
+#include <bit>
+#include <string>
+#include <string_view>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define SCANNER_SSE2
+#include <emmintrin.h>
+#endif
+
+#if defined(_WIN32)
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+#include "scanner.hpp"
+
+namespace Scanner
+{
+    static int hexDigit(char c) {
+        if (c >= '0' && c <= '9') return c - '0';
+        if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+        if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+        return -1;
+    }
+
+    /**
+     * @brief Parse a single byte token such as `8B`, `??`, `4?` or `?4`.
+     */
+    static bool parseByte(std::string_view token, uint8_t* value, uint8_t* mask) {
+        if (token == "?" || token == "??") {
+            *value = 0;
+            *mask = 0;
+            return true;
+        }
+        if (token.size() == 1) {
+            int digit = hexDigit(token[0]);
+            if (digit < 0) {
+                return false;
+            }
+            *value = (uint8_t)digit;
+            *mask = 0xFF;
+            return true;
+        }
+        if (token.size() != 2) {
+            return false;
+        }
+        *value = 0;
+        *mask = 0;
+        for (int i = 0; i < 2; i++) {
+            int shift = i == 0 ? 4 : 0;
+            if (token[i] == '?') {
+                continue;
+            }
+            int digit = hexDigit(token[i]);
+            if (digit < 0) {
+                return false;
+            }
+            *value |= (uint8_t)(digit << shift);
+            *mask |= (uint8_t)(0xF << shift);
+        }
+        return true;
+    }
+
+    static Pattern fail(std::string_view token, const char* reason) {
+        Pattern failed;
+        failed.error = std::string(reason) + " '" + std::string(token) + "'";
+        return failed;
+    }
+
+    Pattern compile(const char* signature) {
+        Pattern pattern;
+        std::string_view text(signature);
+        size_t i = 0;
+
+        while (i < text.size()) {
+            if (text[i] == ' ') {
+                i++;
+                continue;
+            }
+
+            // Groups run to their closing bracket, plain bytes to the next space
+            size_t end;
+            if (text[i] == '(' || text[i] == '[') {
+                end = text.find(text[i] == '(' ? ')' : ']', i);
+                if (end == std::string_view::npos) {
+                    return fail(text.substr(i), "Unterminated group");
+                }
+                end++;
+            }
+            else {
+                end = text.find(' ', i);
+                if (end == std::string_view::npos) {
+                    end = text.size();
+                }
+            }
+            std::string_view token = text.substr(i, end - i);
+            i = end;
+
+            if (token.front() == '(') {
+                Alternation alternation{ pattern.size(), {}, {} };
+                std::string_view body = token.substr(1, token.size() - 2);
+                while (true) {
+                    size_t bar = body.find('|');
+                    std::string_view option = body.substr(0, bar);
+                    while (!option.empty() && option.front() == ' ') option.remove_prefix(1);
+                    while (!option.empty() && option.back() == ' ') option.remove_suffix(1);
+                    uint8_t value, mask;
+                    if (!parseByte(option, &value, &mask)) {
+                        return fail(token, "Bad alternation");
+                    }
+                    alternation.value.push_back(value);
+                    alternation.mask.push_back(mask);
+                    if (bar == std::string_view::npos) {
+                        break;
+                    }
+                    body.remove_prefix(bar + 1);
+                }
+                pattern.alternations.push_back(std::move(alternation));
+                pattern.value.push_back(0);
+                pattern.mask.push_back(0);
+            }
+            else if (token.front() == '[') {
+                std::string_view body = token.substr(1, token.size() - 2);
+                size_t colon = body.find(':');
+                if (colon == std::string_view::npos || colon == 0) {
+                    return fail(token, "Bad capture");
+                }
+                Capture capture{ std::string(body.substr(0, colon)), pattern.size(), 0, Capture::Kind::Value };
+                std::string_view kind = body.substr(colon + 1);
+                if (kind == "rel8" || kind == "rel32") {
+                    capture.kind = Capture::Kind::Relative;
+                    capture.size = kind == "rel8" ? 1 : 4;
+                }
+                else if (kind.size() == 1 && kind[0] >= '1' && kind[0] <= '8') {
+                    capture.size = (size_t)(kind[0] - '0');
+                }
+                else {
+                    return fail(token, "Bad capture");
+                }
+                pattern.value.insert(pattern.value.end(), capture.size, 0);
+                pattern.mask.insert(pattern.mask.end(), capture.size, 0);
+                pattern.captures.push_back(std::move(capture));
+            }
+            else {
+                uint8_t value, mask;
+                if (!parseByte(token, &value, &mask)) {
+                    return fail(token, "Bad byte");
+                }
+                pattern.value.push_back(value);
+                pattern.mask.push_back(mask);
+            }
+        }
+
+        for (size_t j = 0; j < pattern.size(); j++) {
+            if (pattern.mask[j] == 0xFF) {
+                if (pattern.firstAnchor == npos)
+                    pattern.firstAnchor = j;
+                pattern.lastAnchor = j;
+            }
+        }
+        return pattern;
+    }
+
+    static inline bool verify(const uint8_t* bytes, const Pattern& pattern) {
+        const uint8_t* value = pattern.value.data();
+        const uint8_t* mask = pattern.mask.data();
+        for (size_t j = 0; j < pattern.size(); j++) {
+            if ((bytes[j] & mask[j]) != value[j]) {
+                return false;
+            }
+        }
+        for (const auto& alternation : pattern.alternations) {
+            uint8_t byte = bytes[alternation.offset];
+            bool any = false;
+            for (size_t k = 0; k < alternation.value.size() && !any; k++) {
+                any = (byte & alternation.mask[k]) == alternation.value[k];
+            }
+            if (!any) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    size_t find(const uint8_t* data, size_t size, const Pattern& pattern, size_t start) {
+        size_t n = pattern.size();
+        if (n == 0 || size < n || start > size - n) {
+            return npos;
+        }
+        size_t last = size - n;
+        if (pattern.firstAnchor == npos) {
+            // Pattern has no fully specified byte to anchor on
+            for (size_t pos = start; pos <= last; ++pos) {
+                if (verify(data + pos, pattern)) {
+                    return pos;
+                }
+            }
+            return npos;
+        }
+
+        size_t a1 = pattern.firstAnchor;
+        size_t a2 = pattern.lastAnchor;
+        uint8_t b1 = pattern.value[a1];
+        uint8_t b2 = pattern.value[a2];
+        size_t pos = start;
+
+#ifdef SCANNER_SSE2
+        // Compare both anchors for 16 candidate positions at once and only verify the
+        // full pattern where both hit. The furthest load ends at pos + 15 + a2 which the
+        // loop condition keeps below size.
+        const __m128i v1 = _mm_set1_epi8((char)b1);
+        const __m128i v2 = _mm_set1_epi8((char)b2);
+        for (; last >= 15 && pos <= last - 15; pos += 16) {
+            __m128i c1 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + pos + a1));
+            __m128i c2 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + pos + a2));
+            unsigned bits = (unsigned)_mm_movemask_epi8(
+                _mm_and_si128(_mm_cmpeq_epi8(c1, v1), _mm_cmpeq_epi8(c2, v2)));
+            while (bits) {
+                size_t k = (size_t)std::countr_zero(bits);
+                if (verify(data + pos + k, pattern)) {
+                    return pos + k;
+                }
+                bits &= bits - 1;
+            }
+        }
+#endif
+
+        for (; pos <= last; ++pos) {
+            if (data[pos + a1] == b1 && data[pos + a2] == b2 && verify(data + pos, pattern)) {
+                return pos;
+            }
+        }
+        return npos;
+    }
+
+    void findAll(const uint8_t* data, size_t size, const Pattern& pattern, std::vector<size_t>* offsets) {
+        for (size_t pos = find(data, size, pattern); pos != npos; pos = find(data, size, pattern, pos + 1)) {
+            offsets->push_back(pos);
+        }
+    }
+
+    Match decode(const uint8_t* data, size_t offset, const Pattern& pattern, uint64_t base) {
+        Match match{ &pattern, base + offset, {} };
+        for (const auto& capture : pattern.captures) {
+            const uint8_t* bytes = data + offset + capture.offset;
+            uint64_t raw = 0;
+            for (size_t k = 0; k < capture.size; k++) {
+                raw |= (uint64_t)bytes[k] << (8 * k);
+            }
+            if (capture.kind == Capture::Kind::Relative) {
+                int64_t displacement = capture.size == 1 ? (int64_t)(int8_t)raw : (int64_t)(int32_t)raw;
+                raw = base + offset + capture.offset + capture.size + (uint64_t)displacement;
+            }
+            match.values.push_back(raw);
+        }
+        return match;
+    }
+
+    uint64_t Match::operator[](std::string_view name) const {
+        for (size_t k = 0; pattern && k < pattern->captures.size(); k++) {
+            if (pattern->captures[k].name == name) {
+                return values[k];
+            }
+        }
+        return 0;
+    }
+
+    bool prefetch(const std::vector<Range>& ranges) {
+        if (ranges.empty()) {
+            return true;
+        }
+#if defined(_WIN32)
+        // Looked up at runtime as it does not exist before Windows 8
+        using PrefetchVirtualMemory_t = BOOL(WINAPI*)(HANDLE, ULONG_PTR, PWIN32_MEMORY_RANGE_ENTRY, ULONG);
+        static auto prefetchVirtualMemory = reinterpret_cast<PrefetchVirtualMemory_t>(
+            GetProcAddress(GetModuleHandleA("kernel32.dll"), "PrefetchVirtualMemory"));
+        if (!prefetchVirtualMemory) {
+            return false;
+        }
+        std::vector<WIN32_MEMORY_RANGE_ENTRY> entries;
+        for (const auto& range : ranges) {
+            entries.push_back({ const_cast<void*>(range.address), range.size });
+        }
+        return prefetchVirtualMemory(GetCurrentProcess(), entries.size(), entries.data(), 0) != FALSE;
+#else
+        const uintptr_t pageSize = (uintptr_t)sysconf(_SC_PAGESIZE);
+        bool ok = true;
+        for (const auto& range : ranges) {
+            uintptr_t start = (uintptr_t)range.address & ~(pageSize - 1);
+            uintptr_t end = (uintptr_t)range.address + range.size;
+            ok &= madvise((void*)start, end - start, MADV_WILLNEED) == 0;
+        }
+        return ok;
+#endif
+    }
+}
@@ -0,0 +1,85 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2024 Dominik Protasewicz
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <windows.h>
+#include <array>
+#include <span>
+
+#include "spdlog/spdlog.h"
+
+#include "log.hpp"
+#include "utils.hpp"
+#include "profiler.hpp"
+#include "signatures.hpp"
+
+// Generated at build time by tools/resolver.cpp from the game executable. Builds without it,
+// such as ones configured without the game, simply always scan.
+#if __has_include("resolved.hpp")
+#include "resolved.hpp"
+#else
+namespace Signatures
+{
+    inline constexpr std::span<const Build> resolvedBuilds{};
+}
+#endif
+
+namespace Signatures
+{
+    const Scanner::Pattern& pattern(Id id) {
+        static const auto patterns = [] {
+            std::array<Scanner::Pattern, Count> compiled;
+            for (int i = 0; i < Count; i++) {
+                compiled[i] = Scanner::compile(list[i].pattern);
+            }
+            return compiled;
+        }();
+        return patterns[id];
+    }
+
+    void locate(void* module, Id id, std::vector<Scanner::Match>* matches) {
+        PROFILE_ZONE();
+        const auto& compiled = pattern(id);
+        auto base = reinterpret_cast<const uint8_t*>(module);
+
+        PeImage::Identity identity;
+        // The headers always fit in the first page, which the loader maps as a whole
+        if (PeImage::identify(base, 0x1000, &identity)) {
+            for (const auto& build : resolvedBuilds) {
+                uint32_t rva = build.rva[id];
+                if (build.identity != identity || rva == 0) {
+                    continue;
+                }
+                if (rva < identity.sizeOfImage && compiled.size() <= identity.sizeOfImage - rva &&
+                    Scanner::find(base + rva, compiled.size(), compiled) == 0)
+                {
+                    LOG("'{}' resolved at build time @ 0x{:x}", list[id].name, rva);
+                    matches->push_back(Scanner::decode(base, rva, compiled, (uint64_t)base));
+                    return;
+                }
+                LOG("'{}' no longer matches its build time RVA 0x{:x}, scanning", list[id].name, rva);
+            }
+        }
+        Utils::patternScan(module, compiled, matches);
+    }
+}
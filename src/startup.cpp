@@ -0,0 +1,169 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2024 Dominik Protasewicz
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <algorithm>
+#include <cstdio>
+
+#include "startup.hpp"
+
+namespace Startup
+{
+    void Timeline::step(const std::string& name, const char* category, uint64_t start, uint64_t stop, uint32_t thread) {
+        if (finished()) {
+            return;
+        }
+        std::lock_guard lock(mutex);
+        if (!end) {
+            steps.push_back({ name, category, start, stop, thread });
+        }
+    }
+
+    void Timeline::instant(const std::string& name, uint64_t time, uint32_t thread) {
+        step(name, nullptr, time, time, thread);
+    }
+
+    void Timeline::phase(const std::string& name, uint64_t start) {
+        if (finished()) {
+            return;
+        }
+        std::lock_guard lock(mutex);
+        if (!end) {
+            marks.push_back({ name, start });
+        }
+    }
+
+    void Timeline::read(uint64_t start, uint64_t stop, uint64_t bytes) {
+        if (finished()) {
+            return;
+        }
+        std::lock_guard lock(mutex);
+        if (!end) {
+            reads.push_back({ start, stop - start, bytes });
+        }
+    }
+
+    bool Timeline::finish(uint64_t time) {
+        std::lock_guard lock(mutex);
+        if (end) {
+            return false;
+        }
+        end = time;
+        done.store(true, std::memory_order_release);
+        return true;
+    }
+
+    bool Timeline::finished() const {
+        return done.load(std::memory_order_acquire);
+    }
+
+    std::vector<Phase> Timeline::phases() const {
+        std::lock_guard lock(mutex);
+        std::vector<Phase> ordered = marks;
+        std::stable_sort(ordered.begin(), ordered.end(), [](const Phase& a, const Phase& b) { return a.start < b.start; });
+        for (size_t i = 0; i < ordered.size(); i++) {
+            ordered[i].end = i + 1 < ordered.size() ? ordered[i + 1].start : (std::max)(end, ordered[i].start);
+        }
+        for (const auto& read : reads) {
+            // Last phase starting at or before the read
+            auto it = std::upper_bound(ordered.begin(), ordered.end(), read.start,
+                [](uint64_t time, const Phase& phase) { return time < phase.start; });
+            if (it == ordered.begin()) {
+                continue;
+            }
+            --it;
+            it->reads++;
+            it->readBytes += read.bytes;
+            it->readTime += read.duration;
+        }
+        return ordered;
+    }
+
+    /**
+     * @brief Quote a string for JSON, file names are full of backslashes
+     */
+    static std::string quote(const std::string& text) {
+        std::string quoted = "\"";
+        for (char c : text) {
+            if (c == '"' || c == '\\') {
+                quoted += '\\';
+                quoted += c;
+            }
+            else if ((unsigned char)c < 0x20) {
+                char escaped[8];
+                snprintf(escaped, sizeof(escaped), "\\u%04x", c);
+                quoted += escaped;
+            }
+            else {
+                quoted += c;
+            }
+        }
+        return quoted + "\"";
+    }
+
+    bool Timeline::write(const char* path) const {
+        std::vector<Phase> ordered = phases();
+        std::lock_guard lock(mutex);
+        FILE* file = fopen(path, "w");
+        if (!file) {
+            return false;
+        }
+
+        // Microseconds from the first phase, which is process creation when it is known
+        uint64_t origin = UINT64_MAX;
+        for (const auto& phase : ordered) {
+            origin = (std::min)(origin, phase.start);
+        }
+        for (const auto& step : steps) {
+            origin = (std::min)(origin, step.start);
+        }
+        auto us = [origin](uint64_t time) { return (time - origin) / 1e3; };
+
+        fprintf(file, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+        fprintf(file, "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":0,\"args\":{\"name\":\"Phases\"}}");
+        for (const auto& phase : ordered) {
+            fprintf(file, ",\n{\"name\":%s,\"cat\":\"phase\",\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f,\"pid\":1,\"tid\":0,"
+                "\"args\":{\"reads\":%llu,\"readBytes\":%llu,\"readMs\":%.3f}}",
+                quote(phase.name).c_str(), us(phase.start), (phase.end - phase.start) / 1e3,
+                (unsigned long long)phase.reads, (unsigned long long)phase.readBytes, phase.readTime / 1e6);
+        }
+        for (const auto& step : steps) {
+            if (step.category) {
+                fprintf(file, ",\n{\"name\":%s,\"cat\":%s,\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f,\"pid\":1,\"tid\":%u}",
+                    quote(step.name).c_str(), quote(step.category).c_str(), us(step.start), (step.end - step.start) / 1e3,
+                    step.thread);
+            }
+            else {
+                fprintf(file, ",\n{\"name\":%s,\"ph\":\"i\",\"s\":\"g\",\"ts\":%.3f,\"pid\":1,\"tid\":%u}",
+                    quote(step.name).c_str(), us(step.start), step.thread);
+            }
+        }
+        fprintf(file, "\n]}\n");
+        return fclose(file) == 0;
+    }
+
+    Timeline& timeline() {
+        static Timeline instance;
+        return instance;
+    }
+}
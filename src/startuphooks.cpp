@@ -0,0 +1,173 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2024 Dominik Protasewicz
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <windows.h>
+#include <d3d9.h>
+#include <filesystem>
+#include <string>
+
+#include "spdlog/spdlog.h"
+#include "safetyhook.hpp"
+
+#include "log.hpp"
+#include "utils.hpp"
+#include "d3d9hook.hpp"
+#include "startup.hpp"
+
+namespace Startup
+{
+    namespace
+    {
+        constexpr size_t CREATE_DEVICE = 16; // Index of IDirect3D9::CreateDevice in its vtable
+
+        std::string path;
+
+        using CreateFileA_t = HANDLE(WINAPI*)(LPCSTR, DWORD, DWORD, LPSECURITY_ATTRIBUTES, DWORD, DWORD, HANDLE);
+        using ReadFile_t = BOOL(WINAPI*)(HANDLE, LPVOID, DWORD, LPDWORD, LPOVERLAPPED);
+        using Direct3DCreate9_t = IDirect3D9* (WINAPI*)(UINT);
+        CreateFileA_t originalCreateFileA = nullptr;
+        ReadFile_t originalReadFile = nullptr;
+        Direct3DCreate9_t originalDirect3DCreate9 = nullptr;
+
+        SafetyHookInline createDeviceHook{};
+
+        HANDLE WINAPI hookedCreateFileA(LPCSTR lpFileName, DWORD dwDesiredAccess, DWORD dwShareMode,
+            LPSECURITY_ATTRIBUTES lpSecurityAttributes, DWORD dwCreationDisposition, DWORD dwFlagsAndAttributes,
+            HANDLE hTemplateFile)
+        {
+            // Imports stay redirected after startup, other hooks may have chained onto them since
+            if (timeline().finished()) {
+                return originalCreateFileA(lpFileName, dwDesiredAccess, dwShareMode, lpSecurityAttributes,
+                    dwCreationDisposition, dwFlagsAndAttributes, hTemplateFile);
+            }
+            uint64_t start = Hitch::now();
+            HANDLE handle = originalCreateFileA(lpFileName, dwDesiredAccess, dwShareMode, lpSecurityAttributes,
+                dwCreationDisposition, dwFlagsAndAttributes, hTemplateFile);
+            if (lpFileName) {
+                timeline().step(std::string("open ") + std::filesystem::path(lpFileName).filename().string(), "io",
+                    start, Hitch::now(), Hitch::threadId());
+            }
+            return handle;
+        }
+
+        BOOL WINAPI hookedReadFile(HANDLE hFile, LPVOID lpBuffer, DWORD nNumberOfBytesToRead,
+            LPDWORD lpNumberOfBytesRead, LPOVERLAPPED lpOverlapped)
+        {
+            if (timeline().finished()) {
+                return originalReadFile(hFile, lpBuffer, nNumberOfBytesToRead, lpNumberOfBytesRead, lpOverlapped);
+            }
+            uint64_t start = Hitch::now();
+            BOOL ok = originalReadFile(hFile, lpBuffer, nNumberOfBytesToRead, lpNumberOfBytesRead, lpOverlapped);
+            // Overlapped reads may not report a count, what was asked for is counted instead
+            DWORD read = lpNumberOfBytesRead && !lpOverlapped ? *lpNumberOfBytesRead : nNumberOfBytesToRead;
+            if (ok) {
+                timeline().read(start, Hitch::now(), read);
+            }
+            return ok;
+        }
+
+        HRESULT __stdcall createDevice(IDirect3D9* d3d, UINT adapter, D3DDEVTYPE deviceType, HWND focusWindow,
+            DWORD behaviorFlags, D3DPRESENT_PARAMETERS* presentationParameters, IDirect3DDevice9** device)
+        {
+            uint64_t start = Hitch::now();
+            timeline().phase("deviceCreation", start);
+            HRESULT result = createDeviceHook.stdcall<HRESULT>(d3d, adapter, deviceType, focusWindow, behaviorFlags,
+                presentationParameters, device);
+            uint64_t end = Hitch::now();
+            timeline().step("CreateDevice", "d3d9", start, end, Hitch::threadId());
+            timeline().phase("firstFrame", end);
+            if (SUCCEEDED(result) && device && *device) {
+                D3D9Hook::init(*device);
+            }
+            return result;
+        }
+
+        IDirect3D9* WINAPI hookedDirect3DCreate9(UINT sdkVersion) {
+            uint64_t start = Hitch::now();
+            IDirect3D9* d3d = originalDirect3DCreate9(sdkVersion);
+            timeline().step("Direct3DCreate9", "d3d9", start, Hitch::now(), Hitch::threadId());
+            if (d3d && !createDeviceHook) {
+                createDeviceHook = safetyhook::create_inline((*reinterpret_cast<void***>(d3d))[CREATE_DEVICE],
+                    reinterpret_cast<void*>(&createDevice));
+            }
+            return d3d;
+        }
+
+        void onPresent(IDirect3DDevice9*) {
+            // Dropped unless this is the first present, which then finishes the timeline
+            if (timeline().finished()) {
+                return;
+            }
+            uint64_t time = Hitch::now();
+            timeline().instant("first present", time, Hitch::threadId());
+            if (!timeline().finish(time)) {
+                return;
+            }
+            bool written = timeline().write(path.c_str());
+            for (const auto& phase : timeline().phases()) {
+                LOG("{} took {:.2f} ms, {} reads of {:.2f} MiB in {:.2f} ms", phase.name, (phase.end - phase.start) / 1e6,
+                    phase.reads, phase.readBytes / (1024.0 * 1024.0), phase.readTime / 1e6);
+            }
+            LOG("Startup timeline {} '{}'", written ? "written to" : "could not be written to", path);
+        }
+    }
+
+    uint64_t processCreation() {
+        FILETIME creation, exit, kernel, user, current;
+        if (!GetProcessTimes(GetCurrentProcess(), &creation, &exit, &kernel, &user)) {
+            return 0;
+        }
+        GetSystemTimeAsFileTime(&current);
+        uint64_t now = Hitch::now();
+        auto ticks = [](const FILETIME& time) { return ((uint64_t)time.dwHighDateTime << 32) | time.dwLowDateTime; };
+        uint64_t age = (ticks(current) - ticks(creation)) * 100;
+        return age < now ? now - age : 0;
+    }
+
+    bool install(void* module, uint64_t attach, const char* file) {
+        path = file;
+        uint64_t created = processCreation();
+        if (created) {
+            timeline().phase("loader", created);
+        }
+        timeline().phase("dllSetup", attach);
+        timeline().instant("DLL_PROCESS_ATTACH", attach, Hitch::threadId());
+
+        auto game = reinterpret_cast<HMODULE>(module);
+        bool opens = Utils::hookImport(game, "kernel32.dll", "CreateFileA",
+            reinterpret_cast<void*>(&hookedCreateFileA), reinterpret_cast<void**>(&originalCreateFileA));
+        bool reads = Utils::hookImport(game, "kernel32.dll", "ReadFile",
+            reinterpret_cast<void*>(&hookedReadFile), reinterpret_cast<void**>(&originalReadFile));
+        bool device = Utils::hookImport(game, "d3d9.dll", "Direct3DCreate9",
+            reinterpret_cast<void*>(&hookedDirect3DCreate9), reinterpret_cast<void**>(&originalDirect3DCreate9));
+        LOG("File opens {}, reads {}, device creation {}", opens ? "timed" : "not imported",
+            reads ? "timed" : "not imported", device ? "timed" : "not imported");
+
+        // Without the game's device creation Present has to be found with a throwaway device
+        if (!device && !D3D9Hook::init()) {
+            return false;
+        }
+        return D3D9Hook::onPresent(&onPresent);
+    }
+}
@@ -0,0 +1,160 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2024 Dominik Protasewicz
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <algorithm>
+
+#include "texturepool.hpp"
+
+namespace TexturePool
+{
+    static constexpr uint32_t fourcc(char a, char b, char c, char d) {
+        return (uint32_t)(uint8_t)a | (uint32_t)(uint8_t)b << 8 | (uint32_t)(uint8_t)c << 16 | (uint32_t)(uint8_t)d << 24;
+    }
+
+    /**
+     * @brief Bits per pixel of a format, of a 4x4 block divided by 16 for block compressed ones
+     */
+    static uint32_t bitsPerPixel(uint32_t format, bool* block) {
+        *block = false;
+        switch (format) {
+        case fourcc('D', 'X', 'T', '1'):
+            *block = true;
+            return 4;
+        case fourcc('D', 'X', 'T', '2'):
+        case fourcc('D', 'X', 'T', '3'):
+        case fourcc('D', 'X', 'T', '4'):
+        case fourcc('D', 'X', 'T', '5'):
+            *block = true;
+            return 8;
+        case 27: case 28: case 41: case 50: case 52:            // R3G3B2, A8, P8, L8, A4L4
+            return 8;
+        case 23: case 24: case 25: case 26: case 29: case 30:   // R5G6B5 to X4R4G4B4
+        case 40: case 51: case 60: case 61: case 80: case 81:   // A8P8, A8L8, V8U8, L6V5U5, D16, L16
+        case 111:                                               // R16F
+            return 16;
+        case 20:                                                // R8G8B8
+            return 24;
+        case 36: case 110: case 113: case 115:                  // A16B16G16R16, Q16W16V16U16, A16B16G16R16F, G32R32F
+            return 64;
+        case 116:                                               // A32B32G32R32F
+            return 128;
+        default:
+            return 32;
+        }
+    }
+
+    uint64_t textureBytes(const Key& key) {
+        bool block;
+        uint32_t bits = bitsPerPixel(key.format, &block);
+        uint32_t width = key.width;
+        uint32_t height = key.height;
+        uint64_t total = 0;
+        // No levels given means the whole chain down to 1x1
+        for (uint32_t level = 0; key.levels == 0 || level < key.levels; level++) {
+            uint64_t w = block ? ((uint64_t)width + 3) / 4 * 4 : width;
+            uint64_t h = block ? ((uint64_t)height + 3) / 4 * 4 : height;
+            total += w * h * bits / 8;
+            if (width == 1 && height == 1) {
+                break;
+            }
+            width = (std::max)(width / 2, 1u);
+            height = (std::max)(height / 2, 1u);
+        }
+        return total;
+    }
+
+    std::string formatName(uint32_t format) {
+        bool printable = true;
+        for (int shift = 0; shift < 32; shift += 8) {
+            char c = (char)(format >> shift);
+            printable &= (c >= '0' && c <= '9') || (c >= 'A' && c <= 'Z');
+        }
+        if (!printable) {
+            return std::to_string(format);
+        }
+        return std::string{ (char)format, (char)(format >> 8), (char)(format >> 16), (char)(format >> 24) };
+    }
+
+    size_t KeyHash::operator()(const Key& key) const {
+        uint64_t hash = key.device;
+        for (uint32_t value : { key.width, key.height, key.levels, key.format, key.pool, key.usage }) {
+            hash = (hash ^ value) * 0x100000001B3ull;
+        }
+        return (size_t)(hash ^ hash >> 32);
+    }
+
+    Pool::Pool(uint64_t budget) : budget(budget) {
+    }
+
+    void* Pool::take(const Key& key) {
+        auto it = free.find(key);
+        if (it == free.end() || it->second.empty()) {
+            keyStats[key].created++;
+            return nullptr;
+        }
+        // The most recently released one, the least likely to have been paged out
+        auto entry = it->second.back();
+        void* texture = entry->texture;
+        remove(entry);
+        keyStats[key].reused++;
+        return texture;
+    }
+
+    void Pool::give(const Key& key, void* texture, std::vector<void*>* evicted) {
+        KeyStats& stats = keyStats[key];
+        stats.released++;
+        uint64_t size = textureBytes(key);
+        if (size > budget) {
+            stats.evicted++;
+            evicted->push_back(texture);
+            return;
+        }
+        order.push_back({ key, texture, size });
+        free[key].push_back(std::prev(order.end()));
+        bytes += size;
+        while (bytes > budget) {
+            keyStats[order.front().key].evicted++;
+            evicted->push_back(order.front().texture);
+            remove(order.begin());
+        }
+    }
+
+    void Pool::drain(uint32_t pool, std::vector<void*>* removed) {
+        for (auto it = order.begin(); it != order.end();) {
+            auto next = std::next(it);
+            if (it->key.pool == pool) {
+                removed->push_back(it->texture);
+                remove(it);
+            }
+            it = next;
+        }
+    }
+
+    void Pool::remove(std::list<Entry>::iterator entry) {
+        auto& entries = free[entry->key];
+        entries.erase(std::find(entries.begin(), entries.end(), entry));
+        bytes -= entry->bytes;
+        order.erase(entry);
+    }
+}
@@ -0,0 +1,254 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2024 Dominik Protasewicz
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <windows.h>
+#include <d3d9.h>
+#include <algorithm>
+#include <atomic>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+#include "spdlog/spdlog.h"
+#include "safetyhook.hpp"
+
+#include "log.hpp"
+#include "d3d9hook.hpp"
+#include "texturepool.hpp"
+
+namespace TexturePool
+{
+    namespace
+    {
+        // Textures the runtime lets go of while bound are not released through the vtable
+        constexpr uint32_t SWEEP_FRAMES = 60;
+        constexpr size_t LOG_KEYS = 8;
+
+        SafetyHookInline createHook{};
+        SafetyHookInline resetHook{};
+        SafetyHookInline releaseHook{};
+        std::once_flag releaseHooked;
+
+        std::mutex poolMutex;
+        Pool* pool = nullptr;
+        struct Tracked {
+            Key key;
+            bool free;
+        };
+
+        // Every texture holding a reference of the pool, handed out or free
+        std::unordered_map<IDirect3DTexture9*, Tracked> live;
+
+        std::atomic<uint64_t> reused = 0;
+        std::atomic<uint64_t> created = 0;
+        std::atomic<uint64_t> evicted = 0;
+
+        uint32_t logEvery = 0;
+        uint32_t frames = 0;
+
+        /**
+         * @brief Destroy textures the pool let go of, outside of the pool's lock
+         */
+        void destroy(const std::vector<void*>& textures) {
+            for (void* texture : textures) {
+                releaseHook.stdcall<ULONG>(static_cast<IDirect3DTexture9*>(texture));
+            }
+            evicted += textures.size();
+        }
+
+        /**
+         * @brief Put a handed out texture only the pool still references on the free list
+         */
+        void reclaim(IDirect3DTexture9* texture, std::vector<void*>* evict) {
+            auto it = live.find(texture);
+            if (it == live.end() || it->second.free) {
+                return;
+            }
+            it->second.free = true;
+            size_t before = evict->size();
+            pool->give(it->second.key, texture, evict);
+            for (size_t i = before; i < evict->size(); i++) {
+                live.erase(static_cast<IDirect3DTexture9*>((*evict)[i]));
+            }
+        }
+
+        ULONG __stdcall release(IDirect3DTexture9* texture) {
+            ULONG count = releaseHook.stdcall<ULONG>(texture);
+            if (count != 1) {
+                return count;
+            }
+            std::vector<void*> evict;
+            {
+                std::lock_guard lock(poolMutex);
+                auto it = live.find(texture);
+                if (it == live.end() || it->second.free) {
+                    return count;
+                }
+                reclaim(texture, &evict);
+            }
+            destroy(evict);
+            // To the game the texture is gone
+            return 0;
+        }
+
+        /**
+         * @brief Reclaim handed out textures whose last reference the runtime dropped
+         */
+        void sweep() {
+            std::vector<void*> evict;
+            {
+                std::lock_guard lock(poolMutex);
+                std::vector<IDirect3DTexture9*> unused;
+                for (const auto& [texture, tracked] : live) {
+                    if (tracked.free) {
+                        continue;
+                    }
+                    texture->AddRef();
+                    if (releaseHook.stdcall<ULONG>(texture) == 1) {
+                        unused.push_back(texture);
+                    }
+                }
+                for (IDirect3DTexture9* texture : unused) {
+                    reclaim(texture, &evict);
+                }
+            }
+            destroy(evict);
+        }
+
+        HRESULT __stdcall createTexture(IDirect3DDevice9* device, UINT width, UINT height, UINT levels, DWORD usage,
+            D3DFORMAT format, D3DPOOL d3dPool, IDirect3DTexture9** texture, HANDLE* sharedHandle)
+        {
+            // Shared textures belong to more than this device
+            if (!texture || sharedHandle) {
+                return createHook.stdcall<HRESULT>(device, width, height, levels, usage, format, d3dPool, texture, sharedHandle);
+            }
+            Key key{ (uint64_t)reinterpret_cast<uintptr_t>(device), width, height, levels, (uint32_t)format,
+                (uint32_t)d3dPool, usage };
+            {
+                std::lock_guard lock(poolMutex);
+                if (auto free = static_cast<IDirect3DTexture9*>(pool->take(key))) {
+                    live[free].free = false;
+                    free->AddRef();
+                    if (d3dPool == D3DPOOL_MANAGED) {
+                        free->SetLOD(0);
+                    }
+                    *texture = free;
+                    reused++;
+                    return D3D_OK;
+                }
+            }
+
+            HRESULT result = createHook.stdcall<HRESULT>(device, width, height, levels, usage, format, d3dPool, texture, sharedHandle);
+            if (FAILED(result)) {
+                return result;
+            }
+            created++;
+            std::call_once(releaseHooked, [texture] {
+                void** methods = *reinterpret_cast<void***>(*texture);
+                releaseHook = safetyhook::create_inline(methods[2], reinterpret_cast<void*>(&release));
+                LOG("IDirect3DTexture9::Release @ 0x{:x} {}", (uintptr_t)methods[2],
+                    releaseHook ? "hooked" : "could not be hooked");
+            });
+            if (releaseHook) {
+                std::lock_guard lock(poolMutex);
+                (*texture)->AddRef();
+                live.emplace(*texture, Tracked{ key, false });
+            }
+            return result;
+        }
+
+        HRESULT __stdcall reset(IDirect3DDevice9* device, D3DPRESENT_PARAMETERS* params) {
+            // Textures in the default pool have to be gone before a reset can succeed
+            sweep();
+            std::vector<void*> drained;
+            {
+                std::lock_guard lock(poolMutex);
+                pool->drain(D3DPOOL_DEFAULT, &drained);
+                for (void* texture : drained) {
+                    live.erase(static_cast<IDirect3DTexture9*>(texture));
+                }
+            }
+            for (void* texture : drained) {
+                releaseHook.stdcall<ULONG>(static_cast<IDirect3DTexture9*>(texture));
+            }
+            return resetHook.stdcall<HRESULT>(device, params);
+        }
+
+        void report() {
+            std::lock_guard lock(poolMutex);
+            std::vector<std::pair<Key, KeyStats>> keys(pool->stats().begin(), pool->stats().end());
+            std::sort(keys.begin(), keys.end(), [](const auto& a, const auto& b) {
+                return a.second.created + a.second.reused > b.second.created + b.second.reused;
+            });
+            LOG("{} textures reused, {} created, {} evicted, {} free taking {:.1f} MiB",
+                reused.load(), created.load(), evicted.load(), pool->freeCount(), pool->freeBytes() / 1048576.0);
+            for (size_t i = 0; i < (std::min)(keys.size(), LOG_KEYS); i++) {
+                const auto& [key, stats] = keys[i];
+                LOG("{}x{} levels {} format {} pool {} usage 0x{:x}: {} created, {} reused, {} released, {} evicted",
+                    key.width, key.height, key.levels, formatName(key.format), key.pool, key.usage,
+                    stats.created, stats.reused, stats.released, stats.evicted);
+            }
+        }
+
+        void onPresent(IDirect3DDevice9*) {
+            frames++;
+            if (frames % SWEEP_FRAMES == 0) {
+                sweep();
+            }
+            if (logEvery && frames % logEvery == 0) {
+                report();
+            }
+        }
+    }
+
+    bool install(uint64_t budget, uint32_t logFrames) {
+        if (pool) {
+            return true;
+        }
+        if (!D3D9Hook::init()) {
+            return false;
+        }
+        // Never freed, textures are created and released until the very end of the process
+        pool = new Pool(budget);
+        logEvery = logFrames;
+
+        resetHook = safetyhook::create_inline(D3D9Hook::method(D3D9Hook::Reset), reinterpret_cast<void*>(&reset));
+        createHook = safetyhook::create_inline(D3D9Hook::method(D3D9Hook::CreateTexture),
+            reinterpret_cast<void*>(&createTexture));
+        LOG("CreateTexture {}, Reset {}", createHook ? "hooked" : "could not be hooked",
+            resetHook ? "hooked" : "could not be hooked");
+        return createHook && resetHook && D3D9Hook::onPresent(&onPresent);
+    }
+
+    void counters(std::vector<std::pair<std::string, uint64_t>>* counters) {
+        if (!pool) {
+            return;
+        }
+        counters->emplace_back("textureReused", reused.load());
+        counters->emplace_back("textureCreated", created.load());
+        counters->emplace_back("textureEvicted", evicted.load());
+        std::lock_guard lock(poolMutex);
+        counters->emplace_back("textureFreeBytes", pool->freeBytes());
+    }
+}
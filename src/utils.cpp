@@ -24,12 +24,17 @@
 
 #include <Windows.h>
 #include <vector>
+#include <algorithm>
 #include <format>
 #include <iostream>
 #include <cstdint>
 #include <TlHelp32.h>
 
+#include <Zydis/Zydis.h>
+
 #include "utils.hpp"
+#include "scanner.hpp"
+#include "profiler.hpp"
 
 namespace Utils
 {
@@ -73,18 +78,18 @@ namespace Utils
         return {};
     }
 
+    static std::vector<uint8_t> pattern_to_byte(const char* pattern) {
+        auto bytes = std::vector<uint8_t>{};
+        auto start = const_cast<char*>(pattern);
+        auto end = const_cast<char*>(pattern) + strlen(pattern);
+        for (auto current = start; current < end; ++current) {
+            bytes.push_back((uint8_t)strtoul(current, &current, 16));
+        }
+        return bytes;
+    }
+
     void patch(uintptr_t address, const char* pattern)
     {
-        static auto pattern_to_byte = [](const char* pattern) {
-            auto bytes = std::vector<uint8_t>{};
-            auto start = const_cast<char*>(pattern);
-            auto end = const_cast<char*>(pattern) + strlen(pattern);
-            for (auto current = start; current < end; ++current) {
-                bytes.push_back((uint8_t)strtoul(current, &current, 16));
-            }
-            return bytes;
-        };
-
         DWORD oldProtect;
         auto patternBytes = pattern_to_byte(pattern);
         VirtualProtect((LPVOID)address, patternBytes.size(), PAGE_EXECUTE_READWRITE, &oldProtect);
@@ -92,49 +97,357 @@ namespace Utils
         VirtualProtect((LPVOID)address, patternBytes.size(), oldProtect, &oldProtect);
     }
 
-    void patternScan(void* module, const char* signature, std::vector<uint64_t>* address)
+    /**
+     * @brief Suspend every thread of the process but the calling one.
+     * @details The thread ids are gathered and the handle vector reserved before the first
+     *      thread is suspended, a suspended thread may hold the heap lock.
+     */
+    static std::vector<HANDLE> suspendOtherThreads()
+    {
+        std::vector<DWORD> ids;
+        HANDLE snapshot = CreateToolhelp32Snapshot(TH32CS_SNAPTHREAD, 0);
+        if (snapshot == INVALID_HANDLE_VALUE) {
+            return {};
+        }
+        THREADENTRY32 entry{};
+        entry.dwSize = sizeof(entry);
+        for (BOOL more = Thread32First(snapshot, &entry); more; more = Thread32Next(snapshot, &entry)) {
+            if (entry.th32OwnerProcessID == GetCurrentProcessId() && entry.th32ThreadID != GetCurrentThreadId()) {
+                ids.push_back(entry.th32ThreadID);
+            }
+        }
+        CloseHandle(snapshot);
+
+        std::vector<HANDLE> threads;
+        threads.reserve(ids.size());
+        for (DWORD id : ids) {
+            HANDLE thread = OpenThread(THREAD_SUSPEND_RESUME | THREAD_GET_CONTEXT, FALSE, id);
+            if (thread && SuspendThread(thread) != (DWORD)-1) {
+                threads.push_back(thread);
+            }
+            else if (thread) {
+                CloseHandle(thread);
+            }
+        }
+        return threads;
+    }
+
+    static void resumeThreads(const std::vector<HANDLE>& threads)
+    {
+        for (auto thread : threads) {
+            ResumeThread(thread);
+            CloseHandle(thread);
+        }
+    }
+
+    /**
+     * @brief Length of the instruction at `code`, 0 if it does not decode.
+     */
+    static size_t instructionLength(const uint8_t* code, size_t size)
+    {
+        ZydisDecoder decoder;
+        ZydisDecoderInit(&decoder, ZYDIS_MACHINE_MODE_LEGACY_32, ZYDIS_STACK_WIDTH_32);
+        ZydisDecodedInstruction instruction;
+        ZydisDecodedOperand operands[ZYDIS_MAX_OPERAND_COUNT];
+        if (!ZYAN_SUCCESS(ZydisDecoderDecodeFull(&decoder, code, size, &instruction, operands))) {
+            return 0;
+        }
+        return instruction.length;
+    }
+
+    PatchPath patchAtomic(uintptr_t address, const char* pattern)
     {
-        static auto pattern_to_byte = [](const char* pattern) {
-            auto bytes = std::vector<int>{};
-            auto start = const_cast<char*>(pattern);
-            auto end = const_cast<char*>(pattern) + strlen(pattern);
-
-            for (auto current = start; current < end; ++current) {
-                if (*current == '?') {
-                    ++current;
-                    if (*current == '?')
-                        ++current;
-                    bytes.push_back(-1);
+        constexpr size_t MAX_INSTRUCTION = 15;
+        auto bytes = pattern_to_byte(pattern);
+        if (bytes.empty() || bytes.size() > 2 * MAX_INSTRUCTION) {
+            return PatchPath::Failed;
+        }
+
+        // Original instructions the patch touches, from `address` to the end of the one holding
+        // its last byte
+        auto code = reinterpret_cast<const uint8_t*>(address);
+        size_t span = 0;
+        size_t firstLength = 0;
+        while (span < bytes.size()) {
+            size_t length = instructionLength(code + span, MAX_INSTRUCTION);
+            if (length == 0) {
+                return PatchPath::Failed;
+            }
+            firstLength = firstLength ? firstLength : length;
+            span += length;
+        }
+        // The new code as it will read, the patch followed by what is left of the span
+        std::vector<uint8_t> patched(code, code + span + MAX_INSTRUCTION);
+        memcpy(patched.data(), bytes.data(), bytes.size());
+        size_t newLength = instructionLength(patched.data(), patched.size());
+
+        // Only a single instruction swapped for one of the same length can be seen whole or not
+        // at all, anything else needs every thread stopped outside of it
+        uintptr_t qword = address & ~(uintptr_t)7;
+        bool single = span == firstLength && newLength == firstLength;
+        if (single && address + bytes.size() <= qword + 8) {
+            DWORD oldProtect;
+            if (!VirtualProtect((LPVOID)qword, 8, PAGE_EXECUTE_READWRITE, &oldProtect)) {
+                return PatchPath::Failed;
+            }
+            // Merge the new bytes into the qword and swap it in whole, the bytes around the
+            // patch are written back unchanged
+            auto target = reinterpret_cast<volatile long long*>(qword);
+            long long expected = InterlockedCompareExchange64(target, 0, 0);
+            for (;;) {
+                long long desired = expected;
+                memcpy(reinterpret_cast<uint8_t*>(&desired) + (address - qword), bytes.data(), bytes.size());
+                long long previous = InterlockedCompareExchange64(target, desired, expected);
+                if (previous == expected) {
+                    break;
                 }
-                else {
-                    bytes.push_back(strtoul(current, &current, 16));
+                expected = previous;
+            }
+            VirtualProtect((LPVOID)qword, 8, oldProtect, &oldProtect);
+            FlushInstructionCache(GetCurrentProcess(), (LPCVOID)address, bytes.size());
+            return PatchPath::Atomic;
+        }
+
+        // A thread stopped anywhere past the first byte of the span, even on an instruction the
+        // patch keeps, could resume in the middle of a new instruction, so let it run on and try again
+        for (int attempt = 0; attempt < 100; attempt++) {
+            auto threads = suspendOtherThreads();
+            bool inside = false;
+            for (auto thread : threads) {
+                CONTEXT context{};
+                context.ContextFlags = CONTEXT_CONTROL;
+                if (!GetThreadContext(thread, &context) || (context.Eip > address && context.Eip < address + span)) {
+                    inside = true;
+                    break;
                 }
             }
-            return bytes;
-        };
+            if (!inside) {
+                DWORD oldProtect;
+                bool writable = VirtualProtect((LPVOID)address, bytes.size(), PAGE_EXECUTE_READWRITE, &oldProtect);
+                if (writable) {
+                    memcpy((LPVOID)address, bytes.data(), bytes.size());
+                    VirtualProtect((LPVOID)address, bytes.size(), oldProtect, &oldProtect);
+                    FlushInstructionCache(GetCurrentProcess(), (LPCVOID)address, bytes.size());
+                }
+                resumeThreads(threads);
+                return writable ? PatchPath::Frozen : PatchPath::Failed;
+            }
+            resumeThreads(threads);
+            Sleep(1);
+        }
+        return PatchPath::Failed;
+    }
+
+    void patternScan(void* module, const char* signature, std::vector<uint64_t>* address)
+    {
+        patternScan(module, Scanner::compile(signature), address);
+    }
 
+    void patternScan(void* module, const Scanner::Pattern& pattern, std::vector<uint64_t>* address)
+    {
+        PROFILE_ZONE();
         auto dosHeader = (PIMAGE_DOS_HEADER)module;
         auto ntHeaders = (PIMAGE_NT_HEADERS)((std::uint8_t*)module + dosHeader->e_lfanew);
 
         auto sizeOfImage = ntHeaders->OptionalHeader.SizeOfImage;
-        auto patternBytes = pattern_to_byte(signature);
         auto scanBytes = reinterpret_cast<std::uint8_t*>(module);
 
-        auto s = patternBytes.size();
-        auto d = patternBytes.data();
+        std::vector<size_t> offsets;
+        Scanner::findAll(scanBytes, sizeOfImage, pattern, &offsets);
+        for (auto offset : offsets) {
+            address->push_back((uint64_t)&scanBytes[offset]);
+        }
+    }
 
-        for (auto i = 0ul; i < sizeOfImage - s; ++i) {
-            bool found = true;
-            for (auto j = 0ul; j < s; ++j) {
-                if (scanBytes[i + j] != d[j] && d[j] != -1) {
-                    found = false;
-                    break;
+    void patternScan(void* module, const Scanner::Pattern& pattern, std::vector<Scanner::Match>* matches)
+    {
+        PROFILE_ZONE();
+        auto dosHeader = (PIMAGE_DOS_HEADER)module;
+        auto ntHeaders = (PIMAGE_NT_HEADERS)((std::uint8_t*)module + dosHeader->e_lfanew);
+
+        auto sizeOfImage = ntHeaders->OptionalHeader.SizeOfImage;
+        auto scanBytes = reinterpret_cast<std::uint8_t*>(module);
+
+        std::vector<size_t> offsets;
+        Scanner::findAll(scanBytes, sizeOfImage, pattern, &offsets);
+        for (auto offset : offsets) {
+            matches->push_back(Scanner::decode(scanBytes, offset, pattern, (uint64_t)scanBytes));
+        }
+    }
+
+    std::vector<Scanner::Range> sectionRanges(void* module)
+    {
+        auto base = reinterpret_cast<std::uint8_t*>(module);
+        auto dosHeader = (PIMAGE_DOS_HEADER)base;
+        auto ntHeaders = (PIMAGE_NT_HEADERS)(base + dosHeader->e_lfanew);
+
+        std::vector<Scanner::Range> ranges;
+        auto section = IMAGE_FIRST_SECTION(ntHeaders);
+        for (WORD i = 0; i < ntHeaders->FileHeader.NumberOfSections; i++, section++) {
+            size_t size = section->Misc.VirtualSize ? section->Misc.VirtualSize : section->SizeOfRawData;
+            if (size) {
+                ranges.push_back({ base + section->VirtualAddress, size });
+            }
+        }
+        return ranges;
+    }
+
+    bool hookImport(HMODULE module, const char* dllName, const char* functionName, void* replacement, void** original)
+    {
+        auto base = reinterpret_cast<std::uint8_t*>(module);
+        auto dosHeader = (PIMAGE_DOS_HEADER)base;
+        auto ntHeaders = (PIMAGE_NT_HEADERS)(base + dosHeader->e_lfanew);
+        auto& directory = ntHeaders->OptionalHeader.DataDirectory[IMAGE_DIRECTORY_ENTRY_IMPORT];
+        if (directory.VirtualAddress == 0) {
+            return false;
+        }
+
+        for (auto descriptor = (PIMAGE_IMPORT_DESCRIPTOR)(base + directory.VirtualAddress); descriptor->Name; descriptor++) {
+            if (_stricmp(reinterpret_cast<const char*>(base + descriptor->Name), dllName)) {
+                continue;
+            }
+            auto thunk = (PIMAGE_THUNK_DATA)(base + descriptor->FirstThunk);
+            auto lookup = (PIMAGE_THUNK_DATA)(base + (descriptor->OriginalFirstThunk ?
+                descriptor->OriginalFirstThunk : descriptor->FirstThunk));
+            for (; lookup->u1.AddressOfData; lookup++, thunk++) {
+                if (IMAGE_SNAP_BY_ORDINAL(lookup->u1.Ordinal)) {
+                    continue;
+                }
+                auto importByName = (PIMAGE_IMPORT_BY_NAME)(base + lookup->u1.AddressOfData);
+                if (strcmp(reinterpret_cast<const char*>(importByName->Name), functionName)) {
+                    continue;
+                }
+                DWORD oldProtect;
+                auto entry = reinterpret_cast<void**>(&thunk->u1.Function);
+                VirtualProtect(entry, sizeof(void*), PAGE_READWRITE, &oldProtect);
+                *original = *entry;
+                InterlockedExchangePointer(entry, replacement);
+                VirtualProtect(entry, sizeof(void*), oldProtect, &oldProtect);
+                return true;
+            }
+        }
+        return false;
+    }
+
+    bool isCdecl(const void* function, int arguments, std::string* reason)
+    {
+        // A decoder loop of the game's size ends well within this
+        constexpr size_t MAX_BYTES = 4096;
+        ZydisDecoder decoder;
+        ZydisDecoderInit(&decoder, ZYDIS_MACHINE_MODE_LEGACY_32, ZYDIS_STACK_WIDTH_32);
+        ZydisDecodedInstruction instruction;
+        ZydisDecodedOperand operands[ZYDIS_MAX_OPERAND_COUNT];
+
+        auto enclosing = [](ZydisRegister reg) {
+            return ZydisRegisterGetLargestEnclosing(ZYDIS_MACHINE_MODE_LEGACY_32, reg);
+        };
+        // Bytes pushed since entry, the first argument is at [esp + pushed + 4]
+        int64_t pushed = 0;
+        bool espKnown = true;
+        int64_t frame = 0;
+        bool framed = false;
+        // Once control flow leaves the straight line, or a call clobbers them, registers prove nothing
+        bool registersLive = true;
+        bool ecxWritten = false, edxWritten = false;
+
+        const uint8_t* code = (const uint8_t*)function;
+        for (size_t offset = 0; offset < MAX_BYTES; offset += instruction.length) {
+            if (!ZYAN_SUCCESS(ZydisDecoderDecodeFull(&decoder, code + offset, MAX_BYTES - offset, &instruction, operands))) {
+                *reason = std::format("undecodable instruction at +0x{:x}", offset);
+                return false;
+            }
+            if (instruction.mnemonic == ZYDIS_MNEMONIC_RET) {
+                if (instruction.operand_count_visible && operands[0].imm.value.u) {
+                    *reason = std::format("returns with ret {} at +0x{:x}, the callee cleans the stack",
+                        operands[0].imm.value.u, offset);
+                    return false;
+                }
+                return true;
+            }
+
+            // xor ecx, ecx and sub ecx, ecx only write their register
+            bool selfClear = instruction.operand_count_visible == 2 &&
+                (instruction.mnemonic == ZYDIS_MNEMONIC_XOR || instruction.mnemonic == ZYDIS_MNEMONIC_SUB) &&
+                operands[0].type == ZYDIS_OPERAND_TYPE_REGISTER && operands[1].type == ZYDIS_OPERAND_TYPE_REGISTER &&
+                operands[0].reg.value == operands[1].reg.value;
+            std::vector<ZydisRegister> read, written;
+            for (uint8_t i = 0; i < instruction.operand_count; i++) {
+                const ZydisDecodedOperand& operand = operands[i];
+                if (operand.type == ZYDIS_OPERAND_TYPE_REGISTER) {
+                    if ((operand.actions & ZYDIS_OPERAND_ACTION_MASK_READ) && !selfClear) {
+                        read.push_back(enclosing(operand.reg.value));
+                    }
+                    if (operand.actions & ZYDIS_OPERAND_ACTION_MASK_WRITE) {
+                        written.push_back(enclosing(operand.reg.value));
+                    }
+                }
+                else if (operand.type == ZYDIS_OPERAND_TYPE_MEMORY) {
+                    read.push_back(enclosing(operand.mem.base));
+                    read.push_back(enclosing(operand.mem.index));
+
+                    int64_t start = operand.mem.index != ZYDIS_REGISTER_NONE ? -1 :
+                        enclosing(operand.mem.base) == ZYDIS_REGISTER_ESP && espKnown ? pushed :
+                        enclosing(operand.mem.base) == ZYDIS_REGISTER_EBP && framed ? frame : -1;
+                    int64_t disp = operand.mem.disp.value;
+                    if (start >= 0 && disp >= start + 4 + 4 * (int64_t)arguments) {
+                        *reason = std::format("reads stack argument {} at +0x{:x}", (disp - start - 4) / 4 + 1, offset);
+                        return false;
+                    }
                 }
             }
-            if (found) {
-                address->push_back((uint64_t)&scanBytes[i]);
+            if (registersLive) {
+                for (ZydisRegister reg : read) {
+                    if ((reg == ZYDIS_REGISTER_ECX && !ecxWritten) || (reg == ZYDIS_REGISTER_EDX && !edxWritten)) {
+                        *reason = std::format("reads {} at +0x{:x} before writing it, arguments are passed in registers",
+                            ZydisRegisterGetString(reg), offset);
+                        return false;
+                    }
+                }
+                for (ZydisRegister reg : written) {
+                    ecxWritten |= reg == ZYDIS_REGISTER_ECX;
+                    edxWritten |= reg == ZYDIS_REGISTER_EDX;
+                }
+            }
+
+            switch (instruction.meta.category) {
+            case ZYDIS_CATEGORY_CALL:
+            case ZYDIS_CATEGORY_COND_BR:
+            case ZYDIS_CATEGORY_UNCOND_BR:
+                registersLive = false;
+                break;
+            default:
+                break;
+            }
+
+            // Follow esp through the prologue and calls, anything else writing it loses track
+            bool toEsp = instruction.operand_count_visible >= 1 && operands[0].type == ZYDIS_OPERAND_TYPE_REGISTER &&
+                operands[0].reg.value == ZYDIS_REGISTER_ESP;
+            bool immediate = instruction.operand_count_visible == 2 && operands[1].type == ZYDIS_OPERAND_TYPE_IMMEDIATE;
+            if (instruction.mnemonic == ZYDIS_MNEMONIC_PUSH) {
+                pushed += 4;
+            }
+            else if (instruction.mnemonic == ZYDIS_MNEMONIC_POP) {
+                pushed -= 4;
+                espKnown &= !toEsp;
+            }
+            else if (toEsp && immediate && instruction.mnemonic == ZYDIS_MNEMONIC_SUB) {
+                pushed += operands[1].imm.value.s;
+            }
+            else if (toEsp && immediate && instruction.mnemonic == ZYDIS_MNEMONIC_ADD) {
+                pushed -= operands[1].imm.value.s;
+            }
+            else if (std::find(written.begin(), written.end(), ZYDIS_REGISTER_ESP) != written.end() &&
+                instruction.meta.category != ZYDIS_CATEGORY_CALL) {
+                espKnown = false;
+            }
+            if (instruction.mnemonic == ZYDIS_MNEMONIC_MOV && instruction.operand_count_visible == 2 &&
+                operands[0].type == ZYDIS_OPERAND_TYPE_REGISTER && operands[0].reg.value == ZYDIS_REGISTER_EBP) {
+                framed = espKnown && operands[1].type == ZYDIS_OPERAND_TYPE_REGISTER && operands[1].reg.value == ZYDIS_REGISTER_ESP;
+                frame = pushed;
             }
         }
+        *reason = std::format("no ret within {} bytes", MAX_BYTES);
+        return false;
     }
 
     DWORD findProcessID(const char* targetProcess)
@@ -0,0 +1,237 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2024 Dominik Protasewicz
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <windows.h>
+#include <d3d9.h>
+#include <atomic>
+#include <cstring>
+
+#include "spdlog/spdlog.h"
+#include "safetyhook.hpp"
+
+#include "log.hpp"
+#include "d3d9hook.hpp"
+#include "batcher.hpp"
+#include "vertexring.hpp"
+
+namespace VertexRing
+{
+    namespace
+    {
+        SafetyHookInline drawHook{};
+        SafetyHookInline indexedHook{};
+        SafetyHookInline resetHook{};
+
+        // Only touched on the render thread
+        Ring* vertexRing = nullptr;
+        Ring* indexRing = nullptr;
+        IDirect3DDevice9* owner = nullptr;
+        IDirect3DVertexBuffer9* vertexBuffer = nullptr;
+        IDirect3DIndexBuffer9* indexBuffer = nullptr;
+        bool failed = false;
+
+        std::atomic<uint64_t> draws = 0;
+        std::atomic<uint64_t> passed = 0;
+        std::atomic<uint64_t> bytes = 0;
+        std::atomic<uint64_t> discards = 0;
+
+        uint32_t logEvery = 0;
+        uint32_t frames = 0;
+        uint64_t loggedBytes = 0;
+        uint64_t loggedDiscards = 0;
+        uint64_t loggedPassed = 0;
+
+        void release() {
+            if (vertexBuffer) {
+                vertexBuffer->Release();
+                vertexBuffer = nullptr;
+            }
+            if (indexBuffer) {
+                indexBuffer->Release();
+                indexBuffer = nullptr;
+            }
+            owner = nullptr;
+            failed = false;
+        }
+
+        /**
+         * @brief Make sure the rings exist on `device`
+         * @return false if they could not be created, draws are then passed on until the next reset
+         */
+        bool create(IDirect3DDevice9* device) {
+            if (owner == device) {
+                return !failed;
+            }
+            release();
+            owner = device;
+            DWORD usage = D3DUSAGE_DYNAMIC | D3DUSAGE_WRITEONLY;
+            D3DDEVICE_CREATION_PARAMETERS params{};
+            if (SUCCEEDED(device->GetCreationParameters(&params)) &&
+                (params.BehaviorFlags & (D3DCREATE_SOFTWARE_VERTEXPROCESSING | D3DCREATE_MIXED_VERTEXPROCESSING)))
+            {
+                usage |= D3DUSAGE_SOFTWAREPROCESSING;
+            }
+            HRESULT result = device->CreateVertexBuffer(vertexRing->size(), usage, 0, D3DPOOL_DEFAULT, &vertexBuffer, nullptr);
+            if (SUCCEEDED(result)) {
+                result = device->CreateIndexBuffer(indexRing->size(), usage, D3DFMT_INDEX16, D3DPOOL_DEFAULT, &indexBuffer, nullptr);
+            }
+            if (FAILED(result)) {
+                LOG("Could not create the rings: 0x{:x}, passing draws on", (uint32_t)result);
+                release();
+                owner = device;
+                failed = true;
+                return false;
+            }
+            vertexRing->reset();
+            indexRing->reset();
+            return true;
+        }
+
+        /**
+         * @brief Copy data to the next span of a ring
+         *
+         * @param offset Receives the offset the data was copied to
+         * @return false if it does not fit or the buffer could not be locked
+         */
+        template <typename Buffer>
+        bool stream(Buffer* buffer, Ring* ring, const void* data, uint64_t size, uint32_t alignment, uint32_t* offset) {
+            Ring::Span span;
+            if (size > ring->size() || !ring->allocate((uint32_t)size, alignment, &span)) {
+                return false;
+            }
+            void* target = nullptr;
+            if (FAILED(buffer->Lock(span.offset, (UINT)size, &target, span.discard ? D3DLOCK_DISCARD : D3DLOCK_NOOVERWRITE))) {
+                ring->reset();
+                return false;
+            }
+            memcpy(target, data, (size_t)size);
+            buffer->Unlock();
+            bytes += size;
+            discards += span.discard;
+            *offset = span.offset;
+            return true;
+        }
+
+        HRESULT __stdcall drawPrimitiveUP(IDirect3DDevice9* device, D3DPRIMITIVETYPE type, UINT primitives,
+            const void* vertices, UINT stride)
+        {
+            uint64_t size = (uint64_t)Batch::vertexCount((Batch::Primitive)type, primitives) * stride;
+            uint32_t offset;
+            if (!vertices || size == 0 || !create(device) || !stream(vertexBuffer, vertexRing, vertices, size, stride, &offset)) {
+                passed++;
+                return drawHook.stdcall<HRESULT>(device, type, primitives, vertices, stride);
+            }
+            draws++;
+            device->SetStreamSource(0, vertexBuffer, 0, stride);
+            HRESULT result = device->DrawPrimitive(type, offset / stride, primitives);
+            // User pointer draws leave stream 0 unset
+            device->SetStreamSource(0, nullptr, 0, 0);
+            return result;
+        }
+
+        HRESULT __stdcall drawIndexedPrimitiveUP(IDirect3DDevice9* device, D3DPRIMITIVETYPE type, UINT minVertexIndex,
+            UINT numVertices, UINT primitives, const void* indices, D3DFORMAT indexFormat, const void* vertices, UINT stride)
+        {
+            uint64_t indexBytes = (uint64_t)Batch::vertexCount((Batch::Primitive)type, primitives) * sizeof(uint16_t);
+            uint32_t vertexOffset, indexOffset;
+            // Only the vertices the indices may refer to are streamed
+            bool streamed = indexFormat == D3DFMT_INDEX16 && indices && vertices && stride && numVertices && indexBytes &&
+                create(device) &&
+                stream(vertexBuffer, vertexRing, static_cast<const uint8_t*>(vertices) + (size_t)minVertexIndex * stride,
+                    (uint64_t)numVertices * stride, stride, &vertexOffset) &&
+                stream(indexBuffer, indexRing, indices, indexBytes, sizeof(uint16_t), &indexOffset);
+            if (!streamed) {
+                passed++;
+                return indexedHook.stdcall<HRESULT>(device, type, minVertexIndex, numVertices, primitives, indices,
+                    indexFormat, vertices, stride);
+            }
+            draws++;
+            device->SetStreamSource(0, vertexBuffer, 0, stride);
+            device->SetIndices(indexBuffer);
+            HRESULT result = device->DrawIndexedPrimitive(type, (INT)(vertexOffset / stride) - (INT)minVertexIndex,
+                minVertexIndex, numVertices, indexOffset / sizeof(uint16_t), primitives);
+            // User pointer draws leave stream 0 and the indices unset
+            device->SetStreamSource(0, nullptr, 0, 0);
+            device->SetIndices(nullptr);
+            return result;
+        }
+
+        HRESULT __stdcall reset(IDirect3DDevice9* device, D3DPRESENT_PARAMETERS* params) {
+            // Buffers in the default pool have to be gone before a reset can succeed
+            release();
+            return resetHook.stdcall<HRESULT>(device, params);
+        }
+
+        void onPresent(IDirect3DDevice9*) {
+            if (!logEvery || ++frames < logEvery) {
+                return;
+            }
+            uint64_t streamed = bytes.load();
+            uint64_t wraps = discards.load();
+            uint64_t passedOn = passed.load();
+            LOG("{:.1f} KiB streamed per frame over {} frames, {} discards, {} draws passed on",
+                (streamed - loggedBytes) / 1024.0 / frames, frames, wraps - loggedDiscards, passedOn - loggedPassed);
+            loggedBytes = streamed;
+            loggedDiscards = wraps;
+            loggedPassed = passedOn;
+            frames = 0;
+        }
+    }
+
+    bool install(uint32_t vertexBytes, uint32_t indexBytes, uint32_t logFrames) {
+        if (vertexRing) {
+            return true;
+        }
+        if (!D3D9Hook::init()) {
+            return false;
+        }
+        // Never freed, the render thread uses them until the very end of the process
+        vertexRing = new Ring(vertexBytes);
+        indexRing = new Ring(indexBytes);
+        logEvery = logFrames;
+
+        resetHook = safetyhook::create_inline(D3D9Hook::method(D3D9Hook::Reset), reinterpret_cast<void*>(&reset));
+        if (!resetHook) {
+            LOG("Reset could not be hooked");
+            return false;
+        }
+        drawHook = safetyhook::create_inline(D3D9Hook::method(D3D9Hook::DrawPrimitiveUP),
+            reinterpret_cast<void*>(&drawPrimitiveUP));
+        indexedHook = safetyhook::create_inline(D3D9Hook::method(D3D9Hook::DrawIndexedPrimitiveUP),
+            reinterpret_cast<void*>(&drawIndexedPrimitiveUP));
+        LOG("DrawPrimitiveUP {}, DrawIndexedPrimitiveUP {}", drawHook ? "hooked" : "could not be hooked",
+            indexedHook ? "hooked" : "could not be hooked");
+        return (drawHook || indexedHook) && D3D9Hook::onPresent(&onPresent);
+    }
+
+    void counters(std::vector<std::pair<std::string, uint64_t>>* counters) {
+        if (!vertexRing) {
+            return;
+        }
+        counters->emplace_back("ringDraws", draws.load());
+        counters->emplace_back("ringPassed", passed.load());
+        counters->emplace_back("ringBytes", bytes.load());
+        counters->emplace_back("ringDiscards", discards.load());
+    }
+}
@@ -0,0 +1,222 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2024 Dominik Protasewicz
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/**
+ * @file batchcheck.cpp
+ * @brief Differential check and draw count report for the draw batcher.
+ *
+ * Synthetic UI frames, quads drawn as strips, fans and lists between state changes along with
+ * lines and larger meshes, are drawn once straight into a recording sink and once through a
+ * `Batch::Batcher` into another. Both recordings are expanded into triangles and must match
+ * triangle for triangle, including winding, between every two state changes or the run fails.
+ * Reports the draw calls of both and the time the batcher takes per draw.
+ *
+ * Usage: batchcheck [--frames <count>] [--small <vertices>] [--capacity <vertices>]
+ */
+
+#include <cstdio>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <chrono>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "batcher.hpp"
+
+namespace
+{
+    /**
+     * @brief One call of a frame, a draw or a state change.
+     */
+    struct Call {
+        bool state;
+        Batch::Primitive type;
+        uint32_t primitives;
+        uint32_t stride;
+        std::vector<uint8_t> vertices;
+    };
+
+    /**
+     * @brief Records what reaches the device, expanded into triangles per state.
+     */
+    class Recording : public Batch::Sink {
+    public:
+        explicit Recording(uint32_t capacity) : capacity(capacity) {}
+
+        void draw(Batch::Primitive type, uint32_t primitives, const void* vertices, uint32_t stride) override {
+            draws++;
+            oversized += Batch::vertexCount(type, primitives) > capacity;
+            auto bytes = static_cast<const uint8_t*>(vertices);
+            auto vertex = [&](uint32_t index) {
+                current.insert(current.end(), bytes + (size_t)index * stride, bytes + (size_t)(index + 1) * stride);
+            };
+            for (uint32_t i = 0; i < primitives; i++) {
+                switch (type) {
+                case Batch::TriangleList: vertex(3 * i); vertex(3 * i + 1); vertex(3 * i + 2); break;
+                case Batch::TriangleStrip:
+                    vertex(i & 1 ? i + 1 : i); vertex(i & 1 ? i : i + 1); vertex(i + 2); break;
+                case Batch::TriangleFan: vertex(0); vertex(i + 1); vertex(i + 2); break;
+                default: break;
+                }
+            }
+            // Everything else is compared as drawn
+            if (type != Batch::TriangleList && type != Batch::TriangleStrip && type != Batch::TriangleFan) {
+                current.push_back((uint8_t)type);
+                current.insert(current.end(), bytes, bytes + (size_t)Batch::vertexCount(type, primitives) * stride);
+            }
+        }
+
+        void state() {
+            epochs.push_back(std::move(current));
+            current.clear();
+        }
+
+        uint64_t draws = 0;
+        uint64_t oversized = 0;     // Draws of more vertices than a batch holds
+        std::vector<std::vector<uint8_t>> epochs;
+
+    private:
+        uint32_t capacity;
+        std::vector<uint8_t> current;
+    };
+
+    Call quad(std::mt19937& rng, uint32_t stride) {
+        static const Batch::Primitive types[] = { Batch::TriangleStrip, Batch::TriangleFan, Batch::TriangleList };
+        Call call{ false, types[rng() % 3], 2, stride, {} };
+        call.vertices.resize((size_t)Batch::vertexCount(call.type, 2) * stride);
+        for (auto& byte : call.vertices) {
+            byte = (uint8_t)rng();
+        }
+        return call;
+    }
+
+    std::vector<Call> synthesize(size_t frames, uint32_t seed) {
+        std::mt19937 rng(seed);
+        std::vector<Call> calls;
+        for (size_t frame = 0; frame < frames; frame++) {
+            uint32_t stride = rng() % 4 == 0 ? 20 : 28;
+            for (int group = 0; group < 40; group++) {
+                // Runs of sprites sharing a texture, text being the longest
+                int run = rng() % 8 == 0 ? 60 : 1 + rng() % 12;
+                for (int i = 0; i < run; i++) {
+                    calls.push_back(quad(rng, stride));
+                }
+                if (rng() % 10 == 0) {
+                    Call mesh{ false, Batch::TriangleList, (uint32_t)(100 + rng() % 200), stride, {} };
+                    mesh.vertices.resize((size_t)mesh.primitives * 3 * stride, (uint8_t)rng());
+                    calls.push_back(std::move(mesh));
+                }
+                if (rng() % 12 == 0) {
+                    Call line{ false, Batch::LineStrip, 4, stride, {} };
+                    line.vertices.resize((size_t)5 * stride, (uint8_t)rng());
+                    calls.push_back(std::move(line));
+                }
+                if (rng() % 16 == 0) {
+                    stride = stride == 20 ? 28 : 20;
+                }
+                calls.push_back({ true, Batch::TriangleList, 0, 0, {} });
+            }
+        }
+        return calls;
+    }
+
+    void usage() {
+        fprintf(stderr, "Usage: batchcheck [--frames <count>] [--small <vertices>] [--capacity <vertices>]\n");
+        exit(1);
+    }
+}
+
+int main(int argc, char** argv) {
+    size_t frames = 2000;
+    uint32_t small = 64;
+    uint32_t capacity = 4096;
+    for (int arg = 1; arg < argc; arg++) {
+        if (arg + 1 < argc && !strcmp(argv[arg], "--frames")) {
+            frames = strtoull(argv[++arg], nullptr, 10);
+        }
+        else if (arg + 1 < argc && !strcmp(argv[arg], "--small")) {
+            small = (uint32_t)strtoul(argv[++arg], nullptr, 10);
+        }
+        else if (arg + 1 < argc && !strcmp(argv[arg], "--capacity")) {
+            capacity = (uint32_t)strtoul(argv[++arg], nullptr, 10);
+        }
+        else {
+            usage();
+        }
+    }
+
+    std::vector<Call> calls = synthesize(frames, 1);
+    Recording direct(capacity), batched(capacity);
+    Batch::Batcher batcher(&batched, small, capacity);
+    for (const auto& call : calls) {
+        if (call.state) {
+            direct.state();
+            batcher.flush();
+            batched.state();
+            continue;
+        }
+        direct.draw(call.type, call.primitives, call.vertices.data(), call.stride);
+        batcher.draw(call.type, call.primitives, call.vertices.data(), call.stride);
+    }
+
+    size_t mismatches = 0;
+    for (size_t i = 0; i < direct.epochs.size(); i++) {
+        mismatches += i >= batched.epochs.size() || direct.epochs[i] != batched.epochs[i];
+    }
+
+    // Timed apart from the recording so only the batcher's own work is measured
+    struct Discard : Batch::Sink {
+        void draw(Batch::Primitive, uint32_t, const void*, uint32_t) override {}
+    } discard;
+    Batch::Batcher timed(&discard, small, capacity);
+    auto start = std::chrono::steady_clock::now();
+    for (const auto& call : calls) {
+        if (call.state) {
+            timed.flush();
+        }
+        else {
+            timed.draw(call.type, call.primitives, call.vertices.data(), call.stride);
+        }
+    }
+    double elapsed = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+
+    const auto& stats = batcher.stats();
+    printf("%zu frames, %llu draws, %llu after batching (%.1f per frame), %llu merged, %.1f ns per draw\n",
+        frames, (unsigned long long)direct.draws, (unsigned long long)batched.draws,
+        frames ? (double)batched.draws / frames : 0.0, (unsigned long long)stats.merged,
+        stats.received ? elapsed / stats.received : 0.0);
+    if (mismatches) {
+        printf("MISMATCH in %zu of %zu state groups\n", mismatches, direct.epochs.size());
+        return 1;
+    }
+    // Only draws passed through as given may be larger than a batch
+    if (batched.oversized > direct.oversized) {
+        printf("OVERFLOW in %llu batches of more than %u vertices\n",
+            (unsigned long long)(batched.oversized - direct.oversized), capacity);
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,345 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2024 Dominik Protasewicz
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/**
+ * @file decbench.cpp
+ * @brief Throughput benchmark and differential check for the asset decoders.
+ *
+ * Every input is decoded by `Decompress::decodeReference` and by both fast decoders, the
+ * outputs must be identical or the run fails. With `--fuzz` the compressed streams are
+ * also randomly corrupted and the bounded fast decoder must agree with the reference on
+ * every one of them, including which ones are rejected.
+ *
+ * Inputs are raw files which are compressed with a simple greedy encoder first, or with
+ * `--compressed` streams extracted from the game archives. Without any files a synthetic
+ * corpus is generated.
+ *
+ * Usage: decbench [--compressed] [--fuzz <count>] [<file> ...]
+ */
+
+#include <cstdio>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <chrono>
+#include <random>
+#include <string>
+#include <vector>
+#include <fstream>
+#include <iterator>
+#include <algorithm>
+
+#include "decompress.hpp"
+
+namespace
+{
+    /**
+     * @brief Writes the bit stream described in decompress.hpp.
+     */
+    class BitWriter {
+    public:
+        explicit BitWriter(std::vector<uint8_t>& out) : out(out) {}
+
+        void bit(unsigned value) {
+            if (used == 16) {
+                flagPos = out.size();
+                out.push_back(0);
+                out.push_back(0);
+                used = 0;
+            }
+            if (value) {
+                out[flagPos + (used >> 3)] |= (uint8_t)(1 << (used & 7));
+            }
+            used++;
+        }
+
+        void bits(unsigned value, int n) {
+            while (n--) {
+                bit((value >> n) & 1);
+            }
+        }
+
+        void byte(unsigned value) {
+            out.push_back((uint8_t)value);
+        }
+
+        void count(size_t len) {
+            if (len <= 5) {
+                bits(1, (int)len - 1);
+            }
+            else if (len <= 13) {
+                bits(1, 5);
+                bits((unsigned)len - 6, 3);
+            }
+            else {
+                bits(0, 5);
+                byte((unsigned)len - 14);
+            }
+        }
+
+    private:
+        std::vector<uint8_t>& out;
+        size_t flagPos = 0;
+        int used = 16;
+    };
+
+    /**
+     * @brief Greedy single candidate LZ encoder, good enough to produce realistic streams.
+     */
+    std::vector<uint8_t> encode(const std::vector<uint8_t>& in) {
+        constexpr size_t CHUNK = 0x7FF0;
+        constexpr size_t MAX_MATCH = 269;
+        constexpr size_t MAX_RUN = 14 + 0xFFF;
+        constexpr size_t WINDOW = 0x1FFF;
+
+        std::vector<uint8_t> out;
+        std::vector<int64_t> head(1 << 15, -1);
+        auto hash = [&](size_t i) {
+            return ((in[i] << 10) ^ (in[i + 1] << 5) ^ in[i + 2]) & 0x7FFF;
+        };
+
+        size_t i = 0;
+        do {
+            size_t chunkStart = out.size();
+            size_t chunkEnd = std::min(in.size(), i + CHUNK);
+            out.push_back(0);
+            out.push_back(0);
+            BitWriter w(out);
+
+            while (i < chunkEnd) {
+                size_t left = chunkEnd - i;
+                size_t run = 1;
+                while (run < std::min(left, MAX_RUN) && in[i + run] == in[i]) {
+                    run++;
+                }
+                if (run >= 15 && i > 0 && in[i - 1] == in[i]) {
+                    w.bits(3, 2);
+                    w.bits(0, 5);
+                    w.byte(1);
+                    size_t n = run - 14;
+                    if (n > 15) {
+                        w.bit(1);
+                        w.bits((unsigned)(n >> 8), 4);
+                        w.byte((unsigned)(n & 0xFF));
+                    }
+                    else {
+                        w.bit(0);
+                        w.bits((unsigned)n, 4);
+                    }
+                    w.byte(in[i]);
+                    i += run;
+                    continue;
+                }
+
+                size_t best = 0;
+                size_t offset = 0;
+                if (left >= 3) {
+                    size_t h = hash(i);
+                    int64_t candidate = head[h];
+                    head[h] = (int64_t)i;
+                    if (candidate >= 0 && i - (size_t)candidate <= WINDOW) {
+                        size_t limit = std::min(left, MAX_MATCH);
+                        while (best < limit && in[(size_t)candidate + best] == in[i + best]) {
+                            best++;
+                        }
+                        offset = i - (size_t)candidate;
+                    }
+                }
+                if (best >= 3 || (best == 2 && offset < 256)) {
+                    if (offset < 256) {
+                        w.bits(2, 2);
+                        w.byte((unsigned)offset);
+                    }
+                    else {
+                        w.bits(3, 2);
+                        w.bits((unsigned)(offset >> 8), 5);
+                        w.byte((unsigned)(offset & 0xFF));
+                    }
+                    w.count(best);
+                    for (size_t k = 1; k < best && i + k + 2 < in.size(); k++) {
+                        head[hash(i + k)] = (int64_t)(i + k);
+                    }
+                    i += best;
+                }
+                else {
+                    w.bit(0);
+                    w.byte(in[i++]);
+                }
+            }
+
+            w.bits(3, 2);
+            w.bits(0, 5);
+            w.byte(0);
+            size_t chunkLen = out.size() - chunkStart;
+            out[chunkStart] = (uint8_t)chunkLen;
+            out[chunkStart + 1] = (uint8_t)(chunkLen >> 8);
+            out.push_back(i < in.size() ? 1 : 0);
+        } while (i < in.size());
+        return out;
+    }
+
+    /**
+     * @brief Text-like tokens, runs and noise, loosely resembling script and table assets.
+     */
+    std::vector<uint8_t> synthesize(size_t size, uint32_t seed) {
+        static const char* words[] = {
+            "Estelle", "Joshua", "Cassius", "Bracer", "Guild", "Rolent", "Bose", "Ruan",
+            "Zeiss", "Grancel", "orbment", "sepith", "quartz", "#0001F", "\\x02", "0x3F800000"
+        };
+        std::mt19937 rng(seed);
+        std::vector<uint8_t> out;
+        while (out.size() < size) {
+            switch (rng() % 8) {
+            case 0:
+                out.insert(out.end(), 16 + rng() % 200, (uint8_t)(rng() % 4 ? 0 : rng()));
+                break;
+            case 1:
+                for (int n = rng() % 32; n >= 0; n--) {
+                    out.push_back((uint8_t)rng());
+                }
+                break;
+            default:
+                const char* word = words[rng() % std::size(words)];
+                out.insert(out.end(), word, word + strlen(word));
+                out.push_back(rng() % 3 ? ' ' : '\n');
+                break;
+            }
+        }
+        out.resize(size);
+        return out;
+    }
+
+    /**
+     * @brief Best of many runs in MiB/s of output, the minimum filters out scheduling noise.
+     */
+    template <typename Decoder>
+    double throughput(size_t outSize, Decoder decoder) {
+        using clock = std::chrono::steady_clock;
+        double best = 1e30;
+        double total = 0;
+        do {
+            auto start = clock::now();
+            decoder();
+            double seconds = std::chrono::duration<double>(clock::now() - start).count();
+            best = std::min(best, seconds);
+            total += seconds;
+        } while (total < 0.5);
+        return (double)outSize / (1024.0 * 1024.0) / best;
+    }
+
+    struct Sample {
+        std::string name;
+        std::vector<uint8_t> compressed;
+        std::vector<uint8_t> expected;
+    };
+}
+
+int main(int argc, char** argv) {
+    bool compressed = false;
+    size_t fuzz = 0;
+    std::vector<Sample> samples;
+
+    for (int arg = 1; arg < argc; arg++) {
+        if (!strcmp(argv[arg], "--compressed")) {
+            compressed = true;
+            continue;
+        }
+        if (!strcmp(argv[arg], "--fuzz") && arg + 1 < argc) {
+            fuzz = strtoul(argv[++arg], nullptr, 10);
+            continue;
+        }
+        std::ifstream file(argv[arg], std::ios::binary);
+        if (!file) {
+            fprintf(stderr, "Could not open '%s'\n", argv[arg]);
+            return 1;
+        }
+        std::vector<uint8_t> data((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+        Sample sample{ argv[arg], {}, {} };
+        if (compressed) {
+            // Decoded size is not stored in the stream, grow until the reference accepts it
+            sample.compressed = std::move(data);
+            for (size_t capacity = sample.compressed.size() * 4; capacity < (1u << 30); capacity *= 2) {
+                sample.expected.resize(capacity);
+                size_t size = Decompress::decodeReference(sample.compressed.data(), sample.compressed.size(),
+                    sample.expected.data(), capacity);
+                if (size != Decompress::error) {
+                    sample.expected.resize(size);
+                    break;
+                }
+            }
+        }
+        else {
+            sample.expected = std::move(data);
+            sample.compressed = encode(sample.expected);
+        }
+        samples.push_back(std::move(sample));
+    }
+    if (samples.empty()) {
+        for (uint32_t seed = 1; seed <= 4; seed++) {
+            Sample sample{ "synthetic-" + std::to_string(seed), {}, {} };
+            sample.expected = synthesize(size_t(1) << (18 + seed), seed);
+            sample.compressed = encode(sample.expected);
+            samples.push_back(std::move(sample));
+        }
+    }
+
+    int failures = 0;
+    printf("%-24s %10s %10s %12s %12s %12s\n", "sample", "packed", "unpacked", "ref MiB/s", "fast MiB/s", "trust MiB/s");
+    for (const auto& sample : samples) {
+        const auto& in = sample.compressed;
+        size_t size = sample.expected.size();
+        std::vector<uint8_t> ref(size), fast(size), trust(size);
+
+        size_t refSize = Decompress::decodeReference(in.data(), in.size(), ref.data(), size);
+        size_t fastSize = Decompress::decode(in.data(), in.size(), fast.data(), size);
+        size_t trustSize = Decompress::decode(in.data(), trust.data());
+        if (refSize != size || ref != sample.expected || fastSize != size || fast != ref || trustSize != size || trust != ref) {
+            printf("%-24s MISMATCH ref %zu fast %zu trust %zu expected %zu\n", sample.name.c_str(), refSize, fastSize, trustSize, size);
+            failures++;
+            continue;
+        }
+
+        double refRate = throughput(size, [&] { Decompress::decodeReference(in.data(), in.size(), ref.data(), size); });
+        double fastRate = throughput(size, [&] { Decompress::decode(in.data(), in.size(), fast.data(), size); });
+        double trustRate = throughput(size, [&] { Decompress::decode(in.data(), trust.data()); });
+        printf("%-24s %10zu %10zu %12.1f %12.1f %12.1f\n", sample.name.c_str(), in.size(), size, refRate, fastRate, trustRate);
+
+        std::mt19937 rng(1234);
+        for (size_t n = 0; n < fuzz; n++) {
+            std::vector<uint8_t> corrupt = in;
+            for (int k = 1 + rng() % 4; k > 0; k--) {
+                corrupt[rng() % corrupt.size()] ^= (uint8_t)(1 + rng() % 255);
+            }
+            corrupt.resize(corrupt.size() - rng() % std::min<size_t>(corrupt.size(), 4));
+            size_t a = Decompress::decodeReference(corrupt.data(), corrupt.size(), ref.data(), size);
+            size_t b = Decompress::decode(corrupt.data(), corrupt.size(), fast.data(), size);
+            if (a != b || (a != Decompress::error && memcmp(ref.data(), fast.data(), a) != 0)) {
+                printf("%-24s FUZZ MISMATCH on iteration %zu\n", sample.name.c_str(), n);
+                failures++;
+                break;
+            }
+        }
+    }
+    return failures ? 1 : 0;
+}
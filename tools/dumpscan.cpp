@@ -0,0 +1,359 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2024 Dominik Protasewicz
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/**
+ * @file dumpscan.cpp
+ * @brief Streaming signature scanner for memory dumps and minidumps.
+ *
+ * Crash dumps from players can be several gigabytes, too big to map in one piece from a
+ * 32 bit process. The file is instead read in large aligned chunks, with the next chunk
+ * read asynchronously into a second buffer while the current one is scanned. The last
+ * `longest pattern - 1` bytes of each chunk are carried over to the front of the next so
+ * that matches straddling a chunk boundary are still found.
+ *
+ * For minidumps the memory range list (Memory64ListStream or MemoryListStream) is used to
+ * translate file offsets of matches back to the virtual addresses they had in the game.
+ * Any other file is treated as a raw dump starting at the address given by `--base`.
+ *
+ * The signatures are compiled and matched by the same code that `Utils::patternScan`
+ * uses inside the DLL, captures included: every named capture of a match is printed with
+ * relative captures resolved against the match's virtual address.
+ *
+ * Usage: dumpscan [--base <hex>] [--chunk <MiB>] <file> <signature> [<signature> ...]
+ */
+
+#include <cstdio>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <cinttypes>
+#include <chrono>
+#include <future>
+#include <string>
+#include <vector>
+#include <algorithm>
+
+#include "scanner.hpp"
+
+namespace
+{
+    constexpr uint32_t MINIDUMP_SIGNATURE = 0x504D444D; // "MDMP"
+    constexpr uint32_t MEMORY_LIST_STREAM = 5;
+    constexpr uint32_t MEMORY64_LIST_STREAM = 9;
+    constexpr size_t CHUNK_ALIGNMENT = 64 * 1024;
+
+    /**
+     * @brief Thin wrapper around `FILE` with 64 bit offsets on every platform.
+     */
+    class File {
+    public:
+        explicit File(const char* path) : file(fopen(path, "rb")) {}
+        ~File() {
+            if (file)
+                fclose(file);
+        }
+        File(const File&) = delete;
+        File& operator=(const File&) = delete;
+
+        bool isOpen() const { return file != nullptr; }
+
+        uint64_t size() {
+            seek(0, SEEK_END);
+#ifdef _WIN32
+            return (uint64_t)_ftelli64(file);
+#else
+            return (uint64_t)ftello(file);
+#endif
+        }
+
+        bool read(uint64_t offset, void* buffer, size_t size) {
+            return seek(offset, SEEK_SET) && fread(buffer, 1, size, file) == size;
+        }
+
+        size_t readSome(uint64_t offset, void* buffer, size_t size) {
+            return seek(offset, SEEK_SET) ? fread(buffer, 1, size, file) : 0;
+        }
+
+    private:
+        bool seek(uint64_t offset, int origin) {
+#ifdef _WIN32
+            return _fseeki64(file, (int64_t)offset, origin) == 0;
+#else
+            return fseeko(file, (off_t)offset, origin) == 0;
+#endif
+        }
+
+        FILE* file;
+    };
+
+    /**
+     * @brief A contiguous run of captured memory inside the dump file.
+     */
+    struct Range {
+        uint64_t fileOffset;
+        uint64_t size;
+        uint64_t va;
+    };
+
+    template <typename T>
+    T load(const uint8_t* bytes) {
+        T value;
+        memcpy(&value, bytes, sizeof(T));
+        return value;
+    }
+
+    /**
+     * @brief Read the memory range list out of a minidump.
+     *
+     * @param file Dump file
+     * @param ranges Vector the ranges are appended to, sorted by file offset
+     * @return true if the file is a minidump, false otherwise
+     */
+    bool readMinidumpRanges(File& file, std::vector<Range>* ranges) {
+        uint8_t header[32];
+        if (!file.read(0, header, sizeof(header)) || load<uint32_t>(header) != MINIDUMP_SIGNATURE) {
+            return false;
+        }
+        uint32_t numberOfStreams = load<uint32_t>(header + 8);
+        uint32_t streamDirectoryRva = load<uint32_t>(header + 12);
+
+        for (uint32_t i = 0; i < numberOfStreams; i++) {
+            uint8_t entry[12];
+            if (!file.read(streamDirectoryRva + i * sizeof(entry), entry, sizeof(entry))) {
+                break;
+            }
+            uint32_t streamType = load<uint32_t>(entry);
+            uint32_t rva = load<uint32_t>(entry + 8);
+
+            if (streamType == MEMORY64_LIST_STREAM) {
+                uint8_t list[16];
+                if (!file.read(rva, list, sizeof(list))) {
+                    continue;
+                }
+                uint64_t count = load<uint64_t>(list);
+                uint64_t fileOffset = load<uint64_t>(list + 8);
+                std::vector<uint8_t> descriptors(count * 16);
+                if (!file.read(rva + sizeof(list), descriptors.data(), descriptors.size())) {
+                    continue;
+                }
+                for (uint64_t j = 0; j < count; j++) {
+                    uint64_t va = load<uint64_t>(&descriptors[j * 16]);
+                    uint64_t size = load<uint64_t>(&descriptors[j * 16 + 8]);
+                    ranges->push_back({ fileOffset, size, va });
+                    fileOffset += size;
+                }
+            }
+            else if (streamType == MEMORY_LIST_STREAM) {
+                uint8_t list[4];
+                if (!file.read(rva, list, sizeof(list))) {
+                    continue;
+                }
+                uint32_t count = load<uint32_t>(list);
+                std::vector<uint8_t> descriptors((size_t)count * 16);
+                if (!file.read(rva + sizeof(list), descriptors.data(), descriptors.size())) {
+                    continue;
+                }
+                for (uint32_t j = 0; j < count; j++) {
+                    uint64_t va = load<uint64_t>(&descriptors[j * 16]);
+                    uint32_t size = load<uint32_t>(&descriptors[j * 16 + 8]);
+                    uint32_t dataRva = load<uint32_t>(&descriptors[j * 16 + 12]);
+                    ranges->push_back({ dataRva, size, va });
+                }
+            }
+        }
+
+        std::sort(ranges->begin(), ranges->end(),
+            [](const Range& a, const Range& b) { return a.fileOffset < b.fileOffset; });
+        return true;
+    }
+
+    /**
+     * @brief Translate a match in the dump file to the virtual address it was captured from.
+     * @details A match is only valid if it lies completely within a single memory range,
+     *      matches in the minidump headers or straddling two unrelated ranges are rejected.
+     *
+     * @param ranges Memory ranges sorted by file offset
+     * @param offset File offset of the match
+     * @param size Size of the match
+     * @param va Receives the virtual address
+     * @return true if the match maps to captured memory
+     */
+    bool offsetToVa(const std::vector<Range>& ranges, uint64_t offset, uint64_t size, uint64_t* va) {
+        auto it = std::upper_bound(ranges.begin(), ranges.end(), offset,
+            [](uint64_t value, const Range& range) { return value < range.fileOffset; });
+        if (it == ranges.begin()) {
+            return false;
+        }
+        --it;
+        if (offset + size > it->fileOffset + it->size) {
+            return false;
+        }
+        *va = it->va + (offset - it->fileOffset);
+        return true;
+    }
+
+    /**
+     * @brief Scan a file chunk by chunk with double buffered asynchronous reads.
+     *
+     * @param file File to scan
+     * @param fileSize Size of `file`
+     * @param patterns Compiled patterns
+     * @param chunkSize Bytes read per chunk, a multiple of `CHUNK_ALIGNMENT`
+     * @param onMatch Called with the pattern index, the file offset and the bytes of every match
+     */
+    template <typename Callback>
+    void scanStream(File& file, uint64_t fileSize, const std::vector<Scanner::Pattern>& patterns,
+        size_t chunkSize, Callback onMatch)
+    {
+        size_t longest = 0;
+        for (const auto& pattern : patterns) {
+            longest = std::max(longest, pattern.size());
+        }
+        size_t overlap = longest ? longest - 1 : 0;
+
+        // Each buffer is laid out as [carried tail of previous chunk | chunk]. The read of
+        // the next chunk only ever touches the chunk part, so the tail can be copied in
+        // while that read is still in flight.
+        std::vector<uint8_t> buffers[2] = {
+            std::vector<uint8_t>(overlap + chunkSize),
+            std::vector<uint8_t>(overlap + chunkSize)
+        };
+        auto readChunk = [&](int index, uint64_t offset) -> size_t {
+            if (offset >= fileSize) {
+                return 0;
+            }
+            size_t size = (size_t)std::min<uint64_t>(chunkSize, fileSize - offset);
+            return file.readSome(offset, buffers[index].data() + overlap, size);
+        };
+
+        int current = 0;
+        uint64_t nextOffset = 0;
+        size_t carried = 0;
+        auto pending = std::async(std::launch::async, readChunk, current, nextOffset);
+
+        for (;;) {
+            size_t got = pending.get();
+            if (got == 0) {
+                break;
+            }
+            uint64_t chunkOffset = nextOffset;
+            nextOffset += got;
+            pending = std::async(std::launch::async, readChunk, current ^ 1, nextOffset);
+
+            const uint8_t* base = buffers[current].data() + overlap - carried;
+            size_t length = carried + got;
+            uint64_t baseOffset = chunkOffset - carried;
+
+            for (size_t i = 0; i < patterns.size(); i++) {
+                const auto& pattern = patterns[i];
+                for (size_t pos = Scanner::find(base, length, pattern); pos != Scanner::npos;
+                    pos = Scanner::find(base, length, pattern, pos + 1))
+                {
+                    // Matches entirely inside the carried tail were reported last chunk
+                    if (pos + pattern.size() > carried) {
+                        onMatch(i, baseOffset + pos, base + pos);
+                    }
+                }
+            }
+
+            size_t keep = std::min(overlap, length);
+            memcpy(buffers[current ^ 1].data() + overlap - keep, base + length - keep, keep);
+            carried = keep;
+            current ^= 1;
+        }
+    }
+
+    void usage() {
+        fprintf(stderr, "Usage: dumpscan [--base <hex>] [--chunk <MiB>] <file> <signature> [<signature> ...]\n");
+        exit(1);
+    }
+}
+
+int main(int argc, char** argv) {
+    uint64_t base = 0;
+    size_t chunkSize = 16 * 1024 * 1024;
+    int arg = 1;
+    for (; arg < argc && strncmp(argv[arg], "--", 2) == 0; arg++) {
+        if (!strcmp(argv[arg], "--base") && arg + 1 < argc) {
+            base = strtoull(argv[++arg], nullptr, 16);
+        }
+        else if (!strcmp(argv[arg], "--chunk") && arg + 1 < argc) {
+            chunkSize = (size_t)strtoul(argv[++arg], nullptr, 10) * 1024 * 1024;
+        }
+        else {
+            usage();
+        }
+    }
+    if (argc - arg < 2) {
+        usage();
+    }
+    chunkSize = std::max(CHUNK_ALIGNMENT, chunkSize / CHUNK_ALIGNMENT * CHUNK_ALIGNMENT);
+
+    const char* path = argv[arg++];
+    File file(path);
+    if (!file.isOpen()) {
+        fprintf(stderr, "Could not open '%s'\n", path);
+        return 1;
+    }
+    uint64_t fileSize = file.size();
+
+    std::vector<const char*> signatures(argv + arg, argv + argc);
+    std::vector<Scanner::Pattern> patterns;
+    for (auto signature : signatures) {
+        patterns.push_back(Scanner::compile(signature));
+        if (!patterns.back().error.empty()) {
+            fprintf(stderr, "Bad signature '%s': %s\n", signature, patterns.back().error.c_str());
+            return 1;
+        }
+    }
+
+    std::vector<Range> ranges;
+    bool minidump = readMinidumpRanges(file, &ranges);
+    printf("%s: %" PRIu64 " bytes, %s", path, fileSize, minidump ? "minidump" : "raw");
+    if (minidump) {
+        printf(", %zu memory ranges", ranges.size());
+    }
+    printf("\n");
+
+    size_t matches = 0;
+    auto start = std::chrono::steady_clock::now();
+    scanStream(file, fileSize, patterns, chunkSize, [&](size_t index, uint64_t offset, const uint8_t* bytes) {
+        uint64_t va = base + offset;
+        if (minidump && !offsetToVa(ranges, offset, patterns[index].size(), &va)) {
+            return;
+        }
+        printf("'%s' @ file+0x%" PRIx64 " va 0x%" PRIx64 "\n", signatures[index], offset, va);
+        const auto& pattern = patterns[index];
+        auto match = Scanner::decode(bytes, 0, pattern, va);
+        for (size_t k = 0; k < pattern.captures.size(); k++) {
+            printf("    %s = 0x%" PRIx64 "\n", pattern.captures[k].name.c_str(), match.values[k]);
+        }
+        matches++;
+    });
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    printf("%zu matches in %.3f s (%.1f MiB/s)\n", matches, seconds,
+        seconds > 0 ? fileSize / (1024.0 * 1024.0) / seconds : 0.0);
+    return 0;
+}
@@ -0,0 +1,209 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2024 Dominik Protasewicz
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/**
+ * @file fixctl.cpp
+ * @brief Command line client of the control channel of a running fix.
+ *
+ * Connects to the channel the DLL serves when `control.enable` is set and sends a single
+ * command. `--serve` instead serves the channel itself with stand in handlers, so that
+ * the protocol and the client can be exercised where the game does not run.
+ *
+ * Usage: fixctl [--name <name>] ping
+ *        fixctl [--name <name>] counters
+ *        fixctl [--name <name>] scans
+ *        fixctl [--name <name>] fix <name> on|off
+ *        fixctl [--name <name>] loglevel <0-6>
+ *        fixctl [--name <name>] --serve
+ */
+
+#include <chrono>
+#include <cinttypes>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+#include <string>
+#include <thread>
+
+#include "control.hpp"
+
+namespace
+{
+    const char* statusName(Control::Status status) {
+        switch (status) {
+        case Control::Ok: return "ok";
+        case Control::UnknownCommand: return "unknown command";
+        case Control::BadRequest: return "bad request";
+        default: return "failed";
+        }
+    }
+
+    int serve(const std::string& name) {
+        Control::Server server(name);
+        std::map<std::string, bool> fixes = { { "keepAspect", true }, { "textures", true }, { "decompress", false } };
+        uint64_t requests = 0;
+        int level = 2;
+
+        server.on(Control::Ping, [&](Control::Message&, Control::Message* response) {
+            requests++;
+            response->putString("fixctl --serve");
+            return Control::Ok;
+        });
+        server.on(Control::Counters, [&](Control::Message&, Control::Message* response) {
+            requests++;
+            response->putU16(2);
+            response->putString("serve.requests");
+            response->putU64(requests);
+            response->putString("serve.logLevel");
+            response->putU64((uint64_t)level);
+            return Control::Ok;
+        });
+        server.on(Control::Scans, [&](Control::Message&, Control::Message* response) {
+            requests++;
+            response->putU16(1);
+            response->putString("example");
+            response->putU8(1);
+            response->putU32(0x1000);
+            return Control::Ok;
+        });
+        server.on(Control::SetFix, [&](Control::Message& request, Control::Message*) {
+            requests++;
+            std::string fix = request.getString();
+            bool enable = request.getU8() != 0;
+            if (!request.ok || !fixes.count(fix)) {
+                return Control::BadRequest;
+            }
+            fixes[fix] = enable;
+            printf("%s %s\n", fix.c_str(), enable ? "on" : "off");
+            return Control::Ok;
+        });
+        server.on(Control::SetLogLevel, [&](Control::Message& request, Control::Message*) {
+            requests++;
+            int next = request.getU8();
+            if (!request.ok || next > 6) {
+                return Control::BadRequest;
+            }
+            level = next;
+            printf("log level %d\n", level);
+            return Control::Ok;
+        });
+
+        if (!server.start()) {
+            fprintf(stderr, "Could not serve '%s'\n", server.path().c_str());
+            return 1;
+        }
+        printf("Serving '%s', stop with Ctrl+C\n", server.path().c_str());
+        fflush(stdout);
+        for (;;) {
+            std::this_thread::sleep_for(std::chrono::seconds(1));
+        }
+    }
+
+    void usage() {
+        fprintf(stderr,
+            "Usage: fixctl [--name <name>] ping | counters | scans | fix <name> on|off | loglevel <0-6>\n"
+            "       fixctl [--name <name>] --serve\n");
+        exit(1);
+    }
+}
+
+int main(int argc, char** argv) {
+    std::string name = "TrailsInTheSkyFCFix";
+    int arg = 1;
+    if (arg + 1 < argc && !strcmp(argv[arg], "--name")) {
+        name = argv[arg + 1];
+        arg += 2;
+    }
+    if (arg >= argc) {
+        usage();
+    }
+    std::string command = argv[arg++];
+    if (command == "--serve") {
+        return serve(name);
+    }
+
+    Control::Message request, response;
+    uint8_t code;
+    if (command == "ping" && arg == argc) {
+        code = Control::Ping;
+    }
+    else if (command == "counters" && arg == argc) {
+        code = Control::Counters;
+    }
+    else if (command == "scans" && arg == argc) {
+        code = Control::Scans;
+    }
+    else if (command == "fix" && arg + 2 == argc) {
+        code = Control::SetFix;
+        request.putString(argv[arg]);
+        request.putU8(!strcmp(argv[arg + 1], "on"));
+    }
+    else if (command == "loglevel" && arg + 1 == argc) {
+        code = Control::SetLogLevel;
+        request.putU8((uint8_t)atoi(argv[arg]));
+    }
+    else {
+        usage();
+    }
+
+    Control::Client client;
+    if (!client.connect(name)) {
+        fprintf(stderr, "Could not connect to '%s'\n", Control::endpointPath(name).c_str());
+        return 1;
+    }
+    Control::Status status = client.request(code, request, &response);
+    if (status != Control::Ok) {
+        fprintf(stderr, "%s\n", statusName(status));
+        return 1;
+    }
+
+    if (code == Control::Ping) {
+        printf("%s\n", response.getString().c_str());
+    }
+    else if (code == Control::Counters) {
+        for (uint16_t count = response.getU16(), i = 0; i < count && response.ok; i++) {
+            std::string counter = response.getString();
+            uint64_t value = response.getU64();
+            printf("%-28s %" PRIu64 "\n", counter.c_str(), value);
+        }
+    }
+    else if (code == Control::Scans) {
+        for (uint16_t count = response.getU16(), i = 0; i < count && response.ok; i++) {
+            std::string scan = response.getString();
+            bool found = response.getU8() != 0;
+            uint32_t rva = response.getU32();
+            if (found) {
+                printf("%-28s 0x%" PRIx32 "\n", scan.c_str(), rva);
+            }
+            else {
+                printf("%-28s not found\n", scan.c_str());
+            }
+        }
+    }
+    else {
+        printf("ok\n");
+    }
+    return response.ok ? 0 : 1;
+}
@@ -0,0 +1,583 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2024 Dominik Protasewicz
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/**
+ * @file framecompare.cpp
+ * @brief Compares frame time captures and tells whether the differences are significant.
+ *
+ * The first capture is the baseline, every other one is compared against it. For each capture
+ * the mean, the 50th, 90th, 99th and 99.9th percentiles and the share of frames longer than the
+ * hitch threshold are reported with bootstrap confidence intervals, and for each comparison the
+ * difference of each metric with a verdict.
+ *
+ * Captures are read line by line into log-spaced histograms with 0.5% wide buckets, so memory
+ * does not grow with their length and percentiles are exact to a bucket. Confidence intervals
+ * come from a Poisson bootstrap that is streamed along: every replicate weighs each block of
+ * consecutive frames by a Poisson(1) draw, which resamples blocks without keeping the frames.
+ * Blocks keep the correlation between neighbouring frames from narrowing the intervals. The
+ * difference of the means is tested with Welch's t-test on block means, the others with the
+ * bootstrap distribution of the difference.
+ *
+ * Captures are CSV files with one frame per line, as written by the fix with `replay.telemetry`.
+ * The frame time is taken from the column named by `--column`, by default from a column named
+ * `ms` or `MsBetweenPresents`, or the last column if there is no header.
+ *
+ * Usage: framecompare [--column <name>] [--hitch <ms>] [--block <frames>] [--replicates <count>]
+ *                     [--alpha <level>] [--seed <seed>] <baseline> <capture> ...
+ */
+
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <cstdio>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace
+{
+    constexpr double HISTOGRAM_MIN = 0.01;      // ms, shorter frames land in the first bucket
+    constexpr double HISTOGRAM_MAX = 10000.0;   // ms, longer frames land in the last bucket
+    constexpr double HISTOGRAM_GROWTH = 1.005;
+    const size_t BUCKETS = (size_t)std::ceil(std::log(HISTOGRAM_MAX / HISTOGRAM_MIN) / std::log(HISTOGRAM_GROWTH)) + 1;
+
+    struct Options {
+        std::string column;
+        double hitchMs = 25.0;
+        uint32_t block = 32;
+        uint32_t replicates = 200;
+        double alpha = 0.05;
+        uint64_t seed = 1;
+    };
+
+    enum Metric { Mean, P50, P90, P99, P999, HitchRate, MetricCount };
+    const char* metricNames[MetricCount] = { "mean", "p50", "p90", "p99", "p99.9", "hitches" };
+    const double quantiles[MetricCount] = { 0, 0.50, 0.90, 0.99, 0.999, 0 };
+
+    size_t bucketOf(double ms) {
+        if (!(ms > HISTOGRAM_MIN)) {
+            return 0;
+        }
+        return (std::min)((size_t)(std::log(ms / HISTOGRAM_MIN) / std::log(HISTOGRAM_GROWTH)), BUCKETS - 1);
+    }
+
+    /**
+     * @brief Value at `q` of a histogram, interpolated within the bucket it falls into
+     */
+    template <typename Count>
+    double quantile(const Count* histogram, double total, double q) {
+        double target = q * total;
+        double cumulative = 0;
+        for (size_t bucket = 0; bucket < BUCKETS; bucket++) {
+            if (histogram[bucket] == 0) {
+                continue;
+            }
+            if (cumulative + histogram[bucket] >= target) {
+                double lower = HISTOGRAM_MIN * std::pow(HISTOGRAM_GROWTH, (double)bucket);
+                double fraction = (target - cumulative) / histogram[bucket];
+                return lower + lower * (HISTOGRAM_GROWTH - 1) * (std::max)(fraction, 0.0);
+            }
+            cumulative += histogram[bucket];
+        }
+        return HISTOGRAM_MAX;
+    }
+
+    /**
+     * @brief Poisson(1) draws from a 32 bit uniform draw by inverting the distribution function.
+     */
+    class Poisson {
+    public:
+        Poisson() {
+            double p = std::exp(-1.0);
+            double cumulative = 0;
+            for (uint32_t k = 0; k < LIMIT; k++) {
+                cumulative += p;
+                thresholds[k] = (uint64_t)(cumulative * 4294967296.0);
+                p /= k + 1;
+            }
+        }
+
+        uint32_t operator()(uint32_t uniform) const {
+            uint32_t k = 0;
+            while (k + 1 < LIMIT && uniform >= thresholds[k]) {
+                k++;
+            }
+            return k;
+        }
+
+    private:
+        static constexpr uint32_t LIMIT = 12;
+        uint64_t thresholds[LIMIT];
+    };
+
+    /**
+     * @brief Running mean and variance.
+     */
+    struct Welford {
+        uint64_t count = 0;
+        double mean = 0;
+        double m2 = 0;
+
+        void add(double value) {
+            count++;
+            double delta = value - mean;
+            mean += delta / count;
+            m2 += delta * (value - mean);
+        }
+
+        double variance() const { return count > 1 ? m2 / (count - 1) : 0; }
+    };
+
+    /**
+     * @brief Everything kept of a capture, its size does not depend on the number of frames.
+     */
+    struct Capture {
+        struct Replicate {
+            double weight = 0;
+            double sum = 0;
+            double hitches = 0;
+        };
+
+        std::string path;
+        Welford frames;
+        Welford blocks;
+        double minimum = HUGE_VAL;
+        double maximum = 0;
+        uint64_t hitches = 0;
+        std::vector<uint64_t> histogram;
+        std::vector<Replicate> replicates;
+        std::vector<uint32_t> replicateHistograms;  // One histogram per replicate, back to back
+        std::vector<uint32_t> weights;              // Of the current block for each replicate
+        double blockSum = 0;
+        uint32_t blockFrames = 0;
+
+        Capture(const char* path, uint32_t count)
+            : path(path), histogram(BUCKETS), replicates(count), replicateHistograms((size_t)count * BUCKETS), weights(count) {}
+
+        void add(double ms, const Options& options, std::mt19937_64* rng, const Poisson& poisson) {
+            if (blockFrames == 0) {
+                for (auto& weight : weights) {
+                    weight = poisson((uint32_t)(*rng)());
+                }
+            }
+            size_t bucket = bucketOf(ms);
+            bool hitch = ms > options.hitchMs;
+            frames.add(ms);
+            minimum = (std::min)(minimum, ms);
+            maximum = (std::max)(maximum, ms);
+            hitches += hitch;
+            histogram[bucket]++;
+            for (size_t i = 0; i < replicates.size(); i++) {
+                uint32_t weight = weights[i];
+                if (weight) {
+                    replicates[i].weight += weight;
+                    replicates[i].sum += weight * ms;
+                    replicates[i].hitches += hitch ? weight : 0;
+                    replicateHistograms[i * BUCKETS + bucket] += weight;
+                }
+            }
+            blockSum += ms;
+            if (++blockFrames == options.block) {
+                endBlock();
+            }
+        }
+
+        void endBlock() {
+            if (blockFrames) {
+                blocks.add(blockSum / blockFrames);
+            }
+            blockSum = 0;
+            blockFrames = 0;
+        }
+
+        double metric(Metric metric) const {
+            switch (metric) {
+            case Mean:
+                return frames.mean;
+            case HitchRate:
+                return frames.count ? (double)hitches / frames.count : 0;
+            default:
+                return quantile(histogram.data(), (double)frames.count, quantiles[metric]);
+            }
+        }
+
+        /**
+         * @return The metric in a replicate, NAN if the replicate drew no frames
+         */
+        double metric(Metric metric, size_t replicate) const {
+            const Replicate& drawn = replicates[replicate];
+            if (drawn.weight == 0) {
+                return NAN;
+            }
+            switch (metric) {
+            case Mean:
+                return drawn.sum / drawn.weight;
+            case HitchRate:
+                return drawn.hitches / drawn.weight;
+            default:
+                return quantile(&replicateHistograms[replicate * BUCKETS], drawn.weight, quantiles[metric]);
+            }
+        }
+    };
+
+    bool numeric(const std::string& field, double* value) {
+        const char* start = field.c_str();
+        char* end = nullptr;
+        *value = strtod(start, &end);
+        while (end && isspace((unsigned char)*end)) {
+            end++;
+        }
+        return end != start && end && *end == '\0';
+    }
+
+    std::string lower(std::string text) {
+        for (auto& c : text) {
+            c = (char)tolower((unsigned char)c);
+        }
+        return text;
+    }
+
+    void split(const std::string& line, std::vector<std::string>* fields) {
+        fields->clear();
+        size_t start = 0;
+        while (true) {
+            size_t comma = line.find(',', start);
+            std::string field = line.substr(start, comma == std::string::npos ? std::string::npos : comma - start);
+            size_t first = field.find_first_not_of(" \t\"");
+            size_t last = field.find_last_not_of(" \t\"\r\n");
+            fields->push_back(first == std::string::npos ? "" : field.substr(first, last - first + 1));
+            if (comma == std::string::npos) {
+                break;
+            }
+            start = comma + 1;
+        }
+    }
+
+    /**
+     * @brief Read a capture line by line into `capture`
+     * @return false if it could not be opened, has no frame time column or fewer than two blocks of frames
+     */
+    bool read(Capture* capture, const Options& options, std::mt19937_64* rng, const Poisson& poisson) {
+        FILE* file = fopen(capture->path.c_str(), "r");
+        if (!file) {
+            fprintf(stderr, "Could not open '%s'\n", capture->path.c_str());
+            return false;
+        }
+        std::string line;
+        std::vector<std::string> fields;
+        size_t column = std::string::npos;
+        bool first = true;
+        uint64_t skipped = 0;
+        char chunk[4096];
+        bool more = true;
+        while (more) {
+            line.clear();
+            while ((more = fgets(chunk, sizeof(chunk), file) != nullptr)) {
+                line += chunk;
+                if (line.back() == '\n') {
+                    break;
+                }
+            }
+            if (line.find_first_not_of(" \t\r\n") == std::string::npos) {
+                continue;
+            }
+            split(line, &fields);
+            if (first) {
+                first = false;
+                double value;
+                bool header = !numeric(fields.back(), &value);
+                if (header) {
+                    for (size_t i = 0; i < fields.size() && column == std::string::npos; i++) {
+                        std::string name = lower(fields[i]);
+                        bool wanted = options.column.empty() ? name == "ms" || name == "msbetweenpresents" :
+                            name == lower(options.column);
+                        column = wanted ? i : column;
+                    }
+                    if (column == std::string::npos) {
+                        fprintf(stderr, "'%s' has no column %s\n", capture->path.c_str(),
+                            options.column.empty() ? "named ms or MsBetweenPresents" : options.column.c_str());
+                        fclose(file);
+                        return false;
+                    }
+                    continue;
+                }
+                column = fields.size() - 1;
+            }
+            double ms;
+            if (column >= fields.size() || !numeric(fields[column], &ms) || !(ms >= 0)) {
+                skipped++;
+                continue;
+            }
+            capture->add(ms, options, rng, poisson);
+        }
+        capture->endBlock();
+        fclose(file);
+        if (skipped) {
+            fprintf(stderr, "'%s': skipped %llu lines without a frame time\n", capture->path.c_str(),
+                (unsigned long long)skipped);
+        }
+        // Neither the bootstrap nor the test on block means say anything about a single block
+        if (capture->blocks.count < 2) {
+            fprintf(stderr, "'%s' has %llu frames, at least two blocks of %u are needed\n", capture->path.c_str(),
+                (unsigned long long)capture->frames.count, options.block);
+            return false;
+        }
+        return true;
+    }
+
+    /**
+     * @brief Continued fraction of the incomplete beta function, evaluated with Lentz's method.
+     */
+    double betaFraction(double a, double b, double x) {
+        constexpr double TINY = 1e-300;
+        double c = 1;
+        double d = 1 - (a + b) * x / (a + 1);
+        d = 1 / (std::fabs(d) < TINY ? TINY : d);
+        double result = d;
+        for (int m = 1; m <= 300; m++) {
+            for (int odd = 0; odd < 2; odd++) {
+                double numerator = odd ? -(a + m) * (a + b + m) * x / ((a + 2 * m) * (a + 2 * m + 1)) :
+                    m * (b - m) * x / ((a + 2 * m - 1) * (a + 2 * m));
+                d = 1 + numerator * d;
+                d = 1 / (std::fabs(d) < TINY ? TINY : d);
+                c = 1 + numerator / c;
+                c = std::fabs(c) < TINY ? TINY : c;
+                result *= c * d;
+            }
+            if (std::fabs(c * d - 1) < 1e-12) {
+                break;
+            }
+        }
+        return result;
+    }
+
+    /**
+     * @brief Regularized incomplete beta function I_x(a, b)
+     */
+    double incompleteBeta(double a, double b, double x) {
+        if (x <= 0) {
+            return 0;
+        }
+        if (x >= 1) {
+            return 1;
+        }
+        double front = std::exp(std::lgamma(a + b) - std::lgamma(a) - std::lgamma(b) + a * std::log(x) + b * std::log1p(-x));
+        // The continued fraction converges quickly only on the near side of the mean
+        if (x < (a + 1) / (a + b + 2)) {
+            return front * betaFraction(a, b, x) / a;
+        }
+        return 1 - front * betaFraction(b, a, 1 - x) / b;
+    }
+
+    /**
+     * @brief Two sided p-value of Welch's t-test on the block means of two captures
+     * @return NAN if either has fewer than two blocks
+     */
+    double welch(const Welford& a, const Welford& b) {
+        if (a.count < 2 || b.count < 2) {
+            return NAN;
+        }
+        double va = a.variance() / a.count;
+        double vb = b.variance() / b.count;
+        if (va + vb == 0) {
+            return a.mean == b.mean ? 1.0 : 0.0;
+        }
+        double t = (b.mean - a.mean) / std::sqrt(va + vb);
+        double df = (va + vb) * (va + vb) / (va * va / (a.count - 1) + vb * vb / (b.count - 1));
+        return incompleteBeta(df / 2, 0.5, df / (df + t * t));
+    }
+
+    /**
+     * @brief Value at `q` of sorted values, interpolated between neighbours
+     */
+    double percentile(const std::vector<double>& sorted, double q) {
+        if (sorted.empty()) {
+            return NAN;
+        }
+        double position = q * (sorted.size() - 1);
+        size_t below = (size_t)position;
+        size_t above = (std::min)(below + 1, sorted.size() - 1);
+        return sorted[below] + (sorted[above] - sorted[below]) * (position - below);
+    }
+
+    std::vector<double> replicated(const Capture& capture, Metric metric) {
+        std::vector<double> values;
+        for (size_t i = 0; i < capture.replicates.size(); i++) {
+            double value = capture.metric(metric, i);
+            if (!std::isnan(value)) {
+                values.push_back(value);
+            }
+        }
+        std::sort(values.begin(), values.end());
+        return values;
+    }
+
+    /**
+     * @brief A metric in its unit, hitch rates as percentages
+     */
+    std::string format(Metric metric, double value, bool sign = false) {
+        char text[32];
+        snprintf(text, sizeof(text), sign ? "%+.3f %s" : "%.3f %s", metric == HitchRate ? value * 100 : value,
+            metric == HitchRate ? "%" : "ms");
+        return text;
+    }
+
+    void report(const Capture& capture, const Options& options) {
+        printf("%s: %llu frames in %llu blocks, %.3f to %.3f ms\n", capture.path.c_str(),
+            (unsigned long long)capture.frames.count, (unsigned long long)capture.blocks.count,
+            capture.frames.count ? capture.minimum : 0.0, capture.maximum);
+        for (int m = 0; m < MetricCount; m++) {
+            Metric metric = (Metric)m;
+            std::vector<double> values = replicated(capture, metric);
+            std::string interval = "[" + format(metric, percentile(values, options.alpha / 2)) + ", " +
+                format(metric, percentile(values, 1 - options.alpha / 2)) + "]";
+            printf("    %-8s %12s  %s", metricNames[m], format(metric, capture.metric(metric)).c_str(), interval.c_str());
+            if (metric == HitchRate) {
+                printf(" over %.1f ms", options.hitchMs);
+            }
+            printf("\n");
+        }
+    }
+
+    /**
+     * @return Number of metrics that got significantly worse
+     */
+    int compare(const Capture& baseline, const Capture& capture, const Options& options) {
+        printf("\n%s against %s\n", capture.path.c_str(), baseline.path.c_str());
+        int worse = 0;
+        for (int m = 0; m < MetricCount; m++) {
+            Metric metric = (Metric)m;
+            double difference = capture.metric(metric) - baseline.metric(metric);
+            double base = baseline.metric(metric);
+
+            // Captures are independent, so replicates of the same index pair up as well as any
+            std::vector<double> differences;
+            uint32_t below = 0, above = 0;
+            for (size_t i = 0; i < capture.replicates.size() && i < baseline.replicates.size(); i++) {
+                double value = capture.metric(metric, i) - baseline.metric(metric, i);
+                if (std::isnan(value)) {
+                    continue;
+                }
+                differences.push_back(value);
+                below += value <= 0;
+                above += value >= 0;
+            }
+            std::sort(differences.begin(), differences.end());
+            double low = percentile(differences, options.alpha / 2);
+            double high = percentile(differences, 1 - options.alpha / 2);
+            double p = metric == Mean ? welch(baseline.blocks, capture.blocks) :
+                differences.empty() ? NAN : (std::min)(1.0, 2.0 * (std::min)(below, above) / differences.size());
+
+            bool significant = !std::isnan(p) && p < options.alpha && (metric == Mean || low > 0 || high < 0);
+            const char* verdict = std::isnan(p) ? "too few frames to tell" : !significant ? "no significant difference" :
+                difference < 0 ? "better" : "worse";
+            worse += significant && difference > 0;
+
+            char relative[16] = "";
+            if (base != 0) {
+                snprintf(relative, sizeof(relative), "%+.2f %%", difference / base * 100);
+            }
+            // A bootstrap cannot resolve p-values below one pair of replicates
+            double resolution = metric == Mean ? 1e-4 : 2.0 / (std::max)(differences.size(), (size_t)1);
+            char probability[16];
+            if (std::isnan(p)) {
+                snprintf(probability, sizeof(probability), "-");
+            }
+            else {
+                snprintf(probability, sizeof(probability), p < resolution ? "<%.4g" : "%.4f", p < resolution ? resolution : p);
+            }
+            std::string interval = "[" + format(metric, low, true) + ", " + format(metric, high, true) + "]";
+            printf("    %-8s %12s %9s  %-28s p %-8s %s\n", metricNames[m], format(metric, difference, true).c_str(),
+                relative, interval.c_str(), probability, verdict);
+        }
+        return worse;
+    }
+
+    void usage() {
+        fprintf(stderr, "Usage: framecompare [--column <name>] [--hitch <ms>] [--block <frames>] [--replicates <count>]\n"
+            "                    [--alpha <level>] [--seed <seed>] <baseline> <capture> ...\n");
+        exit(1);
+    }
+}
+
+int main(int argc, char** argv) {
+    Options options;
+    std::vector<const char*> paths;
+    for (int arg = 1; arg < argc; arg++) {
+        bool value = arg + 1 < argc;
+        if (!strcmp(argv[arg], "--column") && value) {
+            options.column = argv[++arg];
+        }
+        else if (!strcmp(argv[arg], "--hitch") && value) {
+            options.hitchMs = strtod(argv[++arg], nullptr);
+        }
+        else if (!strcmp(argv[arg], "--block") && value) {
+            options.block = (uint32_t)strtoul(argv[++arg], nullptr, 10);
+        }
+        else if (!strcmp(argv[arg], "--replicates") && value) {
+            options.replicates = (uint32_t)strtoul(argv[++arg], nullptr, 10);
+        }
+        else if (!strcmp(argv[arg], "--alpha") && value) {
+            options.alpha = strtod(argv[++arg], nullptr);
+        }
+        else if (!strcmp(argv[arg], "--seed") && value) {
+            options.seed = strtoull(argv[++arg], nullptr, 10);
+        }
+        else if (argv[arg][0] == '-') {
+            usage();
+        }
+        else {
+            paths.push_back(argv[arg]);
+        }
+    }
+    if (paths.size() < 2 || options.block == 0 || options.replicates < 10 || !(options.alpha > 0 && options.alpha < 1)) {
+        usage();
+    }
+
+    Poisson poisson;
+    std::vector<Capture> captures;
+    captures.reserve(paths.size());
+    for (const char* path : paths) {
+        // Each capture draws its own weights, a fixed seed per position keeps reruns identical
+        std::mt19937_64 rng(options.seed + captures.size());
+        captures.emplace_back(path, options.replicates);
+        if (!read(&captures.back(), options, &rng, poisson)) {
+            return 1;
+        }
+    }
+
+    printf("%u replicates of %u frame blocks, %.0f%% confidence intervals\n\n", options.replicates, options.block,
+        (1 - options.alpha) * 100);
+    for (const auto& capture : captures) {
+        report(capture, options);
+    }
+    int worse = 0;
+    for (size_t i = 1; i < captures.size(); i++) {
+        worse += compare(captures[0], captures[i], options);
+    }
+    return worse ? 2 : 0;
+}
@@ -0,0 +1,232 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2024 Dominik Protasewicz
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/**
+ * @file glyphbench.cpp
+ * @brief Replays glyph request streams through the glyph atlas.
+ *
+ * Every request is looked up in a `GlyphCache::Atlas` and inserted on a miss, the way the
+ * game's rasterization is served. Each bitmap is filled from its key so every glyph handed
+ * out is checked against what was packed, a mismatch fails the run. Reports the hit rate
+ * next to the hit rate of a least recently used cache holding as many bitmap bytes as the
+ * atlas, which no packing can beat, and of an unbounded cache. Also reports how often
+ * pages were cleared, how full the atlas ended up and the time per request.
+ *
+ * Streams are recorded by the fix with `fixes.glyphCache.record`. Without any files a
+ * synthetic dialogue stream is generated.
+ *
+ * Usage: glyphbench [--page <bytes>] [--pages <count>] [<stream> ...]
+ */
+
+#include <cstdio>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <chrono>
+#include <list>
+#include <random>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "glyphcache.hpp"
+
+namespace
+{
+    struct Stream {
+        std::string name;
+        std::vector<GlyphCache::Request> requests;
+    };
+
+    /**
+     * @brief Dialogue-like requests, a few fonts over a large character set with a Zipf distribution.
+     */
+    Stream synthesize(size_t count, uint32_t characters, uint32_t seed) {
+        Stream stream{ "synthetic-" + std::to_string(characters), {} };
+        std::mt19937 rng(seed);
+        std::vector<double> weights(characters);
+        for (uint32_t i = 0; i < characters; i++) {
+            weights[i] = 1.0 / (i + 1);
+        }
+        std::discrete_distribution<uint32_t> character(weights.begin(), weights.end());
+        const uint32_t heights[] = { 24, 24, 24, 18, 32 };
+        for (size_t n = 0; n < count; n++) {
+            uint32_t font = rng() % 5;
+            uint32_t glyph = 0x3000 + character(rng);
+            uint32_t rows = heights[font] - glyph % 5;
+            uint32_t pitch = (heights[font] - glyph % 7 + 3) & ~3u;
+            // Spaces come without a bitmap
+            uint32_t size = glyph % 97 == 0 ? 0 : pitch * rows;
+            stream.requests.push_back({ { 0x1000 + font, 0x55, glyph, 6 }, size, rows });
+        }
+        return stream;
+    }
+
+    void fill(const GlyphCache::Key& key, uint8_t* bitmap, uint32_t size) {
+        uint64_t state = GlyphCache::KeyHash()(key) | 1;
+        for (uint32_t i = 0; i < size; i++) {
+            state ^= state << 13;
+            state ^= state >> 7;
+            state ^= state << 17;
+            bitmap[i] = (uint8_t)state;
+        }
+    }
+
+    using Bitmaps = std::unordered_map<GlyphCache::Key, std::vector<uint8_t>, GlyphCache::KeyHash>;
+
+    /**
+     * @brief Hits of a least recently used cache bounded to `capacity` bitmap bytes, packing aside
+     */
+    uint64_t lruHits(const Stream& stream, const Bitmaps& bitmaps, uint64_t capacity) {
+        using Order = std::list<GlyphCache::Key>;
+        Order order;
+        std::unordered_map<GlyphCache::Key, Order::iterator, GlyphCache::KeyHash> held;
+        uint64_t bytes = 0;
+        uint64_t hits = 0;
+        for (const auto& request : stream.requests) {
+            if (auto it = held.find(request.key); it != held.end()) {
+                order.splice(order.begin(), order, it->second);
+                hits++;
+                continue;
+            }
+            order.push_front(request.key);
+            held[request.key] = order.begin();
+            bytes += bitmaps.at(request.key).size();
+            while (bytes > capacity) {
+                bytes -= bitmaps.at(order.back()).size();
+                held.erase(order.back());
+                order.pop_back();
+            }
+        }
+        return hits;
+    }
+
+    /**
+     * @brief Run a stream through a fresh atlas
+     *
+     * @param check Compare every glyph handed out against its bitmap
+     * @return Number of glyphs handed out that did not match
+     */
+    uint64_t run(const Stream& stream, const Bitmaps& bitmaps, GlyphCache::Atlas* atlas, bool check) {
+        std::vector<uint8_t> out;
+        uint64_t mismatches = 0;
+        for (const auto& request : stream.requests) {
+            const auto& bitmap = bitmaps.at(request.key);
+            if (const GlyphCache::Glyph* glyph = atlas->find(request.key)) {
+                out.resize(glyph->size);
+                atlas->copy(*glyph, out.data());
+                mismatches += check && (out != bitmap || glyph->metrics[0] != (uint8_t)request.key.glyph);
+                continue;
+            }
+            uint8_t metrics = (uint8_t)request.key.glyph;
+            atlas->insert(request.key, &metrics, sizeof(metrics), bitmap.data(), (uint32_t)bitmap.size(), request.rows);
+        }
+        return mismatches;
+    }
+
+    /**
+     * @return false if a glyph handed out does not match what was packed
+     */
+    bool replay(const Stream& stream, uint32_t pageSize, uint32_t pages) {
+        // A glyph keeps the bitmap of its first request, as the atlas does
+        Bitmaps bitmaps;
+        for (const auto& request : stream.requests) {
+            auto [it, inserted] = bitmaps.try_emplace(request.key, request.size);
+            if (inserted) {
+                fill(request.key, it->second.data(), request.size);
+            }
+        }
+
+        GlyphCache::Atlas atlas(pageSize, pages);
+        auto start = std::chrono::steady_clock::now();
+        run(stream, bitmaps, &atlas, false);
+        double elapsed = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+
+        GlyphCache::Atlas checked(pageSize, pages);
+        uint64_t mismatches = run(stream, bitmaps, &checked, true);
+
+        const auto& stats = atlas.stats();
+        double requests = (double)stream.requests.size();
+        uint64_t lru = lruHits(stream, bitmaps, (uint64_t)pageSize * pageSize * pages);
+        printf("%-24s %10zu %8zu %7.1f%% %7.1f%% %7.1f%% %8llu %10llu %8llu %6.1f%% %8.1f\n", stream.name.c_str(),
+            stream.requests.size(), bitmaps.size(),
+            requests ? stats.hits * 100.0 / requests : 0.0,
+            requests ? lru * 100.0 / requests : 0.0,
+            requests ? (requests - bitmaps.size()) * 100.0 / requests : 0.0,
+            (unsigned long long)stats.evictedPages, (unsigned long long)stats.evictedGlyphs,
+            (unsigned long long)stats.rejected, atlas.occupancy() * 100, requests ? elapsed / requests : 0.0);
+        if (mismatches) {
+            printf("%-24s MISMATCH on %llu glyphs\n", stream.name.c_str(), (unsigned long long)mismatches);
+        }
+        return mismatches == 0;
+    }
+
+    void usage() {
+        fprintf(stderr, "Usage: glyphbench [--page <bytes>] [--pages <count>] [<stream> ...]\n");
+        exit(1);
+    }
+}
+
+int main(int argc, char** argv) {
+    uint32_t pageSize = 512;
+    uint32_t pages = 4;
+    std::vector<Stream> streams;
+
+    for (int arg = 1; arg < argc; arg++) {
+        if (!strcmp(argv[arg], "--page") && arg + 1 < argc) {
+            pageSize = (uint32_t)strtoul(argv[++arg], nullptr, 10);
+            continue;
+        }
+        if (!strcmp(argv[arg], "--pages") && arg + 1 < argc) {
+            pages = (uint32_t)strtoul(argv[++arg], nullptr, 10);
+            continue;
+        }
+        if (argv[arg][0] == '-') {
+            usage();
+        }
+        Stream stream{ argv[arg], {} };
+        if (!GlyphCache::read(argv[arg], &stream.requests)) {
+            fprintf(stderr, "Could not read '%s' as a glyph request stream\n", argv[arg]);
+            return 1;
+        }
+        streams.push_back(std::move(stream));
+    }
+    if (pageSize == 0 || pages == 0) {
+        usage();
+    }
+    if (streams.empty()) {
+        for (uint32_t characters : { 800u, 3000u, 8000u }) {
+            streams.push_back(synthesize(500000, characters, characters));
+        }
+    }
+
+    printf("%u pages of %u x %u bytes\n", pages, pageSize, pageSize);
+    printf("%-24s %10s %8s %8s %8s %8s %8s %10s %8s %7s %8s\n", "stream", "requests", "glyphs", "hits",
+        "lru", "ideal", "cleared", "evicted", "rejected", "used", "ns/req");
+    int failures = 0;
+    for (const auto& stream : streams) {
+        failures += !replay(stream, pageSize, pages);
+    }
+    return failures ? 1 : 0;
+}
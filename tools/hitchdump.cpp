@@ -0,0 +1,106 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2024 Dominik Protasewicz
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/**
+ * @file hitchdump.cpp
+ * @brief Lists the slow frames reported by the DLL with `hitch.enable`.
+ *
+ * Prints every slow frame with the time each kind of event overlapped it, followed by its
+ * longest events. Times are relative to the start of the first reported frame.
+ *
+ * Usage: hitchdump [--top <count>] <report>
+ */
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+#include "hitch.hpp"
+
+namespace
+{
+    int dump(const char* path, size_t top) {
+        std::vector<Hitch::Frame> frames;
+        if (!Hitch::read(path, &frames)) {
+            fprintf(stderr, "'%s' is not a hitch report\n", path);
+            return 1;
+        }
+        printf("%s: %zu slow frames\n", path, frames.size());
+        if (frames.empty()) {
+            return 0;
+        }
+
+        uint64_t origin = frames.front().start;
+        Hitch::Summary total;
+        for (auto& frame : frames) {
+            printf("\n%12.3f ms  frame took %.2f ms, %zu events\n", (frame.start - origin) / 1e6,
+                (frame.end - frame.start) / 1e6, frame.events.size());
+            Hitch::Summary summary = Hitch::summarize(frame);
+            for (int kind = 0; kind < Hitch::KindCount; kind++) {
+                if (summary.count[kind]) {
+                    printf("    %-10s %6u events %10.2f ms\n", Hitch::kindNames[kind], summary.count[kind],
+                        summary.overlap[kind] / 1e6);
+                }
+                total.count[kind] += summary.count[kind];
+                total.overlap[kind] += summary.overlap[kind];
+            }
+
+            std::sort(frame.events.begin(), frame.events.end(),
+                [](const Hitch::Event& a, const Hitch::Event& b) { return a.duration > b.duration; });
+            for (size_t i = 0; i < frame.events.size() && i < top; i++) {
+                const auto& event = frame.events[i];
+                printf("      %+10.3f ms %-10s thread %-8u %10.3f ms  arg %u\n",
+                    ((double)event.start - (double)frame.start) / 1e6,
+                    event.kind < Hitch::KindCount ? Hitch::kindNames[event.kind] : "?",
+                    event.thread, event.duration / 1e6, event.arg);
+            }
+        }
+
+        printf("\nAcross all slow frames\n");
+        for (int kind = 0; kind < Hitch::KindCount; kind++) {
+            printf("    %-10s %6u events %10.2f ms\n", Hitch::kindNames[kind], total.count[kind], total.overlap[kind] / 1e6);
+        }
+        return 0;
+    }
+
+    void usage() {
+        fprintf(stderr, "Usage: hitchdump [--top <count>] <report>\n");
+        exit(1);
+    }
+}
+
+int main(int argc, char** argv) {
+    size_t top = 5;
+    int arg = 1;
+    if (arg + 1 < argc && !strcmp(argv[arg], "--top")) {
+        top = strtoull(argv[arg + 1], nullptr, 10);
+        arg += 2;
+    }
+    if (arg + 1 != argc) {
+        usage();
+    }
+    return dump(argv[arg], top);
+}
@@ -0,0 +1,147 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2024 Dominik Protasewicz
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/**
+ * @file hookbench.cpp
+ * @brief Microbenchmark of what hook callbacks pay to read the configuration.
+ *
+ * Compares reading a flag out of a plain global struct, which is what the callbacks did
+ * before, with reading it through `Rcu`, unpinned and pinned, and through the usual locks.
+ * A second phase then hammers pinned reads from several threads while a writer keeps
+ * publishing new snapshots, checking that every snapshot a reader sees is intact and that
+ * replaced snapshots really are reclaimed.
+ *
+ * Usage: hookbench
+ */
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "rcu.hpp"
+
+namespace
+{
+    /**
+     * @brief Stand in for `yml_t`, `check` always mirrors `sequence` in a published snapshot.
+     */
+    struct Snapshot {
+        std::string name = "The Legend of Heroes - Trails in the Sky FC Fix";
+        bool masterEnable = true;
+        bool texturesEnable = true;
+        uint64_t sequence = 0;
+        uint64_t check = 0;
+    };
+
+    template <typename T>
+    inline void doNotOptimize(const T& value) {
+#if defined(__GNUC__) || defined(__clang__)
+        asm volatile("" : : "r,m"(value) : "memory");
+#else
+        static volatile T sink;
+        sink = value;
+#endif
+    }
+
+    template <typename Read>
+    double nanosecondsPerRead(Read read) {
+        constexpr size_t ITERATIONS = 50'000'000;
+        auto start = std::chrono::steady_clock::now();
+        for (size_t i = 0; i < ITERATIONS; i++) {
+            doNotOptimize(read());
+        }
+        auto elapsed = std::chrono::steady_clock::now() - start;
+        return std::chrono::duration<double, std::nano>(elapsed).count() / ITERATIONS;
+    }
+}
+
+int main() {
+    Snapshot plain;
+    Rcu<Snapshot> rcu;
+    rcu.publish(std::make_unique<Snapshot>());
+    std::mutex mutex;
+    std::shared_mutex sharedMutex;
+
+    printf("%-28s %8s\n", "read", "ns/read");
+    printf("%-28s %8.2f\n", "plain struct", nanosecondsPerRead([&] {
+        return plain.masterEnable;
+    }));
+    printf("%-28s %8.2f\n", "Rcu::load", nanosecondsPerRead([&] {
+        return rcu.load()->masterEnable;
+    }));
+    printf("%-28s %8.2f\n", "Rcu::read (pinned)", nanosecondsPerRead([&] {
+        auto snapshot = rcu.read();
+        return snapshot->masterEnable;
+    }));
+    printf("%-28s %8.2f\n", "std::mutex", nanosecondsPerRead([&] {
+        std::lock_guard lock(mutex);
+        return plain.masterEnable;
+    }));
+    printf("%-28s %8.2f\n", "std::shared_mutex (shared)", nanosecondsPerRead([&] {
+        std::shared_lock lock(sharedMutex);
+        return plain.masterEnable;
+    }));
+
+    std::atomic<bool> stop = false;
+    std::atomic<uint64_t> reads = 0;
+    std::atomic<uint64_t> torn = 0;
+    std::vector<std::thread> readers;
+    for (int i = 0; i < 3; i++) {
+        readers.emplace_back([&] {
+            uint64_t count = 0;
+            while (!stop.load(std::memory_order_relaxed)) {
+                auto snapshot = rcu.read();
+                if (snapshot->check != snapshot->sequence || snapshot->name.empty()) {
+                    torn++;
+                }
+                count++;
+            }
+            reads += count;
+        });
+    }
+
+    uint64_t published = 0;
+    auto until = std::chrono::steady_clock::now() + std::chrono::seconds(1);
+    while (std::chrono::steady_clock::now() < until) {
+        auto next = std::make_unique<Snapshot>();
+        next->sequence = next->check = ++published;
+        rcu.publish(std::move(next));
+        std::this_thread::sleep_for(std::chrono::microseconds(100));
+    }
+    stop = true;
+    for (auto& reader : readers) {
+        reader.join();
+    }
+    rcu.publish(std::make_unique<Snapshot>());
+
+    printf("\n%llu pinned reads against %llu publishes, %llu torn, %zu snapshots awaiting reclamation\n",
+        (unsigned long long)reads.load(), (unsigned long long)published, (unsigned long long)torn.load(), rcu.pending());
+    return torn ? 1 : 0;
+}
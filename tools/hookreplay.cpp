@@ -0,0 +1,193 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2024 Dominik Protasewicz
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/**
+ * @file hookreplay.cpp
+ * @brief Replays recorded mid hook contexts through the callbacks, no game required.
+ *
+ * A trace recorded by the DLL with `trace.enable` holds, for every callback invocation,
+ * the context the callback received and the one it left behind. Each recorded context is
+ * fed back through the same callback code from `callbacks.hpp` and the result compared
+ * to the recorded one, so any change in behaviour shows up as a mismatch. Every site is
+ * then replayed repeatedly to measure what its callback costs per call.
+ *
+ * `--synthesize` writes a trace of random contexts run through the current callbacks,
+ * to try the tool out or to pin down today's behaviour before changing a callback.
+ *
+ * Usage: hookreplay [--iterations <count>] <trace>
+ *        hookreplay --synthesize <trace> <records>
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "callbacks.hpp"
+#include "hookcontext.hpp"
+#include "hooktrace.hpp"
+
+namespace
+{
+    template <typename T>
+    inline void doNotOptimize(const T& value) {
+#if defined(__GNUC__) || defined(__clang__)
+        asm volatile("" : : "r,m"(value) : "memory");
+#else
+        static volatile const T* sink;
+        sink = &value;
+#endif
+    }
+
+    std::vector<std::string> siteNames() {
+        return std::vector<std::string>(Callbacks::siteNames, Callbacks::siteNames + Callbacks::SiteCount);
+    }
+
+    int synthesize(const char* path, size_t count) {
+        HookTrace::Writer writer(path, siteNames(), UINT64_MAX);
+        if (!writer.isOpen()) {
+            fprintf(stderr, "Could not create '%s'\n", path);
+            return 1;
+        }
+        std::mt19937_64 random(1);
+        for (size_t i = 0; i < count; i++) {
+            HookContext32 before;
+            auto words = reinterpret_cast<uint32_t*>(&before);
+            for (size_t j = 0; j < HookContext::SIZE / sizeof(uint32_t); j++) {
+                words[j] = (uint32_t)random();
+            }
+            // Only sites whose callbacks can be replayed
+            Callbacks::Site site;
+            HookContext32 after;
+            do {
+                site = (Callbacks::Site)(random() % Callbacks::SiteCount);
+                after = before;
+            } while (!Callbacks::run(site, after));
+            writer.write(site, before, after);
+        }
+        printf("Wrote %zu records to '%s'\n", count, path);
+        return 0;
+    }
+
+    int replay(const char* path, size_t iterations) {
+        std::vector<std::string> sites;
+        std::vector<HookTrace::Record> records;
+        if (!HookTrace::read(path, &sites, &records)) {
+            fprintf(stderr, "'%s' is not a hook trace\n", path);
+            return 1;
+        }
+
+        // Sites are matched by name, the trace may come from an older or newer build
+        std::vector<int> siteMap(sites.size(), -1);
+        for (size_t i = 0; i < sites.size(); i++) {
+            for (int j = 0; j < Callbacks::SiteCount; j++) {
+                if (sites[i] == Callbacks::siteNames[j]) {
+                    siteMap[i] = j;
+                }
+            }
+        }
+
+        printf("%s: %zu records\n", path, records.size());
+        printf("%-12s %10s %12s %12s %12s\n", "site", "calls", "calls/s", "mismatches", "ns/call");
+        int failed = 0;
+        for (size_t i = 0; i < sites.size(); i++) {
+            std::vector<const HookTrace::Record*> calls;
+            for (const auto& record : records) {
+                if (record.site == i) {
+                    calls.push_back(&record);
+                }
+            }
+            if (calls.empty()) {
+                continue;
+            }
+            if (siteMap[i] < 0) {
+                printf("%-12s %10zu   no callback in this build\n", sites[i].c_str(), calls.size());
+                continue;
+            }
+            auto site = (Callbacks::Site)siteMap[i];
+            HookContext32 probe = calls.front()->before;
+            if (!Callbacks::run(site, probe)) {
+                printf("%-12s %10zu   acts on game state, not replayable\n", sites[i].c_str(), calls.size());
+                continue;
+            }
+
+            size_t mismatches = 0;
+            for (auto call : calls) {
+                HookContext32 ctx = call->before;
+                Callbacks::run(site, ctx);
+                mismatches += memcmp(&ctx, &call->after, HookContext::SIZE) != 0;
+            }
+            failed |= mismatches != 0;
+
+            double span = (calls.back()->timestamp - calls.front()->timestamp) / 1e9;
+            double rate = span > 0 ? (calls.size() - 1) / span : 0.0;
+
+            // Best of several runs, each replaying every call of the site `iterations` times
+            double best = 1e30;
+            for (int run = 0; run < 5; run++) {
+                auto start = std::chrono::steady_clock::now();
+                for (size_t n = 0; n < iterations; n++) {
+                    for (auto call : calls) {
+                        HookContext32 ctx = call->before;
+                        Callbacks::run(site, ctx);
+                        doNotOptimize(ctx);
+                    }
+                }
+                std::chrono::duration<double, std::nano> elapsed = std::chrono::steady_clock::now() - start;
+                best = std::min(best, elapsed.count() / (double)(iterations * calls.size()));
+            }
+            printf("%-12s %10zu %12.1f %12zu %12.2f\n", sites[i].c_str(), calls.size(), rate, mismatches, best);
+        }
+        return failed;
+    }
+
+    void usage() {
+        fprintf(stderr, "Usage: hookreplay [--iterations <count>] <trace>\n");
+        fprintf(stderr, "       hookreplay --synthesize <trace> <records>\n");
+        exit(1);
+    }
+}
+
+int main(int argc, char** argv) {
+    size_t iterations = 100;
+    int arg = 1;
+    if (arg < argc && !strcmp(argv[arg], "--synthesize")) {
+        if (argc != 4) {
+            usage();
+        }
+        return synthesize(argv[2], strtoull(argv[3], nullptr, 10));
+    }
+    if (arg + 1 < argc && !strcmp(argv[arg], "--iterations")) {
+        iterations = std::max<size_t>(1, strtoull(argv[arg + 1], nullptr, 10));
+        arg += 2;
+    }
+    if (arg + 1 != argc) {
+        usage();
+    }
+    return replay(argv[arg], iterations);
+}
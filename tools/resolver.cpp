@@ -0,0 +1,143 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2024 Dominik Protasewicz
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/**
+ * @file resolver.cpp
+ * @brief Resolves the fixed signatures against game executables at build time.
+ *
+ * Every signature in `Signatures::list` is scanned for in the mapped image of each given
+ * executable and the RVA of its first match is written, keyed by the identity of the
+ * executable, into a header of `constexpr` tables. The DLL embeds that header and on a
+ * build it knows only checks the pattern at the recorded RVA instead of scanning the
+ * whole image. The build runs it against the executable in the game folder; passing
+ * several executables, e.g. other store releases, embeds all of them.
+ *
+ * Signatures that are missing or ambiguous in a build are reported, and recorded as 0
+ * so that the DLL scans for them as it would on an unknown build.
+ *
+ * Usage: resolver <output header> <executable> [<executable> ...]
+ */
+
+#include <cstdio>
+#include <cstdint>
+#include <cinttypes>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <vector>
+
+#include "scanner.hpp"
+#include "peimage.hpp"
+#include "signatures.hpp"
+
+namespace
+{
+    bool readFile(const char* path, std::vector<uint8_t>* contents) {
+        std::ifstream file(path, std::ios::binary);
+        if (!file) {
+            return false;
+        }
+        contents->assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+        return true;
+    }
+
+    /**
+     * @brief Resolve every signature in one executable.
+     *
+     * @param path Executable
+     * @param build Filled in with the identity and RVAs
+     * @return false if the executable could not be read or is not a PE file
+     */
+    bool resolve(const char* path, Signatures::Build* build) {
+        std::vector<uint8_t> file, image;
+        if (!readFile(path, &file) || !PeImage::identify(file.data(), file.size(), &build->identity) ||
+            !PeImage::map(file, &image))
+        {
+            fprintf(stderr, "resolver: '%s' is not a PE executable\n", path);
+            return false;
+        }
+
+        for (int i = 0; i < Signatures::Count; i++) {
+            const auto& signature = Signatures::list[i];
+            auto pattern = Scanner::compile(signature.pattern);
+            std::vector<size_t> offsets;
+            Scanner::findAll(image.data(), image.size(), pattern, &offsets);
+
+            build->rva[i] = offsets.empty() ? 0 : (uint32_t)offsets[0];
+            if (offsets.empty()) {
+                fprintf(stderr, "resolver: warning: '%s' not found in '%s'\n", signature.name, path);
+            }
+            else if (offsets.size() > 1) {
+                fprintf(stderr, "resolver: warning: '%s' found %zu times in '%s', using the first\n",
+                    signature.name, offsets.size(), path);
+            }
+            printf("resolver: %s @ 0x%" PRIx32 "\n", signature.name, build->rva[i]);
+        }
+        return true;
+    }
+}
+
+int main(int argc, char** argv) {
+    if (argc < 3) {
+        fprintf(stderr, "Usage: resolver <output header> <executable> [<executable> ...]\n");
+        return 1;
+    }
+
+    std::string header =
+        "// Generated by tools/resolver.cpp from the game executable, do not edit\n"
+        "\n"
+        "#pragma once\n"
+        "\n"
+        "#include \"signatures.hpp\"\n"
+        "\n"
+        "namespace Signatures\n"
+        "{\n"
+        "    inline constexpr Build resolvedBuilds[] = {\n";
+    for (int arg = 2; arg < argc; arg++) {
+        Signatures::Build build{};
+        if (!resolve(argv[arg], &build)) {
+            return 1;
+        }
+        header += "        // " + std::string(argv[arg]) + "\n";
+        char line[128];
+        snprintf(line, sizeof(line), "        { { 0x%08" PRIx32 ", 0x%08" PRIx32 ", 0x%08" PRIx32 " }, {",
+            build.identity.timeDateStamp, build.identity.sizeOfImage, build.identity.checkSum);
+        header += line;
+        for (int i = 0; i < Signatures::Count; i++) {
+            snprintf(line, sizeof(line), "%s 0x%" PRIx32, i ? "," : "", build.rva[i]);
+            header += line;
+        }
+        header += " } },\n";
+    }
+    header +=
+        "    };\n"
+        "}\n";
+
+    std::ofstream output(argv[1], std::ios::binary | std::ios::trunc);
+    if (!(output << header)) {
+        fprintf(stderr, "resolver: could not write '%s'\n", argv[1]);
+        return 1;
+    }
+    return 0;
+}